@@ -428,6 +428,7 @@ public:
     Label_vm = -16L,           ///< Protocol ID for VM objects (used for create
                                ///  operations on a factory).
     Label_semaphore = -20L,    ///< Protocol ID for semaphore objects.
+    Label_msg_queue = -22L,    ///< Protocol ID for message-queue objects.
   };
 private:
   Mword _tag;
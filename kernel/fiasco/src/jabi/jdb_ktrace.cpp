@@ -28,9 +28,24 @@ enum {
   Kern_cnt_schedule          = 9,
   Kern_cnt_iobmap_tlb_flush  = 10,
   Kern_cnt_exc_ipc           = 11,
+  Kern_cnt_tlb_shootdown     = 12,
+  Kern_cnt_tlb_ipi           = 13,
+  Kern_cnt_tlb_pages         = 14,
   Kern_cnt_max
 };
 
+enum {
+  Lat_hist_ipc_call          = 0,
+  Lat_hist_ipc_reply_wait    = 1,
+  Lat_hist_page_fault        = 2,
+  Lat_hist_map               = 3,
+  Lat_hist_unmap             = 4,
+  Lat_hist_thread_switch     = 5,
+  Lat_hist_irq               = 6,
+  Lat_hist_max,
+  Lat_hist_buckets           = 32,
+};
+
 struct Tracebuffer_status_window
 {
   Address    tracebuffer;
@@ -40,6 +55,7 @@ struct Tracebuffer_status_window
 
 struct Tracebuffer_status
 {
+  // window[] and current are not updated any more, see Tracebuffer_stream
   Tracebuffer_status_window window[2];
   Address                   current;
   Unsigned32                logevents[Log_event_max];
@@ -50,3 +66,58 @@ struct Tracebuffer_status
 
   Unsigned32 kerncnts[Kern_cnt_max];
 };
+
+enum
+{
+  Tbuf_max_segments    = 32,
+  Tbuf_stream_offset   = 1024, ///< offset of Tracebuffer_stream in status page
+  Tbuf_lat_hist_offset = 3584, ///< offset of Tracebuffer_lat_hist
+};
+
+/**
+ * One per-CPU segment of the trace buffer.
+ *
+ * A segment is a ring of `entries` records. `head` counts the records
+ * completely written to this segment since boot; record `n` lives at
+ * index `n & (entries - 1)`. A reader owns no part of the ring: it has
+ * to check `head` again after copying a record to detect overwrites.
+ */
+struct Tracebuffer_segment
+{
+  Address tracebuffer;  ///< user address of the first record
+  Mword   entries;      ///< number of records, power of 2
+  Mword   head;         ///< records written, free running
+} __attribute__((aligned(64)));
+
+/**
+ * Streaming view of the trace buffer, at Tbuf_stream_offset in the
+ * status page.
+ */
+struct Tracebuffer_stream
+{
+  Mword num_segments;   ///< valid entries in segment[]
+  Mword entry_size;     ///< size of a record in bytes
+  Mword watermark;      ///< records per segment between two notifications
+  Tracebuffer_segment segment[Tbuf_max_segments];
+};
+
+/**
+ * Per-CPU latency histograms, at Tbuf_lat_hist_offset in the status page.
+ * `hist` is 0 if the kernel does not record them (CONFIG_LATENCY_HIST).
+ *
+ * The histograms of CPU `c` start at `hist + c * cpu_stride`: one row
+ * of `num_buckets` Mword counters per kind (Lat_hist_*).  Bucket 0
+ * counts latencies below 2 TSC ticks, bucket i latencies of
+ * [2^i, 2^(i+1)) ticks, the last bucket everything longer.  A call is
+ * measured from its entry to the reply, a reply-and-wait up to the
+ * delivery of the reply, an IRQ from its hit to the delivery of the
+ * notification.
+ */
+struct Tracebuffer_lat_hist
+{
+  Address hist;         ///< user address of the histograms of CPU 0
+  Mword   cpu_stride;   ///< distance between the histograms of two CPUs
+  Mword   num_cpus;
+  Mword   num_kinds;
+  Mword   num_buckets;
+};
@@ -369,9 +369,7 @@ Jdb::peek_task(Address addr, Space *task, void *value, int width)
   if (!task && Kmem::is_kmem_page_fault(addr, 0))
     {
       // address of kernel directory
-      Address pdbr;
-      asm volatile ("mov %%cr3, %0" : "=r" (pdbr));
-      Pdir *kdir = (Pdir*)Mem_layout::phys_to_pmem(pdbr);
+      Pdir *kdir = (Pdir*)Mem_layout::phys_to_pmem(Cpu::get_pdbr_addr());
       auto i = kdir->walk(Virt_addr(addr));
       if (i.is_valid())
 	{
@@ -406,9 +404,7 @@ Jdb::poke_task(Address addr, Space *task, void const *value, int width)
 
   if (task && Kmem::is_kmem_page_fault(addr, 0))
     {
-      Address pdbr;
-      asm volatile ("mov %%cr3, %0" : "=r" (pdbr));
-      Pdir *kdir = (Pdir*)Mem_layout::phys_to_pmem(pdbr);
+      Pdir *kdir = (Pdir*)Mem_layout::phys_to_pmem(Cpu::get_pdbr_addr());
       auto i = kdir->walk(Virt_addr(addr));
       if (i.is_valid())
 	{
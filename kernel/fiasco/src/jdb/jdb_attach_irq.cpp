@@ -193,6 +193,11 @@ Jdb_kobject_irq::show_kobject_short(String_buffer *buf, Kobject_common *o)
               w != o ?  w->dbg_info()->dbg_id() : 0,
               (unsigned)i->flags(),
               t ? t->queued() : -1);
+
+  if (t && t->_mod.max_events)
+    buf->printf(" M=%lu/%luus E=%lu N=%lu",
+                t->_mod.max_events, t->_mod.max_delay,
+                t->_mod.events, t->_mod.notifications);
 }
 
 static
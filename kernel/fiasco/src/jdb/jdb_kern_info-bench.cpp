@@ -26,9 +26,591 @@ void
 Jdb_kern_info_bench::show()
 {
   do_mp_benchmark();
+  do_timeout_benchmark();
+  do_kmem_benchmark();
+  do_mapdb_benchmark();
+  do_mapdb_map_benchmark();
+  do_ready_queue_benchmark();
   show_arch();
 }
 
+//---------------------------------------------------------------------------
+IMPLEMENTATION:
+
+#include "kip.h"
+#include "timeout.h"
+
+/**
+ * Cost of enqueuing and dequeuing a timeout depending on the number of
+ * pending timeouts.  Uses a private timeout queue that never reprograms
+ * the timer.
+ */
+PRIVATE static
+void
+Jdb_kern_info_bench::do_timeout_benchmark()
+{
+  enum { Max_pending = 1024, Rounds = 64 };
+  static Timeout to[Max_pending + Rounds];
+  static Timeout_q q;
+  Unsigned64 now = Kip::k()->clock;
+  Unsigned32 seed = 1;
+
+  q._current = 0;
+  q.set_tick(now);
+
+  printf("Timeout enqueue/dequeue:\n");
+  for (unsigned pending = 16; pending <= Max_pending; pending <<= 2)
+    {
+      // wakeups spread over the next 2 seconds
+      for (unsigned i = 0; i < pending + Rounds; ++i)
+        {
+          seed = seed * 1103515245 + 12345;
+          to[i]._wakeup = now + 1 + (seed >> 8) % 2000000;
+        }
+
+      for (unsigned i = 0; i < pending; ++i)
+        q.enqueue(&to[i]);
+
+      Unsigned64 time = get_time_now();
+      for (unsigned i = pending; i < pending + Rounds; ++i)
+        q.enqueue(&to[i]);
+      Unsigned64 enq = get_time_now() - time;
+
+      time = get_time_now();
+      for (unsigned i = pending; i < pending + Rounds; ++i)
+        to[i].dequeue(false);
+      Unsigned64 deq = get_time_now() - time;
+
+      for (unsigned i = 0; i < pending; ++i)
+        to[i].dequeue(false);
+
+      printf("  %4u pending: enqueue %6lld  dequeue %6lld\n",
+             pending, enq / Rounds, deq / Rounds);
+    }
+}
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION:
+
+#include "kmem_alloc.h"
+#include "mem.h"
+#include "per_cpu_data.h"
+
+static Mword kmem_bench_go;
+static Per_cpu_array<Mword> kmem_bench_done;
+static Per_cpu_array<Unsigned64> kmem_bench_cycles;
+
+/**
+ * Allocate and free batches of pages on `cpu`, either through the
+ * per-CPU hot lists or directly from the global buddy allocator.
+ */
+PRIVATE static
+void
+Jdb_kern_info_bench::kmem_bench_cpu(Cpu_number cpu, bool hot)
+{
+  enum { Batch = 12, Rounds = 256 };
+  void *blocks[Batch];
+  unsigned long const size = Config::PAGE_SIZE;
+  int o = Kmem_alloc::hot_order(size);
+
+  while (!access_once(&kmem_bench_go))
+    Proc::pause();
+
+  Unsigned64 time = get_time_now();
+  for (unsigned r = 0; r < Rounds; ++r)
+    {
+      unsigned n;
+      for (n = 0; n < Batch; ++n)
+        if (!(blocks[n] = hot ? Kmem_alloc::hot_alloc(cpu, o)
+                              : Kmem_alloc::global_alloc(size)))
+          break;
+
+      while (n)
+        if (hot)
+          Kmem_alloc::hot_free(cpu, o, blocks[--n]);
+        else
+          Kmem_alloc::global_free(size, blocks[--n]);
+    }
+
+  kmem_bench_cycles[cpu] = (get_time_now() - time) / (Rounds * Batch);
+  Mem::barrier();
+  write_now(&kmem_bench_done[cpu], (Mword)1);
+}
+
+/**
+ * Page allocation and free from all CPUs at the same time, with and
+ * without the per-CPU hot lists of Kmem_alloc.
+ */
+PRIVATE static
+void
+Jdb_kern_info_bench::do_kmem_benchmark()
+{
+  if (Kmem_alloc::hot_order(Config::PAGE_SIZE) < 0)
+    return;
+
+  printf("Kmem page alloc+free, all CPUs concurrently (cycles):\n");
+  for (int hot = 1; hot >= 0; --hot)
+    {
+      unsigned long locks = Kmem_alloc::_lock_acquired;
+      write_now(&kmem_bench_go, (Mword)0);
+
+      for (Cpu_number u = Cpu_number::first(); u < Config::max_num_cpus(); ++u)
+        {
+          kmem_bench_done[u] = 0;
+          if (Cpu::online(u) && u != Cpu_number::boot_cpu())
+            Jdb::remote_work(u, [hot](Cpu_number cpu)
+                                { kmem_bench_cpu(cpu, hot); }, false);
+        }
+
+      Mem::barrier();
+      write_now(&kmem_bench_go, (Mword)1);
+      kmem_bench_cpu(Cpu_number::boot_cpu(), hot);
+
+      printf("  %-10s", hot ? "hot lists" : "global");
+      for (Cpu_number u = Cpu_number::first(); u < Config::max_num_cpus(); ++u)
+        if (Cpu::online(u))
+          {
+            while (!access_once(&kmem_bench_done[u]))
+              Proc::pause();
+            Mem::barrier();
+            printf(" %2u:%6lld", cxx::int_value<Cpu_number>(u),
+                   kmem_bench_cycles[u]);
+          }
+      printf("  (%lu lock acquisitions)\n",
+             Kmem_alloc::_lock_acquired - locks);
+    }
+}
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION:
+
+#include "kernel_task.h"
+#include "mapdb.h"
+#include "mapping_tree.h"
+
+/**
+ * Build the mapping tree of frame `phys` with `width` children of the
+ * root and a chain of `depth` mappings below the last child.  The
+ * mappings are entered into the kernel task at `va` and up.
+ * @return the number of inserted mappings.
+ */
+static unsigned
+mapdb_build_tree(Mapdb *m, Mapdb::Pfn phys, Mapdb::Pfn va,
+                 unsigned width, unsigned depth)
+{
+  Space *s = Kernel_task::kernel_task();
+  unsigned inserted = 0;
+
+  for (unsigned i = 0; i < width + depth; ++i)
+    {
+      Mapping *node;
+      Mapdb::Frame frame;
+      bool found = i < width
+        ? m->lookup(s, phys, phys, &node, &frame)
+        : m->lookup(s, va + Mapdb::Pcnt(i - 1), phys, &node, &frame);
+      if (!found)
+        continue;
+
+      if (m->insert(frame, node, s, va + Mapdb::Pcnt(i), phys, Mapdb::Pcnt(1)))
+        ++inserted;
+
+      Mapdb::free(frame);
+    }
+
+  return inserted;
+}
+
+/** Tree header of `m`, found by walking up to the root mapping. */
+static Mapping_tree *
+mapdb_walk_head_of(Mapping *m)
+{
+  while (Mapping *p = m->parent())
+    m = p;
+
+  return reinterpret_cast<Mapping_tree *>
+    (reinterpret_cast<char *>(m) - sizeof(Mapping_tree));
+}
+
+/**
+ * The backward scan over the tree array that was used to find the tree
+ * header before the array slots carried root hints.  Only valid for
+ * trees that are not linked.
+ */
+static Mapping_tree *
+mapdb_scan_head_of(Mapping *m)
+{
+  while (m->depth() > Mapping::Depth_root)
+    {
+      if (m->depth() <= Mapping::Depth_max)
+        {
+          m -= m->depth();
+          continue;
+        }
+
+      m--;
+    }
+
+  return reinterpret_cast<Mapping_tree *>
+    (reinterpret_cast<char *>(m) - sizeof(Mapping_tree));
+}
+
+/**
+ * Check Mapping_tree::head_of() on the last mapping of trees of
+ * different shapes against walking up the tree, and compare its cost
+ * with the old backward scan.  Uses a private mapping database.
+ */
+PRIVATE static
+void
+Jdb_kern_info_bench::do_mapdb_benchmark()
+{
+  static struct { unsigned width, depth; } const shapes[] =
+  { { 4, 4 }, { 64, 4 }, { 768, 4 }, { 4, 64 }, { 4, 200 }, { 768, 200 },
+    { 3000, 200 } };
+  enum { Trees = sizeof(shapes) / sizeof(shapes[0]), Rounds = 1000 };
+  static size_t const page_shifts[] = { 0 };
+
+  Space *s = Kernel_task::kernel_task();
+  Mapdb m(s, Mapping::Page(Trees), page_shifts, 1);
+  // the children live above the root pages of all trees
+  Mapdb::Pfn const va(Trees);
+
+  auto cost = [](Mapping_tree *(*head_of)(Mapping *), Mapping *node)
+    {
+      Mapping_tree *volatile t;
+      Unsigned64 time = get_time_now();
+      for (unsigned i = 0; i < Rounds; ++i)
+        t = head_of(node);
+      (void)t;
+      return (get_time_now() - time) / Rounds;
+    };
+
+  printf("Mapdb head_of (cycles):\n");
+  for (unsigned k = 0; k < Trees; ++k)
+    {
+      unsigned width = shapes[k].width;
+      unsigned depth = shapes[k].depth;
+      Mapdb::Pfn phys(k);
+      Mapping *node;
+      Mapdb::Frame frame;
+
+      printf("  width %4u depth %3u:", width, depth);
+      if (mapdb_build_tree(&m, phys, va, width, depth) != width + depth
+          || !m.lookup(s, va + Mapdb::Pcnt(width + depth - 1), phys,
+                       &node, &frame))
+        {
+          printf(" out of memory\n");
+          continue;
+        }
+
+      Mapping_tree *t = mapdb_walk_head_of(node);
+      bool ok = Mapping_tree::head_of(node) == t;
+
+      printf(" head_of %5lld", cost(Mapping_tree::head_of, node));
+      if (!t->is_linked())
+        {
+          ok = ok && mapdb_scan_head_of(node) == t;
+          printf("  backward scan %5lld", cost(mapdb_scan_head_of, node));
+        }
+      else
+        printf("  (linked)");
+
+      printf("  %s\n", ok ? "ok" : "FAILED");
+      Mapdb::free(frame);
+    }
+}
+
+/**
+ * Cost of mapping a frame to many places and unmapping it again, for
+ * trees that fit into the largest tree array and for linked trees.
+ * Also checks that a linked tree becomes a plain array again once all
+ * its mappings are gone.
+ */
+PRIVATE static
+void
+Jdb_kern_info_bench::do_mapdb_map_benchmark()
+{
+  static unsigned const widths[] = { 64, 256, 1024, 4096 };
+  enum { Trees = sizeof(widths) / sizeof(widths[0]) };
+  static size_t const page_shifts[] = { 0 };
+
+  Space *s = Kernel_task::kernel_task();
+  Mapdb m(s, Mapping::Page(Trees), page_shifts, 1);
+  Mapdb::Pfn const va(Trees);
+
+  printf("Mapdb map/unmap (cycles per mapping):\n");
+  for (unsigned k = 0; k < Trees; ++k)
+    {
+      unsigned width = widths[k];
+      Mapdb::Pfn phys(k);
+      Mapping *node;
+      Mapdb::Frame frame;
+      unsigned unmapped = 0;
+
+      Unsigned64 time = get_time_now();
+      unsigned mapped = mapdb_build_tree(&m, phys, va, width, 0);
+      Unsigned64 map = get_time_now() - time;
+
+      if (!m.lookup(s, phys, phys, &node, &frame))
+        continue;
+
+      bool linked = mapdb_walk_head_of(node)->is_linked();
+      Mapdb::free(frame);
+
+      time = get_time_now();
+      for (unsigned i = 0; i < width; ++i)
+        {
+          Mapdb::Pfn a = va + Mapdb::Pcnt(i);
+          if (!m.lookup(s, a, phys, &node, &frame))
+            continue;
+
+          Mapdb::flush(frame, node, L4_map_mask::full(), a, a + Mapdb::Pcnt(1));
+          Mapdb::free(frame);
+          ++unmapped;
+        }
+      Unsigned64 unmap = get_time_now() - time;
+
+      bool ok = mapped == width && unmapped == width
+                && linked == (width > (4U << Mapping_tree::Size_id_max));
+      if (m.lookup(s, phys, phys, &node, &frame))
+        {
+          Mapping_tree *t = mapdb_walk_head_of(node);
+          ok = ok && !t->is_linked() && t->_count == 1;
+          Mapdb::free(frame);
+        }
+      else
+        ok = false;
+
+      printf("  width %4u%-9s: map %6lld  unmap %6lld  %s\n",
+             width, linked ? " (linked)" : "", map / width, unmap / width,
+             ok ? "ok" : "FAILED");
+    }
+}
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION [!(sched_fixed_prio || sched_fp_wfq)]:
+
+PRIVATE static inline
+void
+Jdb_kern_info_bench::do_ready_queue_benchmark()
+{}
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION [sched_fixed_prio || sched_fp_wfq]:
+
+#include <cxx/dlist>
+#include "ready_queue_fp.h"
+
+/** The parts of a scheduling context that Ready_queue_fp uses. */
+class Bench_sc : public cxx::D_list_item
+{
+public:
+  typedef cxx::Sd_list<Bench_sc> Fp_list;
+
+  unsigned short prio() const { return _prio; }
+  bool in_ready_list() const { return Fp_list::in_list(this); }
+
+  unsigned short _prio;
+};
+
+/**
+ * The former fixed-priority ready queue that only kept the highest
+ * priority and scanned downwards on dequeue, for comparison.
+ */
+class Bench_scan_rq
+{
+public:
+  typedef Bench_sc::Fp_list List;
+
+  void enqueue(Bench_sc *i, bool)
+  {
+    if (i->prio() > prio_highest)
+      prio_highest = i->prio();
+
+    prio_next[i->prio()].push(i, List::Back);
+  }
+
+  void dequeue(Bench_sc *i)
+  {
+    prio_next[i->prio()].remove(i);
+
+    while (prio_next[prio_highest].empty() && prio_highest)
+      prio_highest--;
+  }
+
+  Bench_sc *next_to_run() const
+  { return prio_next[prio_highest].front(); }
+
+  unsigned prio_highest;
+  List prio_next[256];
+};
+
+class Bench_rq : public Ready_queue_fp<Bench_sc>
+{
+public:
+  enum { Threads = 512 };
+  static Bench_sc sc[Threads];
+
+  /**
+   * Check the priority bitmap against the ready threads (all of them
+   * are in sc[]).
+   */
+  bool bitmap_consistent() const
+  {
+    Unsigned64 map[4] = { 0, 0, 0, 0 };
+    unsigned summary = 0;
+
+    for (unsigned i = 0; i < Threads; ++i)
+      if (sc[i].in_ready_list())
+        {
+          unsigned p = sc[i].prio();
+          map[p / 64] |= Unsigned64(1) << (p % 64);
+          summary |= 1U << (p / 64);
+        }
+
+    for (unsigned w = 0; w < 4; ++w)
+      if (prio_map(w) != map[w])
+        return false;
+
+    return prio_summary() == summary;
+  }
+
+  /**
+   * Enqueue and dequeue random threads and compare the highest priority
+   * with a count of the ready threads per priority.
+   */
+  bool check_random()
+  {
+    static unsigned count[256];
+    Unsigned32 seed = 4711;
+    bool ok = true;
+
+    for (unsigned i = 0; i < Threads; ++i)
+      {
+        seed = seed * 1103515245 + 12345;
+        sc[i]._prio = (seed >> 16) % 256;
+      }
+
+    for (unsigned round = 0; round < 20000 && ok; ++round)
+      {
+        seed = seed * 1103515245 + 12345;
+        Bench_sc *t = &sc[(seed >> 16) % Threads];
+        if (t->in_ready_list())
+          {
+            dequeue(t);
+            --count[t->prio()];
+          }
+        else
+          {
+            enqueue(t, false);
+            ++count[t->prio()];
+          }
+
+        unsigned highest = 255;
+        while (highest && !count[highest])
+          --highest;
+
+        ok = prio_highest() == highest
+             && (next_to_run() != 0) == (count[highest] != 0);
+      }
+
+    ok = ok && bitmap_consistent();
+
+    for (unsigned i = 0; i < Threads; ++i)
+      if (sc[i].in_ready_list())
+        {
+          dequeue(&sc[i]);
+          --count[sc[i].prio()];
+        }
+
+    return ok && next_to_run() == 0;
+  }
+
+  /**
+   * The scheduler's part of a context switch: the running thread
+   * blocks, its successor is picked, and the blocked thread becomes
+   * ready again at the back of its list.
+   */
+  template<typename Q>
+  static Unsigned64 switch_time(Q &rq, Unsigned64 (*now)())
+  {
+    enum { Rounds = 4096 };
+    Bench_sc *volatile sink;
+
+    Unsigned64 time = now();
+    for (unsigned i = 0; i < Rounds; ++i)
+      {
+        Bench_sc *t = rq.next_to_run();
+        rq.dequeue(t);
+        sink = rq.next_to_run();
+        rq.enqueue(t, false);
+      }
+    (void)sink;
+
+    return (now() - time) / Rounds;
+  }
+};
+
+Bench_sc Bench_rq::sc[Bench_rq::Threads];
+
+/**
+ * Check the priority bitmap of Ready_queue_fp and compare the cost of a
+ * context switch with the former downward scan, for sparse and dense
+ * priority populations.
+ */
+PRIVATE static
+void
+Jdb_kern_info_bench::do_ready_queue_benchmark()
+{
+  static struct
+  {
+    char const *name;
+    unsigned count;
+    unsigned stride;
+  } const shapes[] =
+  {
+    { "prio 0 and 255",  2, 255 },
+    { "every 64th prio", 4,  64 },
+    { "every prio",    256,   1 },
+    { "2 per prio",    512,   1 },
+  };
+  static Bench_rq rq;
+  static Bench_scan_rq ref;
+  Bench_sc *sc = Bench_rq::sc;
+
+  printf("Fixed-priority ready queue: random enqueue/dequeue %s\n",
+         rq.check_random() ? "ok" : "FAILED");
+
+  printf("Context switch (cycles):\n");
+  for (unsigned k = 0; k < sizeof(shapes) / sizeof(shapes[0]); ++k)
+    {
+      unsigned count = shapes[k].count;
+      unsigned top = 0;
+
+      for (unsigned i = 0; i < count; ++i)
+        {
+          sc[i]._prio = (i * shapes[k].stride) % 256;
+          if (sc[i]._prio > top)
+            top = sc[i]._prio;
+          rq.enqueue(&sc[i], false);
+        }
+
+      Unsigned64 bitmap = Bench_rq::switch_time(rq, get_time_now);
+      bool ok = rq.prio_highest() == top && rq.bitmap_consistent();
+
+      for (unsigned i = 0; i < count; ++i)
+        rq.dequeue(&sc[i]);
+
+      for (unsigned i = 0; i < count; ++i)
+        ref.enqueue(&sc[i], false);
+      Unsigned64 scan = Bench_rq::switch_time(ref, get_time_now);
+      for (unsigned i = 0; i < count; ++i)
+        ref.dequeue(&sc[i]);
+
+      printf("  %-16s bitmap %5lld  downward scan %5lld  %s\n",
+             shapes[k].name, bitmap, scan, ok ? "ok" : "FAILED");
+    }
+}
+
 //---------------------------------------------------------------------------
 IMPLEMENTATION [!mp]:
 
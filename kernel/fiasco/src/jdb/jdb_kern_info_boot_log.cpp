@@ -0,0 +1,56 @@
+IMPLEMENTATION:
+
+#include <cstdio>
+
+#include "boot_log.h"
+#include "config.h"
+#include "jdb_kern_info.h"
+#include "static_init.h"
+
+class Jdb_kern_info_boot_log : public Jdb_kern_info_module
+{
+};
+
+static Jdb_kern_info_boot_log k_B INIT_PRIORITY(JDB_MODULE_INIT_PRIO+1);
+
+PUBLIC
+Jdb_kern_info_boot_log::Jdb_kern_info_boot_log()
+  : Jdb_kern_info_module('B', "Boot stages of the CPUs")
+{
+  Jdb_kern_info::register_subcmd(this);
+}
+
+PUBLIC
+void
+Jdb_kern_info_boot_log::show()
+{
+  Unsigned64 last[Config::Max_num_cpus];
+  bool seen[Config::Max_num_cpus] = { false };
+  unsigned n = Boot_log::num();
+  if (n > Boot_log::Max_entries)
+    n = Boot_log::Max_entries;
+
+  printf("cpu %12s %10s  stage\n", "time [us]", "+[us]");
+  for (unsigned i = 0; i < n; ++i)
+    {
+      Boot_log::Entry const *e = Boot_log::entry(i);
+      if (!e)
+        continue;
+
+      unsigned cpu = cxx::int_value<Cpu_number>(e->cpu);
+      Unsigned64 us = Boot_log::to_us(e->time);
+      if (cpu >= Config::Max_num_cpus)
+        {
+          printf("  - %12llu %10s  %s\n", us, "", e->stage);
+          continue;
+        }
+
+      if (seen[cpu])
+        printf("%3u %12llu %10llu  %s\n", cpu, us, us - last[cpu], e->stage);
+      else
+        printf("%3u %12llu %10s  %s\n", cpu, us, "", e->stage);
+
+      seen[cpu] = true;
+      last[cpu] = us;
+    }
+}
@@ -1,5 +1,8 @@
 IMPLEMENTATION:
 
+#include <cstdio>
+
+#include "cpu.h"
 #include "static_init.h"
 #include "jdb_kern_info.h"
 #include "kmem_alloc.h"
@@ -22,12 +25,38 @@ void
 Jdb_kern_info_memory::show()
 {
   ((Kmem_alloc*)Kmem_alloc::allocator())->debug_dump();
+  Kmem_alloc::dump_hot();
   typedef Kmem_slab::Reap_list::Const_iterator Iter;
 
   // Slab allocators
   for (Iter alloc = Kmem_slab::reap_list.begin();
        alloc != Kmem_slab::reap_list.end(); ++alloc)
-    alloc->debug_dump();
+    {
+      alloc->debug_dump();
+      show_magazines(*alloc);
+    }
+}
+
+PRIVATE static
+void
+Jdb_kern_info_memory::show_magazines(Kmem_slab const *s)
+{
+  if (!s->_use_magazines)
+    return;
+
+  printf("  magazines: depot %u full, %u empty\n",
+         s->_depot_full_cnt, s->_depot_empty_cnt);
+
+  for (Cpu_number u = Cpu_number::first(); u < Config::max_num_cpus(); ++u)
+    {
+      Kmem_slab::Cpu_cache const &c = s->_cpu[u];
+      if (!Cpu::online(u) || (!c.hits && !c.misses))
+        continue;
+
+      printf("    cpu%u: %lu hits, %lu misses, loaded %u, prev %u\n",
+             cxx::int_value<Cpu_number>(u), c.hits, c.misses,
+             c.loaded ? c.loaded->count : 0, c.prev ? c.prev->count : 0);
+    }
 }
 
 
@@ -53,6 +53,8 @@ protected:
     Op_switch_log       = 4,
     Op_get_name         = 5,
     Op_query_log_name   = 6,
+    Op_tbuf_observer    = 7,
+    Op_profile          = 8,
   };
 };
 
@@ -0,0 +1,64 @@
+IMPLEMENTATION [lock_stats]:
+
+#include <cstdio>
+#include "simpleio.h"
+
+#include "jdb.h"
+#include "jdb_module.h"
+#include "queued_spin_lock.h"
+#include "static_init.h"
+
+class Jdb_lock_stats_module : public Jdb_module
+{
+public:
+  Jdb_lock_stats_module() FIASCO_INIT;
+};
+
+static Jdb_lock_stats_module jdb_lock_stats_module INIT_PRIORITY(JDB_MODULE_INIT_PRIO);
+
+PRIVATE static
+void
+Jdb_lock_stats_module::print_stats(Spin_lock_stats const *s)
+{
+  Unsigned64 avg = s->acquisitions ? s->total_hold / s->acquisitions : 0;
+  printf("%-24s %-6s %10lu %10lu %12llu %10llu %10llu\n",
+         s->name, s->what ? s->what : "",
+         s->acquisitions, s->contended, s->spins, avg, s->max_hold);
+}
+
+PUBLIC
+Jdb_module::Action_code
+Jdb_lock_stats_module::action(int cmd, void *&, char const *&, int &)
+{
+  if (cmd)
+    return NOTHING;
+
+  printf("\nLOCK STATISTICS (hold times in TSC ticks) ---------------------------------\n"
+         "%-24s %-6s %10s %10s %12s %10s %10s\n",
+         "name", "", "acquired", "contended", "spins", "avg hold", "max hold");
+
+  for (Spin_lock_stats const *s = Spin_lock_stats::list; s; s = s->next)
+    print_stats(s);
+
+  return NOTHING;
+}
+
+PUBLIC
+int
+Jdb_lock_stats_module::num_cmds() const
+{ return 1; }
+
+PUBLIC
+Jdb_module::Cmd const *
+Jdb_lock_stats_module::cmds() const
+{
+  static Cmd cs[] =
+    { { 0, "", "locks", "", "locks\tspin-lock contention statistics", 0 } };
+
+  return cs;
+}
+
+IMPLEMENT
+Jdb_lock_stats_module::Jdb_lock_stats_module()
+  : Jdb_module("INFO")
+{}
@@ -119,11 +119,28 @@ Jdb_mapdb::show_tree(Treemap* pages, Mapping::Pcnt offset, Mdb_types::Order base
 
   screenline += 2;
 
+  unsigned used = t->_count;
+  if (t->is_linked())
+    {
+      unsigned chunks = 0;
+      used = 0;
+      for (Mapping_tree *b = t; b; b = b->next_chunk(), ++chunks)
+        used += b->_count;
+
+      printf(" linked tree: %u chunks, entries used: %u\033[K\n",
+             chunks, used);
+      screenline++;
+    }
+
   unsigned empty = 0;
-  for(i=0; i < t->_count + empty; i++, m++)
+  for(i=0; i < used + empty; i++, m++)
     {
       Kconsole::console()->getchar_chance();
 
+      // continue behind the back and root links of the next chunk
+      if (m->depth() == Mapping::Depth_next_link)
+        m = m->link() + 2;
+
       if (m->depth() == Mapping::Depth_submap)
         printf("%*u: %lx  subtree@" L4_PTR_FMT,
                indent + m->parent()->depth() > 10
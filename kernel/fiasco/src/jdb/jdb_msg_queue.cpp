@@ -0,0 +1,96 @@
+IMPLEMENTATION:
+
+#include <cstdio>
+
+#include "jdb.h"
+#include "jdb_kobject.h"
+#include "jdb_screen.h"
+#include "msg_queue.h"
+#include "simpleio.h"
+#include "static_init.h"
+#include "thread.h"
+
+class Jdb_msg_queue : public Jdb_kobject_handler
+{
+public:
+  Jdb_msg_queue() FIASCO_INIT;
+};
+
+IMPLEMENT
+Jdb_msg_queue::Jdb_msg_queue()
+  : Jdb_kobject_handler(Msg_queue::static_kobj_type)
+{
+  Jdb_kobject::module()->register_handler(this);
+}
+
+PRIVATE static
+Msg_queue *
+Jdb_msg_queue::msg_queue(Kobject_common *o)
+{ return Kobject::dcast<Msg_queue*>(Kobject::from_dbg(o->dbg_info())); }
+
+PRIVATE static
+Mword
+Jdb_msg_queue::thread_id(Msg_queue_end const *e)
+{ return e->_thread ? e->_thread->dbg_info()->dbg_id() : 0; }
+
+PUBLIC
+Kobject_common *
+Jdb_msg_queue::follow_link(Kobject_common *o)
+{
+  Msg_queue *q = msg_queue(o);
+  Thread *t = q->_end[Msg_queue::Consumer]._thread;
+  return t ? Kobject::from_dbg(t->dbg_info()) : o;
+}
+
+PUBLIC
+bool
+Jdb_msg_queue::show_kobject(Kobject_common *o, int lvl)
+{
+  Msg_queue *q = msg_queue(o);
+  static char const *const names[] = { "consumer", "producer" };
+
+  printf("Message queue %lx: %lu slots of %lu bytes\n",
+         o->dbg_info()->dbg_id(), q->_slots, q->_slot_size);
+
+  for (unsigned i = 0; i < Msg_queue::Num_ends; ++i)
+    {
+      Msg_queue_end const *e = &q->_end[i];
+      printf("  %-8s: thread=%lx label=%08lx %s signals=%lu wakeups=%lu\n",
+             names[i], thread_id(e), e->_label,
+             e->_pending ? "pending" : "idle   ", e->_signals, e->_wakeups);
+    }
+
+  if (lvl)
+    {
+      Jdb::getchar();
+      return true;
+    }
+
+  return false;
+}
+
+PUBLIC
+void
+Jdb_msg_queue::show_kobject_short(String_buffer *buf, Kobject_common *o)
+{
+  Msg_queue *q = msg_queue(o);
+  if (!q)
+    return;
+
+  Msg_queue_end const *c = &q->_end[Msg_queue::Consumer];
+  Msg_queue_end const *p = &q->_end[Msg_queue::Producer];
+  buf->printf(" %lux%lu C=%lx%s P=%lx%s S=%lu/%lu W=%lu/%lu",
+              q->_slots, q->_slot_size,
+              thread_id(c), c->_pending ? "*" : "",
+              thread_id(p), p->_pending ? "*" : "",
+              c->_signals, p->_signals, c->_wakeups, p->_wakeups);
+}
+
+PUBLIC
+char const *
+Jdb_msg_queue::kobject_type() const
+{
+  return JDB_ANSI_COLOR(magenta) "MsgQ" JDB_ANSI_COLOR(default);
+}
+
+static Jdb_msg_queue jdb_msg_queue INIT_PRIORITY(JDB_MODULE_INIT_PRIO);
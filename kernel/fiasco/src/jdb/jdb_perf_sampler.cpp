@@ -0,0 +1,56 @@
+IMPLEMENTATION:
+
+#include "entry_frame.h"
+#include "initcalls.h"
+#include "jdb_kobject.h"
+#include "kobject_iface.h"
+#include "l4_error.h"
+#include "perf_sampler.h"
+#include "static_init.h"
+
+/**
+ * Lets user level start and stop the statistical profiler (debugger
+ * invocation on any capability, values[1] is the source, values[2] the
+ * period).
+ */
+class Jdb_perf_sampler_hdl : public Jdb_kobject_handler
+{
+public:
+  Jdb_perf_sampler_hdl() : Jdb_kobject_handler(0) {}
+  virtual bool show_kobject(Kobject_common *, int) { return true; }
+};
+
+class Jdb_perf_sampler
+{
+public:
+  static void init() FIASCO_INIT;
+};
+
+PUBLIC
+bool
+Jdb_perf_sampler_hdl::invoke(Kobject_common *, Syscall_frame *f, Utcb *utcb)
+{
+  if (utcb->values[0] != Op_profile)
+    return false;
+
+  if (f->tag().words() < 3)
+    {
+      f->tag(Kobject_iface::commit_result(-L4_err::EInval));
+      return true;
+    }
+
+  int r = Perf_sampler::start(Perf_sampler::Source(utcb->values[1]),
+                              utcb->values[2]);
+  f->tag(Kobject_iface::commit_result(r));
+  return true;
+}
+
+IMPLEMENT
+void
+Jdb_perf_sampler::init()
+{
+  static Jdb_perf_sampler_hdl hdl;
+  Jdb_kobject::module()->register_handler(&hdl);
+}
+
+STATIC_INITIALIZE(Jdb_perf_sampler);
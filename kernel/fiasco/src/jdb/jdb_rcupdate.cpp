@@ -14,6 +14,7 @@ IMPLEMENTATION:
 #include "simpleio.h"
 #include "rcupdate.h"
 #include "static_init.h"
+#include "timer.h"
 
 class Jdb_rcupdate : public Jdb_module
 {
@@ -33,6 +34,16 @@ Jdb_rcupdate::print_batch(Rcu_batch const &b)
   printf("#%ld", b._b);
 }
 
+PRIVATE static
+long
+Jdb_rcupdate::list_len(Rcu_list const &l)
+{
+  long n = 0;
+  for (Rcu_list::Const_iterator i = l.begin(); i != l.end(); ++i)
+    ++n;
+  return n;
+}
+
 PUBLIC
 Jdb_module::Action_code
 Jdb_rcupdate::action(int cmd, void *&, char const *&, int &)
@@ -52,6 +63,15 @@ Jdb_rcupdate::action(int cmd, void *&, char const *&, int &)
       printf("  active cpus=");
       Jdb::cpu_mask_print(Rcu::_rcu._active_cpus);
       puts("");
+      printf("  grace period: last=%lluus max=%lluus",
+             (unsigned long long)Rcu::_rcu._gp_last,
+             (unsigned long long)Rcu::_rcu._gp_max);
+      if (Rcu::_rcu._current != Rcu::_rcu._completed)
+        printf(" current=%lluus", (unsigned long long)
+               (Timer::system_clock() - Rcu::_rcu._gp_start));
+      printf("\n  expedited requests=%lu up to batch ",
+             Rcu::_rcu._expedited);
+      print_batch(Rcu::_rcu._expedite_until); puts("");
 
       for (Cpu_number i = Cpu_number::first(); i < Config::max_num_cpus(); ++i)
 	{
@@ -66,9 +86,14 @@ Jdb_rcupdate::action(int cmd, void *&, char const *&, int &)
 	  printf("    wait for quiescent state: %s\n", d->_pending?"yes":"no");
 	  printf("    batch=");
 	  print_batch(d->_batch); puts("");
-	  printf("    next list:    h=%p len=%ld\n", d->_n.front(), d->_len);
-	  printf("    current list: h=%p \n", d->_c.front());
-	  printf("    done list:    h=%p\n", d->_d.front());
+	  printf("    next list:    h=%p len=%ld (%ld)\n", d->_n.front(),
+	         list_len(d->_n), d->_len);
+	  printf("    current list: h=%p len=%ld\n", d->_c.front(),
+	         list_len(d->_c));
+	  printf("    done list:    h=%p len=%ld\n", d->_d.front(),
+	         list_len(d->_d));
+	  printf("    max len=%ld invoked=%lu deferred=%lu (limit %d)\n",
+	         d->_max_len, d->_invoked, d->_deferred, Rcu::Batch_limit);
 	}
     }
   return NOTHING;
@@ -4,9 +4,9 @@ INTERFACE:
 #include "l4_types.h"
 #include "std_macros.h"
 #include "tb_entry.h"
-#include "spin_lock.h"
 
 class Context;
+class Irq_base;
 class Log_event;
 struct Tracebuffer_status;
 
@@ -22,16 +22,40 @@ public:
   };
 
 protected:
-  static Tb_entry_union *_tbuf_act;	// current entry
-  static Tb_entry_union *_tbuf_max;
-  static Mword		_entries;	// number of occupied entries
+  /**
+   * Writer state of one segment of the trace buffer. Each CPU writes to
+   * its own segment so that logging an event touches no cache line that
+   * another CPU writes to, apart from the event counter. If there are more
+   * CPUs than segments, a segment is shared and the counters below are
+   * updated atomically.
+   */
+  struct Segment
+  {
+    Tb_entry_union *base;
+    Mword reserved;     ///< entries handed out by new_entry()
+    Mword committed;    ///< entries completed by commit_entry()
+    Mword start;        ///< value of reserved at the last clear_tbuf()
+  } __attribute__((aligned(64)));
+
+  /// Position in the merged, newest first view of all segments.
+  struct Cursor
+  {
+    Mword stamp;        ///< _number when the cursor was last valid
+    Mword idx;          ///< merged index of the entry the cursor points to
+    Mword taken[Tbuf_max_segments]; ///< newer entries skipped per segment
+  };
+
+  static Segment        _segments[Tbuf_max_segments];
+  static Mword          _num_segments;  // power of 2
+  static Mword          _segment_entries; // entries per segment, power of 2
   static Mword		_max_entries;	// maximum number of entries
   static Mword          _filter_enabled;// !=0 if filter is active
   static Mword		_number;	// current event number
-  static Mword		_count_mask1;
-  static Mword		_count_mask2;
   static Address        _size;		// size of memory area for tbuffer
-  static Spin_lock<>    _lock;
+  static Irq_base      *_observer;      // notified when a watermark is passed
+  static Mword          _watermark;     // power of 2
+  static Mword          _notify_pending;
+  static Cursor         _cursor;        // last position used by lookup()
 };
 
 #ifdef CONFIG_JDB_LOGGING
@@ -150,23 +174,28 @@ protected:
 
 IMPLEMENTATION:
 
+#include <cstring>
+#include "atomic.h"
 #include "config.h"
 #include "cpu_lock.h"
+#include "globals.h"
 #include "initcalls.h"
 #include "lock_guard.h"
+#include "mem.h"
 #include "mem_layout.h"
 #include "std_macros.h"
 
-Tb_entry_union *Jdb_tbuf::_tbuf_act;
-Tb_entry_union *Jdb_tbuf::_tbuf_max;
-Mword Jdb_tbuf::_entries;
+Jdb_tbuf::Segment Jdb_tbuf::_segments[Tbuf_max_segments];
+Mword Jdb_tbuf::_num_segments = 1;
+Mword Jdb_tbuf::_segment_entries;
 Mword Jdb_tbuf::_max_entries;
 Mword Jdb_tbuf::_filter_enabled;
 Mword Jdb_tbuf::_number;
-Mword Jdb_tbuf::_count_mask1;
-Mword Jdb_tbuf::_count_mask2;
 Address Jdb_tbuf::_size;
-Spin_lock<> Jdb_tbuf::_lock;
+Irq_base *Jdb_tbuf::_observer;
+Mword Jdb_tbuf::_watermark;
+Mword Jdb_tbuf::_notify_pending;
+Jdb_tbuf::Cursor Jdb_tbuf::_cursor;
 
 static void direct_log_dummy(Tb_entry*, const char*)
 {}
@@ -180,6 +209,14 @@ Jdb_tbuf::status()
   return (Tracebuffer_status *)Mem_layout::Tbuf_status_page;
 }
 
+PUBLIC static inline NEEDS["mem_layout.h"]
+Tracebuffer_stream *
+Jdb_tbuf::stream()
+{
+  return (Tracebuffer_stream *)(Mem_layout::Tbuf_status_page
+                                + Tbuf_stream_offset);
+}
+
 PROTECTED static inline NEEDS["mem_layout.h"]
 Tb_entry_union *
 Jdb_tbuf::buffer()
@@ -194,6 +231,13 @@ Jdb_tbuf::size()
   return _size;
 }
 
+PROTECTED static inline
+Jdb_tbuf::Segment *
+Jdb_tbuf::segment(Cpu_number cpu)
+{
+  return &_segments[cxx::int_value<Cpu_number>(cpu) & (_num_segments - 1)];
+}
+
 /** Clear tracebuffer. */
 PUBLIC static
 void
@@ -204,8 +248,11 @@ Jdb_tbuf::clear_tbuf()
   for (i = 0; i < _max_entries; i++)
     buffer()[i].clear();
 
-  _tbuf_act = buffer();
-  _entries = 0;
+  // Writers keep counting; hide everything logged so far from JDB.
+  for (i = 0; i < _num_segments; i++)
+    _segments[i].start = access_once(&_segments[i].reserved);
+
+  _cursor.stamp = ~0UL;
 }
 
 /** Return pointer to new tracebuffer entry. */
@@ -215,19 +262,21 @@ Jdb_tbuf::new_entry()
 {
   Tb_entry *tb;
   {
-    auto guard = lock_guard(_lock);
+    auto guard = lock_guard(cpu_lock);
 
-    tb = _tbuf_act;
+    Segment *s = segment(current_cpu());
+    Mword pos, nr;
 
-    status()->current = (Address)tb;
+    do
+      pos = access_once(&s->reserved);
+    while (EXPECT_FALSE(!mp_cas(&s->reserved, pos, pos + 1)));
 
-    if (++_tbuf_act >= _tbuf_max)
-      _tbuf_act = buffer();
+    do
+      nr = access_once(&_number);
+    while (EXPECT_FALSE(!mp_cas(&_number, nr, nr + 1)));
 
-    if (_entries < _max_entries)
-      _entries++;
-
-    tb->number(++_number);
+    tb = s->base + (pos & (_segment_entries - 1));
+    tb->number(nr + 1);
   }
 
   tb->rdtsc();
@@ -245,36 +294,75 @@ Jdb_tbuf::new_entry()
   return static_cast<T*>(new_entry());
 }
 
-/** Commit tracebuffer entry. */
+/**
+ * Commit tracebuffer entry.
+ *
+ * Must run on the CPU that got the entry from new_entry(). The head of
+ * the segment is published to user level only when no other entry of
+ * the segment is in flight, so everything below the head is complete.
+ */
 PUBLIC static
 void
 Jdb_tbuf::commit_entry()
 {
-  if (EXPECT_FALSE((_number & _count_mask2) == 0))
+  auto guard = lock_guard(cpu_lock);
+
+  Segment *s = segment(current_cpu());
+  Mword c;
+
+  do
+    c = access_once(&s->committed);
+  while (EXPECT_FALSE(!mp_cas(&s->committed, c, c + 1)));
+
+  if (++c != access_once(&s->reserved))
+    return;
+
+  Mem::mp_wmb();
+
+  Mword *head = &stream()->segment[s - _segments].head;
+  Mword h;
+
+  do
     {
-      if (_number & _count_mask1)
-	status()->window[0].version++; // 64-bit value!
-      else
-	status()->window[1].version++; // 64-bit value!
-
-#if 0 // disbale Tbuf vIRQ for the time beeing (see bug #357)
-      // fire the virtual 'buffer full' irq
-      if (_observer)
-        {
-          auto guard = lock_guard(cpu_lock);
-	  _observer->notify();
-	}
-#endif
+      h = access_once(head);
+      if (Smword(c - h) <= 0)
+        return;
     }
+  while (EXPECT_FALSE(!mp_cas(head, h, c)));
+
+  if (_observer && ((h ^ c) & ~(_watermark - 1)))
+    write_now(&_notify_pending, 1UL);
+}
+
+/** Number of entries of segment s visible to JDB. */
+PRIVATE static inline
+Mword
+Jdb_tbuf::available(Segment const *s)
+{
+  Mword n = s->reserved - s->start;
+  return n < _segment_entries ? n : _segment_entries;
+}
+
+/** Entry of segment s with `newer` newer entries in the same segment. */
+PRIVATE static inline
+Tb_entry_union *
+Jdb_tbuf::segment_entry(Segment const *s, Mword newer)
+{
+  return s->base + ((s->reserved - newer - 1) & (_segment_entries - 1));
 }
 
 /** Return number of entries currently allocated in tracebuffer.
  * @return number of entries */
-PUBLIC static inline
+PUBLIC static
 Mword
 Jdb_tbuf::unfiltered_entries()
 {
-  return _entries;
+  Mword n = 0;
+
+  for (Mword s = 0; s < _num_segments; ++s)
+    n += available(&_segments[s]);
+
+  return n;
 }
 
 PUBLIC static
@@ -285,9 +373,10 @@ Jdb_tbuf::entries()
     return unfiltered_entries();
 
   Mword cnt = 0;
+  Tb_entry *e;
 
-  for (Mword idx = 0; idx<unfiltered_entries(); idx++)
-    if (!buffer()[idx].hidden())
+  for (Mword idx = 0; (e = unfiltered_lookup(idx)); idx++)
+    if (!e->hidden())
       cnt++;
 
   return cnt;
@@ -317,7 +406,7 @@ PUBLIC static inline
 int
 Jdb_tbuf::event_valid(Mword idx)
 {
-  return idx < _entries;
+  return idx < unfiltered_entries();
 }
 
 /** Return pointer to tracebuffer event.
@@ -326,7 +415,11 @@ Jdb_tbuf::event_valid(Mword idx)
  * @return pointer to tracebuffer event
  *
  * event with idx == 0 is the last event queued in
- * event with idx == 1 is the event before */
+ * event with idx == 1 is the event before
+ *
+ * The segments are merged by event number. JDB walks the buffer mostly
+ * sequentially, so the merge continues from the last position if
+ * possible. */
 PUBLIC static
 Tb_entry*
 Jdb_tbuf::unfiltered_lookup(Mword idx)
@@ -334,12 +427,40 @@ Jdb_tbuf::unfiltered_lookup(Mword idx)
   if (!event_valid(idx))
     return 0;
 
-  Tb_entry_union *e = _tbuf_act - idx - 1;
+  if (_num_segments == 1)
+    return segment_entry(&_segments[0], idx);
+
+  if (_cursor.stamp != _number || idx < _cursor.idx)
+    {
+      _cursor.stamp = _number;
+      _cursor.idx = 0;
+      memset(_cursor.taken, 0, sizeof(_cursor.taken));
+    }
 
-  if (e < buffer())
-    e += _max_entries;
+  for (;;)
+    {
+      Tb_entry *newest = 0;
+      Mword seg = 0;
 
-  return e;
+      for (Mword s = 0; s < _num_segments; ++s)
+        {
+          if (_cursor.taken[s] >= available(&_segments[s]))
+            continue;
+
+          Tb_entry *e = segment_entry(&_segments[s], _cursor.taken[s]);
+          if (!newest || Smword(e->number() - newest->number()) > 0)
+            {
+              newest = e;
+              seg = s;
+            }
+        }
+
+      if (!newest || _cursor.idx == idx)
+        return newest;
+
+      ++_cursor.taken[seg];
+      ++_cursor.idx;
+    }
 }
 
 /** Return pointer to tracebuffer event.
@@ -370,17 +491,32 @@ Jdb_tbuf::lookup(Mword look_idx)
     }
 }
 
-PUBLIC static
+/** Count the entries that are newer than e.
+ * @param visible  count only entries that are not hidden */
+PRIVATE static
 Mword
-Jdb_tbuf::unfiltered_idx(Tb_entry const *e)
+Jdb_tbuf::count_newer(Tb_entry const *e, bool visible)
 {
-  Tb_entry_union const *ef = static_cast<Tb_entry_union const *>(e);
-  Mword idx = _tbuf_act - ef - 1;
+  Mword cnt = 0;
+
+  for (Mword s = 0; s < _num_segments; ++s)
+    for (Mword i = 0; i < available(&_segments[s]); ++i)
+      {
+        Tb_entry const *n = segment_entry(&_segments[s], i);
+        if (Smword(n->number() - e->number()) <= 0)
+          break;
+        if (!visible || !n->hidden())
+          cnt++;
+      }
 
-  if (idx > _max_entries)
-    idx += _max_entries;
+  return cnt;
+}
 
-  return idx;
+PUBLIC static
+Mword
+Jdb_tbuf::unfiltered_idx(Tb_entry const *e)
+{
+  return count_newer(e, false);
 }
 
 /** Tb_entry => tracebuffer index. */
@@ -391,23 +527,8 @@ Jdb_tbuf::idx(Tb_entry const *e)
   if (!_filter_enabled)
     return unfiltered_idx(e);
 
-  Tb_entry_union const *ef = static_cast<Tb_entry_union const*>(e);
-  Mword idx = (Mword) - 1;
-
-  for (;;)
-    {
-      if (!ef->hidden())
-	idx++;
-      ef++;
-      if (ef >= buffer() + _max_entries)
-	ef -= _max_entries;
-      if (ef == _tbuf_act)
-	break;
-    }
-
-  return idx;
+  return count_newer(e, true) - (e->hidden() ? 1 : 0);
 }
-
 /** Event number => Tb_entry. */
 PUBLIC static inline
 Tb_entry*
@@ -4,6 +4,8 @@ INTERFACE:
 
 class Jdb_tbuf_init : public Jdb_tbuf
 {
+  friend class Jdb_tbuf_irq_chip;
+
 public:
   static void init();
 };
@@ -16,21 +18,42 @@ IMPLEMENTATION:
 #include <cstring>
 #include <panic.h>
 
+#include "atomic.h"
 #include "config.h"
 #include "cpu.h"
+#include "cpu_lock.h"
+#include "irq_chip.h"
 #include "jdb_ktrace.h"
 #include "koptions.h"
+#include "lat_hist.h"
+#include "lock_guard.h"
 #include "mem_layout.h"
 #include "vmem_alloc.h"
 
+/**
+ * Chip the trace-buffer observer is bound to. It forgets the observer
+ * when the IRQ object is unbound or destroyed.
+ */
+class Jdb_tbuf_irq_chip : public Irq_chip_soft
+{
+public:
+  void unbind(Irq_base *irq)
+  {
+    if (Jdb_tbuf_init::_observer == irq)
+      Jdb_tbuf_init::_observer = 0;
+
+    Irq_chip::unbind(irq);
+  }
+};
+
+static Jdb_tbuf_irq_chip jdb_tbuf_irq_chip;
+
 STATIC_INITIALIZE_P(Jdb_tbuf_init, JDB_MODULE_INIT_PRIO);
 
 // init trace buffer
 IMPLEMENT FIASCO_INIT
 void Jdb_tbuf_init::init()
 {
-  //static Irq_sender tbuf_irq(Config::Tbuf_irq);
-
   static int init_done;
 
   if (!init_done)
@@ -43,10 +66,16 @@ void Jdb_tbuf_init::init()
       if (Koptions::o()->opt(Koptions::F_tbuf_entries))
 	want_entries = Koptions::o()->tbuf_entries;
 
+      // one segment per CPU, a power of 2 and at least one page each
+      unsigned segs = 1;
+      while (segs < Config::Max_num_cpus && segs < Tbuf_max_segments)
+        segs <<= 1;
+
       // minimum: 8KB (  2 pages), maximum: 2MB (512 pages)
       // must be a power of 2 (for performance reasons)
       for (n = Config::PAGE_SIZE / sizeof(Tb_entry_union);
-	   n < want_entries && n * sizeof(Tb_entry_union) < 0x200000;
+	   (n < want_entries || n * sizeof(Tb_entry_union) < segs * Config::PAGE_SIZE)
+	   && n * sizeof(Tb_entry_union) < 0x200000;
 	   n <<= 1)
 	;
 
@@ -80,11 +109,96 @@ void Jdb_tbuf_init::init()
       status()->scaler_tsc_to_us = Cpu::boot_cpu()->get_scaler_tsc_to_us();
       status()->scaler_ns_to_tsc = Cpu::boot_cpu()->get_scaler_ns_to_tsc();
 
-      _tbuf_max    = buffer() + max_entries();
-      _count_mask1 =  max_entries()    - 1;
-      _count_mask2 = (max_entries())/2 - 1;
-      _size        = size;
+      _num_segments    = segs;
+      _segment_entries = n / segs;
+      _watermark       = _segment_entries / 2;
+      _size            = size;
+
+      static_assert(sizeof(Tracebuffer_status) <= Tbuf_stream_offset,
+                    "Tracebuffer_stream overlaps Tracebuffer_status");
+      static_assert(Tbuf_stream_offset + sizeof(Tracebuffer_stream)
+                    <= Tbuf_lat_hist_offset,
+                    "Tracebuffer_stream overlaps Tracebuffer_lat_hist");
+      static_assert(Tbuf_lat_hist_offset + sizeof(Tracebuffer_lat_hist)
+                    <= Config::PAGE_SIZE,
+                    "Tracebuffer_lat_hist does not fit into the status page");
+
+      stream()->num_segments = segs;
+      stream()->entry_size   = sizeof(Tb_entry_union);
+      stream()->watermark    = _watermark;
+
+      for (unsigned i = 0; i < segs; i++)
+        {
+          _segments[i].base = buffer() + i * _segment_entries;
+          stream()->segment[i].tracebuffer = (Address)Mem_layout::Tbuf_ubuffer_area
+            + i * _segment_entries * sizeof(Tb_entry_union);
+          stream()->segment[i].entries = _segment_entries;
+        }
+
+      Lat_hist::init((Tracebuffer_lat_hist *)(Mem_layout::Tbuf_status_page
+                                              + Tbuf_lat_hist_offset));
 
       clear_tbuf();
     }
 }
+
+/**
+ * Fire the observer IRQ if a segment passed its watermark.
+ *
+ * commit_entry() cannot trigger the IRQ itself because it runs in
+ * arbitrary kernel code, e.g., in the middle of a context switch. The
+ * timer tick calls this instead.
+ */
+PUBLIC static inline
+void
+Jdb_tbuf_init::notify_observer()
+{
+  if (EXPECT_FALSE(access_once(&_notify_pending)))
+    deliver_notification();
+}
+
+PRIVATE static
+void
+Jdb_tbuf_init::deliver_notification()
+{
+  if (!mp_cas(&_notify_pending, 1UL, 0UL))
+    return;
+
+  if (Irq_base *o = access_once(&_observer))
+    o->hit(0);
+}
+
+/**
+ * Bind the IRQ that is triggered whenever the head of a segment passes a
+ * multiple of `watermark` entries.
+ * @param irq        IRQ to bind, 0 to remove the current observer
+ * @param watermark  distance between two notifications in entries,
+ *                   0 for half a segment
+ */
+PUBLIC static
+void
+Jdb_tbuf_init::observer(Irq_base *irq, Mword watermark)
+{
+  auto guard = lock_guard(cpu_lock);
+
+  if (_observer)
+    _observer->unbind();
+
+  _observer = 0;
+  if (!irq)
+    return;
+
+  if (!watermark || watermark > _segment_entries)
+    watermark = _segment_entries / 2 ? _segment_entries / 2 : 1;
+
+  while (watermark & (watermark - 1))
+    watermark &= watermark - 1;
+
+  _watermark = watermark;
+  stream()->watermark = watermark;
+
+  // the IRQ may still be attached to another chip, like in Icu::icu_bind_irq
+  irq->unbind();
+  jdb_tbuf_irq_chip.bind(irq, 0);
+  _observer = irq;
+}
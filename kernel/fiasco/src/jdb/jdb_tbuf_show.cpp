@@ -5,14 +5,17 @@ IMPLEMENTATION:
 
 #include "config.h"
 #include "cpu.h"
+#include "irq.h"
 #include "jdb.h"
 #include "jdb_disasm.h"
 #include "jdb_input.h"
+#include "jdb_kobject.h"
 #include "jdb_module.h"
 #include "jdb_screen.h"
 #include "jdb_symbol.h"
 #include "jdb_regex.h"
 #include "jdb_tbuf.h"
+#include "jdb_tbuf_init.h"
 #include "jdb_tbuf_output.h"
 #include "kern_cnt.h"
 #include "kernel_console.h"
@@ -1124,9 +1127,42 @@ Jdb_tbuf_show::num_cmds() const
   return 3;
 }
 
+/**
+ * Lets user level bind an IRQ that fires whenever a segment of the trace
+ * buffer passes its watermark (debugger invocation on the IRQ object).
+ */
+class Jdb_tbuf_hdl : public Jdb_kobject_handler
+{
+public:
+  Jdb_tbuf_hdl() : Jdb_kobject_handler(0) {}
+  virtual bool show_kobject(Kobject_common *, int) { return true; }
+};
+
+PUBLIC
+bool
+Jdb_tbuf_hdl::invoke(Kobject_common *o, Syscall_frame *f, Utcb *utcb)
+{
+  if (utcb->values[0] != Op_tbuf_observer)
+    return false;
+
+  Irq *irq = Kobject::dcast<Irq*>(o);
+  if (!irq || f->tag().words() < 2)
+    {
+      f->tag(Kobject_iface::commit_result(-L4_err::EInval));
+      return true;
+    }
+
+  Jdb_tbuf_init::observer(irq, utcb->values[1]);
+  f->tag(Kobject_iface::commit_result(0));
+  return true;
+}
+
 IMPLEMENT
 Jdb_tbuf_show::Jdb_tbuf_show()
     : Jdb_module("MONITORING")
-{}
+{
+  static Jdb_tbuf_hdl hdl;
+  Jdb_kobject::module()->register_handler(&hdl);
+}
 
 static Jdb_tbuf_show jdb_tbuf_show INIT_PRIORITY(JDB_MODULE_INIT_PRIO);
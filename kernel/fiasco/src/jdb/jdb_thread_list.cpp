@@ -219,12 +219,13 @@ Jdb_thread_list::sc_wfq_iter_prev(Sched_context *t)
   Sched_context::Ready_queue &rq = Sched_context::rq.cpu(cpu);
   Sched_context **rl = RQP::link(t);
   if (!rl || rl == RQP::idle(rq))
-    return RQP::cnt(rq) ? RQP::heap(rq)[RQP::cnt(rq) - 1] : *RQP::idle(rq);
-
-  if (rl == RQP::heap(rq))
-    return *RQP::idle(rq);
+    {
+      Sched_context *l = RQP::last(rq);
+      return l ? l : *RQP::idle(rq);
+    }
 
-  return *(rl - 1);
+  Sched_context *p = RQP::prev(rq, t);
+  return p ? p : *RQP::idle(rq);
 }
 
 template<typename RQP>
@@ -235,12 +236,10 @@ Jdb_thread_list::sc_wfq_iter_next(Sched_context *t)
   Sched_context::Ready_queue &rq = Sched_context::rq.cpu(cpu);
   Sched_context **rl = RQP::link(t);
   if (!rl || rl == RQP::idle(rq))
-    return RQP::cnt(rq) ? RQP::heap(rq)[0] : *RQP::idle(rq);
-
-  if ((unsigned)(rl - RQP::heap(rq)) >= RQP::cnt(rq))
-    return *RQP::idle(rq);
+    return RQP::root(rq) ? RQP::root(rq) : *RQP::idle(rq);
 
-  return *(rl + 1);
+  Sched_context *n = RQP::next(rq, t);
+  return n ? n : *RQP::idle(rq);
 }
 
 
@@ -289,9 +288,23 @@ Jdb_thread_list::sc_fp_iter_next(Sched_context *t)
     }
 }
 
+static void
+Jdb_thread_list::show_prio_bitmap(Ready_queue_fp<Sched_context> const &rq)
+{
+  printf("  highest prio: %02x  summary: %x\n",
+         rq.prio_highest(), rq.prio_summary());
+  for (int w = 3; w >= 0; --w)
+    printf("  prio %02x-%02x: %016llx\n", w * 64 + 63, w * 64,
+           (unsigned long long)rq.prio_map(w));
+}
+
 // --------------------------------------------------------------------------
 IMPLEMENTATION [sched_fixed_prio]:
 
+static void
+Jdb_thread_list::show_prio_bitmap(Cpu_number c)
+{ show_prio_bitmap(Sched_context::rq.cpu(c)); }
+
 template<>
 struct Jdb_thread_list_policy<Ready_queue_fp<Sched_context> >
 {
@@ -304,7 +317,7 @@ struct Jdb_thread_list_policy<Ready_queue_fp<Sched_context> >
   { return rq.prio_next[prio].front(); }
 
   static unsigned prio_highest(Sched_context::Ready_queue &rq)
-  { return rq.prio_highest; }
+  { return rq.prio_highest(); }
 
   static Sched_context *prev(Sched_context *t)
   { return *--Rq::List::iter(t); }
@@ -326,20 +339,30 @@ Jdb_thread_list::sc_iter_next(Sched_context *t)
 // --------------------------------------------------------------------------
 IMPLEMENTATION [sched_wfq]:
 
+static void
+Jdb_thread_list::show_prio_bitmap(Cpu_number)
+{ puts("  no fixed-priority ready queue"); }
+
 template<>
 struct Jdb_thread_list_policy<Ready_queue_wfq<Sched_context> >
 {
   static Sched_context **link(Sched_context *t)
   { return t->_ready_link; }
 
-  static Sched_context **heap(Sched_context::Ready_queue &rq)
-  { return rq._heap; }
+  static Sched_context *root(Sched_context::Ready_queue &rq)
+  { return rq._root; }
 
   static Sched_context **idle(Sched_context::Ready_queue &rq)
   { return &rq.idle; }
 
-  static unsigned cnt(Sched_context::Ready_queue &rq)
-  { return rq._cnt; }
+  static Sched_context *last(Sched_context::Ready_queue &rq)
+  { return rq.iter_last(0); }
+
+  static Sched_context *prev(Sched_context::Ready_queue &rq, Sched_context *t)
+  { return rq.iter_prev(t); }
+
+  static Sched_context *next(Sched_context::Ready_queue &rq, Sched_context *t)
+  { return rq.iter_next(t); }
 };
 
 static inline NOEXPORT
@@ -356,6 +379,10 @@ Jdb_thread_list::sc_iter_next(Sched_context *t)
 // --------------------------------------------------------------------------
 IMPLEMENTATION [sched_fp_wfq]:
 
+static void
+Jdb_thread_list::show_prio_bitmap(Cpu_number c)
+{ show_prio_bitmap(Sched_context::rq.cpu(c).fp_rq); }
+
 static inline NOEXPORT
 Sched_context *
 Jdb_thread_list::sc_iter_prev(Sched_context *)
@@ -586,6 +613,15 @@ Jdb_thread_list::action(int cmd, void *&argbuf, char const *&fmt, int &)
 		    printf("\nCPU %u is not online!\n", Cpu_number::val(cpu));
 		  cpu = Cpu_number::first();
 		  break;
+	case 'b':
+	  putchar('\n');
+	  for (Cpu_number c = Cpu_number::first(); c < Config::max_num_cpus(); ++c)
+	    if (Cpu::online(c))
+	      {
+	        printf("CPU %u:\n", cxx::int_value<Cpu_number>(c));
+	        show_prio_bitmap(c);
+	      }
+	  break;
 	case 't': Jdb::execute_command("lt"); break; // other module
 	case 's': Jdb::execute_command("ls"); break; // other module
 	}
@@ -855,7 +891,7 @@ Jdb_thread_list::cmds() const
 {
   static Cmd cs[] =
     {
-	{ 0, "l", "list", "%C", "l{r|p}\tshow ready/present list", &subcmd },
+	{ 0, "l", "list", "%C", "l{r|p|b}\tshow ready/present list or ready prio bitmap", &subcmd },
         { 1, "", "threadlist", "%C", 0 /* invisible */, &subcmd },
     };
 
@@ -42,11 +42,8 @@ private:
 
   int skip_empty(To_iter *c, int i)
   {
-    while (*c == _q->first(i).end() && i < (int)_q->queues())
-      {
-        ++i;
-        *c = _q->first(i).begin();
-      }
+    while (*c == _q->first(i).end() && ++i < (int)_q->queues())
+      *c = _q->first(i).begin();
     return i;
   }
 
@@ -79,6 +76,9 @@ public:
 
   Timeout *operator * () const { return *_c; }
 
+  /// timer wheel level of the current timeout
+  unsigned level() const { return _q->level(_i); }
+
   bool operator == (Timeout_iter const &o) const
   { return _c == o._c; }
 
@@ -222,13 +222,13 @@ static
 void
 Jdb_list_timeouts::show_header()
 {
-  printf("%s  type           timeout    owner       name\033[m\033[K\n",
+  printf("%s  type           timeout  lvl    owner       name\033[m\033[K\n",
          Jdb::esc_emph);
 }
 
 static
 void
-Jdb_list_timeouts::list_timeouts_show_timeout(Timeout *t)
+Jdb_list_timeouts::list_timeouts_show_timeout(Timeout *t, unsigned level)
 {
   char const *type;
   char ownerstr[32] = "";
@@ -265,6 +265,8 @@ Jdb_list_timeouts::list_timeouts_show_timeout(Timeout *t)
       putstr(time_str.begin());
     }
 
+  printf("  %u", level);
+
   Jdb_kobject_name *nx = 0;
 
   if (owner)
@@ -290,7 +292,38 @@ Jdb_list_timeouts::complete_show()
 
   show_header();
   for (Iter i = to_cont.begin(); i != to_cont.end(); ++i)
-    list_timeouts_show_timeout(*i);
+    list_timeouts_show_timeout(*i, i.level());
+
+  show_wheel(&Timeout_q::timeout_queue.cpu(Cpu_number::first()));
+}
+
+/**
+ * Show the number of pending timeouts per timer wheel level.
+ */
+static
+void
+Jdb_list_timeouts::show_wheel(Timeout_q const *q)
+{
+  enum { Max_levels = 8 };
+  unsigned cnt[Max_levels] = { 0 };
+  unsigned levels = 0;
+
+  for (unsigned i = 0; i < q->queues(); ++i)
+    {
+      unsigned l = q->level(i);
+      if (l >= Max_levels)
+        break;
+
+      levels = l + 1;
+      for (Timeout::To_list::Const_iterator t = q->first(i).begin();
+           t != q->first(i).end(); ++t)
+        ++cnt[l];
+    }
+
+  printf("timer wheel at tick %llu:", q->_tick);
+  for (unsigned l = 0; l < levels; ++l)
+    printf("  level %u: %u", l, cnt[l]);
+  printf("\033[K\n");
 }
 
 static
@@ -322,7 +355,7 @@ Jdb_list_timeouts::list()
           y_max = 0;
           // need to check for y_max > Jdb_screen::height()-3 here too
           for (Iter i = current; i != to_cont.end(); ++i, ++y_max)
-            list_timeouts_show_timeout(*i);
+            list_timeouts_show_timeout(*i, i.level());
 
           for (unsigned i=y_max; i<Jdb_screen::height()-3; ++i)
             putstr("\033[K\n");
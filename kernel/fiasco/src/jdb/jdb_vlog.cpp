@@ -0,0 +1,53 @@
+IMPLEMENTATION:
+
+#include <cstdio>
+
+#include "cpu.h"
+#include "jdb.h"
+#include "jdb_module.h"
+#include "static_init.h"
+#include "vlog.h"
+
+
+/**
+ * Shows the log output of user programs that was not yet written to the
+ * console, e.g. after a crash.
+ */
+class Jdb_vlog : public Jdb_module
+{
+public:
+  Jdb_vlog() FIASCO_INIT;
+};
+
+IMPLEMENT
+Jdb_vlog::Jdb_vlog() : Jdb_module("INFO") {}
+
+PUBLIC
+Jdb_module::Action_code
+Jdb_vlog::action(int, void *&, char const *&, int &)
+{
+  putchar('\n');
+  for (Cpu_number i = Cpu_number::first(); i < Config::max_num_cpus(); ++i)
+    if (Cpu::online(i))
+      Vlog::dump_ring(i);
+
+  return NOTHING;
+}
+
+PUBLIC
+Jdb_module::Cmd const *
+Jdb_vlog::cmds() const
+{
+  static Cmd cs[] =
+    {
+	{ 0, 0, "vlog", "", "vlog\tshow unwritten kernel log buffers", 0 },
+    };
+  return cs;
+}
+
+PUBLIC
+int
+Jdb_vlog::num_cmds() const
+{ return 1; }
+
+static Jdb_vlog jdb_vlog INIT_PRIORITY(JDB_MODULE_INIT_PRIO);
@@ -107,6 +107,10 @@ PUBLIC
 void
 Jdb_kern_info_host::show()
 {
+  Mem_space::Host_stats const &s = Mem_space::host_stats;
+  printf("host updates: %llu queued, %llu coalesced, %llu flushes, "
+         "%llu host calls\n\n", s.ops, s.coalesced, s.syncs, s.calls);
+
   for (Kobject_dbg::Iterator i = Kobject_dbg::begin(); i != Kobject_dbg::end(); ++i)
     {
       Task const *task = Kobject::dcast<Task const *>(Kobject::from_dbg(*i));
@@ -116,7 +120,8 @@ Jdb_kern_info_host::show()
       String_buf<64> buf;
 
       Jdb_kobject::obj_description(&buf, true, *i);
-      printf("%s, host-pid=%d\n", buf.c_str(), task->pid());
+      printf("%s, host-pid=%d, entry=%s\n", buf.c_str(), task->pid(),
+             task->entry_page() ? "shared page" : "ptrace");
 
       buf.reset();
       buf.printf("/proc/%d/maps", task->pid());
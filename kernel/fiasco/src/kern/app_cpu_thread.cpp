@@ -6,6 +6,9 @@ class App_cpu_thread : public Kernel_thread
 {
 private:
   void bootstrap(Mword resume) asm ("call_ap_bootstrap") FIASCO_FASTCALL;
+
+  /// came up on the shared trampoline stack, holds the trampoline lock
+  bool _shared_boot_stack;
 };
 
 IMPLEMENTATION [mp]:
@@ -13,12 +16,14 @@ IMPLEMENTATION [mp]:
 #include <cstdlib>
 #include <cstdio>
 
+#include "boot_log.h"
 #include "config.h"
 #include "delayloop.h"
 #include "fpu.h"
 #include "globals.h"
 #include "helping_lock.h"
 #include "kernel_task.h"
+#include "kmem_alloc.h"
 #include "processor.h"
 #include "scheduler.h"
 #include "task.h"
@@ -27,6 +32,16 @@ IMPLEMENTATION [mp]:
 #include "timer.h"
 #include "timer_tick.h"
 #include "spin_lock.h"
+#include "vlog.h"
+
+PUBLIC inline
+App_cpu_thread::App_cpu_thread() : _shared_boot_stack(true)
+{}
+
+PUBLIC inline
+void
+App_cpu_thread::set_shared_boot_stack(bool shared)
+{ _shared_boot_stack = shared; }
 
 PUBLIC static
 Kernel_thread *
@@ -57,6 +72,7 @@ App_cpu_thread::bootstrap(Mword resume)
 
   state_change_dirty(0, Thread_ready);		// Set myself ready
 
+  Kmem_alloc::enable_hot_lists(current_cpu());
 
   Fpu::init(current_cpu(), resume);
 
@@ -68,7 +84,8 @@ App_cpu_thread::bootstrap(Mword resume)
   Cpu::cpus.current().set_present(1);
   Cpu::cpus.current().set_online(1);
 
-  _tramp_mp_spinlock.set(1);
+  if (_shared_boot_stack)
+    _tramp_mp_spinlock.set(1);
 
   if (!resume)
     {
@@ -92,6 +109,8 @@ App_cpu_thread::bootstrap(Mword resume)
   Timer_tick::enable(current_cpu());
   cpu_lock.clear();
 
+  Boot_log::stamp(current_cpu(), "AP online");
+
   if (!resume)
     {
       Cpu::cpus.current().print_infos();
@@ -99,5 +118,8 @@ App_cpu_thread::bootstrap(Mword resume)
     }
 
   for (;;)
-    idle_op();
+    {
+      Vlog::drain();
+      idle_op();
+    }
 }
@@ -0,0 +1,106 @@
+INTERFACE:
+
+#include "types.h"
+
+/**
+ * Time stamps of the boot stages of all CPUs.
+ *
+ * Each CPU records when it reaches a stage of its bring-up, the kernel
+ * debugger shows the log.  The time stamps come from the local clock of
+ * the CPU (the TSC on x86), so only stamps of the same CPU are directly
+ * comparable.
+ */
+class Boot_log
+{
+public:
+  struct Entry
+  {
+    Unsigned64 time;
+    char const *stage;
+    Cpu_number cpu;
+  };
+
+  enum { Max_entries = 512 };
+
+private:
+  static Entry _log[Max_entries];
+  static Mword _num;
+};
+
+IMPLEMENTATION:
+
+#include "atomic.h"
+#include "mem.h"
+
+Boot_log::Entry Boot_log::_log[Boot_log::Max_entries];
+Mword Boot_log::_num;
+
+/**
+ * Record that a CPU reached a boot stage.
+ * \param cpu    The CPU.
+ * \param stage  Name of the stage, must be a string constant.
+ */
+PUBLIC static
+void
+Boot_log::stamp(Cpu_number cpu, char const *stage)
+{
+  Unsigned64 t = now();
+  Mword n;
+  do
+    {
+      n = access_once(&_num);
+      if (n >= Max_entries)
+        return;
+    }
+  while (!mp_cas(&_num, n, n + 1));
+
+  Entry *e = &_log[n];
+  e->time = t;
+  e->cpu = cpu;
+  Mem::mp_wmb();
+  write_now(&e->stage, stage);
+}
+
+PUBLIC static inline
+unsigned
+Boot_log::num()
+{ return access_once(&_num); }
+
+/**
+ * Get a log entry.
+ * \return the entry, 0 if it is still being written.
+ */
+PUBLIC static inline
+Boot_log::Entry const *
+Boot_log::entry(unsigned i)
+{ return access_once(&_log[i].stage) ? &_log[i] : 0; }
+
+// ------------------------------------------------------------------------
+IMPLEMENTATION [ia32 || amd64 || ux]:
+
+#include "cpu.h"
+
+PRIVATE static inline NEEDS["cpu.h"]
+Unsigned64
+Boot_log::now()
+{ return Cpu::rdtsc(); }
+
+PUBLIC static inline NEEDS["cpu.h"]
+Unsigned64
+Boot_log::to_us(Unsigned64 time)
+{ return Cpu::boot_cpu()->tsc_to_us(time); }
+
+// ------------------------------------------------------------------------
+IMPLEMENTATION [!(ia32 || amd64 || ux)]:
+
+#include "kip.h"
+
+PRIVATE static inline NEEDS["kip.h"]
+Unsigned64
+Boot_log::now()
+{ return Kip::k()->clock; }
+
+PUBLIC static inline
+Unsigned64
+Boot_log::to_us(Unsigned64 time)
+{ return time; }
@@ -536,6 +536,7 @@ IMPLEMENTATION:
 #include "fpu.h"
 #include "globals.h"		// current()
 #include "kdb_ke.h"
+#include "lat_hist.h"
 #include "lock_guard.h"
 #include "logdefs.h"
 #include "mem.h"
@@ -1306,7 +1307,9 @@ Context::switch_exec_locked(Context *t, enum Helping_mode mode)
 
   t->set_current_cpu(get_current_cpu());
   switch_fpu(t);
+  Lat_hist::switch_start();
   switch_cpu(t);
+  Lat_hist::switch_done();
 
   return switch_handle_drq();
 }
@@ -1355,7 +1358,9 @@ Context::switch_exec_helping(Context *t, Helping_mode mode, Mword const *lock, M
   t->set_helper(mode);
   t->set_current_cpu(get_current_cpu());
   switch_fpu(t);
+  Lat_hist::switch_start();
   switch_cpu(t);
+  Lat_hist::switch_done();
   return switch_handle_drq();
 }
 
@@ -1961,7 +1966,7 @@ Context::shutdown_drqs()
 
 PUBLIC inline
 void
-Context::rcu_wait()
+Context::rcu_wait(bool = false)
 {
   // The UP case does not need to block for the next grace period, because
   // the CPU is always in a quiescent state when the interrupts where enabled
@@ -2013,9 +2018,25 @@ protected:
   class Pending_rq : public Queue_item, public Context_member
   {} _pending_rq;
 
+  /**
+   * Idle polling state of a CPU.
+   *
+   * While the idle thread spins on the pending-request queue of its CPU
+   * (see Thread::poll_remote_requests()) \a polling is set and senders of
+   * DRQs to this CPU need no IPI.
+   */
+  struct Idle_poll
+  {
+    enum { Min_budget = 64, Max_budget = 16384 };
+    Mword polling;   ///< idle thread is spinning on the request queue
+    unsigned budget; ///< spin rounds before the CPU is halted
+    Idle_poll() : polling(0), budget(Min_budget) {}
+  };
+
 protected:
   static Per_cpu<Pending_rqq> _pending_rqq;
   static Per_cpu<Cpu_call_queue> _glbl_q;
+  static Per_cpu<Idle_poll> _idle_poll;
   static Cpu_mask _tlb_active;
 
 };
@@ -2033,6 +2054,7 @@ IMPLEMENTATION [mp]:
 
 DEFINE_PER_CPU Per_cpu<Context::Pending_rqq> Context::_pending_rqq;
 DEFINE_PER_CPU Per_cpu<Context::Cpu_call_queue> Context::_glbl_q;
+DEFINE_PER_CPU Per_cpu<Context::Idle_poll> Context::_idle_poll;
 Cpu_mask Context::_tlb_active;
 
 PRIVATE inline
@@ -2159,6 +2181,9 @@ Context::Pending_rqq::handle_requests(Context **mq)
     printf("CPU[%2u:%p]: Context::Pending_rqq::handle_requests() this=%p\n", cxx::int_value<Cpu_number>(current_cpu()), current(), this);
   bool resched = false;
   Context *curr = current();
+  Sched_context::Ready_queue &rq = Sched_context::rq.current();
+  // contexts woken by this burst of requests, enqueued at once
+  Sched_context *bulk = 0;
   while (1)
     {
       Context *c;
@@ -2166,7 +2191,7 @@ Context::Pending_rqq::handle_requests(Context **mq)
           auto guard = lock_guard(q_lock());
           Queue_item *qi = first();
           if (!qi)
-            return resched;
+            break;
 
           check_kdb (dequeue(qi, Queue_item::Ok));
           c = static_cast<Context::Pending_rq *>(qi)->context();
@@ -2182,6 +2207,10 @@ Context::Pending_rqq::handle_requests(Context **mq)
           // would miss the remaining requests or execute them on the wrong CPU.
           if (c != curr)
             {
+              // migration looks at the ready queue, make it complete
+              rq.enqueue_bulk(bulk);
+              bulk = 0;
+
               // we can directly migrate the thread...
               resched |= c->initiate_migration();
 
@@ -2200,12 +2229,20 @@ Context::Pending_rqq::handle_requests(Context **mq)
           if (EXPECT_TRUE(c != curr))
             c->state_add(Thread_drq_ready);
           else
-            resched |= c->handle_drq();
+            {
+              // DRQ handlers may change the ready queue
+              rq.enqueue_bulk(bulk);
+              bulk = 0;
+              resched |= c->handle_drq();
+            }
         }
 
       if (EXPECT_TRUE(c != curr && (c->state() & Thread_ready_mask)))
-        resched |= Sched_context::rq.current().deblock(c->sched(), curr->sched());
+        resched |= rq.deblock_bulk(c->sched(), curr->sched(), &bulk);
     }
+
+  rq.enqueue_bulk(bulk);
+  return resched;
 }
 
 IMPLEMENT inline NEEDS["ipi.h"]
@@ -2323,6 +2360,25 @@ Context::take_cpu_online(Cpu_number cpu)
   Cpu::cpus.cpu(cpu).set_online(true);
 }
 
+/**
+ * Signal \a cpu that its pending-request queue became non-empty.
+ *
+ * The IPI is skipped if the idle thread of \a cpu is spinning on the
+ * queue anyway.
+ */
+PRIVATE static inline NEEDS["ipi.h", "mem.h"]
+void
+Context::kick_pending_rqq(Cpu_number from, Cpu_number cpu)
+{
+  // order the enqueue before reading the flag, pairs with the barrier in
+  // Thread::poll_remote_requests()
+  Mem::mp_mb();
+  if (access_once(&_idle_poll.cpu(cpu).polling))
+    return;
+
+  Ipi::send(Ipi::Request, from, cpu);
+}
+
 PRIVATE
 void
 Context::pending_rqq_enqueue()
@@ -2356,7 +2412,7 @@ Context::pending_rqq_enqueue()
     }
 
   if (ipi)
-    Ipi::send(Ipi::Request, current_cpu(), cpu);
+    kick_pending_rqq(current_cpu(), cpu);
 }
 
 PRIVATE inline
@@ -2448,7 +2504,7 @@ Context::enqueue_drq(Drq *rq, Drq::Exec_mode /*exec*/)
     }
 
   if (ipi)
-    Ipi::send(Ipi::Request, current_cpu, cpu);
+    kick_pending_rqq(current_cpu, cpu);
 
   return false;
 }
@@ -2471,14 +2527,18 @@ Context::shutdown_drqs()
 
 /**
  * Block and wait for the next grace period.
+ * \param expedite  Expedite the grace period, see Rcu::expedite().
  */
 PUBLIC inline NEEDS["cpu_lock.h", "lock_guard.h"]
 void
-Context::rcu_wait()
+Context::rcu_wait(bool expedite = false)
 {
   auto guard = lock_guard(cpu_lock);
   state_change_dirty(~Thread_ready, Thread_waiting);
-  Rcu::call(this, &rcu_unblock);
+  if (expedite)
+    Rcu::call_expedited(this, &rcu_unblock);
+  else
+    Rcu::call(this, &rcu_unblock);
   while (state() & Thread_waiting)
     {
       state_del_dirty(Thread_ready);
@@ -2,15 +2,16 @@ INTERFACE:
 
 #include "fiasco_defs.h"
 #include "ram_quota.h"
-#include "slab_cache.h"
 #include "kobject_helper.h"
 
+class Kmem_slab;
+
 class Factory : public Ram_quota, public Kobject_h<Factory>
 {
   FIASCO_DECLARE_KOBJ();
 
 private:
-  typedef Slab_cache Self_alloc;
+  typedef Kmem_slab Self_alloc;
 };
 
 //---------------------------------------------------------------------------
@@ -25,6 +26,7 @@ IMPLEMENTATION:
 #include "l4_types.h"
 #include "irq.h"
 #include "map_util.h"
+#include "msg_queue.h"
 #include "logdefs.h"
 #include "entry_frame.h"
 
@@ -181,6 +183,17 @@ Factory::new_irq(unsigned w, Utcb const *utcb, int *)
     return Irq::allocate<Irq_sender>(this);
 }
 
+PRIVATE inline NOEXPORT
+Kobject_iface *
+Factory::new_msg_queue(unsigned w, Utcb const *utcb, int *err)
+{
+  *err = L4_err::EInval;
+  if (w < 5)
+    return 0;
+
+  return Msg_queue::create(this, utcb->values[2], utcb->values[4], err);
+}
+
 PUBLIC
 L4_msg_tag
 Factory::kinvoke(L4_obj_ref ref, L4_fpage::Rights rights, Syscall_frame *f,
@@ -247,6 +260,10 @@ Factory::kinvoke(L4_obj_ref ref, L4_fpage::Rights rights, Syscall_frame *f,
       new_o = new_vm(utcb, &err);
       break;
 
+    case L4_msg_tag::Label_msg_queue:
+      new_o = new_msg_queue(f->tag().words(), utcb, &err);
+      break;
+
     default:
       return commit_result(-L4_err::ENodev);
     }
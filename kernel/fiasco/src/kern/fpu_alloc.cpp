@@ -1,8 +1,8 @@
 INTERFACE:
 
 #include "fpu.h"
-#include "slab_cache.h"
 
+class Kmem_slab;
 class Ram_quota;
 
 class Fpu_alloc : public Fpu
@@ -19,7 +19,7 @@ static Kmem_slab _fpu_state_allocator(Fpu::state_size() + sizeof(Ram_quota *),
                                       Fpu::state_align(), "Fpu state");
 
 PRIVATE static
-Slab_cache *
+Kmem_slab *
 Fpu_alloc::slab_alloc()
 {
   return &_fpu_state_allocator;
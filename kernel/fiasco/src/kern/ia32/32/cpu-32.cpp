@@ -130,6 +130,17 @@ Cpu::kernel_sp() const
 //----------------------------------------------------------------------------
 IMPLEMENTATION[ia32]:
 
+/** PCIDs need long mode. */
+PUBLIC inline
+bool
+Cpu::has_pcid() const
+{ return false; }
+
+PUBLIC static inline
+bool
+Cpu::have_pcid()
+{ return false; }
+
 PUBLIC static inline
 void
 Cpu:: set_cs()
@@ -30,6 +30,7 @@ public:
     utcb_ptr_align    = Tl_math::Ld<64>::Res,    // 64byte cachelines
     Idt               = Service_page + 0xfe000,  ///< % 4KB
     Syscalls          = Service_page + 0xff000,  ///< % 4KB syscall page
+    Lat_hist_area     = Service_page + 0x100000, ///< % 4KB up to 1MB
     Tbuf_buffer_area  = Service_page + 0x200000, ///< % 2MB
     Tbuf_ubuffer_area = Tbuf_buffer_area,
     // 0xeb800000-0xec000000 (8MB) free
@@ -219,3 +219,15 @@ Mword
 Cpu::stack_align(Mword stack)
 { return stack & ~0xf; }
 
+
+/** Process-context identifiers, used to tag the TLB entries of
+ *  address spaces (see Mem_space::make_current). */
+PUBLIC inline
+bool
+Cpu::has_pcid() const
+{ return ext_features() & FEATX_PCID; }
+
+PUBLIC static inline
+bool
+Cpu::have_pcid()
+{ return boot_cpu()->has_pcid(); }
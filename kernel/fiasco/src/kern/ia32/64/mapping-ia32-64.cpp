@@ -3,6 +3,7 @@ INTERFACE [amd64]:
 #include "types.h"
 class Space;
 class Treemap;
+class Mapping;
 
 class Mapping_entry
 {
@@ -17,8 +18,10 @@ public:
       unsigned long address:36;	///< Virtual address in address space
     } data;
     Treemap *_submap;
+    Mapping *_link;
   };
   Unsigned8 _depth;
+  Unsigned8 _hint;	///< Offset hint to the root entry (see Mapping_tree)
 
   void set_space(Space *s) { data._space = (unsigned long)s & 0x0ffffffffUL; }
   Space *space() const
@@ -1368,6 +1368,13 @@ Address
 Cpu::get_pdbr()
 { Address addr; asm volatile ("mov %%cr3, %0" : "=r" (addr)); return addr; }
 
+/** Physical address of the current page directory, without the PCID
+ *  or cache-control bits of CR3. */
+PUBLIC static inline
+Address
+Cpu::get_pdbr_addr()
+{ return get_pdbr() & ~0xfffUL; }
+
 PUBLIC static inline
 Mword
 Cpu::get_cr4()
@@ -1615,6 +1622,10 @@ Cpu::init()
   if (has_smep())
     cr4 |= CR4_SMEP;
 
+  // tag TLB entries with the address space, see Mem_space::make_current
+  if (has_pcid())
+    cr4 |= CR4_PCIDE;
+
   set_cr4 (cr4);
 
   // reset time stamp counter (better for debugging)
@@ -64,6 +64,8 @@ IMPLEMENTATION[ia32,amd64,ux]:
 #include "fpu_state.h"
 #include "regdefs.h"
 #include "globals.h"
+#include "lock_guard.h"
+#include "spin_lock.h"
 #include "static_assert.h"
 
 unsigned Fpu::_state_size;
@@ -155,6 +157,10 @@ Fpu::init(Cpu_number cpu, bool resume)
       f._variant  = Variant_fpu;
     }
 
+  // the APs come here in parallel
+  static Spin_lock<> state_lock;
+  auto guard = lock_guard(state_lock);
+
   if (cpu_size > _state_size)
     _state_size = cpu_size;
   if (cpu_align > _state_align)
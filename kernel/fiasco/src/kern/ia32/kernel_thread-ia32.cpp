@@ -2,6 +2,7 @@
 IMPLEMENTATION[ia32,amd64]:
 
 #include "apic.h"
+#include "boot_log.h"
 #include "config.h"
 #include "cpu.h"
 #include "io_apic.h"
@@ -54,6 +55,8 @@ Kernel_thread::boot_app_cpus()
 //--------------------------------------------------------------------------
 IMPLEMENTATION [mp]:
 
+#include "context_base.h"
+
 PUBLIC
 static void
 Kernel_thread::boot_app_cpus()
@@ -88,12 +91,23 @@ Kernel_thread::boot_app_cpus()
 
   __asm__ __volatile__ ("" : : : "memory");
 
+  // The APs run on these until they switch to their kernel thread.  Each
+  // one is a context block whose header tells current_cpu() that there is
+  // no CPU number yet; boot_ap_cpu() sets it once the AP knows its number.
+  extern char _tramp_mp_ap_stacks[];
+  for (unsigned i = 0; i < Config::Max_num_cpus; ++i)
+    reinterpret_cast<Context_base *>(_tramp_mp_ap_stacks
+                                     + i * Context_base::Size)
+      ->set_current_cpu(Cpu_number::nil());
+
   // Say what we do
   printf("MP: detecting APs...\n");
 
   // broadcast an AP startup via the APIC (let run the self-registration code)
   tramp_page = (Address)&(_tramp_mp_entry[0]);
 
-  // Send IPI-Sequency to startup the APs
+  // Send IPI-Sequency to startup the APs, they come up in parallel
+  Boot_log::stamp(Cpu_number::boot_cpu(), "starting APs");
   Apic::mp_startup(Cpu::boot_cpu(), Apic::APIC_IPI_OTHERS, tramp_page);
+  Boot_log::stamp(Cpu_number::boot_cpu(), "APs started");
 }
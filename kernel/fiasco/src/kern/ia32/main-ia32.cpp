@@ -89,6 +89,7 @@ IMPLEMENTATION[(ia32,amd64) && mp]:
 #include <cstdio>
 #include "apic.h"
 #include "app_cpu_thread.h"
+#include "boot_log.h"
 #include "config.h"
 #include "cpu.h"
 #include "div32.h"
@@ -96,6 +97,7 @@ IMPLEMENTATION[(ia32,amd64) && mp]:
 #include "globals.h"
 #include "ipi.h"
 #include "kernel_task.h"
+#include "lock_guard.h"
 #include "processor.h"
 #include "per_cpu_data_alloc.h"
 #include "perf_cnt.h"
@@ -103,25 +105,46 @@ IMPLEMENTATION[(ia32,amd64) && mp]:
 #include "spin_lock.h"
 #include "utcb_init.h"
 
-int FIASCO_FASTCALL boot_ap_cpu() __asm__("BOOT_AP_CPU");
-
-int FIASCO_FASTCALL boot_ap_cpu()
+int FIASCO_FASTCALL boot_ap_cpu(unsigned shared_stack) __asm__("BOOT_AP_CPU");
+
+/**
+ * Bring up an application CPU.
+ *
+ * Usually each AP comes here on a boot stack of its own, so that all of
+ * them initialize in parallel and only the allocation of the per-CPU
+ * data, descriptor tables and the kernel thread is serialized.  The boot
+ * stacks are context blocks, their header holds the CPU number for
+ * current_cpu() while the AP runs here.
+ *
+ * \param shared_stack  The AP runs on the shared trampoline stack and
+ *                      holds the trampoline spinlock.
+ */
+int FIASCO_FASTCALL boot_ap_cpu(unsigned shared_stack)
 {
+  extern Spin_lock<Mword> _tramp_mp_spinlock;
+  static Spin_lock<> alloc_lock;
+  static Cpu_number last_cpu; // keep track of the last cpu ever appeared
+
+  auto guard = lock_guard(alloc_lock);
+
   Cpu_number _cpu = Apic::find_cpu(Apic::get_id());
   bool cpu_is_new = false;
-  static Cpu_number last_cpu; // keep track of the last cpu ever appeared
   if (_cpu == Cpu_number::nil())
     {
       _cpu = ++last_cpu; // 0 is the boot cpu, so pre increment
       cpu_is_new = true;
     }
 
+  current()->set_current_cpu(_cpu);
+
   if (cpu_is_new && !Per_cpu_data_alloc::alloc(_cpu))
     {
-      extern Spin_lock<Mword> _tramp_mp_spinlock;
       printf("CPU allocation failed for CPU%u, disabling CPU.\n",
              cxx::int_value<Cpu_number>(_cpu));
-      _tramp_mp_spinlock.clear();
+      current()->set_current_cpu(Cpu_number::nil());
+      guard.reset();
+      if (shared_stack)
+        _tramp_mp_spinlock.clear();
       while (1)
         Proc::halt();
     }
@@ -129,13 +152,20 @@ int FIASCO_FASTCALL boot_ap_cpu()
   if (cpu_is_new)
     Per_cpu_data::run_ctors(_cpu);
 
+  // the TSC of the AP is reset by the Cpu constructor, so start the log here
+  Boot_log::stamp(_cpu, "AP per-CPU data");
+
   Cpu &cpu = Cpu::cpus.cpu(_cpu);
 
   Idt::load();
 
+  if (cpu_is_new)
+    Kmem::init_cpu(cpu);
+
+  guard.reset();
+
   if (cpu_is_new)
     {
-      Kmem::init_cpu(cpu);
       Apic::init_ap();
       Apic::apic.cpu(_cpu).construct(_cpu);
       Ipi::init(_cpu);
@@ -157,10 +187,17 @@ int FIASCO_FASTCALL boot_ap_cpu()
   if (Koptions::o()->opt(Koptions::F_loadcnt))
     Perf_cnt::init_ap();
 
+  Boot_log::stamp(_cpu, "AP local APIC and timer");
 
   // create kernel thread
+  guard.lock(&alloc_lock);
   Kernel_thread *kernel = App_cpu_thread::may_be_create(_cpu, cpu_is_new);
+  guard.reset();
+  static_cast<App_cpu_thread *>(kernel)->set_shared_boot_stack(shared_stack);
 
+  // the shared boot stack goes to the next AP once we run on the kernel
+  // thread, which knows its CPU
+  current()->set_current_cpu(Cpu_number::nil());
   main_switch_ap_cpu_stack(kernel, !cpu_is_new);
   return 0;
 }
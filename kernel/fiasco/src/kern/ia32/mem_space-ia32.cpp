@@ -61,6 +61,38 @@ protected:
   Dir_type *_dir;
 };
 
+//----------------------------------------------------------------------------
+INTERFACE [ia32 || amd64]:
+
+EXTENSION class Mem_space
+{
+public:
+  enum { Have_tlb_flush_range = 1 }; ///< single pages go with invlpg
+};
+
+//----------------------------------------------------------------------------
+INTERFACE [amd64]:
+
+#include "per_cpu_data.h"
+
+EXTENSION class Mem_space
+{
+public:
+  enum : Mword
+  {
+    Pcid_invalid = ~0UL,
+    Num_pcids    = 256,       ///< PCIDs used per CPU, out of 4096
+    Cr3_no_flush = 1UL << 63, ///< keep the TLB entries of the loaded PCID
+  };
+
+private:
+  typedef Per_cpu_array<Mword> Pcid_array;
+  Pcid_array _pcid;
+
+  static Per_cpu<unsigned> _next_free_pcid;
+  static Per_cpu<Mem_space *[Num_pcids]> _active_pcids;
+};
+
 //----------------------------------------------------------------------------
 IMPLEMENTATION [ia32 || ux || amd64]:
 
@@ -76,8 +108,12 @@ IMPLEMENTATION [ia32 || ux || amd64]:
 
 
 
-PUBLIC explicit inline
-Mem_space::Mem_space(Ram_quota *q) : _quota(q), _dir(0) {}
+PUBLIC explicit inline NEEDS[Mem_space::init_pcid, Mem_space::init_host]
+Mem_space::Mem_space(Ram_quota *q) : _quota(q), _dir(0)
+{
+  init_pcid();
+  init_host();
+}
 
 PROTECTED inline
 bool
@@ -97,6 +133,8 @@ PUBLIC
 Mem_space::Mem_space(Ram_quota *q, Dir_type* pdir)
   : _quota(q), _dir(pdir)
 {
+  init_pcid();
+  init_host();
   _kernel_space = this;
   _current.cpu(Cpu_number::boot_cpu()) = this;
 }
@@ -116,14 +154,6 @@ Mem_space::has_superpages()
 }
 
 
-PUBLIC inline NEEDS["mem_unit.h"]
-void
-Mem_space::tlb_flush(bool = false)
-{
-  if (_current.current() == this)
-    Mem_unit::tlb_flush();
-}
-
 
 IMPLEMENT inline
 Mem_space *
@@ -341,6 +371,7 @@ Mem_space::v_delete(Vaddr virt, Page_order size, L4_fpage::Rights page_attribs)
 PUBLIC
 Mem_space::~Mem_space()
 {
+  reset_pcid();
   if (_dir)
     {
       dir_shutdown();
@@ -365,13 +396,10 @@ IMPLEMENTATION [ia32 || amd64]:
 #include "config.h"
 #include "kmem.h"
 
-IMPLEMENT inline NEEDS ["cpu.h", "kmem.h"]
+PRIVATE inline
 void
-Mem_space::make_current()
-{
-  Cpu::set_pdbr((Mem_layout::pmem_to_phys(_dir)));
-  _current.cpu(current_cpu()) = this;
-}
+Mem_space::init_host()
+{}
 
 PUBLIC inline NEEDS ["kmem.h"]
 Address
@@ -380,6 +408,40 @@ Mem_space::phys_dir()
   return Mem_layout::pmem_to_phys(_dir);
 }
 
+/**
+ * Flush the TLB entries of this space on the current CPU.
+ *
+ * A space that is not current on this CPU has no TLB entries here, unless
+ * they are tagged with a PCID, in which case the PCID is given up.
+ */
+PUBLIC inline NEEDS["mem_unit.h", Mem_space::drop_pcid]
+void
+Mem_space::tlb_flush(bool = false)
+{
+  if (_current.current() == this)
+    Mem_unit::tlb_flush_current();
+  else
+    drop_pcid(current_cpu());
+}
+
+/**
+ * Flush the TLB entries for `pages` pages starting at `va` on the current
+ * CPU, see tlb_flush().
+ */
+PUBLIC inline NEEDS["mem_unit.h", "config.h", Mem_space::drop_pcid]
+void
+Mem_space::tlb_flush_range(Address va, unsigned pages)
+{
+  if (_current.current() != this)
+    {
+      drop_pcid(current_cpu());
+      return;
+    }
+
+  for (; pages; --pages, va += Config::PAGE_SIZE)
+    Mem_unit::tlb_flush(va);
+}
+
 /*
  * The following functions are all no-ops on native ia32.
  * Pages appear in an address space when the corresponding PTE is made
@@ -434,8 +496,141 @@ Mem_space::sync_kernel()
 // --------------------------------------------------------------------
 IMPLEMENTATION [amd64]:
 
+#include "atomic.h"
 #include "cpu.h"
 
+DEFINE_PER_CPU Per_cpu<unsigned> Mem_space::_next_free_pcid;
+DEFINE_PER_CPU Per_cpu<Mem_space *[Mem_space::Num_pcids]> Mem_space::_active_pcids;
+
+PRIVATE inline
+void
+Mem_space::init_pcid()
+{
+  for (Pcid_array::iterator i = _pcid.begin(); i != _pcid.end(); ++i)
+    *i = Pcid_invalid;
+}
+
+/* PCID 0 tags the entries of the boot page table and is never handed out. */
+PRIVATE static inline
+Mword
+Mem_space::next_pcid(Cpu_number cpu)
+{
+  unsigned &n = _next_free_pcid.cpu(cpu);
+  if (n == 0 || n >= Num_pcids)
+    n = 1;
+  return n++;
+}
+
+/**
+ * PCID of this space on the current CPU, allocated on demand.
+ * \return The PCID bits for CR3.  A newly allocated PCID may still have
+ *         stale entries in the TLB, so only for a PCID that was used by
+ *         this space before the no-flush bit is set.
+ */
+PRIVATE inline NEEDS[Mem_space::next_pcid, "atomic.h"]
+Mword
+Mem_space::pcid()
+{
+  Cpu_number cpu = current_cpu();
+  Mword pcid = _pcid[cpu];
+  if (EXPECT_TRUE(pcid != Pcid_invalid))
+    return pcid | Cr3_no_flush;
+
+  // FIFO PCID replacement strategy, as for the ASIDs on ARM
+  pcid = next_pcid(cpu);
+  Mem_space **bad_guy = &_active_pcids.cpu(cpu)[pcid];
+  while (Mem_space *victim = access_once(bad_guy))
+    {
+      // do not replace the PCID of the current space
+      if (victim == _current.cpu(cpu))
+        {
+          pcid = next_pcid(cpu);
+          bad_guy = &_active_pcids.cpu(cpu)[pcid];
+          continue;
+        }
+
+      // If the victim is valid and we get a 1 written to the PCID array
+      // then we have to reset the PCID of our victim, else reset_pcid()
+      // is currently resetting the PCIDs of the victim on a different CPU.
+      if (victim != reinterpret_cast<Mem_space*>(~0UL)
+          && mp_cas(bad_guy, victim, reinterpret_cast<Mem_space*>(1)))
+        write_now(&victim->_pcid[cpu], (Mword)Pcid_invalid);
+      break;
+    }
+
+  _pcid[cpu] = pcid;
+  write_now(bad_guy, this);
+  return pcid;
+}
+
+/**
+ * Give up the PCID of this space on `cpu`, which must be the current CPU.
+ * The next make_current() allocates a fresh PCID, flushing the stale
+ * entries.
+ */
+PRIVATE inline NEEDS["atomic.h", "cpu.h"]
+void
+Mem_space::drop_pcid(Cpu_number cpu)
+{
+  if (!Cpu::have_pcid())
+    return;
+
+  Mword pcid = _pcid[cpu];
+  if (pcid == Pcid_invalid)
+    return;
+
+  write_now(&_pcid[cpu], (Mword)Pcid_invalid);
+  mp_cas(&_active_pcids.cpu(cpu)[pcid], this,
+         reinterpret_cast<Mem_space*>(~0UL));
+}
+
+PRIVATE inline NEEDS["atomic.h"]
+void
+Mem_space::reset_pcid()
+{
+  for (Cpu_number i = Cpu_number::first(); i < Config::max_num_cpus(); ++i)
+    {
+      Mword pcid = access_once(&_pcid[i]);
+      if (pcid == Pcid_invalid)
+        continue;
+
+      Mem_space **a = &_active_pcids.cpu(i)[pcid];
+      if (!mp_cas(a, this, reinterpret_cast<Mem_space*>(~0UL)))
+        // It could be our PCID is in the process of being preempted,
+        // so wait until this is done.
+        while (access_once(a) == reinterpret_cast<Mem_space*>(1))
+          ;
+    }
+}
+
+/*
+ * The current space is updated before loading CR3 (which serializes), so
+ * that a TLB shootdown after a page-table update does not miss this CPU,
+ * see tlb_active_on().
+ */
+IMPLEMENT inline NEEDS ["cpu.h", "kmem.h", Mem_space::pcid]
+void
+Mem_space::make_current()
+{
+  Mword cr3 = Mem_layout::pmem_to_phys(_dir);
+  if (Cpu::have_pcid())
+    cr3 |= pcid();
+  write_now(&_current.current(), this);
+  Cpu::set_pdbr(cr3);
+}
+
+/**
+ * Can `cpu` have TLB entries of this space?  That is the case if the space
+ * is current on `cpu` or has a PCID there.
+ */
+PUBLIC inline
+bool
+Mem_space::tlb_active_on(Cpu_number cpu) const
+{
+  return access_once(&_pcid[cpu]) != Pcid_invalid
+         || access_once(&_current.cpu(cpu)) == this;
+}
+
 PUBLIC static inline
 Page_number
 Mem_space::canonize(Page_number v)
@@ -462,6 +657,21 @@ IMPLEMENTATION [ia32 || ux]:
 
 #include "cpu.h"
 
+PRIVATE inline
+void
+Mem_space::init_pcid()
+{}
+
+PRIVATE inline
+void
+Mem_space::drop_pcid(Cpu_number)
+{}
+
+PRIVATE inline
+void
+Mem_space::reset_pcid()
+{}
+
 PUBLIC static inline
 Page_number
 Mem_space::canonize(Page_number v)
@@ -475,3 +685,24 @@ Mem_space::init_page_sizes()
   if (Cpu::cpus.cpu(Cpu_number::boot_cpu()).superpages())
     add_page_size(Page_order(22)); // 4MB
 }
+
+// --------------------------------------------------------------------
+IMPLEMENTATION [ia32]:
+
+IMPLEMENT inline NEEDS ["cpu.h", "kmem.h"]
+void
+Mem_space::make_current()
+{
+  // see the amd64 version for the order
+  write_now(&_current.current(), this);
+  Cpu::set_pdbr((Mem_layout::pmem_to_phys(_dir)));
+}
+
+/**
+ * Can `cpu` have TLB entries of this space?  Without PCIDs loading CR3
+ * flushes the entries of the previous space.
+ */
+PUBLIC inline
+bool
+Mem_space::tlb_active_on(Cpu_number cpu) const
+{ return access_once(&_current.cpu(cpu)) == this; }
@@ -9,11 +9,11 @@ class Mem_unit
 
 IMPLEMENTATION[ia32 || amd64]:
 
-/** Flush the whole TLB.
+/** Flush the non-global TLB entries of the current address space.
  */
 PUBLIC static inline ALWAYS_INLINE
 void
-Mem_unit::tlb_flush()
+Mem_unit::tlb_flush_current()
 {
   Mword dummy;
   __asm__ __volatile__ ("mov %%cr3,%0; mov %0,%%cr3 " : "=r"(dummy) : : "memory");
@@ -33,3 +33,39 @@ PUBLIC static inline ALWAYS_INLINE
 void
 Mem_unit::clean_dcache(void *)
 {}
+
+
+IMPLEMENTATION[ia32]:
+
+/** Flush the whole TLB.
+ */
+PUBLIC static inline ALWAYS_INLINE
+void
+Mem_unit::tlb_flush()
+{ tlb_flush_current(); }
+
+
+IMPLEMENTATION[amd64]:
+
+#include "regdefs.h"
+
+/** Flush the whole TLB.
+ *
+ * With PCIDs enabled reloading CR3 only flushes the entries of the current
+ * PCID, toggling CR4.PGE flushes the entries of all PCIDs.
+ */
+PUBLIC static inline ALWAYS_INLINE NEEDS["regdefs.h"]
+void
+Mem_unit::tlb_flush()
+{
+  Mword cr4;
+  __asm__ __volatile__ ("mov %%cr4,%0" : "=r"(cr4));
+  if (!(cr4 & CR4_PCIDE))
+    {
+      tlb_flush_current();
+      return;
+    }
+
+  __asm__ __volatile__ ("mov %0,%%cr4; mov %1,%%cr4"
+                        : : "r"(cr4 ^ CR4_PGE), "r"(cr4) : "memory");
+}
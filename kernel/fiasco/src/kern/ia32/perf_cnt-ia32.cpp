@@ -34,6 +34,14 @@ public:
   inline void touch_watchdog()
     { Cpu::wrmsr(hold_watchdog, _ctr_reg0+pmc_watchdog); }
 
+  // reload the sample counter after an overflow
+  inline void rearm_sampler()
+    { Cpu::wrmsr(hold_sampler, _ctr_reg0+pmc_sampler); }
+
+  // counter wrapped: bit 31 of the negative start value got cleared
+  inline bool sampler_overflowed()
+    { return !(Cpu::rdmsr(_ctr_reg0+pmc_sampler) & 0x80000000); }
+
 protected:
   Mword _nr_regs;
   Mword _sel_reg0;
@@ -52,7 +60,9 @@ protected:
 
   static Mword    pmc_watchdog;                   // # perfcounter of watchdog
   static Mword    pmc_loadcnt;                    // # perfcounter of loadcnt
+  static Mword    pmc_sampler;                    // # perfcounter of sampler
   static Signed64 hold_watchdog;
+  static Signed64 hold_sampler;
   static Event    pmc_event[Perf_cnt::Max_slot];  // index is slot number
   static char     pmc_alloc[Perf_cnt::Max_pmc];   // index is # of perfcounter
 };
@@ -85,7 +95,9 @@ char const *Perf_cnt::perf_type_str = "n/a";
 
 Mword Perf_cnt_arch::pmc_watchdog = (Mword)-1;
 Mword Perf_cnt_arch::pmc_loadcnt  = (Mword)-1;
+Mword Perf_cnt_arch::pmc_sampler  = (Mword)-1;
 Signed64 Perf_cnt_arch::hold_watchdog;
+Signed64 Perf_cnt_arch::hold_sampler;
 Perf_cnt_arch::Event Perf_cnt_arch::pmc_event[Perf_cnt::Max_slot];
 char  Perf_cnt_arch::pmc_alloc[Perf_cnt::Max_pmc];
 
@@ -100,6 +112,7 @@ enum
   Alloc_none            = 0,	// unallocated
   Alloc_perf            = 1,	// allocated as performance counter
   Alloc_watchdog        = 2,	// allocated for watchdog
+  Alloc_sampler         = 3,	// allocated for the profiling sampler
 };
 
 enum
@@ -395,6 +408,29 @@ Perf_cnt_p6::stop_watchdog()
   Cpu::wrmsr(msr, _sel_reg0+pmc_watchdog);
 }
 
+bool
+Perf_cnt_p6::init_sampler()
+{
+  Unsigned64 msr;
+
+  msr = P6_evntsel_int  // Int enable: enable interrupt on overflow
+      | P6_evntsel_kern // Monitor kernel-level events
+      | P6_evntsel_user // Monitor user-level events
+      | 0x79;           // #clocks CPU is not halted
+  Cpu::wrmsr(msr, _sel_reg0+pmc_sampler);
+  return true;
+}
+
+void
+Perf_cnt_p6::stop_sampler()
+{
+  Unsigned64 msr;
+
+  msr = Cpu::rdmsr(_sel_reg0+pmc_sampler);
+  msr &= ~P6_evntsel_int; // no more overflow interrupts
+  Cpu::wrmsr(msr, _sel_reg0+pmc_sampler);
+}
+
 static Mword p6_read_pmc_0() { return Cpu::rdpmc(0, 0xC1); }
 static Mword p6_read_pmc_1() { return Cpu::rdpmc(1, 0xC2); }
 
@@ -445,6 +481,19 @@ Perf_cnt_k7::init_loadcnt()
   printf("Load counter initialized (read with rdpmc(0x%02lX))\n", pmc_loadcnt);
 }
 
+bool
+Perf_cnt_k7::init_sampler()
+{
+  Unsigned64 msr;
+
+  msr = K7_evntsel_int  // Int enable: enable interrupt on overflow
+      | K7_evntsel_kern // Monitor kernel-level events
+      | K7_evntsel_user // Monitor user-level events
+      | 0x76;           // #clocks CPU is running
+  Cpu::wrmsr(msr, _sel_reg0+pmc_sampler);
+  return true;
+}
+
 static Mword k7_read_pmc_0() { return Cpu::rdpmc(0, 0xC0010004); }
 static Mword k7_read_pmc_1() { return Cpu::rdpmc(1, 0xC0010005); }
 static Mword k7_read_pmc_2() { return Cpu::rdpmc(2, 0xC0010006); }
@@ -500,6 +549,19 @@ Perf_cnt_ap::init_loadcnt()
   printf("Load counter initialized (read with rdpmc(0x%02lX))\n", pmc_loadcnt);
 }
 
+bool
+Perf_cnt_ap::init_sampler()
+{
+  Unsigned64 msr;
+
+  msr = AP_evntsel_int    // Int enable: enable interrupt on overflow
+        | AP_evntsel_kern // Monitor kernel-level events
+        | AP_evntsel_user // Monitor user-level events
+        | 0x3C;           // #clocks CPU is running
+  Cpu::wrmsr(msr, _sel_reg0 + pmc_sampler);
+  return true;
+}
+
 
 //--------------------------------------------------------------------
 // Intel P4
@@ -663,6 +725,33 @@ Mword
 Perf_cnt_arch::loadcnt_allocated()
 { return (pmc_loadcnt != (Mword)-1); }
 
+PUBLIC inline
+Mword
+Perf_cnt_arch::sampler_allocated()
+{ return (pmc_sampler != (Mword)-1); }
+
+// the sampler only takes a free counter, it never moves the watchdog
+PUBLIC
+bool
+Perf_cnt_arch::alloc_sampler()
+{
+  if (sampler_allocated())
+    return true;
+
+  if (!_watchdog)
+    return false;
+
+  for (Mword pmc=0; pmc<_nr_regs; pmc++)
+    if (pmc_alloc[pmc] == Alloc_none)
+      {
+	pmc_alloc[pmc] = Alloc_sampler;
+	pmc_sampler    = pmc;
+	return true;
+      }
+
+  return false;
+}
+
 void
 Perf_cnt_arch::alloc_watchdog()
 {
@@ -822,6 +911,29 @@ Perf_cnt_arch::setup_watchdog(Mword timeout)
     }
 }
 
+// program the sample counter of the current CPU, period 0 stops it
+PUBLIC
+bool
+Perf_cnt_arch::setup_sampler(Mword period)
+{
+  if (!sampler_allocated())
+    return false;
+
+  if (!period)
+    {
+      stop_sampler();
+      return true;
+    }
+
+  hold_sampler = -(Signed64)period;
+  if (!init_sampler())
+    return false;
+
+  rearm_sampler();
+  start_pmc(pmc_sampler);
+  return true;
+}
+
 PUBLIC
 void
 Perf_cnt_arch::setup_loadcnt()
@@ -844,6 +956,17 @@ void
 Perf_cnt_arch::init_loadcnt()
 { panic("Cannot initialize load counter"); }
 
+PUBLIC virtual
+bool
+Perf_cnt_arch::init_sampler()
+{ return false; } // no sampler per default
+
+// stop sampler (disable generation of overflow interrupt)
+PUBLIC virtual
+void
+Perf_cnt_arch::stop_sampler()
+{}
+
 // start watchdog (enable generation of overflow interrupt)
 PUBLIC virtual
 void
@@ -1067,6 +1190,29 @@ Perf_cnt::touch_watchdog()
     pcnt->touch_watchdog();
 }
 
+PUBLIC static inline
+bool
+Perf_cnt::alloc_sampler()
+{ return pcnt && pcnt->alloc_sampler(); }
+
+PUBLIC static inline
+bool
+Perf_cnt::setup_sampler(Mword period)
+{ return pcnt && pcnt->setup_sampler(period); }
+
+PUBLIC static inline
+bool
+Perf_cnt::sampler_overflowed()
+{ return pcnt && pcnt->sampler_allocated() && pcnt->sampler_overflowed(); }
+
+PUBLIC static inline
+void
+Perf_cnt::rearm_sampler()
+{
+  if (pcnt && pcnt->sampler_allocated())
+    pcnt->rearm_sampler();
+}
+
 // return human-readable type of performance counters
 PUBLIC static inline
 char const *
@@ -0,0 +1,40 @@
+IMPLEMENTATION [debug && perf_cnt && (ia32 || amd64)]:
+
+#include "apic.h"
+#include "globals.h"
+#include "perf_cnt.h"
+#include "trap_state.h"
+
+/*
+ * The sample counter shares the performance-counter NMI with the
+ * watchdog, so an NMI is only taken as a sample if the counter has
+ * wrapped on a CPU where it is armed.
+ */
+
+PRIVATE static inline NEEDS["apic.h", "perf_cnt.h"]
+bool
+Perf_sampler::arch_cycles_supported()
+{ return Apic::have_pcint() && Perf_cnt::alloc_sampler(); }
+
+PRIVATE static inline NEEDS["apic.h", "perf_cnt.h"]
+void
+Perf_sampler::arch_setup_cpu(Mword period)
+{
+  if (period)
+    Apic::set_perf_nmi();
+  Perf_cnt::setup_sampler(period);
+}
+
+PUBLIC static
+bool
+Perf_sampler::nmi(Trap_state *ts)
+{
+  if (!_cpu.current().cycles || !Perf_cnt::sampler_overflowed())
+    return false;
+
+  sample(current(), ts->ip(), (ts->cs() & 3) ? 0 : Kernel_ip);
+  Perf_cnt::rearm_sampler();
+  // the local APIC masks the counter vector on delivery
+  Apic::set_perf_nmi();
+  return true;
+}
@@ -0,0 +1,12 @@
+//--------------------------------------------------------------------------
+IMPLEMENTATION [(ia32|ux|amd64) && mp]:
+
+PROTECTED static inline
+Mword
+Queued_spin_lock_base::fetch_and_inc(Mword *m)
+{
+  Mword o = 1;
+  asm volatile ("lock; xadd %[o], %[m]"
+                : [o] "+r" (o), [m] "+m" (*m) : : "memory", "cc");
+  return o;
+}
@@ -32,6 +32,7 @@
 #define CR4_OSFXSR      0x00000200      // OS Supports FXSAVE/FXRSTOR
 #define CR4_OSXMMEXCPT  0x00000400      // OS Supports SIMD Exceptions
 #define CR4_VMXE        0x00002000      // VMX enable
+#define CR4_PCIDE       0x00020000      // Process-Context Identifiers
 #define CR4_OSXSAVE     0x00040000      // OS Support XSAVE
 #define CR4_SMEP        0x00100000      // Supervisor-Mode Execution Prevention
 
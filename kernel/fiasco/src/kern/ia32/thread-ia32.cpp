@@ -45,6 +45,7 @@ IMPLEMENTATION [ia32,amd64,ux]:
 #include "mem_layout.h"
 #include "logdefs.h"
 #include "paging.h"
+#include "perf_sampler.h"
 #include "processor.h"		// for cli/sti
 #include "regdefs.h"
 #include "std_macros.h"
@@ -187,6 +188,9 @@ Thread::handle_slow_trap(Trap_state *ts)
       goto generic_debug;
     }
 
+  if (EXPECT_FALSE(ts->_trapno == 2) && Perf_sampler::nmi(ts))
+    return 0;                  // profiling sample, not a watchdog NMI
+
   if (from_user && _space.user_mode())
     {
       if (ts->_trapno == 14 && Kmem::is_io_bitmap_page_fault(ts->_cr2))
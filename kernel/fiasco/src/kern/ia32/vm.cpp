@@ -58,7 +58,7 @@ Vm::mem_space_map_max_address() const
 
 PUBLIC static
 template< typename VM >
-Slab_cache *
+Kmem_slab *
 Vm::allocator()
 { return &Vm_allocator<VM>::a; }
 
@@ -2,9 +2,9 @@ INTERFACE:
 
 #include "kobject.h"
 #include "kobject_helper.h"
-#include "slab_cache.h"
 #include "thread_object.h"
 
+class Kmem_slab;
 class Ram_quota;
 
 class Ipc_gate_obj;
@@ -37,7 +37,7 @@ class Ipc_gate_obj : public Ipc_gate, public Ipc_gate_ctl
 
 private:
   friend class Ipc_gate;
-  typedef Slab_cache Self_alloc;
+  typedef Kmem_slab Self_alloc;
 
 public:
   bool put() { return Ipc_gate::put(); }
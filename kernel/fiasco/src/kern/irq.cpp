@@ -3,10 +3,13 @@ INTERFACE:
 #include "ipc_sender.h"
 #include "irq_chip.h"
 #include "kobject_helper.h"
+#include "lat_hist.h"
 #include "member_offs.h"
 #include "sender.h"
 #include "context.h"
+#include "timeout.h"
 
+class Kmem_slab;
 class Ram_quota;
 class Thread;
 
@@ -21,7 +24,7 @@ class Irq : public Irq_base, public Kobject
   FIASCO_DECLARE_KOBJ();
 
 private:
-  typedef Slab_cache Allocator;
+  typedef Kmem_slab Allocator;
 
 public:
   enum Op
@@ -31,6 +34,7 @@ public:
     Op_trigger    = 2,
     Op_chain      = 3,
     Op_eoi_2      = 4,
+    Op_moderate   = 5,
   };
 
 private:
@@ -42,6 +46,20 @@ protected:
 };
 
 
+class Irq_sender;
+
+/**
+ * Window timer of an Irq_sender in moderation mode.
+ */
+class Irq_moderation_timeout : public Timeout
+{
+public:
+  explicit Irq_moderation_timeout(Irq_sender *irq) : _irq(irq) {}
+
+private:
+  Irq_sender *_irq;
+};
+
 /**
  * IRQ Kobject to send IPC messages to a receiving thread.
  */
@@ -49,9 +67,17 @@ class Irq_sender
 : public Kobject_h<Irq_sender, Irq>,
   public Ipc_sender<Irq_sender>
 {
+  friend class Jdb_kobject_irq;
+
 public:
   Mword kobject_size() const { return sizeof(*this); }
 
+  enum
+  {
+    Max_moderation_delay = 100000, ///< Upper bound of the window in us
+    Max_moderation_batch = 0x7fff, ///< Most events per notification
+  };
+
 private:
   Irq_sender(Irq_sender &);
 
@@ -61,6 +87,33 @@ protected:
 
 private:
   Mword _irq_id;
+  Lat_hist::Stamp _lat; ///< First hit of the pending notification
+
+  /**
+   * Interrupt moderation.
+   *
+   * With max_events set, events are collected until max_events of them
+   * are pending or max_delay us have passed since the first one.  They
+   * are then delivered as a single notification whose message-tag label
+   * holds the number of events.  Except for `kick` and `armed` the state
+   * is only touched on the home CPU of the attached thread.
+   */
+  struct Moderation
+  {
+    Mword max_events;    ///< 0: moderation off
+    Mword max_delay;     ///< Window in us, 0: no time bound
+    Mword kick;          ///< Remote kick DRQ in flight
+    Mword armed;         ///< Window timer queued on `cpu`
+    Cpu_number cpu;
+    Mword batch;         ///< Events of the notification in transfer
+    bool busy;           ///< A notification is queued at the receiver
+    bool expired;        ///< The window timer fired
+    Mword events;        ///< Events delivered
+    Mword notifications; ///< Notifications delivered
+  };
+
+  Moderation _mod;
+  Irq_moderation_timeout _mod_timeout;
 };
 
 
@@ -112,6 +165,9 @@ IMPLEMENTATION:
 #include "thread_object.h"
 #include "thread_state.h"
 #include "l4_buf_iter.h"
+#include "mem.h"
+#include "processor.h"
+#include "timer.h"
 #include "vkey.h"
 
 FIASCO_DEFINE_KOBJ(Irq);
@@ -325,6 +381,9 @@ Irq_sender::alloc(Thread *t)
         }
 
       _queued = 0;
+      _mod.batch = 0;
+      _mod.busy = false;
+      _mod.expired = false;
     }
 
   return ret;
@@ -349,6 +408,7 @@ Irq_sender::free(Thread *t, Kobject ***rl)
     {
       auto guard = lock_guard(cpu_lock);
       mask();
+      moderation_disarm();
 
       if (EXPECT_TRUE(t != 0))
 	{
@@ -366,7 +426,8 @@ Irq_sender::free(Thread *t, Kobject ***rl)
 
 PUBLIC explicit
 Irq_sender::Irq_sender(Ram_quota *q = 0)
-: Kobject_h<Irq_sender, Irq>(q), _queued(0), _irq_thread(0), _irq_id(~0UL)
+: Kobject_h<Irq_sender, Irq>(q), _queued(0), _irq_thread(0), _irq_id(~0UL),
+  _mod(), _mod_timeout(this)
 {
   hit_func = &hit_level_irq;
 }
@@ -391,20 +452,24 @@ Irq_sender::destroy(Kobject ***rl)
 }
 
 
-/** Consume one interrupt.
+/** Consume one interrupt, or the batch of a moderated notification.
     @return number of IRQs that are still pending.
  */
 PRIVATE inline NEEDS ["atomic.h"]
 Smword
 Irq_sender::consume()
 {
+  Smword n = EXPECT_TRUE(!_mod.max_events) ? 1 : _mod.batch;
   Smword old;
 
   do
     {
       old = _queued;
     }
-  while (!mp_cas (&_queued, old, old - 1));
+  while (!mp_cas (&_queued, old, old - n));
+
+  if (EXPECT_FALSE(_mod.max_events))
+    return moderation_consumed(old - n);
 
   if (old == 2 && hit_func == &hit_edge_irq)
     unmask();
@@ -444,8 +509,17 @@ Irq_sender::transfer_msg(Receiver *recv)
 {
   Syscall_frame* dst_regs = recv->rcv_regs();
 
-  // set ipc return value: OK
-  dst_regs->tag(L4_msg_tag(0));
+  _lat.record(Lat_hist::Irq);
+
+  // set ipc return value: OK, for a moderated IRQ the label holds
+  // the number of events
+  if (EXPECT_FALSE(_mod.max_events))
+    {
+      _mod.batch = min<Smword>(access_once(&_queued), Max_moderation_batch);
+      dst_regs->tag(L4_msg_tag(0, 0, 0, _mod.batch));
+    }
+  else
+    dst_regs->tag(L4_msg_tag(0));
 
   // set ipc source thread id
   dst_regs->from(_irq_id);
@@ -491,14 +565,24 @@ Irq_sender::queue()
   do
     old = _queued;
   while (!mp_cas(&_queued, old, old + 1));
+
+  if (!old)
+    _lat.start();
+
   return old;
 }
 
 
-PRIVATE inline
+PRIVATE inline NEEDS[Irq_sender::moderation_hit]
 void
 Irq_sender::count_and_send(Smword queued)
 {
+  if (EXPECT_FALSE(_mod.max_events))
+    {
+      moderation_hit(queued);
+      return;
+    }
+
   if (EXPECT_TRUE (queued == 0) && EXPECT_TRUE(_irq_thread != 0))	// increase hit counter
     {
       if (EXPECT_FALSE(_irq_thread->home_cpu() != current_cpu()))
@@ -552,8 +636,9 @@ Irq_sender::_hit_edge_irq(Upstream_irq const *ui)
 
   // if we get a second edge triggered IRQ before the first is
   // handled we can mask the IRQ.  The consume function will
-  // unmask the IRQ when the last IRQ is dequeued.
-  if (!q)
+  // unmask the IRQ when the last IRQ is dequeued.  A moderated IRQ
+  // keeps counting until its window is full.
+  if (!q || (_mod.max_events && q + 1 < (Smword)_mod.max_events))
     ack();
   else
     mask_and_ack();
@@ -568,6 +653,220 @@ Irq_sender::hit_edge_irq(Irq_base *i, Upstream_irq const *ui)
 { nonull_static_cast<Irq_sender*>(i)->_hit_edge_irq(ui); }
 
 
+//
+// Interrupt moderation
+//
+
+/**
+ * Send a notification for the pending events of a moderated IRQ if its
+ * window is full or has expired, otherwise make sure the window timer
+ * runs.  Must be called on the home CPU of the attached thread.
+ * @return true if a reschedule is necessary.
+ */
+PRIVATE
+bool
+Irq_sender::moderation_kick(bool might_switch)
+{
+  Thread *t = access_once(&_irq_thread);
+  Smword q = access_once(&_queued);
+  if (!t || _mod.busy)
+    return false;
+
+  if (q <= 0)
+    {
+      _mod.expired = false;
+      return false;
+    }
+
+  // a level-triggered IRQ stays masked until its notification is
+  // consumed, so without a window timer it never gets a second event
+  if (q < (Smword)_mod.max_events && !_mod.expired
+      && (_mod.max_delay || hit_func != &hit_level_irq))
+    {
+      if (_mod.max_delay && !_mod.armed)
+        {
+          _mod.cpu = current_cpu();
+          _mod.armed = 1;
+          _mod_timeout.set(Timer::system_clock() + _mod.max_delay, _mod.cpu);
+        }
+      return false;
+    }
+
+  _mod.expired = false;
+  if (_mod.armed && _mod.cpu == current_cpu() && _mod_timeout.is_set())
+    {
+      _mod_timeout.reset();
+      _mod.armed = 0;
+    }
+
+  _mod.busy = true;
+  return send_msg(t, might_switch);
+}
+
+PRIVATE static
+Context::Drq::Result
+Irq_sender::handle_remote_kick(Context::Drq *, Context *, void *arg)
+{
+  Irq_sender *irq = (Irq_sender*)arg;
+  write_now(&irq->_mod.kick, 0UL);
+  Mem::mp_mb();
+  irq->set_cpu(current_cpu());
+  if (irq->moderation_kick(false))
+    return Context::Drq::no_answer_resched();
+  return Context::Drq::no_answer();
+}
+
+/**
+ * Account a hit of a moderated IRQ.  Only the first event of a window
+ * and a full window need a decision on the home CPU.
+ */
+PRIVATE inline NEEDS["atomic.h"]
+void
+Irq_sender::moderation_hit(Smword queued)
+{
+  if (queued != 0 && queued + 1 < (Smword)_mod.max_events)
+    return;
+
+  Thread *t = access_once(&_irq_thread);
+  if (EXPECT_FALSE(!t))
+    return;
+
+  if (EXPECT_TRUE(t->home_cpu() == current_cpu()))
+    moderation_kick(true);
+  else if (mp_cas(&_mod.kick, 0UL, 1UL))
+    t->drq(&_drq, handle_remote_kick, this,
+           Context::Drq::Target_ctxt, Context::Drq::No_wait);
+}
+
+/**
+ * Book-keeping after a notification of a moderated IRQ was delivered.
+ * @param left  events that arrived while the notification was pending.
+ * @return the number of events to deliver right away, 0 if the
+ *         remaining events start a new window.
+ */
+PRIVATE
+Smword
+Irq_sender::moderation_consumed(Smword left)
+{
+  ++_mod.notifications;
+  _mod.events += _mod.batch;
+  _mod.batch = 0;
+
+  // edge-triggered IRQs get masked when the window is full
+  if (hit_func == &hit_edge_irq)
+    unmask();
+
+  if (left >= (Smword)_mod.max_events)
+    return left;
+
+  _mod.busy = false;
+  _mod.expired = false;
+  if (left > 0 && _mod.max_delay && !_mod.armed)
+    {
+      _mod.cpu = current_cpu();
+      _mod.armed = 1;
+      _mod_timeout.set(Timer::system_clock() + _mod.max_delay, _mod.cpu);
+    }
+
+  return 0;
+}
+
+/**
+ * The window timer fired.
+ * @return true if a reschedule is necessary.
+ */
+PUBLIC
+bool
+Irq_sender::moderation_timeout()
+{
+  bool resched = false;
+  Thread *t = access_once(&_irq_thread);
+  if (t && t->home_cpu() == current_cpu())
+    {
+      _mod.expired = true;
+      resched = moderation_kick(false);
+    }
+  else if (t && mp_cas(&_mod.kick, 0UL, 1UL))
+    {
+      // the thread migrated since the timer was set
+      _mod.expired = true;
+      t->drq(&_drq, handle_remote_kick, this,
+             Context::Drq::Target_ctxt, Context::Drq::No_wait);
+    }
+
+  Mem::mp_mb();
+  write_now(&_mod.armed, 0UL);
+  return resched;
+}
+
+/**
+ * Stop the window timer if it runs on this CPU, called with the IRQ
+ * already detached.  A timer on another CPU is left alone, it finds the
+ * IRQ detached when it fires; see ~Irq_sender().
+ */
+PRIVATE
+void
+Irq_sender::moderation_disarm()
+{
+  if (!access_once(&_mod.armed) || _mod.cpu != current_cpu())
+    return;
+
+  if (_mod_timeout.is_set())
+    _mod_timeout.reset();
+  _mod.armed = 0;
+}
+
+/**
+ * Cancel a window timer that is still queued on another CPU before the
+ * object goes away.  Runs without the CPU lock held, from the final
+ * release of the object.
+ */
+PUBLIC
+Irq_sender::~Irq_sender()
+{
+  if (EXPECT_TRUE(!access_once(&_mod.armed)))
+    return;
+
+  Cpu_mask cpus;
+  cpus.set(_mod.cpu);
+  Context::cpu_call_many(cpus, [this](Cpu_number)
+    {
+      auto guard = lock_guard(cpu_lock);
+      if (_mod_timeout.is_set())
+        _mod_timeout.reset();
+      write_now(&_mod.armed, 0UL);
+      return false;
+    });
+}
+
+PRIVATE
+L4_msg_tag
+Irq_sender::sys_moderate(L4_msg_tag const &tag, Utcb const *utcb)
+{
+  if (EXPECT_FALSE(tag.words() < 3))
+    return commit_result(-L4_err::EInval);
+
+  Mword events = utcb->values[1];
+  Mword delay = utcb->values[2];
+
+  // a level-triggered IRQ has at most one event pending
+  if (events > 1 && !delay && hit_func == &hit_level_irq)
+    return commit_result(-L4_err::EInval);
+
+  // moderation can only be switched on or off while detached
+  if (!events != !_mod.max_events && access_once(&_irq_thread))
+    return commit_result(-L4_err::EBusy);
+
+  _mod.max_delay = min<Mword>(delay, Max_moderation_delay);
+  write_now(&_mod.max_events, events);
+  return commit_result(0);
+}
+
+PRIVATE
+bool
+Irq_moderation_timeout::expired()
+{ return _irq->moderation_timeout(); }
+
 PRIVATE
 L4_msg_tag
 Irq_sender::sys_attach(L4_msg_tag const &tag, Utcb const *utcb, Syscall_frame * /*f*/,
@@ -643,6 +942,8 @@ Irq_sender::kinvoke(L4_obj_ref, L4_fpage::Rights /*rights*/, Syscall_frame *f,
       log();
       hit(0);
       return no_reply();
+    case Op_moderate:
+      return sys_moderate(tag, utcb);
     default:
       return commit_result(-L4_err::EInval);
     }
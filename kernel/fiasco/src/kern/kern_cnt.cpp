@@ -54,6 +54,9 @@ Kern_cnt::get_str(Mword num)
     case Kern_cnt_schedule:          return "Scheduler calls";
     case Kern_cnt_iobmap_tlb_flush:  return "IO bitmap TLB flushs";
     case Kern_cnt_exc_ipc:           return "Exception IPCs";
+    case Kern_cnt_tlb_shootdown:     return "TLB shootdowns";
+    case Kern_cnt_tlb_ipi:           return "TLB shootdown IPIs";
+    case Kern_cnt_tlb_pages:         return "TLB pages flushed singly";
     default:                         return 0;
     }
 }
@@ -29,19 +29,23 @@ IMPLEMENTATION:
 #include <cstdlib>
 #include <cstdio>
 
+#include "boot_log.h"
 #include "config.h"
 #include "cpu.h"
 #include "delayloop.h"
 #include "globals.h"
 #include "helping_lock.h"
 #include "kernel_task.h"
+#include "kmem_alloc.h"
 #include "per_cpu_data_alloc.h"
 #include "processor.h"
+#include "queued_spin_lock.h"
 #include "task.h"
 #include "thread.h"
 #include "thread_state.h"
 #include "timer.h"
 #include "timer_tick.h"
+#include "vlog.h"
 #include "watchdog.h"
 
 
@@ -59,6 +63,8 @@ IMPLEMENT FIASCO_INIT
 void
 Kernel_thread::bootstrap()
 {
+  Boot_log::stamp(Cpu_number::boot_cpu(), "kernel thread");
+
   // Initializations done -- Helping_lock can now use helping lock
   Helping_lock::threading_system_active = true;
 
@@ -70,6 +76,9 @@ Kernel_thread::bootstrap()
   _home_cpu = Cpu::boot_cpu()->id();
   Mem::barrier();
 
+  Kmem_alloc::enable_hot_lists(current_cpu());
+  Mcs_spin_lock::enable_cpu_nodes();
+
   state_change_dirty(0, Thread_ready);		// Set myself ready
 
   Timer::init_system_clock();
@@ -95,6 +104,7 @@ Kernel_thread::bootstrap()
   // Init delay loop, needs working timer interrupt
   Delay::init();
   printf("done.\n");
+  Boot_log::stamp(current_cpu(), "delay loop calibrated");
 
   run();
 }
@@ -117,9 +127,13 @@ Kernel_thread::run()
   // init_workload cannot be an initcall, because it fires up the userland
   // applications which then have access to initcall frames as per kinfo page.
   init_workload();
+  Boot_log::stamp(home_cpu(), "sigma0 and root task started");
 
   for (;;)
-    idle_op();
+    {
+      Vlog::drain();
+      idle_op();
+    }
 }
 
 // ------------------------------------------------------------------------
@@ -129,6 +143,10 @@ PUBLIC inline NEEDS["processor.h"]
 void
 Kernel_thread::idle_op()
 {
+  // spin a little for requests from other CPUs, saves their IPIs
+  if (poll_remote_requests())
+    return;
+
   if (Config::hlt_works_ok)
     Proc::halt();			// stop the CPU, waiting for an int
   else
@@ -3,9 +3,10 @@ INTERFACE:
 #include <auto_quota.h>
 #include <cxx/slist>
 
-#include "spin_lock.h"
+#include "queued_spin_lock.h"
 #include "lock_guard.h"
 #include "initcalls.h"
+#include "per_cpu_data.h"
 
 class Buddy_alloc;
 class Mem_region_map_base;
@@ -16,15 +17,47 @@ template<typename Q> class Kmem_q_alloc;
 class Kmem_alloc
 {
   Kmem_alloc();
+  friend class Jdb_kern_info_bench;
 
 public:
   typedef Buddy_alloc Alloc;
+
+  /**
+   * Per-CPU hot lists in front of the global buddy allocator.
+   *
+   * Blocks of the Hot_orders smallest sizes are cached per CPU and
+   * moved to and from the buddy allocator in batches of Hot_batch
+   * blocks, so that most allocations and frees of page tables, slabs
+   * and the like do not take the global lock.
+   */
+  enum
+  {
+    Hot_orders = 3,             ///< Buddy sizes Min_size << 0..2
+    Hot_batch  = 8,             ///< Blocks moved per refill or drain
+    Hot_high   = 2 * Hot_batch, ///< Drain a list growing beyond this
+  };
+
+  struct Hot_block { Hot_block *next; };
+
+  /// Must be valid when zero-filled, there is no constructor.
+  struct Hot_lists
+  {
+    Hot_block *head[Hot_orders];
+    unsigned cnt[Hot_orders];
+    unsigned long hits;    ///< Allocs and frees served locally
+    unsigned long refills; ///< Batches taken from the buddy allocator
+    unsigned long drains;  ///< Batches returned to the buddy allocator
+    bool ready;            ///< The CPU runs on its kernel thread
+  };
+
 private:
-  typedef Spin_lock<> Lock;
+  typedef Ticket_spin_lock Lock;
   static Lock lock;
   static Alloc *a;
   static unsigned long _orig_free;
   static Kmem_alloc *_alloc;
+  static Per_cpu<Hot_lists> _hot;
+  static unsigned long _lock_acquired; ///< Acquisitions of the global lock
 };
 
 
@@ -76,8 +109,10 @@ private:
 IMPLEMENTATION:
 
 #include <cassert>
+#include <cstdio>
 
 #include "config.h"
+#include "cpu_lock.h"
 #include "kdb_ke.h"
 #include "kip.h"
 #include "mem_layout.h"
@@ -90,6 +125,8 @@ Kmem_alloc::Alloc *Kmem_alloc::a = &_a;
 unsigned long Kmem_alloc::_orig_free;
 Kmem_alloc::Lock Kmem_alloc::lock;
 Kmem_alloc* Kmem_alloc::_alloc;
+DEFINE_PER_CPU Per_cpu<Kmem_alloc::Hot_lists> Kmem_alloc::_hot;
+unsigned long Kmem_alloc::_lock_acquired;
 
 PUBLIC static inline NEEDS[<cassert>]
 Kmem_alloc *
@@ -121,6 +158,7 @@ Kmem_alloc::init()
 {
   static Kmem_alloc al;
   Kmem_alloc::allocator(&al);
+  lock.register_stats("Kmem_alloc", "buddy");
 }
 
 PUBLIC
@@ -143,15 +181,162 @@ Kmem_alloc::free(size_t o, void *p)
   unaligned_free(1UL << o, p);
 }
 
-PUBLIC 
+/**
+ * Hot list index for blocks of `size`, or -1 if there is no hot list
+ * for this size.
+ */
+PUBLIC static inline NEEDS["buddy_alloc.h"]
+int
+Kmem_alloc::hot_order(unsigned long size)
+{
+  for (int o = 0; o < Hot_orders; ++o)
+    if (size == (unsigned long)Alloc::Min_size << o)
+      return o;
+
+  return -1;
+}
+
+/**
+ * Let `cpu` use its hot lists.  Called by the CPU itself once it runs on
+ * its kernel thread; before, on the boot stacks, current_cpu() may not
+ * name the CPU yet and all allocations go to the buddy allocator.
+ */
+PUBLIC static
+void
+Kmem_alloc::enable_hot_lists(Cpu_number cpu)
+{ _hot.cpu(cpu).ready = true; }
+
+/**
+ * May `cpu` use its per-CPU caches, i.e., does it run on its kernel
+ * thread?  Also used for the magazines of Kmem_slab.
+ */
+PUBLIC static inline NEEDS["config.h"]
+bool
+Kmem_alloc::per_cpu_ready(Cpu_number cpu)
+{
+  return cpu < Config::max_num_cpus() && Per_cpu_data::valid(cpu)
+         && _hot.cpu(cpu).ready;
+}
+
+/**
+ * Take a block of hot list order `o` from the hot lists of `cpu`,
+ * refilling them from the buddy allocator if necessary.  Must be called
+ * with the CPU lock held on `cpu`.
+ */
+PRIVATE static
 void *
-Kmem_alloc::unaligned_alloc(unsigned long size)
+Kmem_alloc::hot_alloc(Cpu_number cpu, int o)
+{
+  Hot_lists &h = _hot.cpu(cpu);
+
+  if (EXPECT_FALSE(!h.head[o]))
+    {
+      unsigned long const size = (unsigned long)Alloc::Min_size << o;
+      auto guard = lock_guard(lock);
+      ++_lock_acquired;
+      for (unsigned i = 0; i < Hot_batch; ++i)
+        {
+          Hot_block *b = (Hot_block *)a->alloc(size);
+          if (!b)
+            break;
+
+          b->next = h.head[o];
+          h.head[o] = b;
+          ++h.cnt[o];
+        }
+
+      if (!h.head[o])
+        return 0;
+
+      ++h.refills;
+    }
+
+  Hot_block *b = h.head[o];
+  h.head[o] = b->next;
+  --h.cnt[o];
+  ++h.hits;
+  return b;
+}
+
+/**
+ * Put a block of hot list order `o` onto the hot lists of `cpu`,
+ * returning a batch to the buddy allocator if the list grows too long.
+ * Must be called with the CPU lock held on `cpu`.
+ */
+PRIVATE static
+void
+Kmem_alloc::hot_free(Cpu_number cpu, int o, void *block)
+{
+  Hot_lists &h = _hot.cpu(cpu);
+  Hot_block *b = (Hot_block *)block;
+
+  b->next = h.head[o];
+  h.head[o] = b;
+  ++h.hits;
+
+  if (EXPECT_TRUE(++h.cnt[o] <= Hot_high))
+    return;
+
+  unsigned long const size = (unsigned long)Alloc::Min_size << o;
+  auto guard = lock_guard(lock);
+  ++_lock_acquired;
+  for (unsigned i = 0; i < Hot_batch; ++i)
+    {
+      b = h.head[o];
+      h.head[o] = b->next;
+      --h.cnt[o];
+      a->free(b, size);
+    }
+
+  ++h.drains;
+}
+
+/**
+ * Return all blocks in the hot lists of `cpu` to the buddy allocator.
+ * Must be called with the CPU lock held on `cpu`.
+ */
+PUBLIC static
+void
+Kmem_alloc::hot_drain(Cpu_number cpu)
+{
+  if (!Per_cpu_data::valid(cpu))
+    return;
+
+  Hot_lists &h = _hot.cpu(cpu);
+  auto guard = lock_guard(lock);
+  ++_lock_acquired;
+  for (unsigned o = 0; o < Hot_orders; ++o)
+    {
+      if (!h.head[o])
+        continue;
+
+      unsigned long const size = (unsigned long)Alloc::Min_size << o;
+      while (Hot_block *b = h.head[o])
+        {
+          h.head[o] = b->next;
+          a->free(b, size);
+        }
+
+      h.cnt[o] = 0;
+      ++h.drains;
+    }
+}
+
+/**
+ * Allocate directly from the buddy allocator.  On failure, reap the
+ * caches and drain the hot lists of the current CPU, into which the
+ * reapers free their blocks, before trying once more.  The hot lists of
+ * the other CPUs are drained by a reaper on MP (see kmem_hot_reaper.cpp).
+ */
+PRIVATE static
+void *
+Kmem_alloc::global_alloc(unsigned long size)
 {
-  assert(size >=8 /*NEW INTERFACE PARANIOIA*/);
   void* ret;
 
   {
     auto guard = lock_guard(lock);
+    ++_lock_acquired;
     ret = a->alloc(size);
   }
 
@@ -159,22 +344,109 @@ Kmem_alloc::unaligned_alloc(unsigned long size)
     {
       Kmem_alloc_reaper::morecore (/* desperate= */ true);
 
+      {
+        auto guard = lock_guard(cpu_lock);
+        Cpu_number cpu = current_cpu();
+        if (per_cpu_ready(cpu))
+          hot_drain(cpu);
+      }
+
       auto guard = lock_guard(lock);
+      ++_lock_acquired;
       ret = a->alloc(size);
     }
 
   return ret;
 }
 
+PRIVATE static
+void
+Kmem_alloc::global_free(unsigned long size, void *page)
+{
+  auto guard = lock_guard(lock);
+  ++_lock_acquired;
+  a->free(page, size);
+}
+
+PUBLIC 
+void *
+Kmem_alloc::unaligned_alloc(unsigned long size)
+{
+  assert(size >=8 /*NEW INTERFACE PARANIOIA*/);
+
+  int o = hot_order(size);
+  if (o >= 0)
+    {
+      auto guard = lock_guard(cpu_lock);
+      Cpu_number cpu = current_cpu();
+      if (EXPECT_TRUE(per_cpu_ready(cpu)))
+        if (void *b = hot_alloc(cpu, o))
+          return b;
+    }
+
+  return global_alloc(size);
+}
+
 PUBLIC
 void
 Kmem_alloc::unaligned_free(unsigned long size, void *page)
 {
   assert(size >=8 /*NEW INTERFACE PARANIOIA*/);
-  auto guard = lock_guard(lock);
-  a->free(page, size);
+
+  int o = hot_order(size);
+  if (o >= 0)
+    {
+      auto guard = lock_guard(cpu_lock);
+      Cpu_number cpu = current_cpu();
+      if (EXPECT_TRUE(per_cpu_ready(cpu)))
+        {
+          hot_free(cpu, o, page);
+          return;
+        }
+    }
+
+  global_free(size, page);
 }
 
+/**
+ * Bytes cached in the per-CPU hot lists.
+ */
+PUBLIC static
+unsigned long
+Kmem_alloc::hot_avail()
+{
+  unsigned long sum = 0;
+  for (Cpu_number u = Cpu_number::first(); u < Config::max_num_cpus(); ++u)
+    if (Per_cpu_data::valid(u))
+      for (unsigned o = 0; o < Hot_orders; ++o)
+        sum += (unsigned long)_hot.cpu(u).cnt[o] * (Alloc::Min_size << o);
+
+  return sum;
+}
+
+PUBLIC static
+void
+Kmem_alloc::dump_hot()
+{
+  printf("Global lock acquired %lu times, %luKB in per-CPU hot lists\n",
+         _lock_acquired, hot_avail() / 1024);
+
+  for (Cpu_number u = Cpu_number::first(); u < Config::max_num_cpus(); ++u)
+    {
+      if (!Per_cpu_data::valid(u))
+        continue;
+
+      Hot_lists const &h = _hot.cpu(u);
+      if (!h.hits && !h.refills)
+        continue;
+
+      printf("  cpu%u: %lu hits, %lu refills, %lu drains, cached",
+             cxx::int_value<Cpu_number>(u), h.hits, h.refills, h.drains);
+      for (unsigned o = 0; o < Hot_orders; ++o)
+        printf(" %uK:%u", (Alloc::Min_size << o) / 1024, h.cnt[o]);
+      printf("\n");
+    }
+}
 
 PRIVATE static FIASCO_INIT
 unsigned long
@@ -0,0 +1,48 @@
+INTERFACE:
+
+// The per-CPU caches of Kmem_alloc and Kmem_slab are drained across CPUs
+// from here, kmem_alloc and kmem_slab themselves must not depend on Context.
+
+IMPLEMENTATION [mp]:
+
+#include "context.h"
+#include "cpu.h"
+#include "cpu_lock.h"
+#include "kmem_alloc.h"
+#include "kmem_slab.h"
+
+/**
+ * Memory reaper returning the objects in the slab magazines and the
+ * blocks in the hot lists of all CPUs to the buddy allocator.  It must
+ * wait for the cross-CPU calls and therefore does nothing when called
+ * with the CPU lock held; Kmem_slab and Kmem_alloc drain at least the
+ * caches of the current CPU themselves.
+ */
+static size_t
+drain_hot_lists(bool desperate)
+{
+  if (!desperate || cpu_lock.test())
+    return 0;
+
+  Cpu_mask cpus;
+  cpus = Cpu::online_mask();
+  Context::cpu_call_many(cpus, [](Cpu_number cpu)
+    {
+      Kmem_slab::drain_cpu(cpu);
+      return false;
+    });
+
+  // the slabs emptied above partly go to the hot lists of this CPU
+  unsigned long cached = Kmem_alloc::hot_avail();
+  cached += Kmem_slab::reap_all(desperate);
+  Context::cpu_call_many(cpus, [](Cpu_number cpu)
+    {
+      Kmem_alloc::hot_drain(cpu);
+      return false;
+    });
+
+  unsigned long left = Kmem_alloc::hot_avail();
+  return cached > left ? cached - left : 0;
+}
+
+static Kmem_alloc_reaper hot_list_reaper(drain_hot_lists);
@@ -4,11 +4,23 @@ INTERFACE:
 #include "buddy_alloc.h"
 #include "config.h"
 #include "lock_guard.h"
-#include "spin_lock.h"
+#include "queued_spin_lock.h"
 
 #include "slab_cache.h"		// Slab_cache
+#include "per_cpu_data.h"
 #include <cxx/slist>
 
+/**
+ * Slab cache for kernel objects with a per-CPU magazine layer.
+ *
+ * Each CPU keeps a loaded and a previous magazine of free objects and
+ * serves alloc() and free() from them with only the CPU lock held.
+ * Only when both magazines are exhausted (or full) it exchanges a
+ * magazine with the cache-wide depot, which is protected by a spin
+ * lock.  If neither the CPU layer nor the depot can help, the request
+ * falls through to the Slab_cache.  The previous magazine is always
+ * either full or empty.
+ */
 class Kmem_slab : public Slab_cache, public cxx::S_list_item
 {
   friend class Jdb_kern_info_memory;
@@ -16,6 +28,51 @@ class Kmem_slab : public Slab_cache, public cxx::S_list_item
 
   // STATIC DATA
   static Reap_list reap_list;
+
+public:
+  enum { Magazine_rounds = 14 };
+
+  struct Magazine : public cxx::S_list_item
+  {
+    unsigned count;
+    void *rounds[Magazine_rounds];
+
+    Magazine() : count(0) {}
+    bool empty() const { return count == 0; }
+    bool full() const { return count == Magazine_rounds; }
+  };
+
+  /// Per-CPU part of the magazine layer.
+  struct Cpu_cache
+  {
+    Magazine *loaded;
+    Magazine *prev;
+    unsigned long hits;   ///< alloc/free served by this CPU's magazines
+    unsigned long misses; ///< alloc/free that went to the Slab_cache
+
+    Cpu_cache() : loaded(0), prev(0), hits(0), misses(0) {}
+    void swap_magazines()
+    {
+      Magazine *t = loaded;
+      loaded = prev;
+      prev = t;
+    }
+  };
+
+  enum No_magazines_t { No_magazines };
+
+private:
+  typedef cxx::S_list<Magazine> Mag_list;
+  typedef Ticket_spin_lock Depot_lock;
+
+  bool _use_magazines;
+  Per_cpu_array<Cpu_cache> _cpu;
+
+  Depot_lock _depot_lock;
+  Mag_list _depot_full;
+  Mag_list _depot_empty;
+  unsigned _depot_full_cnt;
+  unsigned _depot_empty_cnt;
 };
 
 template< typename T >
@@ -39,10 +96,18 @@ Kmem_slab::Reap_list Kmem_slab::reap_list;
 //-
 
 #include <cassert>
+#include <new>
 #include "config.h"
 #include "atomic.h"
+#include "cpu_lock.h"
 #include "panic.h"
 #include "kmem_alloc.h"
+#include "static_init.h"
+
+/// Cache for the magazines themselves, runs without magazine layer.
+static Kmem_slab _magazine_allocator INIT_PRIORITY(STARTUP1_INIT_PRIO)
+  (sizeof(Kmem_slab::Magazine), __alignof(Kmem_slab::Magazine),
+   "Kmem_slab::Magazine", Kmem_slab::No_magazines);
 
 // Specializations providing their own block_alloc()/block_free() can
 // also request slab sizes larger than one page.
@@ -51,8 +116,11 @@ Kmem_slab::Kmem_slab(unsigned long slab_size,
 				   unsigned elem_size,
 				   unsigned alignment,
 				   char const *name)
-  : Slab_cache(slab_size, elem_size, alignment, name)
+  : Slab_cache(slab_size, elem_size, alignment, name),
+    _use_magazines(true), _depot_full_cnt(0), _depot_empty_cnt(0)
 {
+  _depot_lock.init();
+  register_locks(name);
   reap_list.add(this, mp_cas<cxx::S_list_item*>);
 }
 
@@ -64,17 +132,288 @@ Kmem_slab::Kmem_slab(unsigned elem_size,
                      char const *name,
                      unsigned long min_size = Buddy_alloc::Min_size,
                      unsigned long max_size = Buddy_alloc::Max_size)
-  : Slab_cache(elem_size, alignment, name, min_size, max_size)
+  : Slab_cache(elem_size, alignment, name, min_size, max_size),
+    _use_magazines(true), _depot_full_cnt(0), _depot_empty_cnt(0)
 {
+  _depot_lock.init();
+  register_locks(name);
   reap_list.add(this, mp_cas<cxx::S_list_item*>);
 }
 
+PUBLIC
+Kmem_slab::Kmem_slab(unsigned elem_size, unsigned alignment,
+                     char const *name, No_magazines_t)
+  : Slab_cache(elem_size, alignment, name,
+               Buddy_alloc::Min_size, Buddy_alloc::Max_size),
+    _use_magazines(false), _depot_full_cnt(0), _depot_empty_cnt(0)
+{
+  _depot_lock.init();
+  register_locks(name);
+  reap_list.add(this, mp_cas<cxx::S_list_item*>);
+}
+
+PRIVATE inline
+void
+Kmem_slab::register_locks(char const *name)
+{
+  register_lock_stats();
+  if (_use_magazines)
+    _depot_lock.register_stats(name, "depot");
+}
+
 PUBLIC
 Kmem_slab::~Kmem_slab()
 {
+  for (Cpu_cache *c = _cpu.begin(); c != _cpu.end(); ++c)
+    {
+      drain_magazine(c->loaded);
+      drain_magazine(c->prev);
+      c->loaded = c->prev = 0;
+    }
+
+  drain_depot();
   destroy();
 }
 
+//
+// Magazine layer
+//
+
+/**
+ * Get this CPU's part of the magazine layer, or 0 if there is none
+ * (yet).  Must be called with the CPU lock held.
+ */
+PRIVATE inline NEEDS["cpu_lock.h", "kmem_alloc.h"]
+Kmem_slab::Cpu_cache *
+Kmem_slab::cpu_cache()
+{
+  assert(cpu_lock.test());
+  Cpu_number cpu = current_cpu();
+  if (EXPECT_FALSE(!_use_magazines || !Kmem_alloc::per_cpu_ready(cpu)))
+    return 0;
+
+  return &_cpu[cpu];
+}
+
+/**
+ * Return all objects in `m` to the Slab_cache and free `m`.
+ */
+PRIVATE
+void
+Kmem_slab::drain_magazine(Magazine *m)
+{
+  if (!m)
+    return;
+
+  while (m->count)
+    Slab_cache::free(m->rounds[--m->count]);
+
+  _magazine_allocator.free(m);
+}
+
+/**
+ * Return the objects of all depot magazines to the Slab_cache and free
+ * the magazines.  The magazines loaded on the CPUs remain untouched.
+ */
+PRIVATE
+void
+Kmem_slab::drain_depot()
+{
+  for (;;)
+    {
+      Magazine *m;
+        {
+          auto guard = lock_guard(_depot_lock);
+          m = _depot_full.pop_front();
+          if (m)
+            --_depot_full_cnt;
+          else if ((m = _depot_empty.pop_front()))
+            --_depot_empty_cnt;
+          else
+            return;
+        }
+
+      drain_magazine(m);
+    }
+}
+
+/**
+ * Exchange magazine `m` (full or empty, may be 0) for a full or an
+ * empty one from the depot.  Returns 0, and keeps `m`, if the depot
+ * has no such magazine.
+ */
+PRIVATE inline
+Kmem_slab::Magazine *
+Kmem_slab::depot_exchange(Magazine *m, bool want_full)
+{
+  auto guard = lock_guard(_depot_lock);
+  Magazine *r = (want_full ? _depot_full : _depot_empty).pop_front();
+  if (!r)
+    return 0;
+
+  if (want_full)
+    --_depot_full_cnt;
+  else
+    --_depot_empty_cnt;
+
+  if (m)
+    {
+      if (m->empty())
+        {
+          _depot_empty.push_front(m);
+          ++_depot_empty_cnt;
+        }
+      else
+        {
+          _depot_full.push_front(m);
+          ++_depot_full_cnt;
+        }
+    }
+
+  return r;
+}
+
+PUBLIC
+void *
+Kmem_slab::alloc()
+{
+    {
+      auto guard = lock_guard(cpu_lock);
+      Cpu_cache *c = cpu_cache();
+      if (EXPECT_TRUE(c != 0))
+        {
+          if (EXPECT_FALSE(!c->loaded || c->loaded->empty()))
+            {
+              if (c->prev && c->prev->full())
+                c->swap_magazines();
+              else if (Magazine *m = depot_exchange(c->prev, true))
+                {
+                  c->prev = c->loaded;
+                  c->loaded = m;
+                }
+            }
+
+          if (EXPECT_TRUE(c->loaded && !c->loaded->empty()))
+            {
+              ++c->hits;
+              return c->loaded->rounds[--c->loaded->count];
+            }
+
+          ++c->misses;
+        }
+    }
+
+  return Slab_cache::alloc();
+}
+
+/**
+ * Put the empty magazine `m` into the depot.
+ */
+PRIVATE inline
+void
+Kmem_slab::depot_put_empty(Magazine *m)
+{
+  auto guard = lock_guard(_depot_lock);
+  _depot_empty.push_front(m);
+  ++_depot_empty_cnt;
+}
+
+PUBLIC
+void
+Kmem_slab::free(void *cache_entry)
+{
+  Magazine *spare = 0;
+
+  for (;;)
+    {
+        {
+          auto guard = lock_guard(cpu_lock);
+          Cpu_cache *c = cpu_cache();
+          if (EXPECT_FALSE(!c))
+            break;
+
+          if (EXPECT_FALSE(!c->loaded || c->loaded->full()))
+            {
+              if (c->prev && c->prev->empty())
+                c->swap_magazines();
+              else if (Magazine *m = depot_exchange(c->prev, false))
+                {
+                  c->prev = c->loaded;
+                  c->loaded = m;
+                }
+              else if (spare)
+                {
+                  if (c->prev)
+                    {
+                      auto g = lock_guard(_depot_lock);
+                      _depot_full.push_front(c->prev);
+                      ++_depot_full_cnt;
+                    }
+
+                  c->prev = c->loaded;
+                  c->loaded = spare;
+                  spare = 0;
+                }
+            }
+
+          if (EXPECT_TRUE(c->loaded && !c->loaded->full()))
+            {
+              ++c->hits;
+              c->loaded->rounds[c->loaded->count++] = cache_entry;
+              if (EXPECT_FALSE(spare != 0))
+                depot_put_empty(spare);
+              return;
+            }
+
+          if (spare)
+            {
+              ++c->misses;
+              break;
+            }
+        }
+
+      // No empty magazine anywhere, get one without holding the CPU
+      // lock: the allocation may enter the memory reapers, which drain
+      // the magazines of this CPU, and it may take the buddy lock.
+      void *b = _magazine_allocator.alloc();
+      if (!b)
+        break;
+
+      spare = new (b) Magazine();
+    }
+
+  if (spare)
+    depot_put_empty(spare);
+
+  Slab_cache::free(cache_entry);
+}
+
+PUBLIC template< typename Q >
+inline
+void *
+Kmem_slab::q_alloc(Q *quota)
+{
+  Auto_quota<Q> q(quota, entry_size());
+  if (EXPECT_FALSE(!q))
+    return 0;
+
+  void *r;
+  if (EXPECT_FALSE(!(r=alloc())))
+    return 0;
+
+  q.release();
+  return r;
+}
+
+PUBLIC template< typename Q >
+inline
+void
+Kmem_slab::q_free(Q *quota, void *obj)
+{
+  free(obj);
+  quota->free(entry_size());
+}
+
 
 // Callback functions called by our super class, Slab_cache, to
 // allocate or free blocks
@@ -98,12 +437,53 @@ Kmem_slab::block_free(void *block, unsigned long size)
 // 
 // Memory reaper
 // 
+
+/**
+ * Return the objects in the magazines of `cpu` of all caches to their
+ * Slab_cache.  Must be called on `cpu` with the CPU lock held.
+ */
+PUBLIC static
+void
+Kmem_slab::drain_cpu(Cpu_number cpu)
+{
+  assert(cpu_lock.test());
+  if (!Kmem_alloc::per_cpu_ready(cpu))
+    return;
+
+  for (Reap_list::Const_iterator alloc = reap_list.begin();
+       alloc != reap_list.end(); ++alloc)
+    {
+      if (!alloc->_use_magazines)
+        continue;
+
+      Cpu_cache *c = &alloc->_cpu[cpu];
+      Magazine *loaded = c->loaded;
+      Magazine *prev = c->prev;
+      c->loaded = c->prev = 0;
+      alloc->drain_magazine(loaded);
+      alloc->drain_magazine(prev);
+    }
+}
+
 PUBLIC static
 size_t
 Kmem_slab::reap_all (bool desperate)
 {
   size_t freed = 0;
 
+  // Return the magazines of this CPU and of the depot first, so that
+  // their slabs and the magazines themselves can be reaped below.  The
+  // magazines of the other CPUs are drained by a reaper on MP (see
+  // kmem_hot_reaper.cpp).
+    {
+      auto guard = lock_guard(cpu_lock);
+      drain_cpu(current_cpu());
+    }
+
+  for (Reap_list::Const_iterator alloc = reap_list.begin();
+       alloc != reap_list.end(); ++alloc)
+    alloc->drain_depot();
+
   for (Reap_list::Const_iterator alloc = reap_list.begin();
        alloc != reap_list.end(); ++alloc)
     {
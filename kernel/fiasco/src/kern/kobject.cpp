@@ -170,6 +170,15 @@ Kobject::destroy(Kobject ***)
   existence_lock.wait_free();
 }
 
+/**
+ * Whether deleting this object should wait for an expedited grace
+ * period instead of a regular one, see Reap_list::del().
+ */
+PUBLIC virtual
+bool
+Kobject::expedite_reap() const
+{ return false; }
+
 PUBLIC virtual
 Kobject::~Kobject()
 {
@@ -221,10 +230,14 @@ Kobject::Reap_list::del()
   if (EXPECT_TRUE(!_h))
     return;
 
+  bool expedite = false;
   for (Kobject *reap = _h; reap; reap = reap->_next_to_reap)
-    reap->destroy(list());
+    {
+      reap->destroy(list());
+      expedite |= reap->expedite_reap();
+    }
 
-  current()->rcu_wait();
+  current()->rcu_wait(expedite);
 
   for (Kobject *reap = _h; reap;)
     {
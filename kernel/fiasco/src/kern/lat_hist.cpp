@@ -0,0 +1,229 @@
+INTERFACE:
+
+#include "jdb_ktrace.h"
+#include "types.h"
+
+/**
+ * Per-CPU latency histograms of the main kernel entry points.
+ *
+ * Each kind of operation has a histogram of Lat_hist_buckets log2
+ * buckets of TSC ticks.  The histograms live in memory that user space
+ * can read, Jdb_tbuf_init announces them in the trace-buffer status page
+ * (Tracebuffer_lat_hist), hence CONFIG_LATENCY_HIST depends on
+ * CONFIG_JDB.  Nothing is recorded before Jdb_tbuf_init calls init().
+ * Without CONFIG_LATENCY_HIST the interface below compiles to nothing.
+ */
+class Lat_hist
+{
+public:
+  enum Kind
+  {
+    Ipc_call       = Lat_hist_ipc_call,
+    Ipc_reply_wait = Lat_hist_ipc_reply_wait,
+    Page_fault     = Lat_hist_page_fault,
+    Map            = Lat_hist_map,
+    Unmap          = Lat_hist_unmap,
+    Thread_switch  = Lat_hist_thread_switch,
+    Irq            = Lat_hist_irq,
+    None           = Lat_hist_max, ///< record nothing
+  };
+};
+
+INTERFACE [lat_hist]:
+
+#include "per_cpu_data.h"
+
+EXTENSION class Lat_hist
+{
+public:
+  /**
+   * Start of an operation, recorded at most once.
+   */
+  class Stamp
+  {
+  public:
+    Stamp() : _t(0) {}
+    void start() { _t = Lat_hist::now(); }
+
+    void record(Kind k)
+    {
+      if (!_t)
+        return;
+
+      Lat_hist::record(k, _t);
+      _t = 0;
+    }
+
+  private:
+    Unsigned64 _t;
+  };
+
+  /**
+   * Records the time from its construction to stop() or its destruction.
+   */
+  class Scope
+  {
+  public:
+    explicit Scope(Kind k) : _k(k)
+    {
+      if (k != None)
+        _s.start();
+    }
+
+    ~Scope() { stop(); }
+    void stop() { _s.record(_k); }
+
+  private:
+    Stamp _s;
+    Kind _k;
+  };
+
+private:
+  struct Cpu_hist
+  {
+    Mword cnt[Lat_hist_max][Lat_hist_buckets];
+  } __attribute__((aligned(64)));
+
+  static Cpu_hist *_hist;
+  static Per_cpu<Unsigned64> _switch_start;
+};
+
+INTERFACE [!lat_hist]:
+
+EXTENSION class Lat_hist
+{
+public:
+  class Stamp
+  {
+  public:
+    void start() {}
+    void record(Kind) {}
+  };
+
+  class Scope
+  {
+  public:
+    explicit Scope(Kind) {}
+    void stop() {}
+  };
+};
+
+// ------------------------------------------------------------------------
+IMPLEMENTATION [lat_hist]:
+
+#include <panic.h>
+
+#include "config.h"
+#include "cpu.h"
+#include "cpu_lock.h"
+#include "lock_guard.h"
+#include "mem_layout.h"
+#include "vmem_alloc.h"
+
+Lat_hist::Cpu_hist *Lat_hist::_hist;
+DEFINE_PER_CPU Per_cpu<Unsigned64> Lat_hist::_switch_start;
+
+/**
+ * Allocate the histograms and describe them to user space.
+ * \param desc  Descriptor in the trace-buffer status page.
+ */
+PUBLIC static
+void
+Lat_hist::init(Tracebuffer_lat_hist *desc)
+{
+  static_assert(Config::Max_num_cpus * sizeof(Cpu_hist)
+                <= Mem_layout::Tbuf_buffer_area - Mem_layout::Lat_hist_area,
+                "latency histograms do not fit into their area");
+
+  Address size = Config::Max_num_cpus * sizeof(Cpu_hist);
+  for (Address o = 0; o < size; o += Config::PAGE_SIZE)
+    if (!Vmem_alloc::page_alloc((void *)(Mem_layout::Lat_hist_area + o),
+                                Vmem_alloc::ZERO_FILL, Vmem_alloc::User))
+      panic("lat_hist: alloc histograms at " L4_PTR_FMT " failed",
+            (Address)Mem_layout::Lat_hist_area + o);
+
+  desc->hist        = Mem_layout::Lat_hist_area;
+  desc->cpu_stride  = sizeof(Cpu_hist);
+  desc->num_cpus    = Config::Max_num_cpus;
+  desc->num_kinds   = Lat_hist_max;
+  desc->num_buckets = Lat_hist_buckets;
+
+  _hist = (Cpu_hist *)Mem_layout::Lat_hist_area;
+}
+
+PUBLIC static inline NEEDS["cpu.h"]
+Unsigned64
+Lat_hist::now()
+{ return Cpu::rdtsc(); }
+
+/**
+ * Bucket of a latency: 0 for less than 2 ticks, i for [2^i, 2^(i+1))
+ * ticks, the last one for everything longer.
+ */
+PRIVATE static inline
+unsigned
+Lat_hist::bucket(Unsigned64 ticks)
+{
+  if (ticks < 2)
+    return 0;
+
+  unsigned b = 63 - __builtin_clzll(ticks);
+  return b < Lat_hist_buckets ? b : Lat_hist_buckets - 1;
+}
+
+/**
+ * Count an operation of kind `k` that started at `start` on the current
+ * CPU.  The TSCs of different CPUs may be slightly off, a start time in
+ * the future counts as 0 ticks.
+ */
+PUBLIC static inline NEEDS["cpu_lock.h", "lock_guard.h", Lat_hist::now,
+                           Lat_hist::bucket]
+void
+Lat_hist::record(Kind k, Unsigned64 start)
+{
+  Cpu_hist *h = _hist;
+  if (EXPECT_FALSE(!h))
+    return;
+
+  Unsigned64 t = now();
+  unsigned b = bucket(t > start ? t - start : 0);
+
+  auto guard = lock_guard(cpu_lock);
+  ++h[cxx::int_value<Cpu_number>(current_cpu())].cnt[k][b];
+}
+
+/**
+ * The current context is about to switch to another one.
+ * \pre cpu_lock held.
+ */
+PUBLIC static inline NEEDS[Lat_hist::now]
+void
+Lat_hist::switch_start()
+{ _switch_start.current() = now(); }
+
+/**
+ * Count the switch to the current context begun by switch_start().
+ * \pre cpu_lock held.
+ */
+PUBLIC static inline NEEDS[Lat_hist::record]
+void
+Lat_hist::switch_done()
+{ record(Thread_switch, _switch_start.current()); }
+
+// ------------------------------------------------------------------------
+IMPLEMENTATION [!lat_hist]:
+
+PUBLIC static inline
+void
+Lat_hist::init(Tracebuffer_lat_hist *)
+{}
+
+PUBLIC static inline
+void
+Lat_hist::switch_start()
+{}
+
+PUBLIC static inline
+void
+Lat_hist::switch_done()
+{}
@@ -68,8 +68,7 @@
 #define LOG_TRAP                                                        \
   LOG_TRACE_COND("Exceptions", "exc", current(), Tb_entry_trap,         \
                  (!ts->exclude_logging()),                              \
-    l->set(ts->ip(), ts);                                               \
-    Jdb_tbuf::commit_entry() )
+    l->set(ts->ip(), ts) )
 
 #define LOG_TRAP_N(n)                                                   \
   LOG_TRACE("Exceptions", "exc", current(), Tb_entry_trap,              \
@@ -129,6 +128,12 @@
 #define CNT_IO_FAULT            Jdb_tbuf::status()->kerncnts[Kern_cnt_io_fault]++;
 #define CNT_SCHEDULE            Jdb_tbuf::status()->kerncnts[Kern_cnt_schedule]++;
 #define CNT_EXC_IPC             Jdb_tbuf::status()->kerncnts[Kern_cnt_exc_ipc]++;
+#define CNT_TLB_SHOOTDOWN(ipis, pages)                                  \
+  do {                                                                  \
+    Jdb_tbuf::status()->kerncnts[Kern_cnt_tlb_shootdown]++;             \
+    Jdb_tbuf::status()->kerncnts[Kern_cnt_tlb_ipi] += (ipis);           \
+    Jdb_tbuf::status()->kerncnts[Kern_cnt_tlb_pages] += (pages);        \
+  } while (0)
 
 // FIXME: currently unused entries below
 #define CNT_SHORTCUT_FAILED     Jdb_tbuf::status()->kerncnts[Kern_cnt_shortcut_failed]++;
@@ -146,6 +151,7 @@
 #define CNT_IO_FAULT		do { } while (0)
 #define CNT_SCHEDULE		do { } while (0)
 #define CNT_EXC_IPC             do { } while (0)
+#define CNT_TLB_SHOOTDOWN(ipis, pages) do { (void)(ipis); (void)(pages); } while (0)
 
 // FIXME: currently unused entries below
 #define CNT_SHORTCUT_FAILED	do { } while (0)
@@ -78,7 +78,8 @@ mem_map(Space *from, L4_fpage const &fp_from,
     @return combined (bit-ORed) access status of unmapped physical pages
 */
 L4_fpage::Rights __attribute__((nonnull(1)))
-mem_fpage_unmap(Space *space, L4_fpage fp, L4_map_mask mask)
+mem_fpage_unmap(Space *space, L4_fpage fp, L4_map_mask mask,
+                Mu::Auto_tlb_flush<Mem_space> &tlb)
 {
   if (fp.order() < L4_fpage::Mem_addr::Shift)
     return L4_fpage::Rights(0);
@@ -88,7 +89,6 @@ mem_fpage_unmap(Space *space, L4_fpage fp, L4_map_mask mask)
   Mem_space::V_pfn start = fp.mem_address();
 
   start = cxx::mask_lsb(start, o);
-  Mu::Auto_tlb_flush<Mem_space> tlb;
   return unmap<Mem_space>(mapdb_mem.get(), space, space,
                start, size,
                fp.rights(), mask, tlb, (Mem_space::Reap_list**)0);
@@ -1,12 +1,16 @@
 INTERFACE:
 
 #include "assert_opt.h"
+#include "cpu_mask.h"
 #include "l4_types.h"
+#include "mem.h"
 #include "space.h"
 #include <cxx/function>
 
 class Mapdb;
 
+void tlb_shootdown_account(unsigned ipis, unsigned pages);
+
 namespace Mu {
 
 template<typename SPACE>
@@ -18,18 +22,78 @@ struct Auto_tlb_flush
 template<>
 struct Auto_tlb_flush<Mem_space>
 {
-  enum { N_spaces = 4 };
+  enum
+  {
+    N_spaces = 4,
+    N_ranges = 8,
+    /// more pages than this are flushed with the whole space
+    Max_pages = 32,
+  };
+
+  struct Range
+  {
+    Mem_space *space;
+    Address va;
+    unsigned pages;
+  };
+
   bool all;
   bool empty;
+  /// number of valid entries in ranges, > N_ranges: flush whole spaces
+  unsigned n_ranges;
+  unsigned n_pages;
 
   Mem_space *spaces[N_spaces];
-  Auto_tlb_flush() : all(false), empty(true)
+  Range ranges[N_ranges];
+
+  Auto_tlb_flush()
+  : all(false), empty(true),
+    n_ranges(Mem_space::Have_tlb_flush_range ? 0 : N_ranges + 1), n_pages(0)
   {
     for (unsigned i = 0; i < N_spaces; ++i)
       spaces[i] = 0;
   }
 
-  void add_page(Mem_space *space, Mem_space::V_pfn, Mem_space::Page_order)
+  void add_range(Mem_space *space, Mem_space::V_pfn virt,
+                 Mem_space::Page_order order)
+  {
+    if (n_ranges > N_ranges)
+      return;
+
+    unsigned shift = cxx::int_value<Mem_space::Page_order>(order)
+                     - Config::PAGE_SHIFT;
+    unsigned pages = shift < 8 ? 1U << shift : Max_pages + 1;
+    if (n_pages + pages > Max_pages)
+      {
+        n_ranges = N_ranges + 1;
+        return;
+      }
+
+    Address va = cxx::int_value<Mem_space::V_pfn>(virt);
+    n_pages += pages;
+
+    // unmaps mostly walk a region page by page, so merge adjacent pages
+    if (n_ranges)
+      {
+        Range *r = &ranges[n_ranges - 1];
+        if (r->space == space && r->va + (r->pages << Config::PAGE_SHIFT) == va)
+          {
+            r->pages += pages;
+            return;
+          }
+      }
+
+    if (n_ranges == N_ranges)
+      {
+        n_ranges = N_ranges + 1;
+        return;
+      }
+
+    ranges[n_ranges++] = Range{space, va, pages};
+  }
+
+  void add_page(Mem_space *space, Mem_space::V_pfn virt,
+                Mem_space::Page_order order)
   {
     if (all)
       return;
@@ -41,11 +105,15 @@ struct Auto_tlb_flush<Mem_space>
         if (spaces[i] == 0)
           {
             spaces[i] = space;
+            add_range(space, virt, order);
             return;
           }
 
         if (spaces[i] == space)
-          return;
+          {
+            add_range(space, virt, order);
+            return;
+          }
       }
 
     // got an overflow, we have to flush all
@@ -61,6 +129,14 @@ struct Auto_tlb_flush<Mem_space>
         return;
       }
 
+    if (n_ranges <= N_ranges)
+      {
+        // few pages: flush them one by one instead of the whole space
+        for (unsigned i = 0; i < n_ranges; ++i)
+          ranges[i].space->tlb_flush_range(ranges[i].va, ranges[i].pages);
+        return;
+      }
+
     for (unsigned i = 0; i < N_spaces; ++i)
       {
         if (spaces[i])
@@ -70,12 +146,49 @@ struct Auto_tlb_flush<Mem_space>
       }
   }
 
+  /**
+   * Does `cpu` possibly have TLB entries of the recorded spaces?  CPUs
+   * that do not run a space, and do not keep its entries tagged, are
+   * skipped (lazy TLB).
+   */
+  bool need_flush(Cpu_number cpu) const
+  {
+    if (all)
+      return true;
+
+    for (unsigned i = 0; i < N_spaces && spaces[i]; ++i)
+      if (spaces[i]->tlb_active_on(cpu))
+        return true;
+
+    return false;
+  }
+
   void global_flush()
   {
     if (empty)
       return;
 
-    Context::cpu_call_many(Context::active_tlb(), [this](Cpu_number) {
+    // order the page-table updates before looking at the CPUs, pairs
+    // with the update of the current space in Mem_space::make_current()
+    Mem::mp_mb();
+
+    Cpu_mask const &active = Context::active_tlb();
+    Cpu_mask cpus;
+    unsigned ipis = 0;
+    for (Cpu_number n = Cpu_number::first(); n < Config::max_num_cpus(); ++n)
+      if (active.get(n) && need_flush(n))
+        {
+          cpus.set(n);
+          if (n != current_cpu())
+            ++ipis;
+        }
+
+    tlb_shootdown_account(ipis, n_ranges <= N_ranges ? n_pages : 0);
+
+    if (cpus.empty())
+      return;
+
+    Context::cpu_call_many(cpus, [this](Cpu_number) {
       this->do_flush();
       return false;
     });
@@ -180,9 +293,14 @@ IMPLEMENTATION:
 #include "config.h"
 #include "context.h"
 #include "kobject.h"
+#include "logdefs.h"
 #include "paging.h"
 #include "warn.h"
 
+void
+tlb_shootdown_account(unsigned ipis, unsigned pages)
+{ CNT_TLB_SHOOTDOWN(ipis, pages); }
+
 
 IMPLEMENT template<typename SPACE>
 inline
@@ -316,7 +434,8 @@ fpage_map(Space *from, L4_fpage fp_from, Space *to,
 // Don't inline -- it eats too much stack.
 // inline NEEDS ["config.h", io_fpage_unmap]
 L4_fpage::Rights
-fpage_unmap(Space *space, L4_fpage fp, L4_map_mask mask, Kobject ***rl)
+fpage_unmap(Space *space, L4_fpage fp, L4_map_mask mask, Kobject ***rl,
+            Mu::Auto_tlb_flush<Mem_space> &tlb)
 {
   L4_fpage::Rights ret(0);
   Space::Caps caps = space->caps();
@@ -328,17 +447,117 @@ fpage_unmap(Space *space, L4_fpage fp, L4_map_mask mask, Kobject ***rl)
     ret |= obj_fpage_unmap(space, fp, mask, rl);
 
   if ((caps & Space::Caps::mem()) && (fp.is_mempage() || fp.is_all_spaces()))
-    ret |= mem_fpage_unmap(space, fp, mask);
+    ret |= mem_fpage_unmap(space, fp, mask, tlb);
 
   return ret;
 }
 
+/**
+ * Unmap a single flexpage, flushing the TLBs before returning.  Use the
+ * variant with an Auto_tlb_flush to flush once for several flexpages.
+ */
+L4_fpage::Rights
+fpage_unmap(Space *space, L4_fpage fp, L4_map_mask mask, Kobject ***rl)
+{
+  Mu::Auto_tlb_flush<Mem_space> tlb;
+  return fpage_unmap(space, fp, mask, rl, tlb);
+}
+
 
 //////////////////////////////////////////////////////////////////////
 //
 // Utility functions for all address-space types
 //
 
+/**
+ * Map the rest of a sender page that the receiver takes in smaller pages.
+ *
+ * Called by map() after it mapped the first receiver page out of the
+ * sender page, with the mapdb tree of the sender mapping still locked.
+ * All further receiver pages have the same sender mapping, attributes and
+ * mapdb parent; the per-page sender page-table walk and mapdb lookup,
+ * which dominate mapping large regions, are skipped.  The mapdb parent
+ * already has its submap, so the locked tree sees no further allocation.
+ *
+ * Stops at the first receiver page that is already mapped or cannot be
+ * inserted and leaves it to the generic loop.
+ *
+ * @param snd_end  End of the range to send within the sender page.
+ * @return Size of the range mapped.
+ */
+inline
+template <typename SPACE, typename MAPDB> inline
+typename SPACE::V_pfc
+map_subpages(MAPDB *mapdb, typename MAPDB::Frame const &mapdb_frame,
+             typename MAPDB::Mapping *sender_mapping,
+             SPACE *to, Space *to_id,
+             typename SPACE::V_pfn snd_addr, typename SPACE::V_pfn snd_end,
+             typename SPACE::V_pfn rcv_addr, typename SPACE::V_pfn rcv_max,
+             typename SPACE::Phys_addr s_phys,
+             typename SPACE::Page_order s_order,
+             typename SPACE::Attr s_attribs, typename SPACE::Attr attribs,
+             Mu::Auto_tlb_flush<SPACE> &tlb, L4_error *condition)
+{
+  typedef typename SPACE::Attr Attr;
+  typedef typename SPACE::Page_order Page_order;
+  typedef typename SPACE::V_pfc V_pfc;
+  typedef Map_traits<SPACE> Mt;
+
+  auto const to_fit_size = to->fitting_sizes();
+  bool const managed = mapdb->valid_address(SPACE::to_pfn(s_phys));
+  V_pfc done = V_pfc(0);
+
+  while (snd_addr < snd_end && rcv_addr < rcv_max)
+    {
+      typename SPACE::Phys_addr r_phys;
+      Page_order r_order;
+      Attr r_attribs;
+
+      if (to->v_lookup(rcv_addr, &r_phys, &r_order, &r_attribs))
+        break;                  // overmap, needs a flush first
+
+      Page_order i_order = to_fit_size(s_order);
+      V_pfc i_size = SPACE::to_size(i_order);
+
+      while (i_order > r_order
+             || snd_addr + i_size > snd_end
+             || SPACE::subpage_offset(snd_addr, i_order) != V_pfc(0)
+             || SPACE::subpage_offset(rcv_addr, i_order) != V_pfc(0))
+        {
+          i_order = to_fit_size(--i_order);
+          i_size = SPACE::to_size(i_order);
+        }
+
+      typename SPACE::Phys_addr i_phys
+        = SPACE::subpage_address(s_phys, SPACE::subpage_offset(snd_addr, s_order));
+      Attr i_attribs = Mt::apply_attribs(s_attribs, i_phys, attribs);
+
+      if (to->v_insert(i_phys, rcv_addr, i_order, i_attribs) != SPACE::Insert_ok)
+        break;
+
+      if (managed
+          && !mapdb->insert(mapdb_frame, sender_mapping,
+                            to_id, SPACE::to_pfn(rcv_addr),
+                            SPACE::to_pfn(i_phys), SPACE::to_pcnt(i_order)))
+        {
+          to->v_delete(rcv_addr, i_order, L4_fpage::Rights::FULL());
+          tlb.add_page(to, rcv_addr, i_order);
+          *condition = L4_error::Map_failed;
+          break;
+        }
+
+      if (SPACE::Need_insert_tlb_flush)
+        tlb.add_page(to, rcv_addr, i_order);
+
+      snd_addr += i_size;
+      rcv_addr += i_size;
+      done += i_size;
+    }
+
+  return done;
+}
+
+
 inline
 template <typename SPACE, typename MAPDB> inline
 L4_error
@@ -597,6 +816,24 @@ map(MAPDB* mapdb,
           break;
         }
 
+      // Fast path for the remaining receiver pages of a sender superpage
+      if (status == SPACE::Insert_ok && !grant && condition.ok()
+          && i_order < s_order
+          && (sender_mapping || !mapdb->valid_address(SPACE::to_pfn(s_phys))))
+        {
+          V_pfn snd_end = SPACE::page_address(snd_addr, s_order)
+                          + SPACE::to_size(s_order);
+          if (snd_end > snd_addr + snd_size)
+            snd_end = snd_addr + snd_size;
+          if (snd_end > from_max)
+            snd_end = from_max;
+
+          size += map_subpages(mapdb, mapdb_frame, sender_mapping, to, to_id,
+                               snd_addr + size, snd_end, rcv_addr + size, to_max,
+                               s_phys, s_order, s_attribs, attribs, tlb,
+                               &condition);
+        }
+
       if (sender_mapping)
         mapdb->free(mapdb_frame);
 
@@ -1,6 +1,5 @@
 INTERFACE:
 
-#include "slab_cache.h"
 #include "l4_types.h"
 #include "types.h"
 #include "mapping.h"
@@ -8,6 +7,7 @@ INTERFACE:
 #include "auto_quota.h"
 
 struct Mapping_tree;		// forward decls
+class Kmem_slab;
 class Physframe;
 class Treemap;
 class Space;
@@ -160,24 +160,20 @@ IMPLEMENTATION:
  *                                     |             |
  *                                     ---------------
 
+ * To find the tree header corresponding to a mapping, each array
+ * slot holds a one-byte hint with the (saturated) negative array
+ * offset of the Sigma0 mapping.  See Mapping_tree::head_of().
+
  * IDEAS for enhancing this implementation: 
 
- * We often have to find a tree header corresponding to a mapping.
- * Currently, we do this by iterating backwards over the array
- * containing the mappings until we find the Sigma0 mapping, from
- * whose address we can compute the address of the tree header.  If
- * this becomes a problem, we could add one more byte to the mappings
- * with a hint (negative array offset) where to find the sigma0
- * mapping.  (If the hint value overflows, just iterate using the hint
- * value of the mapping we find with the first hint value.)  Another
- * idea (from Adam) would be to just look up the tree header by using
- * the physical address from the page-table lookup, but we would need
- * to change the interface of the mapping database for that (pass in
- * the physical address at all times), or we would have to include the
- * physical address (or just the address of the tree header) in the
- * Mapdb-user-visible Mapping (which could be different from the
- * internal tree representation).  (XXX: Implementing one of these
- * ideas is probably worthwile doing!)
+ * Another idea (from Adam) for finding the tree header would be to
+ * just look up the tree header by using the physical address from
+ * the page-table lookup, but we would need to change the interface
+ * of the mapping database for that (pass in the physical address at
+ * all times), or we would have to include the physical address (or
+ * just the address of the tree header) in the Mapdb-user-visible
+ * Mapping (which could be different from the internal tree
+ * representation).
 
  * Instead of copying whole trees around when they grow or shrink a
  * lot, or copying parts of trees when inserting an element, we could
@@ -487,7 +483,7 @@ Treemap::~Treemap()
 static Kmem_slab_t<Treemap> _treemap_allocator("Treemap");
 
 static
-Slab_cache *
+Kmem_slab *
 Treemap::allocator()
 { return &_treemap_allocator; }
 
@@ -629,6 +625,7 @@ Treemap::lookup(Pcnt key, Space *search_space, Pfn search_va,
       else if (m->space() == search_space
 	       && vaddr(m) == cxx::mask_lsb(search_va, psz))
 	{
+	  assert (Mapping_tree::head_of(m) == t);
 	  *out_mapping = m;
 	  *out_treemap = this;
 	  *out_frame = f;
@@ -690,7 +687,8 @@ Treemap::insert(Physframe* frame, Mapping* parent, Space *space,
 	  // free the mapping got with allocate
 	  t->free_mapping(payer, free);
 #ifndef NDEBUG
-          ++t->_empty_count;
+          if (!t->is_linked())  // linked trees count dead entries per chunk
+            ++t->_empty_count;
 #endif
 	  return 0;
 	}
@@ -1025,17 +1023,10 @@ Treemap::find_space(Space *s)
         continue;
 
       t->check_integrity();
-      Mapping *m = t->mappings();
-      for (unsigned mx = 0; mx < t->number_of_entries(); ++mx)
+      unsigned mx = 0;
+      for (Mapping *ma = t->mappings(); ma; ma = t->next(ma), ++mx)
         {
           bool mapping_bug = false;
-          Mapping *ma = m + mx;
-          if (ma->is_end_tag())
-            break;
-
-          if (ma->unused())
-            continue;
-
           if (ma->submap())
             mapping_bug = ma->submap()->find_space(s);
           else if (ma->space() == s)
@@ -26,14 +26,21 @@ public:
   struct Page_t;
   typedef cxx::int_type_order<Address, Page_t, Order> Page;
 
+  // The depth byte also tags special entries.  The link entries of
+  // linked mapping trees (see Mapping_tree) take three of the values
+  // above Depth_max, so mappings can nest 249 instead of 252 levels.
   enum Mapping_depth
   {
-    Depth_root = 0, Depth_max = 252, 
+    Depth_root = 0, Depth_max = 249,
+    Depth_root_link = 250, Depth_prev_link = 251, Depth_next_link = 252,
     Depth_submap = 253, Depth_empty = 254, Depth_end = 255 
   };
 
   enum { Alignment = Mapping_entry::Alignment };
 
+  /// Largest offset that can be stored in a root hint (see hint()).
+  enum { Hint_max = 255 };
+
   // CREATORS
   Mapping(const Mapping&);	// this constructor is undefined.
 
@@ -168,6 +175,73 @@ Mapping::set_unused()
   data()->_depth = Depth_empty;
 }
 
+/** Link entry of a linked mapping tree?
+    Link entries connect the chunks of a linked mapping tree (see
+    Mapping_tree) and never denote a mapping.
+ */
+PUBLIC inline
+bool
+Mapping::is_link() const
+{
+  return depth() >= Depth_root_link && depth() <= Depth_next_link;
+}
+
+/** Target of a link entry. */
+PUBLIC inline
+Mapping *
+Mapping::link() const
+{
+  return data()->_link;
+}
+
+/** Make this entry a link entry.
+    @param depth  one of Depth_root_link, Depth_prev_link, Depth_next_link
+    @param target the entry the link points to
+ */
+PUBLIC inline
+void
+Mapping::set_link(Mapping_depth depth, Mapping *target)
+{
+  data()->_link = target;
+  data()->_depth = depth;
+}
+
+/** Root hint.
+    The hint is the (saturated) array distance of this entry to the
+    root (sigma0) entry of the mapping tree.  It belongs to the array
+    slot, not to the mapping stored in it, and is set up once when the
+    mapping tree is created.
+    @return number of entries to step back towards the root entry.
+ */
+PUBLIC inline
+unsigned
+Mapping::hint() const
+{
+  return data()->_hint;
+}
+
+/** Set root hint of this array slot. */
+PUBLIC inline
+void
+Mapping::set_hint(unsigned hint)
+{
+  data()->_hint = hint < Hint_max ? hint : (unsigned)Hint_max;
+}
+
+/** Copy a mapping into this array slot.
+    The root hint stays with the slot, so moving mappings around in
+    the tree array keeps the hints valid.
+ */
+PUBLIC inline
+Mapping &
+Mapping::operator = (Mapping const &o)
+{
+  Unsigned8 h = data()->_hint;
+  _data = o._data;
+  data()->_hint = h;
+  return *this;
+}
+
 /** Parent.
     @return parent mapping of this mapping.
  */
@@ -180,13 +254,20 @@ Mapping::parent()
   // Iterate over mapping entries of this tree backwards until we find
   // an entry with a depth smaller than ours.  (We assume here that
   // "special" depths (empty, end) are larger than Depth_max.)
+  // In linked trees, the first entry of a chunk links back to the last
+  // entry of the previous chunk.
   Mapping *m = this - 1;
 
   // NOTE: Depth_unused / Depth_submap are high, so no need to test
   // for them
-  while (m->depth() >= depth())
-    m--;
-
-  return m;
+  for (;;)
+    {
+      if (m->depth() == Depth_prev_link)
+        m = m->link() - 1;
+      else if (m->depth() >= depth() || m->is_link())
+        m--;
+      else
+        return m;
+    }
 }
 
@@ -18,10 +18,13 @@ class Simple_tree_submap_ops
 
  * This implementation encodes mapping trees in very compact arrays of
  * fixed sizes, prefixed by a tree header (Mapping_tree).  Array
- * sizes can vary from 4 mappings to 4<<15 mappings.  For each size,
- * we set up a slab allocator.  To grow or shrink the size of an
- * array, we have to allocate a larger or smaller tree from the
- * corresponding allocator and then copy the array elements.
+ * sizes can vary from 4 mappings to 4<<Size_id_max mappings.  For
+ * each size, we set up a slab allocator.  To grow or shrink the size
+ * of an array, we have to allocate a larger or smaller tree from the
+ * corresponding allocator and then copy the array elements.  Trees
+ * that outgrow the largest array size are switched to a linked
+ * representation (see below), so no single copy ever touches more
+ * than one array of the largest size.
  * 
  * The array elements (Mapping) contain a tree depth element.  This
  * depth and the relative position in the array is all information we
@@ -83,33 +86,51 @@ class Simple_tree_submap_ops
  *                                     |             |
  *                                     ---------------
 
+ * Each array slot carries a one-byte hint: the negative array offset
+ * of the slot to the Sigma0 mapping, saturated at Mapping::Hint_max.
+ * The hint belongs to the slot (Mapping::operator = does not copy
+ * it), so it is set up once when a tree array is created and stays
+ * valid while mappings are moved around inside the array.  To find
+ * the tree header belonging to a mapping (head_of()), we follow the
+ * hints until we reach the slot with hint 0.  This needs at most
+ * number_of_entries() / Hint_max steps, independent of the depth and
+ * the fill level of the tree.
+
  * IDEAS for enhancing this implementation: 
 
- * We often have to find a tree header corresponding to a mapping.
- * Currently, we do this by iterating backwards over the array
- * containing the mappings until we find the Sigma0 mapping, from
- * whose address we can compute the address of the tree header.  If
- * this becomes a problem, we could add one more byte to the mappings
- * with a hint (negative array offset) where to find the sigma0
- * mapping.  (If the hint value overflows, just iterate using the hint
- * value of the mapping we find with the first hint value.)  Another
- * idea (from Adam) would be to just look up the tree header by using
- * the physical address from the page-table lookup, but we would need
- * to change the interface of the mapping database for that (pass in
- * the physical address at all times), or we would have to include the
- * physical address (or just the address of the tree header) in the
- * Mapdb-user-visible Mapping (which could be different from the
- * internal tree representation).  (XXX: Implementing one of these
- * ideas is probably worthwile doing!)
+ * Another idea (from Adam) for finding the tree header would be to
+ * just look up the tree header by using the physical address from
+ * the page-table lookup, but we would need to change the interface
+ * of the mapping database for that (pass in the physical address at
+ * all times), or we would have to include the physical address (or
+ * just the address of the tree header) in the Mapdb-user-visible
+ * Mapping (which could be different from the internal tree
+ * representation).
+
+ * Linked mapping trees (credits for the pre-order-encoded list idea
+ * to: Christan Szmajda and Adam Wiggins):
 
  * Instead of copying whole trees around when they grow or shrink a
- * lot, or copying parts of trees when inserting an element, we could
- * give up the array representation and add a "next" pointer to the
- * elements -- that is, keep the tree of mappings in a
- * pre-order-encoded singly-linked list (credits to: Christan Szmajda
- * and Adam Wiggins).  24 bits would probably be enough to encode that
- * pointer.  Disadvantages: Mapping entries would be larger, and the
- * cache-friendly space-locality of tree entries would be lost.
+ * lot, a tree that needs more than the largest array size is kept
+ * as a pre-order-encoded doubly-linked list of chunks.  Each chunk is
+ * an array of the largest size allocated from the same slab.  The
+ * first chunk is the original tree array (its header is the tree
+ * header), the following chunks use their first two entries as links
+ * to the previous chunk (Depth_prev_link) and to the root entry of
+ * the tree (Depth_root_link).  The last entry of each chunk either
+ * links to the next chunk (Depth_next_link) or is the end tag of the
+ * tree.  The remaining entries of a chunk hold mappings or are dead;
+ * end tags never appear there.  Every chunk header counts the live
+ * mappings of its own chunk.
+ *
+ * A new mapping is inserted directly behind its parent (behind the
+ * parent's submap entry, if there is one).  If the chunk has no dead
+ * entry behind the insertion point, the entries behind the insertion
+ * point, but at most the upper half of the chunk, are moved to a new
+ * chunk; so an insert never copies more than one chunk.
+ * Mappings that are flushed just become dead entries.  Empty and
+ * sparse chunks are merged with their predecessor in pack(), and a
+ * linked tree that shrinks to a single chunk is a plain array again.
  */
 
 
@@ -126,7 +147,8 @@ struct Mapping_tree
   enum Size_id
   {
     Size_id_min = 0,
-    Size_id_max = 9		// can be up to 15 (4 bits)
+    Size_id_max = 9		// can be up to 15 (4 bits), larger trees
+                                // are linked lists of Size_id_max chunks
   };
   // DATA
   unsigned _count: 16;		///< Number of live entries in this tree.
@@ -135,7 +157,7 @@ struct Mapping_tree
                                 //   XXX currently never read, except in
                                 //   sanity checks
 
-  unsigned _unused: 1;		// (make this 32 bits to avoid a compiler bug)
+  unsigned _linked: 1;		///< Tree (chunk) is part of a linked tree.
 
   Mapping _mappings[0];
 
@@ -155,10 +177,11 @@ struct Mapping_tree
   enum Size_id
   {
     Size_id_min = 0,
-    Size_id_max = 9		// can be up to 15 (4 bits)
+    Size_id_max = 9		// can be up to 15 (4 bits), larger trees
+                                // are linked lists of Size_id_max chunks
   };
   // DATA
-  unsigned _unused: 1;		// (make this 32 bits to avoid a compiler bug)
+  unsigned _linked: 1;		///< Tree (chunk) is part of a linked tree.
   unsigned _size_id: 4;		///< Tree size -- see number_of_entries().
   unsigned _empty_count: 11;	///< Number of dead entries in this tree.
                                 //   XXX currently never read, except in
@@ -238,7 +261,7 @@ Simple_tree_submap_ops::flush(Treemap *, Page_number, Page_number) const
 enum Mapping_tree_size
 {
   Size_factor = 4,
-  Size_id_max = 9		// can be up to 15 (4 bits)
+  Size_id_max = Mapping_tree::Size_id_max
 };
 
 PUBLIC inline
@@ -334,12 +357,22 @@ Mapping_tree::operator delete (void* block)
   allocator_for_treesize(t->_size_id)->free(block);
 }
 
+PRIVATE inline NEEDS[Mapping_tree::number_of_entries]
+void
+Mapping_tree::init_hints()
+{
+  for (unsigned i = 0; i < number_of_entries(); ++i)
+    _mappings[i].set_hint(i);
+}
+
 PUBLIC //inline NEEDS[Mapping_depth, Mapping_tree::last]
 Mapping_tree::Mapping_tree(Size_id size_id, Page page,
                            Space *owner)
 {
   _count = 1;			// 1 valid mapping
   _size_id = size_id;   	// size is equal to Size_factor << 0
+  _linked = 0;
+  init_hints();
 #ifndef NDEBUG
   _empty_count = 0;		// no gaps in tree representation
 #endif
@@ -358,10 +391,18 @@ Mapping_tree::Mapping_tree(Size_id size_id, Page page,
 PUBLIC
 Mapping_tree::~Mapping_tree()
 {
+  // the chunks of a linked tree go away together with the tree header
+  if (_linked && !is_chunk())
+    while (Mapping_tree *c = next_chunk())
+      {
+        unlink_chunk(c);
+        delete c;
+      }
+
   // special case for copied mapping trees
   for (Mapping *m = _mappings; m < end() && !m->is_end_tag(); ++m)
     {
-      if (!m->submap() && !m->unused())
+      if (!m->submap() && !m->unused() && !m->is_link())
         quota(m->space())->free(sizeof(Mapping));
     }
 }
@@ -370,11 +411,39 @@ PUBLIC //inline NEEDS[Mapping_depth, Mapping_tree::last]
 Mapping_tree::Mapping_tree(Size_id size_id, Mapping_tree* from_tree)
 {
   _size_id = size_id;
+  _linked = 0;
+  init_hints();
   last()->set_depth(Mapping::Depth_end);
 
   copy_compact_tree(this, from_tree);
 }
 
+/**
+ * Create an empty chunk for a linked mapping tree.
+ * @param root  root entry of the tree the chunk belongs to
+ *
+ * The chunk is not yet linked into the tree, see link_chunk().
+ */
+PRIVATE
+Mapping_tree::Mapping_tree(Mapping *root)
+{
+  _count = 0;
+  _size_id = Size_id_max;
+  _linked = 1;
+  init_hints();
+
+  _mappings[0].set_link(Mapping::Depth_prev_link, 0);
+  _mappings[1].set_link(Mapping::Depth_root_link, root);
+
+  for (Mapping *m = first_entry(); m < last(); ++m)
+    m->set_unused();
+
+  last()->set_depth(Mapping::Depth_end);
+#ifndef NDEBUG
+  _empty_count = last() - first_entry();
+#endif
+}
+
 // public routines with inline implementations
 PUBLIC inline NEEDS[Mapping_tree_size]
 unsigned
@@ -397,6 +466,29 @@ Mapping_tree::is_empty() const
   return _count == 0;
 }
 
+PUBLIC inline
+bool
+Mapping_tree::is_linked() const
+{
+  return _linked;
+}
+
+/** Is this a chunk (and not the header) of a linked mapping tree? */
+PUBLIC inline
+bool
+Mapping_tree::is_chunk() const
+{
+  return _mappings[0].depth() == Mapping::Depth_prev_link;
+}
+
+/** First entry of this array that can hold a mapping. */
+PUBLIC inline NEEDS[Mapping_tree::is_chunk, Mapping_tree::mappings]
+Mapping *
+Mapping_tree::first_entry()
+{
+  return mappings() + (is_chunk() ? 2 : 0);
+}
+
 PUBLIC inline NEEDS[Mapping_tree::mappings, Mapping_tree::number_of_entries]
 Mapping *
 Mapping_tree::end()
@@ -411,26 +503,19 @@ Mapping_tree::last()
   return end() - 1;
 }
 
-// A utility function to find the tree header belonging to a mapping. 
+// Utility functions to find the tree header belonging to a mapping. 
 
-/** Our Mapping_tree.
-    @return the Mapping_tree we are in.
+/** The array (tree header or chunk) an entry is stored in.
+    Follows the root hints of the array slots, see the comment at the
+    top of this file.
+    @return the Mapping_tree whose array contains m.
  */
-PUBLIC static
+PUBLIC static inline
 Mapping_tree *
-Mapping_tree::head_of(Mapping *m)
+Mapping_tree::chunk_of(Mapping *m)
 {
-  while (m->depth() > Mapping::Depth_root)
-    {
-      // jump in bigger steps if this is not a free mapping
-      if (m->depth() <= Mapping::Depth_max)
-        {
-          m -= m->depth();
-          continue;
-        }
-
-      m--;
-    }
+  while (unsigned h = m->hint())
+    m -= h;
 
   return reinterpret_cast<Mapping_tree *>
     (reinterpret_cast<char *>(m) - sizeof(Mapping_tree));
@@ -442,6 +527,206 @@ Mapping_tree::head_of(Mapping *m)
   //   (reinterpret_cast<char *>(m) - offsetof(Mapping_tree, _mappings));
 }
 
+/** Our Mapping_tree.
+    @return the Mapping_tree we are in.
+ */
+PUBLIC static inline NEEDS[Mapping_tree::chunk_of, Mapping_tree::is_chunk]
+Mapping_tree *
+Mapping_tree::head_of(Mapping *m)
+{
+  Mapping_tree *t = chunk_of(m);
+  if (EXPECT_FALSE(t->is_chunk()))
+    t = chunk_of(t->_mappings[1].link());
+
+  return t;
+}
+
+/** The chunk following this one in a linked mapping tree.
+    @return the next chunk, or 0 if this is the last one.
+ */
+PUBLIC inline NEEDS[Mapping_tree::last, Mapping_tree::chunk_of]
+Mapping_tree *
+Mapping_tree::next_chunk()
+{
+  Mapping *l = last();
+  return l->depth() == Mapping::Depth_next_link ? chunk_of(l->link()) : 0;
+}
+
+/** Link the empty chunk c into the list of chunks behind this one. */
+PRIVATE
+void
+Mapping_tree::link_chunk(Mapping_tree *c)
+{
+  Mapping *l = last();
+  if (l->depth() == Mapping::Depth_next_link)
+    {
+      Mapping *n = l->link();
+      c->last()->set_link(Mapping::Depth_next_link, n);
+      n->set_link(Mapping::Depth_prev_link, c->last());
+    }
+  else
+    c->last()->set_depth(Mapping::Depth_end);
+
+  l->set_link(Mapping::Depth_next_link, c->mappings());
+  c->mappings()->set_link(Mapping::Depth_prev_link, l);
+}
+
+/** Remove chunk c from its linked mapping tree.  Its entries are not
+    touched. */
+PRIVATE static
+void
+Mapping_tree::unlink_chunk(Mapping_tree *c)
+{
+  Mapping *p = c->mappings()->link();
+  Mapping *l = c->last();
+  if (l->depth() == Mapping::Depth_next_link)
+    {
+      Mapping *n = l->link();
+      p->set_link(Mapping::Depth_next_link, n);
+      n->set_link(Mapping::Depth_prev_link, p);
+    }
+  else
+    p->set_depth(Mapping::Depth_end);
+
+  l->set_depth(Mapping::Depth_end);
+}
+
+/** Release the memory of an unlinked chunk whose mappings have been
+    moved elsewhere. */
+PRIVATE static
+void
+Mapping_tree::free_chunk(Mapping_tree *c)
+{
+  allocator_for_treesize(c->_size_id)->free(c);
+}
+
+/** Recompute the entry counters of a tree header or chunk in a linked
+    tree. */
+PRIVATE
+void
+Mapping_tree::recount()
+{
+  unsigned used = 0, dead = 0;
+  for (Mapping *m = first_entry(); m < last(); ++m)
+    if (m->unused())
+      ++dead;
+    else
+      ++used;
+
+  _count = used;
+#ifndef NDEBUG
+  _empty_count = dead;
+#endif
+  (void)dead;
+}
+
+/** Move the mappings in [from, to) of this array to the empty chunk c,
+    which must be linked behind this array.  The entries in [from, to)
+    become dead. */
+PRIVATE
+void
+Mapping_tree::move_to_chunk(Mapping *from, Mapping *to, Mapping_tree *c)
+{
+  Mapping *d = c->first_entry();
+  for (Mapping *s = from; s < to; ++s)
+    {
+      if (!s->unused())
+        *d++ = *s;
+
+      s->set_unused();
+    }
+
+  recount();
+  c->recount();
+}
+
+/** Switch a full tree array of the largest size to a linked tree by
+    moving its upper half to a new chunk.
+    @return false if there was no memory for the chunk.
+ */
+PUBLIC
+bool
+Mapping_tree::make_linked()
+{
+  assert (!_linked && _size_id == Size_id_max);
+
+  Mapping_tree *c = new (Size_id_max) Mapping_tree(mappings());
+  if (EXPECT_FALSE(!c))
+    return false;
+
+  // The array might contain an end tag followed by stale entries if
+  // it was flushed before; the stale entries are dropped.
+  Mapping *end_of_data = mappings();
+  while (end_of_data < end() && !end_of_data->is_end_tag())
+    ++end_of_data;
+
+  Mapping *half = mappings() + number_of_entries() / 2;
+  assert (end_of_data > half);
+
+  move_to_chunk(half, end_of_data, c);
+  for (Mapping *m = end_of_data; m < last(); ++m)
+    m->set_unused();
+
+  last()->set_depth(Mapping::Depth_end);
+  _linked = 1;
+  link_chunk(c);
+  recount();
+  return true;
+}
+
+/** Merge chunk c, which follows this array, into this array.  The
+    caller has to make sure that the mappings of both fit. */
+PRIVATE
+void
+Mapping_tree::merge_chunk(Mapping_tree *c)
+{
+  Mapping *d = first_entry();
+  for (Mapping *s = first_entry(); s < last(); ++s)
+    if (!s->unused())
+      {
+        if (d != s)
+          *d = *s;
+        ++d;
+      }
+
+  for (Mapping *s = c->first_entry(); s < c->last(); ++s)
+    if (!s->unused())
+      *d++ = *s;
+
+  assert (d <= last());
+
+  for (; d < last(); ++d)
+    d->set_unused();
+
+  unlink_chunk(c);
+  free_chunk(c);
+  recount();
+}
+
+/** Free empty chunks, merge sparse neighbours, and turn a linked tree
+    that fits into its first array into a plain array again. */
+PUBLIC
+void
+Mapping_tree::pack_linked()
+{
+  Mapping_tree *t = this;
+  while (Mapping_tree *c = t->next_chunk())
+    {
+      unsigned fits = ((t->last() - t->first_entry()) >> 2) * 3;
+      if (static_cast<unsigned>(t->_count) + c->_count <= fits)
+        t->merge_chunk(c); // stay at t, it might take the next one too
+      else
+        t = c;
+    }
+
+  if (!next_chunk())
+    {
+      // last() is the end tag, everything before it a mapping or dead
+      _linked = 0;
+      recount();
+    }
+}
+
 /** Next mapping in the mapping tree.
     @param t head of mapping tree, if available
     @return the next mapping in the mapping tree.  If the mapping has
@@ -453,6 +738,22 @@ PUBLIC inline
 Mapping *
 Mapping_tree::next(Mapping *m)
 {
+  if (EXPECT_FALSE(_linked))
+    {
+      // The last entry of every array of a linked tree is either the
+      // end tag or a link to the next chunk.
+      for (;;)
+        {
+          m++;
+          if (m->depth() == Mapping::Depth_next_link)
+            m = m->link(); // skipped as a link entry in the next round
+          else if (m->is_end_tag())
+            return 0;
+          else if (! m->unused() && ! m->is_link())
+            return m;
+        }
+    }
+
   for (m++; m < end() && ! m->is_end_tag(); m++)
     if (! m->unused())
       return m;
@@ -491,6 +792,7 @@ Mapping_tree::copy_compact_tree(Mapping_tree *dst, Mapping_tree *src)
 {
   unsigned src_count = src->_count; // Store in local variable before
                                     // it can get overwritten
+  assert (!src->_linked);
 
   // Special case: cannot in-place compact a full tree
   if (src == dst && src->number_of_entries() == src_count)
@@ -530,6 +832,14 @@ Mapping_tree::check_integrity(Space *owner = (Space*)-1)
 {
   (void)owner;
 #ifndef NDEBUG
+  if (_linked)
+    {
+      // Chunks are checked together with their tree header.
+      if (!is_chunk())
+        check_integrity_linked(owner);
+      return;
+    }
+
   bool enter_ke = false;
   // Sanity checking
   if (// Either each entry is used
@@ -558,6 +868,14 @@ Mapping_tree::check_integrity(Space *owner = (Space*)-1)
       enter_ke = true;
     }
 
+  for (unsigned i = 0; i < number_of_entries(); ++i)
+    if (mappings()[i].hint() != (i < Mapping::Hint_max ? i : (unsigned)Mapping::Hint_max))
+      {
+        printf("mapdb: bad root hint %d at entry %d\n", mappings()[i].hint(), i);
+        enter_ke = true;
+        break;
+      }
+
   unsigned used = 0, dead = 0;
 
   while (m < end() && !m->is_end_tag())
@@ -587,6 +905,73 @@ Mapping_tree::check_integrity(Space *owner = (Space*)-1)
 }
 
 
+PRIVATE
+void
+Mapping_tree::check_integrity_linked(Space *owner)
+{
+  (void)owner;
+#ifndef NDEBUG
+  bool enter_ke = false;
+  Mapping *m = mappings();
+
+  if (m->unused() || m->is_link() || m->depth() != 0
+      || (owner != (Space *)-1 && m->space() != owner))
+    {
+      printf("mapdb corrupted: linked tree %p, owner=%p\n", this, owner);
+      enter_ke = true;
+    }
+
+  for (Mapping_tree *b = this; b && !enter_ke; b = b->next_chunk())
+    {
+      for (unsigned i = 0; i < b->number_of_entries(); ++i)
+        if (b->mappings()[i].hint() != (i < Mapping::Hint_max ? i : (unsigned)Mapping::Hint_max))
+          {
+            printf("mapdb: bad root hint %d at entry %d of chunk %p\n",
+                   b->mappings()[i].hint(), i, b);
+            enter_ke = true;
+          }
+
+      if (b != this && (b->mappings()[1].depth() != Mapping::Depth_root_link
+                        || b->mappings()[1].link() != mappings()))
+        {
+          printf("mapdb: chunk %p has a bad root link\n", b);
+          enter_ke = true;
+        }
+
+      if (Mapping_tree *n = b->next_chunk())
+        if (!n->is_chunk() || n->mappings()->link() != b->last())
+          {
+            printf("mapdb: chunk %p has a bad back link\n", n);
+            enter_ke = true;
+          }
+
+      unsigned used = 0, dead = 0;
+      for (Mapping *e = b->first_entry(); e < b->last(); ++e)
+        if (e->unused())
+          dead++;
+        else if (e->is_link())
+          enter_ke = true;
+        else
+          used++;
+
+      if (b->_count != used || b->_empty_count != dead)
+        {
+          printf("mapdb: chunk %p: _count=%d/%d _empty_count=%d/%d\n",
+                 b, b->_count, used, b->_empty_count, dead);
+          enter_ke = true;
+        }
+    }
+
+  if (enter_ke)
+    {
+      printf("mapdb:    from %p on CPU%d\n",
+             __builtin_return_address(0),
+             cxx::int_value<Cpu_number>(current_cpu()));
+      kdb_ke("mapdb");
+    }
+#endif // ! NDEBUG
+}
+
 /**
  * Use this function to reset a the tree to empty.
  *
@@ -618,6 +1003,88 @@ Mapping_tree::find_submap(Mapping* parent)
   return 0;
 }
 
+/**
+ * Allocate an entry in a linked mapping tree.
+ *
+ * In contrast to the array case, the new entry is always placed
+ * directly behind its parent (or behind the parent's submap entry),
+ * i.e., it becomes the parent's first child.  Only the array holding
+ * this position is searched for a dead entry; if it has none, its
+ * entries behind the position (at most its upper half) are moved to a
+ * new chunk.
+ *
+ * @return the new entry, or 0 if the maximum depth is reached or no
+ *         chunk could be allocated.
+ */
+PRIVATE
+Mapping *
+Mapping_tree::allocate_linked(Mapping *parent, bool insert_submap)
+{
+  if (EXPECT_FALSE (parent->depth() == Mapping::Depth_max))
+    return 0;
+
+  Mapping *insert = parent;
+  if (!insert_submap)
+    if (Mapping *n = next(parent))
+      if (n->submap())
+        insert = n;
+
+  Mapping_tree *b = chunk_of(insert);
+  Mapping *pos = insert + 1;
+  if (pos == b->last())
+    if (Mapping_tree *n = b->next_chunk())
+      {
+        b = n;
+        pos = n->first_entry();
+      }
+
+  Mapping *free = pos;
+  while (free < b->last() && !free->unused())
+    ++free;
+
+  if (free < b->last())
+    {
+      // Make room at pos by moving the entries up to the dead one
+      for (; free > pos; --free)
+        *free = *(free - 1);
+    }
+  else
+    {
+      Mapping_tree *c = new (Size_id_max) Mapping_tree(mappings());
+      if (EXPECT_FALSE(!c))
+        return 0;
+
+      b->link_chunk(c);
+      if (pos == b->last())
+        {
+          b = c;
+          free = c->first_entry();
+        }
+      else
+        {
+          // Move at most the upper half of the array, which always
+          // fits into the chunk, and make room at pos.
+          Mapping *split = b->first_entry()
+                           + (b->last() - b->first_entry()) / 2;
+          if (split < pos)
+            split = pos;
+
+          b->move_to_chunk(split, b->last(), c);
+          for (free = split; free > pos; --free)
+            *free = *(free - 1);
+        }
+    }
+
+  b->_count += 1;
+#ifndef NDEBUG
+  b->_empty_count -= 1;
+#endif
+
+  free->set_depth(insert_submap ? (unsigned)Mapping::Depth_submap
+                                : parent->depth() + 1);
+  return free;
+}
+
 PUBLIC inline NEEDS["ram_quota.h"]
 Mapping *
 Mapping_tree::allocate(Ram_quota *payer, Mapping *parent,
@@ -627,6 +1094,15 @@ Mapping_tree::allocate(Ram_quota *payer, Mapping *parent,
   if (EXPECT_FALSE(!q))
     return 0;
 
+  if (EXPECT_FALSE(_linked))
+    {
+      Mapping *free = allocate_linked(parent, insert_submap);
+      if (free)
+        q.release();
+
+      return free;
+    }
+
   // After locating the right place for the new entry, it will be
   // stored there (if this place is empty) or the following entries
   // moved by one entry.
@@ -741,6 +1217,16 @@ Mapping_tree::free_mapping(Ram_quota *q, Mapping *m)
   assert (!m->unused() && !m->is_end_tag());
   q->free(sizeof(Mapping));
   m->set_unused();
+  if (EXPECT_FALSE(_linked))
+    {
+      Mapping_tree *b = chunk_of(m);
+      --b->_count;
+#ifndef NDEBUG
+      ++b->_empty_count;
+#endif
+      return;
+    }
+
   --_count;
 }
 
@@ -752,6 +1238,12 @@ Mapping_tree::flush(Mapping *parent, bool me_too,
 {
   assert (! parent->unused());
 
+  if (EXPECT_FALSE(_linked))
+    {
+      flush_linked(parent, me_too, offs_begin, offs_end, submap_ops);
+      return;
+    }
+
   // This is easy to do: We just have to iterate over the array
   // encoding the tree.
   Mapping *start_of_deletions = parent;
@@ -835,6 +1327,54 @@ Mapping_tree::flush(Mapping *parent, bool me_too,
     }
 }
 
+/**
+ * Flush for linked mapping trees.  Same as the array variant, except
+ * that the freed entries stay dead (free_mapping() accounts for them
+ * in their chunks) and no end tag is moved.
+ */
+PRIVATE template< typename SUBMAP_OPS >
+void
+Mapping_tree::flush_linked(Mapping *parent, bool me_too,
+                           Pcnt offs_begin, Pcnt offs_end,
+                           SUBMAP_OPS const &submap_ops)
+{
+  unsigned p_depth = parent->depth();
+  unsigned m_depth = p_depth;
+
+  // Find the first entry behind the subtree before deleting anything
+  Mapping *m = next(parent);
+
+  if (me_too)
+    free_mapping(quota(parent->space()), parent);
+
+  for (Mapping *n; m && unsigned (m->depth()) > p_depth; m = n)
+    {
+      n = next(m);
+
+      Space *space;
+      if (Treemap* submap = m->submap())
+        {
+          space = submap_ops.owner(submap);
+          if (! me_too
+              && m_depth == p_depth
+              && submap_ops.is_partial(submap, offs_begin, offs_end))
+            {
+              submap_ops.flush(submap, offs_begin, offs_end);
+              continue;
+            }
+          else
+            submap_ops.del(submap);
+        }
+      else
+        {
+          space = m->space();
+          m_depth = m->depth();
+        }
+
+      free_mapping(quota(space), m);
+    }
+}
+
 PUBLIC template< typename SUBMAP_OPS >
 bool
 Mapping_tree::grant(Mapping* m, Space *new_space, Page page,
@@ -944,9 +1484,20 @@ Base_mappable::pack()
   // than 3/4 of the entries are used, compress the tree.  Otherwise,
   // (4) copy to a larger tree.
 
+  // Linked trees have no last entry to keep free, allocate() makes
+  // room by adding chunks.  Just give back sparse chunks; the tree
+  // might become a plain array again, which we handle as usual.
+
   Mapping_tree *t = tree.get();
   bool maybe_out_of_memory = false;
 
+  if (t->is_linked())
+    {
+      t->pack_linked();
+      if (t->is_linked())
+        return;
+    }
+
   do // (this is not actually a loop, just a block we can "break" out of)
     {
       // (1) Do we need to allocate a smaller tree?
@@ -978,20 +1529,27 @@ Base_mappable::pack()
       // array.
 
       // (3) Should we compress the tree?
-      // We also try to compress if we cannot allocate a bigger
-      // tree because there is no bigger tree size.
       if (t->_count < (t->number_of_entries() >> 2)
-                      + (t->number_of_entries() >> 1)
-          || t->_size_id == Size_id_max) // cannot enlarge?
+                      + (t->number_of_entries() >> 1))
         {
-          if (t->_size_id == Size_id_max)
-            maybe_out_of_memory = true;
-
           Mapping_tree::copy_compact_tree(t, t); // in-place compression
 
           break;
         }
 
+      // (3a) There is no bigger tree size, switch to a linked tree.
+      // We also try to compress if we cannot allocate a chunk.
+      if (t->_size_id == Size_id_max)
+        {
+          if (!t->make_linked())
+            {
+              maybe_out_of_memory = true;
+              Mapping_tree::copy_compact_tree(t, t);
+            }
+
+          break;
+        }
+
       // (4) OK, allocate a bigger array.
 
       Mapping_tree::Size_id sid = t->bigger();
@@ -1018,7 +1576,7 @@ Base_mappable::pack()
 
   // The last entry of the tree should now be free -- exept if we're
   // out of memory.
-  assert (t->last()->unused() || maybe_out_of_memory);
+  assert (t->last()->unused() || t->is_linked() || maybe_out_of_memory);
   (void) maybe_out_of_memory;
 }
 
@@ -219,6 +219,17 @@ public:
 };
 
 
+//---------------------------------------------------------------------------
+INTERFACE [!(ia32 || amd64)]:
+
+EXTENSION class Mem_space
+{
+public:
+  /// tlb_flush_range() is cheaper than flushing the whole space
+  enum { Have_tlb_flush_range = 0 };
+};
+
+
 //---------------------------------------------------------------------------
 IMPLEMENTATION:
 
@@ -335,3 +346,25 @@ PUBLIC inline
 bool
 Mem_space::io_lookup (Address)
 { return false; }
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION [!(ia32 || amd64)]:
+
+/**
+ * Flush the TLB entries for `pages` pages starting at `va` on the current
+ * CPU.  Without an architecture specific version the whole space is
+ * flushed.
+ */
+PUBLIC inline NEEDS[Mem_space::tlb_flush]
+void
+Mem_space::tlb_flush_range(Address, unsigned)
+{ tlb_flush(true); }
+
+/**
+ * Can `cpu` have TLB entries of this space?  Without an architecture
+ * specific version every CPU is assumed to have some.
+ */
+PUBLIC inline
+bool
+Mem_space::tlb_active_on(Cpu_number) const
+{ return true; }
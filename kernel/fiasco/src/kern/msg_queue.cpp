@@ -0,0 +1,473 @@
+INTERFACE:
+
+#include "context.h"
+#include "ipc_sender.h"
+#include "kobject.h"
+
+class Kmem_slab;
+class Ram_quota;
+class Thread;
+
+/**
+ * Wakeup channel of one side of a message queue.
+ *
+ * Works like an Irq_sender: the thread attached to the end gets an IPC
+ * message from it whenever the end is signalled, and waits for that
+ * message with a closed receive on the queue.  Signals that arrive while
+ * a wakeup is still pending are merged into it.
+ */
+class Msg_queue_end : public Ipc_sender<Msg_queue_end>
+{
+  friend class Jdb_msg_queue;
+
+private:
+  Thread *_thread;
+  Mword _label;
+  Mword _pending;    ///< A wakeup is on its way to _thread
+  Mword _kick;       ///< Remote notification DRQ in flight
+  Context::Drq _drq;
+
+  Mword _signals;    ///< Signal operations, including merged ones
+  Mword _wakeups;    ///< Wakeups delivered
+};
+
+/**
+ * Message queue: kernel-mediated wakeups for a ring in shared memory.
+ *
+ * The ring of fixed-size message slots lives in memory shared between
+ * the producer and the consumer tasks and is operated without kernel
+ * entry (see <l4/sys/msg_queue>).  The kernel object only provides the
+ * two wakeup channels of the ring: the consumer end is signalled when
+ * the ring becomes non-empty, the producer end when it becomes
+ * non-full.  A side only enters the kernel to block on its end or to
+ * signal the other one.  The geometry of the ring is recorded at
+ * creation so that a peer may query it.
+ */
+class Msg_queue : public Kobject
+{
+  FIASCO_DECLARE_KOBJ();
+  friend class Jdb_msg_queue;
+
+private:
+  typedef Kmem_slab Self_alloc;
+
+public:
+  enum End
+  {
+    Consumer = 0,
+    Producer = 1,
+    Num_ends = 2,
+  };
+
+  enum Op
+  {
+    Op_attach = 0,
+    Op_detach = 1,
+    Op_signal = 2,
+    Op_wait   = 3,
+    Op_info   = 4,
+  };
+
+  enum { Max_slots = 1UL << 20 };
+
+private:
+  Ram_quota *_quota;
+  Mword _slots;
+  Mword _slot_size;
+  Msg_queue_end _end[Num_ends];
+};
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION:
+
+#include <cstddef>
+
+#include "atomic.h"
+#include "cpu_lock.h"
+#include "entry_frame.h"
+#include "kmem_slab.h"
+#include "l4_buf_iter.h"
+#include "lock_guard.h"
+#include "mem.h"
+#include "ram_quota.h"
+#include "thread.h"
+#include "thread_object.h"
+#include "thread_state.h"
+
+FIASCO_DEFINE_KOBJ(Msg_queue);
+
+PUBLIC inline
+Msg_queue_end::Msg_queue_end()
+: _thread(0), _label(0), _pending(0), _kick(0), _signals(0), _wakeups(0)
+{}
+
+PUBLIC inline
+Thread *
+Msg_queue_end::thread() const
+{ return access_once(&_thread); }
+
+PUBLIC inline
+Syscall_frame *
+Msg_queue_end::transfer_msg(Receiver *recv)
+{
+  Syscall_frame *dst_regs = recv->rcv_regs();
+  dst_regs->tag(L4_msg_tag(0));
+  dst_regs->from(_label);
+  return dst_regs;
+}
+
+/**
+ * The wakeup was delivered, later signals need a new one.
+ */
+PRIVATE inline NEEDS["mem.h"]
+void
+Msg_queue_end::consume()
+{
+  ++_wakeups;
+  write_now(&_pending, 0UL);
+  // the woken side re-checks the ring after this, pairs with the
+  // cas in signal()
+  Mem::mp_mb();
+}
+
+PUBLIC inline NEEDS[Msg_queue_end::consume]
+bool
+Msg_queue_end::requeue_sender()
+{
+  consume();
+  return false;
+}
+
+PUBLIC inline NEEDS[Msg_queue_end::consume]
+bool
+Msg_queue_end::dequeue_sender()
+{
+  consume();
+  return true;
+}
+
+PUBLIC
+void
+Msg_queue_end::modify_label(Mword const *todo, int cnt)
+{
+  for (int i = 0; i < cnt*4; i += 4)
+    {
+      Mword const test_mask = todo[i];
+      Mword const test      = todo[i+1];
+      if ((_label & test_mask) == test)
+        {
+          Mword const set_mask = todo[i+2];
+          Mword const set      = todo[i+3];
+
+          _label = (_label & ~set_mask) | set;
+          return;
+        }
+    }
+}
+
+PRIVATE static
+Context::Drq::Result
+Msg_queue_end::handle_remote_notify(Context::Drq *, Context *, void *arg)
+{
+  Msg_queue_end *e = (Msg_queue_end*)arg;
+  write_now(&e->_kick, 0UL);
+  Mem::mp_mb();
+
+  // the end may have been re-attached to a thread on another CPU meanwhile
+  if (Thread *t = e->thread())
+    if (e->notify(t))
+      return Context::Drq::no_answer_resched();
+
+  return Context::Drq::no_answer();
+}
+
+/**
+ * Deliver the pending wakeup to \a t, unless it is already queued there.
+ * Remote deliveries go through a DRQ to the home CPU of \a t, at most
+ * one of them is in flight.
+ * \return true if a reschedule is necessary.
+ */
+PRIVATE
+bool
+Msg_queue_end::notify(Thread *t)
+{
+  if (EXPECT_FALSE(t->home_cpu() != current_cpu()))
+    {
+      if (mp_cas(&_kick, 0UL, 1UL))
+        t->drq(&_drq, handle_remote_notify, this,
+               Context::Drq::Target_ctxt, Context::Drq::No_wait);
+      return false;
+    }
+
+  if (!access_once(&_pending) || in_sender_list())
+    return false;
+
+  return send_msg(t, false);
+}
+
+/**
+ * Wake the thread attached to this end.
+ *
+ * A signal while a wakeup is still pending is merged into it.  Without
+ * an attached thread the wakeup stays pending until a thread attaches.
+ * \return true if a reschedule is necessary.
+ */
+PUBLIC
+bool
+Msg_queue_end::signal()
+{
+  ++_signals;
+  if (!mp_cas(&_pending, 0UL, 1UL))
+    return false;
+
+  Thread *t = thread();
+  return t && notify(t);
+}
+
+PUBLIC
+bool
+Msg_queue_end::alloc(Thread *t, Mword label)
+{
+  if (!mp_cas(&_thread, (Thread *)0, t))
+    return false;
+
+  t->inc_ref();
+  _label = label;
+
+  // a signal that came in while nobody was attached
+  if (access_once(&_pending))
+    current()->schedule_if(notify(t));
+
+  return true;
+}
+
+PUBLIC
+bool
+Msg_queue_end::free(Thread *t, Kobject ***rl)
+{
+  if (!t || !mp_cas(&_thread, t, (Thread *)0))
+    return false;
+
+  auto guard = lock_guard(cpu_lock);
+  // a wakeup that did not make it to t stays pending for the next thread
+  t->Receiver::abort_send(this);
+
+  // a notification DRQ dropped by a dying t would block all later ones
+  if (!_drq.queued())
+    write_now(&_kick, 0UL);
+
+  // release cpu-lock early, actually before delete
+  guard.reset();
+  t->put_n_reap(rl);
+  return true;
+}
+
+
+PUBLIC inline
+Msg_queue::Msg_queue(Ram_quota *q, Mword slots, Mword slot_size)
+: _quota(q), _slots(slots), _slot_size(slot_size)
+{}
+
+PUBLIC inline NEEDS[<cstddef>]
+void *
+Msg_queue::operator new (size_t, void *b) throw()
+{ return b; }
+
+static Kmem_slab_t<Msg_queue> _msg_queue_allocator("Msg_queue");
+
+PRIVATE static
+Msg_queue::Self_alloc *
+Msg_queue::allocator()
+{ return &_msg_queue_allocator; }
+
+/**
+ * Create a message queue for a ring of \a slots slots of \a slot_size
+ * bytes each.  \a slots must be a power of two.
+ */
+PUBLIC static
+Msg_queue *
+Msg_queue::create(Ram_quota *q, Mword slots, Mword slot_size, int *err)
+{
+  *err = L4_err::EInval;
+  if (!slots || slots > Max_slots || (slots & (slots - 1)) || !slot_size)
+    return 0;
+
+  *err = L4_err::ENomem;
+  Auto_quota<Ram_quota> quota(q, sizeof(Msg_queue));
+  if (EXPECT_FALSE(!quota))
+    return 0;
+
+  void *nq = allocator()->alloc();
+  if (EXPECT_FALSE(!nq))
+    return 0;
+
+  quota.release();
+  return new (nq) Msg_queue(q, slots, slot_size);
+}
+
+PUBLIC
+void
+Msg_queue::operator delete (void *_q)
+{
+  Msg_queue *mq = (Msg_queue*)_q;
+  Ram_quota *p = mq->_quota;
+
+  allocator()->free(mq);
+  if (p)
+    p->free(sizeof(Msg_queue));
+}
+
+PUBLIC
+void
+Msg_queue::destroy(Kobject ***rl)
+{
+  Kobject::destroy(rl);
+  for (unsigned i = 0; i < Num_ends; ++i)
+    _end[i].free(_end[i].thread(), rl);
+}
+
+PRIVATE
+L4_msg_tag
+Msg_queue::sys_attach(Msg_queue_end *e, L4_msg_tag const &tag,
+                      Utcb const *utcb, Space *space)
+{
+  L4_snd_item_iter snd_items(utcb, tag.words());
+
+  if (EXPECT_FALSE(tag.words() < 3 || !tag.items() || !snd_items.next()))
+    return commit_result(-L4_err::EInval);
+
+  L4_fpage bind_thread(snd_items.get()->d);
+  if (EXPECT_FALSE(!bind_thread.is_objpage()))
+    return commit_error(utcb, L4_error::Overflow);
+
+  Thread *t = Kobject::dcast<Thread_object*>(space->lookup_local(bind_thread.obj_index()));
+  if (EXPECT_FALSE(!t))
+    return commit_result(-L4_err::EInval);
+
+  if (!e->alloc(t, utcb->values[2]))
+    return commit_result(-L4_err::EBusy);
+
+  return commit_result(0);
+}
+
+PRIVATE
+L4_msg_tag
+Msg_queue::sys_detach(Msg_queue_end *e)
+{
+  Reap_list rl;
+  if (!e->free(e->thread(), rl.list()))
+    return commit_result(-L4_err::ENoent);
+
+  cpu_lock.clear();
+  rl.del();
+  cpu_lock.lock();
+  return commit_result(0);
+}
+
+PRIVATE
+L4_msg_tag
+Msg_queue::sys_info(Utcb *out)
+{
+  out->values[0] = _slots;
+  out->values[1] = _slot_size;
+  return commit_result(0, 2);
+}
+
+/**
+ * Wait for a wakeup of end \a e, optionally signalling another end
+ * first.  The wait is a closed receive on the end, so it has the usual
+ * IPC timeout and cancellation semantics.
+ */
+PRIVATE
+void
+Msg_queue::sys_wait(Msg_queue_end *e, L4_obj_ref self, L4_fpage::Rights rights,
+                    Syscall_frame *f, Utcb const *utcb)
+{
+  Thread *ct = current_thread();
+  L4_msg_tag tag = f->tag();
+
+  if (EXPECT_FALSE(!self.have_recv()))
+    {
+      f->tag(commit_result(-L4_err::EInval));
+      return;
+    }
+
+  if (EXPECT_FALSE(e->thread() != ct))
+    {
+      f->tag(commit_result(-L4_err::EPerm));
+      return;
+    }
+
+  // we are about to block anyway, so no need to reschedule here
+  if (tag.words() >= 3 && utcb->values[2] < Num_ends)
+    _end[utcb->values[2]].signal();
+
+  ct->do_ipc(tag, 0, 0, true, e, f->timeout(), f, rights);
+}
+
+PUBLIC
+void
+Msg_queue::invoke(L4_obj_ref self, L4_fpage::Rights rights,
+                  Syscall_frame *f, Utcb *utcb)
+{
+  L4_msg_tag tag = f->tag();
+
+  if (EXPECT_FALSE(!(self.op() & L4_obj_ref::Ipc_send)))
+    {
+      f->tag(commit_result(-L4_err::EInval));
+      return;
+    }
+
+  if (tag.proto() == L4_msg_tag::Label_kobject)
+    {
+      f->tag(kobject_invoke(self, rights, f, utcb, utcb));
+      return;
+    }
+
+  if (EXPECT_FALSE(tag.proto() != L4_msg_tag::Label_msg_queue))
+    {
+      f->tag(commit_result(-L4_err::EBadproto));
+      return;
+    }
+
+  if (EXPECT_FALSE(tag.words() < 1))
+    {
+      f->tag(commit_result(-L4_err::EInval));
+      return;
+    }
+
+  Mword op = utcb->values[0];
+  if (op == Op_info)
+    {
+      f->tag(sys_info(utcb));
+      return;
+    }
+
+  if (EXPECT_FALSE(tag.words() < 2 || utcb->values[1] >= Num_ends))
+    {
+      f->tag(commit_result(-L4_err::EInval));
+      return;
+    }
+
+  Msg_queue_end *e = &_end[utcb->values[1]];
+
+  switch (op)
+    {
+    case Op_attach:
+      f->tag(sys_attach(e, tag, utcb, current()->space()));
+      return;
+    case Op_detach:
+      f->tag(sys_detach(e));
+      return;
+    case Op_signal:
+      f->tag(commit_result(0));
+      current()->schedule_if(e->signal());
+      return;
+    case Op_wait:
+      sys_wait(e, self, rights, f, utcb);
+      return;
+    default:
+      f->tag(commit_result(-L4_err::ENosys));
+      return;
+    }
+}
@@ -77,10 +77,15 @@ namespace Obj {
 
   protected:
     Mword _flags : 8;
-    Mword _pad   : 24;
+    /// Page frame of the cap page holding this entry, used to get from the
+    /// virtually mapped cap table of the current space to the kernel
+    /// address of the entry.
+    Mword _page  : sizeof(Mword) * 8 - 8;
 
   public:
     Mapping() : _flags(0) {}
+    Mword page() const { return _page; }
+    void set_page(Mword pfn) { _page = pfn; }
     // fake this really badly
     Mapping *parent() { return this; }
     Mword delete_rights() const { return _flags & Delete; }
@@ -31,12 +31,6 @@ public:
 private:
   enum
   {
-    // do not use the virtually mapped cap table in
-    // v_lookup and v_insert, because the map logic needs the kernel
-    // address for link pointers in the map-nodes and these addresses must
-    // be valid in all address spaces.
-    Optimize_local = 0,
-
     Whole_space = 20,
     Map_max_address = 1UL << 20, /* 20bit obj index */
   };
@@ -76,6 +70,44 @@ Obj_space_virt<SPACE>::get_cap(Cap_index index)
   return reinterpret_cast<Entry*>(Mem_layout::phys_to_pmem(phys));
 }
 
+/**
+ * Get the kernel address of a cap-table entry of the current space.
+ *
+ * The map logic needs the kernel address for the link pointers in the
+ * map-nodes, because these must be valid in all address spaces.  Every
+ * entry carries the page frame of its cap page, so the kernel address
+ * comes from reading the virtually mapped entry instead of walking the
+ * page table as get_cap() does.
+ */
+PRIVATE template< typename SPACE >
+static inline NEEDS["mem_layout.h", Obj_space_virt::cap_virt]
+typename Obj_space_virt<SPACE>::Entry *
+Obj_space_virt<SPACE>::get_cap_local(Cap_index index)
+{
+  Entry *c = cap_virt(index);
+  Capability cap;
+  if (EXPECT_FALSE(!Mem_layout::read_special_safe((Capability*)c, cap)))
+    return 0;
+
+  // the cap page is mapped, so the rest of the entry can be read directly
+  Address offs = Address(c) & (Config::PAGE_SIZE - 1);
+  return reinterpret_cast<Entry*>(Mem_layout::phys_to_pmem(c->page()
+                                                           << Config::PAGE_SHIFT)
+                                  + offs);
+}
+
+PRIVATE template< typename SPACE >
+inline NEEDS["mem_space.h", Obj_space_virt::get_cap,
+             Obj_space_virt::get_cap_local]
+typename Obj_space_virt<SPACE>::Entry *
+Obj_space_virt<SPACE>::get_cap_fast(Cap_index index)
+{
+  if (SPACE::mem_space(this) == Mem_space::current_mem_space(current_cpu()))
+    return get_cap_local(index);
+
+  return get_cap(index);
+}
+
 PRIVATE  template< typename SPACE >
 /*inline NEEDS["kmem_alloc.h", <cstring>, "ram_quota.h",
                      Obj_space_virt::cap_virt]*/
@@ -92,9 +124,14 @@ Obj_space_virt<SPACE>::caps_alloc(Cap_index virt)
 
   Mem::memset_mwords(mem, 0, Config::PAGE_SIZE / sizeof(Mword));
 
+  Address pa = Mem_space::kernel_space()->virt_to_phys((Address)mem);
+  for (Entry *e = reinterpret_cast<Entry*>(mem);
+       e < reinterpret_cast<Entry*>(mem) + Obj::Caps_per_page; ++e)
+    e->set_page(pa >> Config::PAGE_SHIFT);
+
   Mem_space::Status s;
   s = SPACE::mem_space(this)->v_insert(
-      Mem_space::Phys_addr(Mem_space::kernel_space()->virt_to_phys((Address)mem)),
+      Mem_space::Phys_addr(pa),
       cxx::mask_lsb(Virt_addr(cv), Mem_space::Page_order(Config::PAGE_SHIFT)),
       Mem_space::Page_order(Config::PAGE_SHIFT),
       Mem_space::Attr(L4_fpage::Rights::RW()));
@@ -155,19 +192,13 @@ Obj_space_virt<SPACE>::caps_free()
 //
 
 IMPLEMENT  template< typename SPACE >
-inline  NEEDS[Obj_space_virt::cap_virt, Obj_space_virt::get_cap]
+inline  NEEDS[Obj_space_virt::get_cap_fast]
 bool FIASCO_FLATTEN
 Obj_space_virt<SPACE>::v_lookup(V_pfn const &virt, Phys_addr *phys,
                                    Page_order *size, Attr *attribs)
 {
   if (size) *size = Order(0);
-  Entry *cap;
-
-  if (Optimize_local
-      && SPACE::mem_space(this) == Mem_space::current_mem_space(current_cpu()))
-    cap = cap_virt(virt);
-  else
-    cap = get_cap(virt);
+  Entry *cap = get_cap_fast(virt);
 
   if (EXPECT_FALSE(!cap))
     {
@@ -175,23 +206,11 @@ Obj_space_virt<SPACE>::v_lookup(V_pfn const &virt, Phys_addr *phys,
       return false;
     }
 
-  if (Optimize_local)
-    {
-      Capability c = Mem_layout::read_special_safe((Capability*)cap);
-
-      if (phys) *phys = c.obj();
-      if (c.valid() && attribs)
-        *attribs = Attr(c.rights());
-      return c.valid();
-    }
-  else
-    {
-      Obj::set_entry(virt, cap);
-      if (phys) *phys = cap->obj();
-      if (cap->valid() && attribs)
-        *attribs = Attr(cap->rights());
-      return cap->valid();
-    }
+  Obj::set_entry(virt, cap);
+  if (phys) *phys = cap->obj();
+  if (cap->valid() && attribs)
+    *attribs = Attr(cap->rights());
+  return cap->valid();
 }
 
 IMPLEMENT template< typename SPACE >
@@ -227,7 +246,7 @@ Obj_space_virt<SPACE>::lookup_local(Cap_index virt, L4_fpage::Rights *rights)
 
 
 IMPLEMENT template< typename SPACE >
-inline NEEDS[<cassert>, Obj_space_virt::cap_virt, Obj_space_virt::get_cap]
+inline NEEDS[<cassert>, Obj_space_virt::get_cap_fast]
 L4_fpage::Rights FIASCO_FLATTEN
 Obj_space_virt<SPACE>::v_delete(V_pfn virt, Order size,
                                    L4_fpage::Rights page_attribs)
@@ -235,20 +254,7 @@ Obj_space_virt<SPACE>::v_delete(V_pfn virt, Order size,
   (void)size;
   assert (size == Order(0));
 
-  Entry *c;
-  if (Optimize_local
-      && SPACE::mem_space(this) == Mem_space::current_mem_space(current_cpu()))
-    {
-      c = cap_virt(virt);
-      if (!c)
-	return L4_fpage::Rights(0);
-
-      Capability cap = Mem_layout::read_special_safe((Capability*)c);
-      if (!cap.valid())
-	return L4_fpage::Rights(0);
-    }
-  else
-    c = get_cap(virt);
+  Entry *c = get_cap_fast(virt);
 
   if (c && c->valid())
     {
@@ -262,8 +268,8 @@ Obj_space_virt<SPACE>::v_delete(V_pfn virt, Order size,
 }
 
 IMPLEMENT  template< typename SPACE >
-inline NEEDS[Obj_space_virt::cap_virt, Obj_space_virt::caps_alloc,
-             Obj_space_virt::get_cap, "kdb_ke.h"]
+inline NEEDS[Obj_space_virt::caps_alloc, Obj_space_virt::get_cap_fast,
+             "kdb_ke.h"]
 typename Obj::Insert_result FIASCO_FLATTEN
 Obj_space_virt<SPACE>::v_insert(Phys_addr phys, V_pfn const &virt, Order size,
                                 Attr page_attribs)
@@ -271,27 +277,10 @@ Obj_space_virt<SPACE>::v_insert(Phys_addr phys, V_pfn const &virt, Order size,
   (void)size;
   assert (size == Order(0));
 
-  Entry *c;
-
-  if (Optimize_local
-      && SPACE::mem_space(this) == Mem_space::current_mem_space(current_cpu()))
-    {
-      c = cap_virt(virt);
-      if (!c)
-	return Obj::Insert_err_nomem;
-
-      Capability cap;
-      if (!Mem_layout::read_special_safe((Capability*)c, cap)
-	  && !caps_alloc(virt))
-	return Obj::Insert_err_nomem;
-    }
-  else
-    {
-      c = get_cap(virt);
-      if (!c && !(c = caps_alloc(virt)))
-	return Obj::Insert_err_nomem;
-      Obj::set_entry(virt, c);
-    }
+  Entry *c = get_cap_fast(virt);
+  if (!c && !(c = caps_alloc(virt)))
+    return Obj::Insert_err_nomem;
+  Obj::set_entry(virt, c);
 
   if (c->valid())
     {
@@ -0,0 +1,232 @@
+INTERFACE:
+
+#include "types.h"
+
+class Context;
+class Trap_state;
+
+/**
+ * \brief Statistical profiler.
+ *
+ * Records the interrupted instruction pointer together with the current
+ * thread and address space, either every n-th timer tick or on overflow
+ * of a performance counter.  The samples are "Profile samples" entries
+ * in the trace buffer, so user level drains them from the per-CPU
+ * segments of the trace buffer (see Tracebuffer_stream) and symbolizes
+ * them.  The log event has to be switched on for samples to be recorded.
+ *
+ * Each CPU picks up a new configuration with its next timer tick, so the
+ * performance counters are always programmed by their own CPU.
+ */
+class Perf_sampler
+{
+public:
+  enum Source
+  {
+    Off    = 0,
+    Timer  = 1, ///< every period-th timer tick
+    Cycles = 2, ///< every period unhalted CPU cycles, needs a PMC
+  };
+
+  enum Flags
+  {
+    Kernel_ip = 1, ///< ip is a kernel address, 0 if unknown
+    Entry_ip  = 2, ///< ip is the user ip of the last kernel entry
+  };
+};
+
+//---------------------------------------------------------------------------
+INTERFACE [debug]:
+
+#include "per_cpu_data.h"
+#include "tb_entry.h"
+
+class Space;
+
+EXTENSION class Perf_sampler
+{
+public:
+  struct Log : public Tb_entry
+  {
+    Address ip;
+    Space *space;
+    Mword flags;
+    void print(String_buffer *) const;
+  };
+
+private:
+  struct Cpu_state
+  {
+    Mword generation; ///< configuration the CPU is programmed for
+    Mword ticks;      ///< timer ticks until the next sample
+    Mword cycles;     ///< sample counter is armed on this CPU
+  };
+
+  static Source _source;
+  static Mword _period;
+  static Mword _generation;
+  static Per_cpu<Cpu_state> _cpu;
+};
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION [!debug]:
+
+PUBLIC static inline
+void
+Perf_sampler::timer_tick(Context *)
+{}
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION [debug]:
+
+#include "context.h"
+#include "entry_frame.h"
+#include "kernel_task.h"
+#include "l4_error.h"
+#include "logdefs.h"
+#include "mem.h"
+#include "string_buffer.h"
+
+Perf_sampler::Source Perf_sampler::_source;
+Mword Perf_sampler::_period;
+Mword Perf_sampler::_generation;
+DEFINE_PER_CPU Per_cpu<Perf_sampler::Cpu_state> Perf_sampler::_cpu;
+
+IMPLEMENT
+void
+Perf_sampler::Log::print(String_buffer *buf) const
+{
+  buf->printf("%s ip=" L4_PTR_FMT " space=%p",
+              flags & Kernel_ip ? "kern" : "user", ip, space);
+}
+
+/**
+ * Start sampling or switch it off.
+ * \param src     Sample source.
+ * \param period  Timer ticks or cycles between two samples.
+ * \return 0 on success, -L4_err::ENosys if the source is not available
+ *         on this CPU, -L4_err::EInval for a bad period.
+ */
+PUBLIC static
+int
+Perf_sampler::start(Source src, Mword period)
+{
+  switch (src)
+    {
+    case Off:
+      period = 0;
+      break;
+    case Timer:
+      if (!period)
+        return -L4_err::EInval;
+      break;
+    case Cycles:
+      // the counters take 31 bits of the negated period
+      if (!period || period > 0x7fffffff)
+        return -L4_err::EInval;
+      if (!arch_cycles_supported())
+        return -L4_err::ENosys;
+      break;
+    default:
+      return -L4_err::EInval;
+    }
+
+  write_now(&_source, src);
+  write_now(&_period, period);
+  Mem::mp_wmb();
+  write_now(&_generation, _generation + 1);
+  return 0;
+}
+
+PUBLIC static inline
+Perf_sampler::Source
+Perf_sampler::source()
+{ return access_once(&_source); }
+
+PUBLIC static inline
+Mword
+Perf_sampler::period()
+{ return access_once(&_period); }
+
+/**
+ * Record one sample.
+ * \param c      Interrupted context.
+ * \param ip     Sampled instruction pointer.
+ * \param flags  See Flags.
+ */
+PUBLIC static
+void
+Perf_sampler::sample(Context *c, Address ip, Mword flags)
+{
+  LOG_TRACE("Profile samples", "prof", c, Log,
+    l->ip = ip;
+    l->space = c->space();
+    l->flags = flags);
+}
+
+PRIVATE static
+void
+Perf_sampler::sync_cpu(Cpu_state *s)
+{
+  Mword gen = access_once(&_generation);
+  Mem::mp_rmb();
+  s->generation = gen;
+  s->ticks = _period;
+  if (_source == Cycles)
+    {
+      s->cycles = 1;
+      arch_setup_cpu(_period);
+    }
+  else if (s->cycles)
+    {
+      arch_setup_cpu(0);
+      s->cycles = 0;
+    }
+}
+
+/**
+ * Per-CPU part of the sampler, called from the timer interrupt.
+ */
+PUBLIC static
+void
+Perf_sampler::timer_tick(Context *c)
+{
+  Cpu_state *s = &_cpu.current();
+  if (EXPECT_FALSE(s->generation != access_once(&_generation)))
+    sync_cpu(s);
+
+  if (EXPECT_TRUE(_source != Timer) || --s->ticks)
+    return;
+
+  s->ticks = _period;
+  if (c->space() == Kernel_task::kernel_task())
+    // the idle thread and other kernel threads have no user state
+    sample(c, 0, Kernel_ip);
+  else
+    sample(c, c->regs()->ip(), Entry_ip);
+}
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION [!(debug && perf_cnt && (ia32 || amd64))]:
+
+/**
+ * Handle an NMI raised by the sample counter.
+ * \return true if the NMI was a sample and is done with.
+ */
+PUBLIC static inline
+bool
+Perf_sampler::nmi(Trap_state *)
+{ return false; }
+
+//---------------------------------------------------------------------------
+IMPLEMENTATION [debug && !(perf_cnt && (ia32 || amd64))]:
+
+PRIVATE static inline
+bool
+Perf_sampler::arch_cycles_supported()
+{ return false; }
+
+PRIVATE static inline
+void
+Perf_sampler::arch_setup_cpu(Mword)
+{}
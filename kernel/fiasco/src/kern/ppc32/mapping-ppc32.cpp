@@ -2,6 +2,7 @@ INTERFACE [ppc32]:
 
 #include "types.h"
 class Treemap;
+class Mapping;
 
 class Mapping_entry
 {
@@ -16,8 +17,10 @@ public:
       unsigned long address:20;	///< Virtual address in address space
     } __attribute__((packed)) data;
     Treemap *_submap;
+    Mapping *_link;
   };
   Unsigned8 _depth;
+  Unsigned8 _hint;	///< Offset hint to the root entry (see Mapping_tree)
   void set_space(Space *s) { data._space = (unsigned long)s; }
   Space *space() const { return (Space *)data._space; }
 };
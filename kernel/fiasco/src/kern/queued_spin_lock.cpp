@@ -0,0 +1,528 @@
+INTERFACE:
+
+#include "spin_lock.h"
+
+//--------------------------------------------------------------------------
+INTERFACE [lock_stats]:
+
+/**
+ * \brief Contention statistics of a single fair spin lock.
+ *
+ * The counters are only updated by the current holder of the lock and
+ * therefore need no atomic operations.  Locks with a name given by
+ * Queued_spin_lock_base::register_stats() are listed in JDB.
+ */
+class Spin_lock_stats
+{
+public:
+  char const *name;
+  char const *what;
+  Spin_lock_stats *next;
+
+  Mword acquisitions;
+  Mword contended;       ///< Acquisitions that had to wait
+  Unsigned64 spins;      ///< Iterations of the wait loops
+  Unsigned64 total_hold; ///< Sum of all hold times in TSC ticks
+  Unsigned64 max_hold;   ///< Longest hold time in TSC ticks
+  Unsigned64 hold_start;
+
+  static Spin_lock_stats *list;
+};
+
+//--------------------------------------------------------------------------
+INTERFACE:
+
+/**
+ * \brief Common part of the fair spin locks.
+ *
+ * With CONFIG_LOCK_STATS it also carries the contention statistics of
+ * the lock, see Spin_lock_stats.
+ */
+class Queued_spin_lock_base : public Spin_lock_base
+{
+public:
+  enum { Arch_lock = 2 };
+};
+
+/**
+ * \brief Fair spin lock handing out the lock in ticket order.
+ *
+ * Also disables lock IRQs for the time the lock is held.
+ * A waiter draws a ticket with a single atomic increment and afterwards
+ * only reads the owner field, so the lock is passed on in FIFO order.
+ * Meant for short critical sections.  In the UP case it is in fact just
+ * the Cpu_lock.
+ */
+class Ticket_spin_lock : public Queued_spin_lock_base
+{
+};
+
+/**
+ * \brief MCS queued spin lock.
+ *
+ * Also disables lock IRQs for the time the lock is held.
+ * Each waiter spins on a queue node of its own CPU, so passing on the
+ * lock only touches the cache lines of the old and the new holder.
+ * Meant for hot locks contended by many CPUs.  In the UP case it is in
+ * fact just the Cpu_lock.
+ */
+class Mcs_spin_lock : public Queued_spin_lock_base
+{
+};
+
+//--------------------------------------------------------------------------
+INTERFACE [!mp]:
+
+EXTENSION class Ticket_spin_lock
+{
+public:
+  Ticket_spin_lock() {}
+  explicit Ticket_spin_lock(Lock_init) {}
+  void init() {}
+
+  using Cpu_lock::Status;
+  using Cpu_lock::test;
+  using Cpu_lock::lock;
+  using Cpu_lock::clear;
+  using Cpu_lock::test_and_set;
+  using Cpu_lock::set;
+};
+
+EXTENSION class Mcs_spin_lock
+{
+public:
+  Mcs_spin_lock() {}
+  explicit Mcs_spin_lock(Lock_init) {}
+  void init() {}
+  static void enable_cpu_nodes() {}
+
+  using Cpu_lock::Status;
+  using Cpu_lock::test;
+  using Cpu_lock::lock;
+  using Cpu_lock::clear;
+  using Cpu_lock::test_and_set;
+  using Cpu_lock::set;
+};
+
+//--------------------------------------------------------------------------
+INTERFACE [mp]:
+
+#include "config.h"
+
+EXTENSION class Ticket_spin_lock
+{
+public:
+  typedef Mword Status;
+  Ticket_spin_lock() {}
+  explicit Ticket_spin_lock(Lock_init) : _next(0), _owner(0) {}
+
+private:
+  Mword _next;  ///< Next ticket to draw
+  Mword _owner; ///< Ticket currently holding the lock
+};
+
+EXTENSION class Mcs_spin_lock
+{
+public:
+  typedef Mword Status;
+  Mcs_spin_lock() {}
+  explicit Mcs_spin_lock(Lock_init) : _tail(0), _holder(0) {}
+
+private:
+  struct Node
+  {
+    Node *next;
+    Mword wait;
+  };
+
+  /**
+   * Queue nodes of one CPU.
+   *
+   * A CPU may hold several MCS locks at a time and release them in any
+   * order, so the nodes are handed out by a bitmap rather than a stack.
+   */
+  struct Cpu_nodes
+  {
+    enum { Max_nested = 4 };
+    Mword used;
+    Node node[Max_nested];
+  } __attribute__((aligned(64)));
+
+  static Cpu_nodes _nodes[Config::Max_num_cpus];
+
+  /// Node of all MCS locks until the boot CPU runs on its kernel thread
+  static Node _boot_node;
+  static bool _cpu_nodes;
+
+  Node *_tail;   ///< Last node in the queue, 0 if the lock is free
+  Node *_holder; ///< Node of the current holder
+};
+
+//--------------------------------------------------------------------------
+INTERFACE [lock_stats]:
+
+EXTENSION class Queued_spin_lock_base
+{
+protected:
+  Spin_lock_stats _stats;
+};
+
+//--------------------------------------------------------------------------
+IMPLEMENTATION [!lock_stats]:
+
+/**
+ * Give the lock a name for the lock statistics.
+ *
+ * Only for locks that are never destroyed.  A no-op unless the kernel
+ * is configured with CONFIG_LOCK_STATS.
+ */
+PUBLIC inline
+void
+Queued_spin_lock_base::register_stats(char const *, char const *)
+{}
+
+PROTECTED inline
+void
+Queued_spin_lock_base::init_stats()
+{}
+
+PROTECTED inline
+void
+Queued_spin_lock_base::acquired(Mword)
+{}
+
+PROTECTED inline
+void
+Queued_spin_lock_base::released()
+{}
+
+//--------------------------------------------------------------------------
+IMPLEMENTATION [lock_stats]:
+
+#include <cassert>
+#include "atomic.h"
+#include "cpu.h"
+
+Spin_lock_stats *Spin_lock_stats::list;
+
+PROTECTED inline
+void
+Queued_spin_lock_base::init_stats()
+{
+  _stats.name = 0;
+  _stats.acquisitions = _stats.contended = 0;
+  _stats.spins = _stats.total_hold = _stats.max_hold = 0;
+}
+
+PUBLIC
+void
+Queued_spin_lock_base::register_stats(char const *name, char const *what)
+{
+  assert (!_stats.name);
+  _stats.name = name;
+  _stats.what = what;
+
+  Spin_lock_stats *n;
+  do
+    {
+      n = access_once(&Spin_lock_stats::list);
+      _stats.next = n;
+    }
+  while (!mp_cas(&Spin_lock_stats::list, n, &_stats));
+}
+
+PROTECTED
+void
+Queued_spin_lock_base::acquired(Mword spins)
+{
+  ++_stats.acquisitions;
+  if (spins)
+    {
+      ++_stats.contended;
+      _stats.spins += spins;
+    }
+  _stats.hold_start = Cpu::rdtsc();
+}
+
+PROTECTED
+void
+Queued_spin_lock_base::released()
+{
+  Unsigned64 d = Cpu::rdtsc() - _stats.hold_start;
+  _stats.total_hold += d;
+  if (d > _stats.max_hold)
+    _stats.max_hold = d;
+}
+
+//--------------------------------------------------------------------------
+IMPLEMENTATION [mp && !(ia32 || ux || amd64)]:
+
+#include "atomic.h"
+
+PROTECTED static inline NEEDS["atomic.h"]
+Mword
+Queued_spin_lock_base::fetch_and_inc(Mword *m)
+{
+  Mword o;
+  do
+    o = access_once(m);
+  while (!mp_cas(m, o, o + 1));
+  return o;
+}
+
+//--------------------------------------------------------------------------
+IMPLEMENTATION [mp]:
+
+#include <cassert>
+#include "atomic.h"
+#include "context_base.h"
+#include "mem.h"
+#include "panic.h"
+#include "processor.h"
+
+Mcs_spin_lock::Cpu_nodes Mcs_spin_lock::_nodes[Config::Max_num_cpus];
+Mcs_spin_lock::Node Mcs_spin_lock::_boot_node;
+bool Mcs_spin_lock::_cpu_nodes;
+
+PUBLIC inline
+void
+Ticket_spin_lock::init()
+{
+  _next = 0;
+  _owner = 0;
+  init_stats();
+}
+
+PUBLIC inline
+Ticket_spin_lock::Status
+Ticket_spin_lock::test() const
+{
+  return (!!cpu_lock.test())
+         | (access_once(&_next) != access_once(&_owner) ? Arch_lock : 0);
+}
+
+PRIVATE inline NEEDS[Queued_spin_lock_base::fetch_and_inc, "processor.h"]
+void
+Ticket_spin_lock::lock_arch()
+{
+  Mword ticket = fetch_and_inc(&_next);
+  Mword spins = 0;
+  while (access_once(&_owner) != ticket)
+    {
+      Proc::pause();
+      ++spins;
+    }
+  acquired(spins);
+}
+
+PRIVATE inline
+void
+Ticket_spin_lock::unlock_arch()
+{
+  // only the holder writes _owner
+  write_now(&_owner, _owner + 1);
+}
+
+PUBLIC inline NEEDS[<cassert>, Ticket_spin_lock::lock_arch, "mem.h"]
+void
+Ticket_spin_lock::lock()
+{
+  assert(!cpu_lock.test());
+  cpu_lock.lock();
+  lock_arch();
+  Mem::mp_mb();
+}
+
+PUBLIC inline NEEDS[Ticket_spin_lock::unlock_arch, "mem.h"]
+void
+Ticket_spin_lock::clear()
+{
+  released();
+  Mem::mp_mb();
+  unlock_arch();
+  Cpu_lock::clear();
+}
+
+PUBLIC inline NEEDS[Ticket_spin_lock::lock_arch, "mem.h"]
+Ticket_spin_lock::Status
+Ticket_spin_lock::test_and_set()
+{
+  Status s = !!cpu_lock.test();
+  cpu_lock.lock();
+  lock_arch();
+  Mem::mp_mb();
+  return s;
+}
+
+PUBLIC inline NEEDS[Ticket_spin_lock::unlock_arch, "mem.h"]
+void
+Ticket_spin_lock::set(Status s)
+{
+  if (!(s & Arch_lock))
+    {
+      released();
+      Mem::mp_mb();
+      unlock_arch();
+    }
+
+  if (!(s & 1))
+    cpu_lock.clear();
+}
+
+
+PUBLIC inline
+void
+Mcs_spin_lock::init()
+{
+  _tail = 0;
+  _holder = 0;
+  init_stats();
+}
+
+PUBLIC inline
+Mcs_spin_lock::Status
+Mcs_spin_lock::test() const
+{
+  return (!!cpu_lock.test()) | (access_once(&_tail) ? Arch_lock : 0);
+}
+
+/**
+ * Switch all MCS locks to the per-CPU queue nodes.  Before, during early
+ * boot, current_cpu() may not be valid yet; but then only the boot CPU
+ * runs and the locks are never contended, so they share _boot_node.
+ * Called by the boot CPU on its kernel thread, before the APs start.
+ */
+PUBLIC static inline
+void
+Mcs_spin_lock::enable_cpu_nodes()
+{ _cpu_nodes = true; }
+
+PRIVATE static inline NEEDS["config.h", "context_base.h", "panic.h"]
+Mcs_spin_lock::Node *
+Mcs_spin_lock::alloc_node()
+{
+  if (EXPECT_FALSE(!_cpu_nodes))
+    return &_boot_node;
+
+  unsigned cpu = cxx::int_value<Cpu_number>(current_cpu());
+  if (EXPECT_FALSE(cpu >= Config::Max_num_cpus))
+    panic("MCS lock taken on invalid CPU %u", cpu);
+
+  Cpu_nodes &c = _nodes[cpu];
+  unsigned i = 0;
+  while (i < Cpu_nodes::Max_nested && (c.used & (1UL << i)))
+    ++i;
+
+  if (EXPECT_FALSE(i >= Cpu_nodes::Max_nested))
+    panic("more than %d nested MCS locks on CPU %u",
+          (int)Cpu_nodes::Max_nested, cpu);
+
+  c.used |= 1UL << i;
+  return &c.node[i];
+}
+
+PRIVATE static inline NEEDS["context_base.h"]
+void
+Mcs_spin_lock::free_node(Node *n)
+{
+  if (n == &_boot_node)
+    return;
+
+  // we cannot have migrated while holding the lock
+  Cpu_nodes &c = _nodes[cxx::int_value<Cpu_number>(current_cpu())];
+  c.used &= ~(1UL << (n - c.node));
+}
+
+PRIVATE inline NEEDS[Mcs_spin_lock::alloc_node, "atomic.h", "mem.h",
+                     "processor.h"]
+void
+Mcs_spin_lock::lock_arch()
+{
+  Node *n = alloc_node();
+  n->next = 0;
+  n->wait = 1;
+  // our successor links itself into n->next as soon as it sees n in _tail
+  Mem::mp_wmb();
+
+  Node *prev;
+  do
+    prev = access_once(&_tail);
+  while (!mp_cas(&_tail, prev, n));
+
+  Mword spins = 0;
+  if (prev)
+    {
+      write_now(&prev->next, n);
+      while (access_once(&n->wait))
+        {
+          Proc::pause();
+          ++spins;
+        }
+    }
+
+  _holder = n;
+  acquired(spins);
+}
+
+PRIVATE inline NEEDS[Mcs_spin_lock::free_node, "atomic.h", "processor.h"]
+void
+Mcs_spin_lock::unlock_arch()
+{
+  Node *n = _holder;
+  Node *next = access_once(&n->next);
+  if (!next && !mp_cas<Node *>(&_tail, n, 0))
+    // a successor is just about to link itself to us
+    while (!(next = access_once(&n->next)))
+      Proc::pause();
+
+  if (next)
+    write_now(&next->wait, 0UL);
+
+  free_node(n);
+}
+
+PUBLIC inline NEEDS[<cassert>, Mcs_spin_lock::lock_arch, "mem.h"]
+void
+Mcs_spin_lock::lock()
+{
+  assert(!cpu_lock.test());
+  cpu_lock.lock();
+  lock_arch();
+  Mem::mp_mb();
+}
+
+PUBLIC inline NEEDS[Mcs_spin_lock::unlock_arch, "mem.h"]
+void
+Mcs_spin_lock::clear()
+{
+  released();
+  Mem::mp_mb();
+  unlock_arch();
+  Cpu_lock::clear();
+}
+
+PUBLIC inline NEEDS[Mcs_spin_lock::lock_arch, "mem.h"]
+Mcs_spin_lock::Status
+Mcs_spin_lock::test_and_set()
+{
+  Status s = !!cpu_lock.test();
+  cpu_lock.lock();
+  lock_arch();
+  Mem::mp_mb();
+  return s;
+}
+
+PUBLIC inline NEEDS[Mcs_spin_lock::unlock_arch, "mem.h"]
+void
+Mcs_spin_lock::set(Status s)
+{
+  if (!(s & Arch_lock))
+    {
+      released();
+      Mem::mp_mb();
+      unlock_arch();
+    }
+
+  if (!(s & 1))
+    cpu_lock.clear();
+}
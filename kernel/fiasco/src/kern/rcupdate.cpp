@@ -87,6 +87,7 @@ private:
  */
 class Rcu_data
 {
+  friend class Rcu;
   friend class Jdb_rcupdate;
 public:
 
@@ -101,6 +102,10 @@ public:
   Rcu_list _c;
   Rcu_list _d;
   Cpu_number _cpu;
+
+  long _max_len;              ///< high-water mark of _len
+  unsigned long _invoked;     ///< callbacks invoked so far
+  unsigned long _deferred;    ///< batches cut short by Rcu::Batch_limit
 };
 
 
@@ -122,6 +127,11 @@ private:
 
   Cpu_mask _active_cpus;
 
+  Rcu_batch _expedite_until; ///< kick all CPUs for batches up to this one
+  unsigned long _expedited;  ///< number of expedite requests
+  Unsigned64 _gp_start;      ///< start of the current grace period
+  Unsigned64 _gp_last;       ///< duration of the last grace period
+  Unsigned64 _gp_max;        ///< longest grace period so far
 };
 
 /**
@@ -138,6 +148,14 @@ class Rcu
 public:
   /// The lock to prevent a quiescent state.
   typedef Cpu_lock Lock;
+
+  /**
+   * Maximum number of callbacks invoked per process_callbacks() call.
+   * The remainder is processed from the per-CPU RCU timeout, so that
+   * tearing down a large task does not stall its CPU for milliseconds.
+   */
+  enum { Batch_limit = 64 };
+
   static Rcu_glbl *rcu() { return &_rcu; }
 private:
   static Rcu_glbl _rcu;
@@ -196,6 +214,8 @@ IMPLEMENTATION:
 #include "mem.h"
 #include "static_init.h"
 #include "timeout.h"
+#include "timer.h"
+#include "ipi.h"
 #include "logdefs.h"
 
 // XXX: includes for debugging
@@ -223,13 +243,17 @@ DEFINE_PER_CPU static Per_cpu<Rcu_timeout> _rcu_timeout;
 PUBLIC
 Rcu_glbl::Rcu_glbl()
 : _current(-300),
-  _completed(-300)
+  _completed(-300),
+  _expedite_until(-300)
 {}
 
 PUBLIC
 Rcu_data::Rcu_data(Cpu_number cpu)
 : _idle(true),
-  _cpu(cpu)
+  _cpu(cpu),
+  _max_len(0),
+  _invoked(0),
+  _deferred(0)
 {}
 
 
@@ -247,34 +271,41 @@ void
 Rcu_data::enqueue(Rcu_item *i)
 {
   _n.enqueue(i);
-  ++_len;
+  if (++_len > _max_len)
+    _max_len = _len;
 }
 
-PRIVATE inline NOEXPORT NEEDS["cpu_lock.h", "lock_guard.h"]
+/**
+ * Invoke at most Rcu::Batch_limit callbacks from the done list.  If
+ * callbacks remain, the per-CPU RCU timeout is armed to continue
+ * right away, without waiting for the next tick.
+ */
+PRIVATE inline NOEXPORT NEEDS["cpu_lock.h", "lock_guard.h", "timer.h"]
 bool
 Rcu_data::do_batch()
 {
   int count = 0;
   bool need_resched = false;
-  for (Rcu_list::Const_iterator l = _d.begin(); l != _d.end();)
+  while (Rcu_item *i = _d.pop_front())
     {
-      Rcu_item *i = *l;
-      ++l;
-
       need_resched |= i->_call_back(i);
-      ++count;
+      if (++count >= Rcu::Batch_limit)
+        break;
     }
 
-  // XXX: I do not know why this and the former stuff is w/o cpu lock
-  //      but the couting needs it?
-  _d.clear();
-
-  // XXX: we use clear, we seemingly worked through the whole list
-  //_d.head(l);
+  // pop_front() does not maintain the tail pointer
+  if (_d.empty())
+    _d.clear();
 
     {
       auto guard = lock_guard(cpu_lock);
       _len -= count;
+      _invoked += count;
+      if (!_d.empty())
+        {
+          ++_deferred;
+          Rcu::schedule_callbacks(_cpu, Timer::system_clock());
+        }
     }
 
   return need_resched;
@@ -291,9 +322,31 @@ Rcu_glbl::start_batch()
       ++_current;
       Mem::mp_mb();
       _cpus = _active_cpus;
+      _gp_start = Timer::system_clock();
+      if (_expedite_until >= _current)
+        kick_cpus();
     }
 }
 
+/**
+ * Make all CPUs that still owe a quiescent state for the current batch
+ * pass through one as soon as possible: other CPUs get a request IPI,
+ * which ends in Rcu::do_pending_work(), the current CPU arms its RCU
+ * timeout.
+ */
+PRIVATE
+void
+Rcu_glbl::kick_cpus()
+{
+  Cpu_number self = current_cpu();
+  for (Cpu_number c = Cpu_number::first(); c < Config::max_num_cpus(); ++c)
+    if (c != self && _cpus.get(c))
+      Ipi::send(Ipi::Request, self, c);
+
+  if (_cpus.get(self))
+    Rcu::schedule_callbacks(self, Timer::system_clock());
+}
+
 PUBLIC
 void
 Rcu_data::enter_idle(Rcu_glbl *rgp)
@@ -345,6 +398,10 @@ Rcu_glbl::cpu_quiet(Cpu_number cpu)
   _cpus.clear(cpu);
   if (_cpus.empty())
     {
+      _gp_last = Timer::system_clock() - _gp_start;
+      if (_gp_last > _gp_max)
+        _gp_max = _gp_last;
+
       _completed = _current;
       start_batch();
     }
@@ -398,6 +455,44 @@ Rcu::call(Rcu_item *i, bool (*cb)(Rcu_item *))
   rdp->enqueue(i);
 }
 
+/**
+ * Expedite the grace periods for all callbacks queued so far.
+ *
+ * Instead of waiting for each CPU to pass a quiescent state on its own
+ * (typically on the next timer tick), all CPUs that hold up the
+ * current grace period and the one after it are interrupted.  Use this
+ * for latency-sensitive object deletion only, it costs an IPI per CPU
+ * and grace period.
+ */
+PUBLIC static
+void
+Rcu::expedite()
+{
+  auto guard = lock_guard(cpu_lock);
+  Rcu_glbl *rgp = rcu();
+
+  _rcu_data.current().start_next_batch(rgp);
+
+  auto g = lock_guard(rgp->_lock);
+  ++rgp->_expedited;
+  // our callbacks are in the current batch or, if another batch is in
+  // flight, in the one after that
+  rgp->_expedite_until = rgp->_current + 2;
+  if (rgp->_current != rgp->_completed)
+    rgp->kick_cpus();
+}
+
+/**
+ * Like Rcu::call(), with an expedited grace period.
+ */
+PUBLIC static
+void
+Rcu::call_expedited(Rcu_item *i, bool (*cb)(Rcu_item *))
+{
+  call(i, cb);
+  expedite();
+}
+
 PRIVATE
 void
 Rcu_data::move_batch(Rcu_list &l)
@@ -427,18 +522,14 @@ Rcu_data::~Rcu_data()
   current_rdp->move_batch(_d);
 }
 
-PUBLIC
-bool FIASCO_WARN_RESULT
-Rcu_data::process_callbacks(Rcu_glbl *rgp)
+/**
+ * Move new callbacks into the current list and request a grace period
+ * for them, unless the current list still waits for one.
+ */
+PRIVATE
+void
+Rcu_data::start_next_batch(Rcu_glbl *rgp)
 {
-  LOG_TRACE("Rcu callbacks", "rcu", ::current(), Rcu::Log_rcu,
-      l->cpu = _cpu;
-      l->item = 0;
-      l->event = Rcu::Rcu_process);
-
-  if (!_c.empty() && rgp->_completed >= _batch)
-    _d.append(_c);
-
   if (!_n.empty() && _c.empty())
     {
 	{
@@ -459,7 +550,21 @@ Rcu_data::process_callbacks(Rcu_glbl *rgp)
 	  rgp->start_batch();
 	}
     }
+}
+
+PUBLIC
+bool FIASCO_WARN_RESULT
+Rcu_data::process_callbacks(Rcu_glbl *rgp)
+{
+  LOG_TRACE("Rcu callbacks", "rcu", ::current(), Rcu::Log_rcu,
+      l->cpu = _cpu;
+      l->item = 0;
+      l->event = Rcu::Rcu_process);
+
+  if (!_c.empty() && rgp->_completed >= _batch)
+    _d.append(_c);
 
+  start_next_batch(rgp);
   check_quiescent_state(rgp);
   if (!_d.empty())
     return do_batch();
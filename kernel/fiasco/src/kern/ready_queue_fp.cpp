@@ -23,7 +23,21 @@ class Ready_queue_fp
 
 private:
   typedef typename E::Fp_list List;
-  unsigned prio_highest;
+
+  enum
+  {
+    Prio_word_shift = 6,
+    Prio_word_bits  = 1 << Prio_word_shift,
+    Prio_words      = 256 / Prio_word_bits,
+  };
+
+  /**
+   * Two-level bitmap of non-empty priority lists: bit `p % 64` of
+   * `_prio_map[p / 64]` is set iff `prio_next[p]` is not empty, and bit
+   * `w` of `_prio_summary` is set iff `_prio_map[w]` is not zero.
+   */
+  Unsigned64 _prio_map[Prio_words];
+  unsigned _prio_summary;
   List prio_next[256];
 
 public:
@@ -46,11 +60,66 @@ IMPLEMENTATION [sched_fixed_prio || sched_fp_wfq]:
 #include "config.h"
 
 
+/**
+ * Highest priority with a non-empty ready list, 0 if all lists are empty.
+ */
+PUBLIC inline
+template<typename E>
+unsigned
+Ready_queue_fp<E>::prio_highest() const
+{
+  if (EXPECT_FALSE(!_prio_summary))
+    return 0;
+
+  unsigned w = sizeof(unsigned) * 8 - 1 - __builtin_clz(_prio_summary);
+  return (w << Prio_word_shift) + 63 - __builtin_clzll(_prio_map[w]);
+}
+
+/**
+ * Word `w` of the non-empty priority bitmap (priorities 64*w .. 64*w+63).
+ */
+PUBLIC inline
+template<typename E>
+Unsigned64
+Ready_queue_fp<E>::prio_map(unsigned w) const
+{ return _prio_map[w]; }
+
+/**
+ * Summary of the non-empty priority bitmap: bit `w` is set iff
+ * prio_map(w) is not zero.
+ */
+PUBLIC inline
+template<typename E>
+unsigned
+Ready_queue_fp<E>::prio_summary() const
+{ return _prio_summary; }
+
+PRIVATE inline
+template<typename E>
+void
+Ready_queue_fp<E>::mark_prio(unsigned prio)
+{
+  unsigned w = prio >> Prio_word_shift;
+  _prio_map[w] |= Unsigned64(1) << (prio & (Prio_word_bits - 1));
+  _prio_summary |= 1U << w;
+}
+
+PRIVATE inline
+template<typename E>
+void
+Ready_queue_fp<E>::unmark_prio(unsigned prio)
+{
+  unsigned w = prio >> Prio_word_shift;
+  _prio_map[w] &= ~(Unsigned64(1) << (prio & (Prio_word_bits - 1)));
+  if (!_prio_map[w])
+    _prio_summary &= ~(1U << w);
+}
+
 IMPLEMENT inline
 template<typename E>
 E *
 Ready_queue_fp<E>::next_to_run() const
-{ return prio_next[prio_highest].front(); }
+{ return prio_next[prio_highest()].front(); }
 
 /**
  * Enqueue context in ready-list.
@@ -68,9 +137,7 @@ Ready_queue_fp<E>::enqueue(E *i, bool is_current_sched)
 
   unsigned short prio = i->prio();
 
-  if (prio > prio_highest)
-    prio_highest = prio;
-
+  mark_prio(prio);
   prio_next[prio].push(i, is_current_sched ? List::Front : List::Back);
 }
 
@@ -92,8 +159,8 @@ Ready_queue_fp<E>::dequeue(E *i)
 
   prio_next[prio].remove(i);
 
-  while (prio_next[prio_highest].empty() && prio_highest)
-    prio_highest--;
+  if (prio_next[prio].empty())
+    unmark_prio(prio);
 }
 
 
@@ -109,6 +176,23 @@ Ready_queue_fp<E>::requeue(E *i)
 }
 
 
+/**
+ * Enqueue a context of a burst of wakeups, see Ready_queue_wfq::bulk_add().
+ * Enqueueing costs O(1) anyway, so the context is enqueued right away.
+ */
+PUBLIC template<typename E> inline
+E *
+Ready_queue_fp<E>::bulk_add(E *list, E *i)
+{
+  enqueue(i, true);
+  return list;
+}
+
+PUBLIC template<typename E> inline
+void
+Ready_queue_fp<E>::enqueue_bulk(E *)
+{}
+
 PUBLIC template<typename E> inline
 void
 Ready_queue_fp<E>::deblock_refill(E *)
@@ -11,6 +11,17 @@ struct L4_sched_param_wfq : public L4_sched_param
   Mword weight;
 };
 
+/**
+ * Ready queue of the weighted-fair-queueing scheduler.
+ *
+ * The runnable contexts form a pairing heap ordered by deadline: the links
+ * are part of the scheduling contexts, so the queue has no size limit and
+ * never allocates memory.  Insertion and removal of an arbitrary context
+ * are O(1) and O(log n) amortized.  A context in the queue has
+ * `_ready_link` pointing to the pointer that refers to it (the root
+ * pointer, its parent's child pointer, or its left sibling's sibling
+ * pointer).
+ */
 template< typename E >
 class Ready_queue_wfq
 {
@@ -35,13 +46,12 @@ public:
   E *next_to_run() const;
 
 private:
-  void swap(unsigned a, unsigned b);
-  void heap_up(unsigned a);
-  void heap_down(unsigned a);
+  E *meld(E *a, E *b);
+  E *merge_pairs(E *first);
+  void set_root(E *r);
 
   E *_current_sched;
-  unsigned _cnt;
-  E *_heap[1024];
+  E *_root;
 
   static typename E::Wfq_sc *_e(E *e) { return E::wfq_elem(e); }
 };
@@ -77,8 +87,8 @@ template<typename E>
 E *
 Ready_queue_wfq<E>::next_to_run() const
 {
-  if (_cnt)
-    return _heap[0];
+  if (_root)
+    return _root;
 
   if (_current_sched)
     _e(idle)->_dl = _e(_current_sched)->_dl;
@@ -86,56 +96,89 @@ Ready_queue_wfq<E>::next_to_run() const
   return idle;
 }
 
+/**
+ * Link two heaps, the one with the later deadline becomes the leftmost
+ * child of the other.
+ * \return the root of the joint heap, its sibling and link are unset.
+ */
 IMPLEMENT inline
 template<typename E>
-void
-Ready_queue_wfq<E>::swap(unsigned a, unsigned b)
+E *
+Ready_queue_wfq<E>::meld(E *a, E *b)
 {
-  _e(_heap[a])->_ready_link = &_heap[b];
-  _e(_heap[b])->_ready_link = &_heap[a];
-  E *s = _heap[a];
-  _heap[a] = _heap[b];
-  _heap[b] = s;
+  if (*_e(b) < *_e(a))
+    {
+      E *t = a;
+      a = b;
+      b = t;
+    }
+
+  E *c = _e(a)->_ready_child;
+  _e(b)->_ready_sibling = c;
+  if (c)
+    _e(c)->_ready_link = &_e(b)->_ready_sibling;
+
+  _e(b)->_ready_link = &_e(a)->_ready_child;
+  _e(b)->_ready_parent = a;
+  _e(a)->_ready_child = b;
+  return a;
 }
 
-IMPLEMENT inline
+/**
+ * Combine a list of heaps linked through `_ready_sibling` into one heap,
+ * pairing them from left to right and melding the pairs from right to left.
+ * \return the root of the resulting heap, its sibling and link are unset.
+ */
+IMPLEMENT
 template<typename E>
-void
-Ready_queue_wfq<E>::heap_up(unsigned a)
+E *
+Ready_queue_wfq<E>::merge_pairs(E *first)
 {
-  for (;a > 0;)
+  if (!first)
+    return 0;
+
+  E *pairs = 0;
+  while (first)
+    {
+      E *a = first;
+      E *b = _e(a)->_ready_sibling;
+      if (!b)
+        {
+          _e(a)->_ready_sibling = pairs;
+          pairs = a;
+          break;
+        }
+
+      first = _e(b)->_ready_sibling;
+      a = meld(a, b);
+      _e(a)->_ready_sibling = pairs;
+      pairs = a;
+    }
+
+  E *r = pairs;
+  pairs = _e(r)->_ready_sibling;
+  while (pairs)
     {
-      unsigned p = (a-1)/2;
-      if (*_e(_heap[p]) < *_e(_heap[a]))
-	return;
-      swap(p, a);
-      a = p;
+      E *n = _e(pairs)->_ready_sibling;
+      r = meld(r, pairs);
+      pairs = n;
     }
+
+  return r;
 }
 
 IMPLEMENT inline
 template<typename E>
 void
-Ready_queue_wfq<E>::heap_down(unsigned a)
+Ready_queue_wfq<E>::set_root(E *r)
 {
-  for (;;)
-    {
-      unsigned c1 = 2*a + 1;
-      unsigned c2 = 2*a + 2;
-
-      if (_cnt <= c1)
-	return;
-
-      if (_cnt > c2 && *_e(_heap[c2]) <= *_e(_heap[c1]))
-	c1 = c2;
-
-      if (*_e(_heap[a]) <= *_e(_heap[c1]))
-	return;
-
-      swap(c1, a);
+  _root = r;
+  if (!r)
+    return;
 
-      a = c1;
-    }
+  _e(r)->_ready_link = &_root;
+  _e(r)->_ready_sibling = 0;
+  _e(r)->_ready_parent = 0;
 }
 
 /**
@@ -152,13 +195,46 @@ Ready_queue_wfq<E>::enqueue(E *i, bool /*is_current_sched**/)
   if (EXPECT_FALSE (i->in_ready_list()))
     return;
 
-  unsigned n = _cnt++;
+  _e(i)->_ready_child = 0;
+  set_root(_root ? meld(_root, i) : i);
+}
+
+/**
+ * Add a context to a list of contexts to be enqueued at once.
+ * \param list  Result of the previous call, 0 for the first one.
+ * \return the new list, to be passed to enqueue_bulk().
+ */
+PUBLIC inline NEEDS ["cpu_lock.h", "kdb_ke.h", "std_macros.h"]
+template<typename E>
+E *
+Ready_queue_wfq<E>::bulk_add(E *list, E *i)
+{
+  assert_kdb(cpu_lock.test());
 
-  E *&h = _heap[n];
-  h = i;
-  _e(i)->_ready_link = &h;
+  if (EXPECT_FALSE (i->in_ready_list()))
+    return list;
 
-  heap_up(n);
+  _e(i)->_ready_link = &_root; // mark as queued, fixed up by meld()
+  _e(i)->_ready_child = 0;
+  _e(i)->_ready_sibling = list;
+  return i;
+}
+
+/**
+ * Enqueue a list of contexts collected with bulk_add().
+ *
+ * The contexts are first combined into a heap of their own that is then
+ * linked into the queue with a single meld, so a burst of wakeups touches
+ * the root only once and leaves a balanced subtree behind.
+ */
+PUBLIC
+template<typename E>
+void
+Ready_queue_wfq<E>::enqueue_bulk(E *list)
+{
+  E *h = merge_pairs(list);
+  if (h)
+    set_root(_root ? meld(_root, h) : h);
 }
 
 /**
@@ -175,31 +251,95 @@ Ready_queue_wfq<E>::dequeue(E *i)
   if (EXPECT_FALSE (!i->in_ready_list() || i == idle))
     return;
 
-  unsigned x = _e(i)->_ready_link - _heap;
-
-  if (x == --_cnt)
+  E *sub = merge_pairs(_e(i)->_ready_child);
+  if (i == _root)
+    set_root(sub);
+  else
     {
-      _e(i)->_ready_link = 0;
-      return;
+      E **l = _e(i)->_ready_link;
+      E *s = _e(i)->_ready_sibling;
+      *l = s;
+      if (s)
+        _e(s)->_ready_link = l;
+
+      if (sub)
+        set_root(meld(_root, sub));
     }
 
-  swap(x, _cnt);
-  heap_down(x);
   _e(i)->_ready_link = 0;
 }
 
 /**
- * Enqueue context in ready-list.
+ * Move context to its place after its deadline changed.
  */
 PUBLIC
 template<typename E>
 void
 Ready_queue_wfq<E>::requeue(E *i)
 {
-  if (!i->in_ready_list())
-    enqueue(i, false);
+  dequeue(i);
+  enqueue(i, false);
+}
+
+/**
+ * Successor of a queued context in pre-order, for the kernel debugger.
+ */
+PUBLIC
+template<typename E>
+E *
+Ready_queue_wfq<E>::iter_next(E *i) const
+{
+  if (_e(i)->_ready_child)
+    return _e(i)->_ready_child;
+
+  for (; i; i = _e(i)->_ready_parent)
+    if (_e(i)->_ready_sibling)
+      return _e(i)->_ready_sibling;
+
+  return 0;
+}
+
+/**
+ * Predecessor of a queued context in pre-order, for the kernel debugger.
+ */
+PUBLIC
+template<typename E>
+E *
+Ready_queue_wfq<E>::iter_prev(E *i) const
+{
+  E *p = _e(i)->_ready_parent;
+  if (!p)
+    return 0;
+
+  E *l = _e(p)->_ready_child;
+  if (l == i)
+    return p;
+
+  while (_e(l)->_ready_sibling != i)
+    l = _e(l)->_ready_sibling;
+
+  return iter_last(l);
+}
+
+/**
+ * Last context of a (sub-)heap in pre-order, for the kernel debugger.
+ */
+PUBLIC
+template<typename E>
+E *
+Ready_queue_wfq<E>::iter_last(E *i) const
+{
+  if (!i)
+    i = _root;
+
+  while (i && _e(i)->_ready_child)
+    {
+      i = _e(i)->_ready_child;
+      while (_e(i)->_ready_sibling)
+        i = _e(i)->_ready_sibling;
+    }
 
-  heap_down(_e(i)->_ready_link - _heap);
+  return i;
 }
 
 
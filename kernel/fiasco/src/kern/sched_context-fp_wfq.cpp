@@ -55,6 +55,9 @@ private:
   struct Wfq_sc : public Sched_context_wfq<Wfq_sc>, public B_sc
   {
     Sched_context **_ready_link;
+    Sched_context *_ready_parent;
+    Sched_context *_ready_child;
+    Sched_context *_ready_sibling;
     bool _idle:1;
     Unsigned64 _dl;
 
@@ -89,6 +92,8 @@ public:
     void enqueue(Sched_context *sc, bool is_current);
     void dequeue(Sched_context *);
     void requeue(Sched_context *sc);
+    Sched_context *bulk_add(Sched_context *list, Sched_context *sc);
+    void enqueue_bulk(Sched_context *list) { wfq_rq.enqueue_bulk(list); }
 
     void set_idle(Sched_context *sc)
     { sc->_t = Wfq; sc->_sc.wfq._p = 0; wfq_rq.set_idle(sc); }
@@ -240,6 +245,17 @@ Sched_context::Ready_queue_base::dequeue(Sched_context *sc)
     wfq_rq.dequeue(sc);
 }
 
+IMPLEMENT inline
+Sched_context *
+Sched_context::Ready_queue_base::bulk_add(Sched_context *list,
+                                          Sched_context *sc)
+{
+  if (sc->_t == Fixed_prio)
+    return fp_rq.bulk_add(list, sc);
+  else
+    return wfq_rq.bulk_add(list, sc);
+}
+
 IMPLEMENT
 void
 Sched_context::Ready_queue_base::requeue(Sched_context *sc)
@@ -36,6 +36,9 @@ private:
   static Sched_context *wfq_elem(Sched_context *x) { return x; }
 
   Sched_context **_ready_link;
+  Sched_context *_ready_parent;
+  Sched_context *_ready_child;
+  Sched_context *_ready_sibling;
   bool _idle:1;
   Unsigned64 _dl;
   Unsigned64 _left;
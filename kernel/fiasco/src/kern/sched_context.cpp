@@ -10,6 +10,8 @@ public:
     void set_current_sched(Sched_context *sched);
     void invalidate_sched() { activate(0); }
     bool deblock(Sched_context *sc, Sched_context *crs, bool lazy_q = false);
+    bool deblock_bulk(Sched_context *sc, Sched_context *crs,
+                      Sched_context **bulk);
     void ready_enqueue(Sched_context *sc)
     {
       assert_kdb(cpu_lock.test());
@@ -48,6 +50,9 @@ public:
     }
 
     Context *schedule_in_progress;
+
+  private:
+    bool deblock_check(Sched_context *sc, Sched_context *crs);
   };
 
   static Per_cpu<Ready_queue> rq;
@@ -97,6 +102,26 @@ Sched_context::Ready_queue::set_current_sched(Sched_context *sched)
 }
 
 
+/**
+ * Refill \a sc for being deblocked and check whether it shall preempt.
+ * \return true if \a sc dominates both the current timeslice and \a crs.
+ */
+IMPLEMENT inline
+bool
+Sched_context::Ready_queue::deblock_check(Sched_context *sc, Sched_context *crs)
+{
+  Sched_context *cs = current_sched();
+  if (sc == cs)
+    return !crs->dominates(sc);
+
+  deblock_refill(sc);
+
+  if ((EXPECT_TRUE(cs != 0) && cs->dominates(sc)) || crs->dominates(sc))
+    return false;
+
+  return true;
+}
+
 /**
  * \param sc Sched_context that shall be deblocked
  * \param crs the Sched_context of the currently running context
@@ -108,21 +133,7 @@ Sched_context::Ready_queue::deblock(Sched_context *sc, Sched_context *crs, bool
 {
   assert_kdb(cpu_lock.test());
 
-  Sched_context *cs = current_sched();
-  bool res = true;
-  if (sc == cs)
-    {
-      if (crs->dominates(sc))
-        res = false;
-    }
-  else
-    {
-      deblock_refill(sc);
-
-      if ((EXPECT_TRUE(cs != 0) && cs->dominates(sc)) || crs->dominates(sc))
-        res = false;
-    }
-
+  bool res = deblock_check(sc, crs);
   if (res && lazy_q)
     return true;
 
@@ -130,6 +141,24 @@ Sched_context::Ready_queue::deblock(Sched_context *sc, Sched_context *crs, bool
   return res;
 }
 
+/**
+ * Like deblock(), but collect \a sc in \a bulk instead of enqueueing it
+ * right away.  The caller passes the collection to enqueue_bulk() once it
+ * has deblocked all contexts of a burst of wakeups.
+ */
+IMPLEMENT inline NEEDS["kdb_ke.h"]
+bool
+Sched_context::Ready_queue::deblock_bulk(Sched_context *sc, Sched_context *crs,
+                                         Sched_context **bulk)
+{
+  assert_kdb(cpu_lock.test());
+
+  bool res = deblock_check(sc, crs);
+  *bulk = bulk_add(*bulk, sc);
+  return res;
+}
+
+
 INTERFACE [debug]:
 
 #include "tb_entry.h"
@@ -22,7 +22,7 @@ INTERFACE:
 #include "obj_space.h"
 #include "spin_lock.h"
 #include "ref_obj.h"
-#include "slab_cache.h"
+#include "kmem_slab.h"
 #include <cxx/slist>
 
 class Ram_quota;
@@ -75,7 +75,7 @@ public:
     void *k_addr;
     unsigned size;
 
-    static Slab_cache *a;
+    static Kmem_slab *a;
 
     void *operator new (size_t, Ram_quota *q) throw()
     { return a->q_alloc(q); }
@@ -54,6 +54,7 @@ IMPLEMENTATION:
 #include "kdb_ke.h"
 #include "kmem.h"
 #include "kmem_slab.h"
+#include "lat_hist.h"
 #include "l4_types.h"
 #include "l4_buf_iter.h"
 #include "logdefs.h"
@@ -66,7 +67,7 @@ IMPLEMENTATION:
 FIASCO_DEFINE_KOBJ(Task);
 
 static Kmem_slab_t<Task::Ku_mem> _k_u_mem_list_alloc("Ku_mem");
-Slab_cache *Space::Ku_mem::a = &_k_u_mem_list_alloc;
+Kmem_slab *Space::Ku_mem::a = &_k_u_mem_list_alloc;
 
 extern "C" void vcpu_resume(Trap_state *, Return_frame *sp)
    FIASCO_FASTCALL FIASCO_NORETURN;
@@ -281,7 +282,7 @@ Task::Task(Ram_quota *q, Mem_space::Dir_type* pdir, Caps c)
 static Kmem_slab_t<Task> _task_allocator("Task");
 
 PROTECTED static
-Slab_cache*
+Kmem_slab *
 Task::allocator()
 { return &_task_allocator; }
 
@@ -355,6 +356,16 @@ Task::destroy(Kobject ***reap_list)
   fpage_unmap(this, L4_fpage::all_spaces(L4_fpage::Rights::FULL()), L4_map_mask::full(), reap_list);
 }
 
+/**
+ * Deleting a task deletes all objects bound to it at once, the thread
+ * deleting it should not wait for the CPUs to pass a grace period on
+ * their next timer ticks.
+ */
+PUBLIC
+bool
+Task::expedite_reap() const
+{ return true; }
+
 PRIVATE inline NOEXPORT
 L4_msg_tag
 Task::sys_map(L4_fpage::Rights rights, Syscall_frame *f, Utcb *utcb)
@@ -445,14 +456,21 @@ Task::sys_unmap(Syscall_frame *f, Utcb *utcb)
 
       L4_map_mask m(utcb->values[1]);
 
-      for (unsigned i = 2; i < words; ++i)
-        {
-          L4_fpage::Rights const flushed
-            = fpage_unmap(this, L4_fpage(utcb->values[i]), m, rl.list());
-
-          utcb->values[i] = (utcb->values[i] & ~0xfUL)
-                          | cxx::int_value<L4_fpage::Rights>(flushed);
-        }
+      {
+        // one TLB shootdown for the whole batch, when tlb goes out of
+        // scope, i.e. before the caller sees the result
+        Mu::Auto_tlb_flush<Mem_space> tlb;
+
+        for (unsigned i = 2; i < words; ++i)
+          {
+            L4_fpage::Rights const flushed
+              = fpage_unmap(this, L4_fpage(utcb->values[i]), m, rl.list(),
+                            tlb);
+
+            utcb->values[i] = (utcb->values[i] & ~0xfUL)
+                            | cxx::int_value<L4_fpage::Rights>(flushed);
+          }
+      }
       cpu_lock.lock();
     }
 
@@ -550,10 +568,16 @@ Task::invoke(L4_obj_ref, L4_fpage::Rights rights, Syscall_frame *f, Utcb *utcb)
   switch (utcb->values[0])
     {
     case Map:
-      f->tag(sys_map(rights, f, utcb));
+        {
+          Lat_hist::Scope lat(Lat_hist::Map);
+          f->tag(sys_map(rights, f, utcb));
+        }
       return;
     case Unmap:
-      f->tag(sys_unmap(f, utcb));
+        {
+          Lat_hist::Scope lat(Lat_hist::Unmap);
+          f->tag(sys_unmap(f, utcb));
+        }
       return;
     case Cap_info:
       f->tag(sys_cap_info(f, utcb));
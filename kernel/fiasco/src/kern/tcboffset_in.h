@@ -62,6 +62,7 @@
 #endif
 #ifdef CONFIG_PF_UX
   DUMP_CONSTANT (MEM_LAYOUT__TRAMPOLINE_PAGE,  Mem_layout::Trampoline_page)
+  DUMP_CONSTANT (MEM_LAYOUT__ENTRY_PAGE,       Mem_layout::Entry_page_user)
 #endif
 #if defined(CONFIG_IA32) || defined(CONFIG_AMD64)
   DUMP_MEMBER1 (CPU, Cpu, tss, TSS)
@@ -122,6 +122,7 @@ IMPLEMENTATION:
 #include "config.h"
 #include "cpu_lock.h"
 #include "ipc_timeout.h"
+#include "lat_hist.h"
 #include "lock_guard.h"
 #include "logdefs.h"
 #include "map_util.h"
@@ -431,6 +432,10 @@ Thread::do_ipc(L4_msg_tag const &tag, bool have_send, Thread *partner,
 
   assert_kdb (!(state() & Thread_ipc_mask));
 
+  Lat_hist::Scope lat(!have_send || !have_receive ? Lat_hist::None
+                      : sender ? Lat_hist::Ipc_call
+                      : Lat_hist::Ipc_reply_wait);
+
   prepare_receive(sender, have_receive ? regs : 0);
   bool activate_partner = false;
   Cpu_number current_cpu = ::current_cpu();
@@ -513,6 +518,10 @@ Thread::do_ipc(L4_msg_tag const &tag, bool have_send, Thread *partner,
       state_add_dirty(Thread_receive_wait);
     }
 
+  // the wait for the next message is not part of a reply's latency
+  if (!sender)
+    lat.stop();
+
   // only do direct switch on closed wait (call) or if we run on a foreign
   // scheduling context
   Sender *next = 0;
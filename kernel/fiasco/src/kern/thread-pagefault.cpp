@@ -6,6 +6,7 @@ IMPLEMENTATION:
 #include "cpu.h"
 #include "kdb_ke.h"
 #include "kmem.h"
+#include "lat_hist.h"
 #include "logdefs.h"
 #include "processor.h"
 #include "std_macros.h"
@@ -28,7 +29,7 @@ IMPLEMENTATION:
  */
 IMPLEMENT inline NEEDS[<cstdio>,"kdb_ke.h","processor.h",
 		       "config.h","std_macros.h","logdefs.h",
-		       "warn.h",Thread::page_fault_log]
+		       "warn.h","lat_hist.h",Thread::page_fault_log]
 int Thread::handle_page_fault(Address pfa, Mword error_code, Mword pc,
                               Return_frame *regs)
 {
@@ -64,6 +65,8 @@ int Thread::handle_page_fault(Address pfa, Mword error_code, Mword pc,
   // Check for page fault in user memory area
   if (EXPECT_TRUE(!Kmem::is_kmem_page_fault(pfa, error_code)))
     {
+      Lat_hist::Scope lat(Lat_hist::Page_fault);
+
       // Make sure that we do not handle page faults that do not
       // belong to this thread.
       //assert_kdb (mem_space() == current_mem_space());
@@ -931,6 +931,10 @@ unsigned Thread::sys_fpage_unmap_log(Syscall_frame *)
 // ----------------------------------------------------------------------------
 IMPLEMENTATION [!mp]:
 
+PUBLIC static inline
+bool
+Thread::poll_remote_requests()
+{ return false; }
 
 PRIVATE inline
 bool
@@ -1038,6 +1042,8 @@ protected:
 IMPLEMENTATION [mp]:
 
 #include "ipi.h"
+#include "mem.h"
+#include "processor.h"
 
 PUBLIC
 void
@@ -1082,8 +1088,73 @@ Thread::handle_remote_requests_irq()
 {
   assert_kdb (cpu_lock.test());
   // printf("CPU[%2u]: > RQ IPI (current=%p)\n", current_cpu(), current());
-  Context *const c = current();
   Ipi::eoi(Ipi::Request, current_cpu());
+  handle_pending_remote_requests();
+}
+
+/**
+ * Spin on the pending-request queue of the current CPU before halting.
+ *
+ * Called by the idle thread with the CPU lock released.  While we spin,
+ * CPUs enqueueing DRQs for us skip the IPI (Context::kick_pending_rqq()).
+ * The spinning is done with IRQs disabled, in slices with a short IRQ
+ * window in between, so that the polling flag is never left set while
+ * some other thread preempted the idle thread.  The spin budget adapts
+ * to the load: it doubles whenever a request arrived while spinning and
+ * halves whenever it ran out.
+ *
+ * \return true if requests were handled, false if the CPU may be halted.
+ */
+PUBLIC static
+bool
+Thread::poll_remote_requests()
+{
+  enum { Slice = 32 };
+  Idle_poll &p = _idle_poll.current();
+  Queue const &q = _pending_rqq.current();
+  auto guard = lock_guard(cpu_lock);
+
+  for (unsigned n = 0; n < p.budget; n += Slice)
+    {
+      write_now(&p.polling, 1UL);
+      Mem::mp_mb();
+
+      for (unsigned i = 0; i < Slice && !q.first(); ++i)
+        {
+          Proc::pause();
+          Mem::barrier();
+        }
+
+      write_now(&p.polling, 0UL);
+      // a sender that saw the flag set did not send an IPI, so look again
+      // after clearing it
+      Mem::mp_mb();
+
+      if (q.first())
+        {
+          if (p.budget < Idle_poll::Max_budget)
+            p.budget *= 2;
+
+          handle_pending_remote_requests();
+          return true;
+        }
+
+      cpu_lock.clear();
+      Proc::irq_chance();
+      cpu_lock.lock();
+    }
+
+  if (p.budget > Idle_poll::Min_budget)
+    p.budget /= 2;
+
+  return false;
+}
+
+PRIVATE static
+void
+Thread::handle_pending_remote_requests()
+{
+  Context *const c = current();
   //LOG_MSG_3VAL(c, "ipi", c->cpu(), (Mword)c, c->drq_pending());
 
   // we might have to migrate the currently running thread, and we cannot do
@@ -13,6 +13,7 @@ class Timeout : public cxx::H_list_item
 {
   friend class Jdb_timeout_list;
   friend class Jdb_list_timeouts;
+  friend class Jdb_kern_info_bench;
   friend class Timeout_q;
 
 public:
@@ -44,16 +45,32 @@ private:
 };
 
 
+/**
+ * Per-CPU timeout queue, a hierarchical timer wheel.
+ *
+ * Level 0 has one slot per tick of (1 << Wheel_tick_shift) us, each
+ * slot of level n covers Wheel_slots slots of level n - 1.  A timeout
+ * is put into the lowest level whose range contains its wakeup tick,
+ * so enqueue and reset are constant-time list operations.  Slots of
+ * the upper levels are cascaded (re-enqueued) into the lower levels
+ * only when the wheel reaches them (lazy cascading).  Timeouts beyond
+ * the range of the top level are parked in its farthest slot.
+ */
 class Timeout_q
 {
+  friend class Jdb_kern_info_bench;
+  friend class Jdb_list_timeouts;
+
 private:
   /**
-   * Timeout queue count (2^n) and  distance between two queues in 2^n.
+   * Wheel geometry in 2^n.
    */
   enum
   {
-    Wakeup_queue_count	  = 8,
-    Wakeup_queue_distance = 12 // i.e. (1<<12)us
+    Wheel_tick_shift = 10, // i.e. (1<<10)us per tick
+    Wheel_slot_shift = 6,  // slots per level
+    Wheel_slots      = 1 << Wheel_slot_shift,
+    Wheel_levels     = 4,
   };
 
   typedef Timeout::To_list To_list;
@@ -61,15 +78,26 @@ private:
   typedef To_list::Const_iterator Const_iterator;
 
   /**
-   * The timeout queues.
+   * The timeout queues, Wheel_slots per level.
+   */
+  To_list _q[Wheel_levels * Wheel_slots];
+
+  /**
+   * Slots that may contain timeouts, one word per level.  Bits are set
+   * on enqueue and only cleared when a slot is found empty, so that
+   * Timeout::reset() stays a plain list operation.
+   */
+  Unsigned64 _used[Wheel_levels];
+
+  /**
+   * The tick the wheel has been advanced to.
    */
-  To_list _q[Wakeup_queue_count];
+  Unsigned64 _tick;
 
   /**
    * The current programmed timeout.
    */
   Unsigned64 _current;
-  Unsigned64 _old_clock;
 
 public:
   static Per_cpu<Timeout_q> timeout_queue;
@@ -92,37 +120,84 @@ IMPLEMENTATION:
 DEFINE_PER_CPU Per_cpu<Timeout_q> Timeout_q::timeout_queue;
 
 
+/**
+ * Advance an empty wheel to `clock` (in us).  Only for queues that are
+ * not driven by the timer interrupt, such as the JDB benchmark's.
+ */
+PUBLIC inline
+void
+Timeout_q::set_tick(Unsigned64 clock)
+{ _tick = clock >> Wheel_tick_shift; }
+
+/**
+ * Timeout queue by index, the queues of all wheel levels are numbered
+ * consecutively.
+ */
 PUBLIC inline
 Timeout_q::To_list &
 Timeout_q::first(int index)
-{ return _q[index & (Wakeup_queue_count-1)]; }
+{ return _q[index & (Wheel_levels * Wheel_slots - 1)]; }
 
 PUBLIC inline
 Timeout_q::To_list const &
 Timeout_q::first(int index) const
-{ return _q[index & (Wakeup_queue_count-1)]; }
+{ return _q[index & (Wheel_levels * Wheel_slots - 1)]; }
+
+PUBLIC inline
+unsigned
+Timeout_q::queues() const { return Wheel_levels * Wheel_slots; }
 
+/**
+ * Wheel level of the queue with the given index.
+ */
 PUBLIC inline
 unsigned
-Timeout_q::queues() const { return Wakeup_queue_count; }
+Timeout_q::level(unsigned index) const
+{ return index >> Wheel_slot_shift; }
+
+PRIVATE static inline
+unsigned
+Timeout_q::slot_index(unsigned level, Unsigned64 tick)
+{ return (tick >> (level * Wheel_slot_shift)) & (Wheel_slots - 1); }
 
+/**
+ * Put a timeout into the wheel slot for its wakeup time relative to
+ * the current wheel tick.
+ */
+PRIVATE inline NEEDS[Timeout_q::slot_index]
+void
+Timeout_q::place(Timeout *to)
+{
+  enum { Span_shift = Wheel_levels * Wheel_slot_shift };
+
+  Unsigned64 tick = to->_wakeup >> Wheel_tick_shift;
+  if (tick < _tick)
+    tick = _tick;
+
+  Unsigned64 delta = tick - _tick;
+  unsigned level = 0;
+  while (level < Wheel_levels - 1
+         && delta >= (1ULL << ((level + 1) * Wheel_slot_shift)))
+    ++level;
+
+  // park timeouts beyond the wheel in the farthest slot of the top
+  // level, they are placed again when this slot is cascaded
+  if (EXPECT_FALSE(delta >> Span_shift))
+    tick = _tick + (1ULL << Span_shift) - 1;
+
+  unsigned idx = slot_index(level, tick);
+  _q[level * Wheel_slots + idx].push_front(to);
+  _used[level] |= 1ULL << idx;
+}
 
 /**
  * Enqueue a new timeout.
  */
-PUBLIC inline NEEDS[Timeout_q::first, "timer.h", "config.h"]
+PUBLIC inline NEEDS[Timeout_q::place, "timer.h", "config.h"]
 void
 Timeout_q::enqueue(Timeout *to)
 {
-  int queue = (to->_wakeup >> Wakeup_queue_distance) & (Wakeup_queue_count-1);
-
-  To_list &q = first(queue);
-  Iterator tmp = q.begin();
-
-  while (tmp != q.end() && tmp->_wakeup < to->_wakeup)
-    ++tmp;
-
-  q.insert_before(to, tmp);
+  place(to);
 
   if (Config::Scheduler_one_shot && (to->_wakeup <= _current))
     {
@@ -262,113 +337,223 @@ Timeout::dequeue(bool is_expired = true)
     return false;
 }
 
+/**
+ * Re-enqueue the timeouts of one slot of an upper wheel level.
+ */
+PRIVATE inline NEEDS[Timeout_q::place]
+void
+Timeout_q::cascade(unsigned level, unsigned idx)
+{
+  To_list &q = _q[level * Wheel_slots + idx];
+  _used[level] &= ~(1ULL << idx);
+
+  while (!q.empty())
+    {
+      Timeout *to = q.front();
+      To_list::remove(to);
+      place(to);
+    }
+}
+
+/**
+ * Re-enqueue all timeouts relative to a new wheel tick.  Used if the
+ * wheel has not been advanced for a long time, instead of stepping
+ * over all the missed ticks.
+ */
+PRIVATE
+void
+Timeout_q::rehash(Unsigned64 tick)
+{
+  To_list all;
+
+  for (unsigned i = 0; i < Wheel_levels * Wheel_slots; ++i)
+    while (!_q[i].empty())
+      {
+        Timeout *to = _q[i].front();
+        To_list::remove(to);
+        all.push_front(to);
+      }
+
+  for (unsigned l = 0; l < Wheel_levels; ++l)
+    _used[l] = 0;
+
+  _tick = tick;
+
+  while (!all.empty())
+    {
+      Timeout *to = all.front();
+      To_list::remove(to);
+      place(to);
+    }
+}
+
+/**
+ * Find the next level-0 slot that may contain timeouts.
+ * @param after  slot offset relative to the current tick to start behind
+ * @return the slot offset relative to the current tick, or Wheel_slots
+ *         if there is none.
+ */
+PRIVATE inline
+unsigned
+Timeout_q::next_used_slot(unsigned after = 0) const
+{
+  unsigned idx = _tick & (Wheel_slots - 1);
+  Unsigned64 m = _used[0];
+
+  // rotate the slot of the current tick to bit 0
+  if (idx)
+    m = (m >> idx) | (m << (Wheel_slots - idx));
+
+  m = after + 1 < Wheel_slots ? m & (~0ULL << (after + 1)) : 0;
+
+  return m ? __builtin_ctzll(m) : (unsigned)Wheel_slots;
+}
+
+PRIVATE inline
+void
+Timeout_q::update_current(To_list const &q)
+{
+  for (Const_iterator i = q.begin(); i != q.end(); ++i)
+    if (i->_wakeup < _current)
+      _current = i->_wakeup;
+}
+
 /**
  * Handles the timeouts, i.e. call expired() for the expired timeouts
  * and programs the "oneshot timer" to the next timeout.
  * @return true if a reschedule is necessary, false otherwise.
  */
 PUBLIC inline NEEDS [<cassert>, <climits>, "kip.h", "timer.h", "config.h",
-                     Timeout::expire]
+                     Timeout::expire, Timeout_q::cascade,
+                     Timeout_q::next_used_slot, Timeout_q::update_current]
 bool
 Timeout_q::do_timeouts()
 {
   bool reschedule = false;
+  Unsigned64 clock = Kip::k()->clock;
+  Unsigned64 now = clock >> Wheel_tick_shift;
 
-  // We test if the time between 2 activiations of this function is greater
-  // than the distance between two timeout queues.
-  // To avoid to lose timeouts, we calculating the missed queues and
-  // scan them too.
-  // This can only happen, if we dont enter the timer interrupt for a long
-  // time, usual with one shot timer.
-  // Because we initalize old_dequeue_time with zero,
-  // we can get an "miss" on the first timerinterrupt.
-  // But this is booting the system, which is uncritical.
-
-  // Calculate which timeout queues needs to be checked.
-  int start = (_old_clock >> Wakeup_queue_distance);
-  int diff  = (Kip::k()->clock >> Wakeup_queue_distance) - start;
-  int end   = (start + diff + 1) & (Wakeup_queue_count - 1);
-
-  // wrap around
-  start = start & (Wakeup_queue_count - 1);
-
-  // test if an complete miss
-  if (diff >= Wakeup_queue_count)
-    start = end = 0; // scan all queues
-
-  // update old_clock for the next run
-  _old_clock = Kip::k()->clock;
-
-  // ensure we always terminate
-  assert((end >= 0) && (end < Wakeup_queue_count));
+  // If we did not enter the timer interrupt for a long time (usual with
+  // the one-shot timer), do not step over all the missed ticks.
+  if (EXPECT_FALSE(now > _tick
+                   && now - _tick >= (Unsigned64)Wheel_slots * Wheel_slots))
+    rehash(now);
 
   for (;;)
     {
-      To_list &q = first(start);
+      unsigned idx = _tick & (Wheel_slots - 1);
+      To_list &q = _q[idx];
       Iterator timeout = q.begin();
 
-      // now scan this queue for timeouts below current clock
-      while (timeout != q.end() && timeout->_wakeup <= (Kip::k()->clock))
+      // now scan the slot of the current tick for expired timeouts, all
+      // of them are expired unless this is the tick of the current clock
+      while (timeout != q.end())
         {
+          if (timeout->_wakeup > clock)
+            {
+              ++timeout;
+              continue;
+            }
+
           Timeout *to = *timeout;
           timeout = q.erase(timeout);
           reschedule |= to->expire();
         }
 
-      // next queue
-      start = (start + 1) & (Wakeup_queue_count - 1);
+      if (q.empty())
+        _used[0] &= ~(1ULL << idx);
+
+      if (_tick >= now)
+        break;
+
+      // advance to the next used slot, but stop at the next level-1
+      // boundary to cascade the upper levels
+      Unsigned64 next = (_tick | (Wheel_slots - 1)) + 1;
+      unsigned n = next_used_slot();
+      if (n < Wheel_slots && _tick + n < next)
+        next = _tick + n;
+      if (next > now)
+        next = now;
+
+      _tick = next;
+
+      if (_tick & (Wheel_slots - 1))
+        continue;
 
-      if (start == end)
-	break;
+      // cascade from the highest level whose boundary we reached
+      unsigned l = 1;
+      while (l < Wheel_levels - 1
+             && !(_tick & ((1ULL << ((l + 1) * Wheel_slot_shift)) - 1)))
+        ++l;
+
+      for (; l > 0; --l)
+        {
+          unsigned i = slot_index(l, _tick);
+          if (_used[l] & (1ULL << i))
+            cascade(l, i);
+        }
     }
 
   if (Config::Scheduler_one_shot)
     {
-      // scan all queues for the next minimum
+      // the first used slot of level 0 holds the next minimum
       //_current = (Unsigned64) ULONG_LONG_MAX;
-      _current = Kip::k()->clock + 10000; //ms
-      bool update_timer = true;
+      _current = clock + 10000; //ms
 
-      for (int i = 0; i < Wakeup_queue_count; i++)
-	{
-	  // make sure that something enqueued other than the dummy element
-	  if (first(i).empty())
-	    continue;
-
-	  update_timer = true;
-
-	  if (first(i).front()->_wakeup < _current)
-	    _current =  first(i).front()->_wakeup;
-	}
+      for (unsigned n = 0; n < Wheel_slots; n = next_used_slot(n))
+        {
+          unsigned idx = (_tick + n) & (Wheel_slots - 1);
+          if (_q[idx].empty())
+            {
+              _used[0] &= ~(1ULL << idx);
+              continue;
+            }
+
+          update_current(_q[idx]);
+          break;
+        }
 
-      if (update_timer)
-	Timer::update_timer(_current);
+      // the slots cascaded at the next level-1 boundary might hold an
+      // earlier one
+      Unsigned64 b = (_tick | (Wheel_slots - 1)) + 1;
+      for (unsigned l = 1;
+           l < Wheel_levels && (b << Wheel_tick_shift) < _current; ++l)
+        {
+          update_current(_q[l * Wheel_slots + slot_index(l, b)]);
+          if (b & ((1ULL << ((l + 1) * Wheel_slot_shift)) - 1))
+            break;
+        }
 
+      Timer::update_timer(_current);
     }
   return reschedule;
 }
 
 PUBLIC inline
 Timeout_q::Timeout_q()
-: _current(ULONG_LONG_MAX), _old_clock(0)
-{}
+: _tick(0), _current(ULONG_LONG_MAX)
+{
+  for (unsigned l = 0; l < Wheel_levels; ++l)
+    _used[l] = 0;
+}
 
 PUBLIC inline
 bool
 Timeout_q::have_timeouts(Timeout const *ignore) const
 {
-  for (unsigned i = 0; i < Wakeup_queue_count; ++i)
-    {
-      To_list const &t = first(i);
-      if (!t.empty())
-        {
-          To_list::Const_iterator f = t.begin();
-          if (*f == ignore && (++f) == t.end())
-            continue;
-
-          return true;
-        }
-    }
+  for (unsigned l = 0; l < Wheel_levels; ++l)
+    for (Unsigned64 m = _used[l]; m; m &= m - 1)
+      {
+        To_list const &t = _q[l * Wheel_slots + __builtin_ctzll(m)];
+        if (!t.empty())
+          {
+            To_list::Const_iterator f = t.begin();
+            if (*f == ignore && (++f) == t.end())
+              continue;
+
+            return true;
+          }
+      }
 
   return false;
 }
@@ -59,9 +59,12 @@ IMPLEMENTATION:
 #include "timer.h"
 
 #include "kernel_console.h"
+#include "perf_sampler.h"
 #include "vkey.h"
+#include "vlog.h"
 
-PRIVATE static inline NEEDS["thread.h", "timer.h", "kernel_console.h", "vkey.h"]
+PRIVATE static inline NEEDS["thread.h", "timer.h", "kernel_console.h", "vkey.h",
+                            "perf_sampler.h", "vlog.h"]
 void
 Timer_tick::handle_timer(Irq_base *_s, Upstream_irq const *ui,
                          Thread *t, Cpu_number cpu)
@@ -76,6 +79,9 @@ Timer_tick::handle_timer(Irq_base *_s, Upstream_irq const *ui,
         kdb_ke("SERIAL_ESC");
     }
   self->log_timer();
+  self->notify_tbuf();
+  Vlog::timer_tick();
+  Perf_sampler::timer_tick(t);
   t->handle_timer_interrupt();
 }
 
@@ -95,7 +101,7 @@ Timer_tick::handler_sys_time(Irq_base *_s, Upstream_irq const *ui)
   handle_timer(_s, ui, current_thread(), Cpu_number::boot_cpu());
 }
 
-PUBLIC static inline NEEDS["thread.h", "timer.h"]
+PUBLIC static inline NEEDS["thread.h", "timer.h", "perf_sampler.h", "vlog.h"]
 void
 Timer_tick::handler_app(Irq_base *_s, Upstream_irq const *ui)
 {
@@ -103,7 +109,11 @@ Timer_tick::handler_app(Irq_base *_s, Upstream_irq const *ui)
   self->ack();
   ui->ack();
   self->log_timer();
-  current_thread()->handle_timer_interrupt();
+  self->notify_tbuf();
+  Vlog::timer_tick();
+  Thread *t = current_thread();
+  Perf_sampler::timer_tick(t);
+  t->handle_timer_interrupt();
 }
 
 // --------------------------------------------------------------------------
@@ -114,11 +124,17 @@ void
 Timer_tick::log_timer()
 {}
 
+PUBLIC static inline
+void
+Timer_tick::notify_tbuf()
+{}
+
 // --------------------------------------------------------------------------
 IMPLEMENTATION [debug]:
 
 #include "logdefs.h"
 #include "irq_chip.h"
+#include "jdb_tbuf_init.h"
 #include "string_buffer.h"
 
 IMPLEMENT
@@ -138,3 +154,10 @@ Timer_tick::log_timer()
       l->obj      = this;
   );
 }
+
+PUBLIC static inline NEEDS["jdb_tbuf_init.h"]
+void
+Timer_tick::notify_tbuf()
+{
+  Jdb_tbuf_init::notify_observer();
+}
@@ -37,6 +37,7 @@ private:
   static char                           _help[];
   static char const *                   _modules[];
   static bool				_emulate_clisti;
+  static bool                           _entry_pages;
   static unsigned long                  _sigma0_start;
   static unsigned long                  _sigma0_end;
   static unsigned long                  _root_start;
@@ -89,6 +90,7 @@ const char *            Boot_info::_net_program = "ux_net";
 void *                  Boot_info::_mbi_vbe;
 const char *            Boot_info::_irq0_program = "irq0";
 bool			Boot_info::_emulate_clisti;
+bool                    Boot_info::_entry_pages;
 unsigned long           Boot_info::_sigma0_start;
 unsigned long           Boot_info::_sigma0_end;
 unsigned long           Boot_info::_root_start;
@@ -122,6 +124,7 @@ struct option Boot_info::_long_options[] FIASCO_INITDATA =
   { "roottaskconfig",           required_argument,      NULL, 'C' },
   { "lines",                    required_argument,      NULL, 'L' },
   { "clisti",			no_argument,		NULL, 's' },
+  { "entry_pages",              no_argument,            NULL, 'P' },
   { 0, 0, 0, 0 }
 };
 
@@ -147,7 +150,9 @@ char Boot_info::_help[] FIASCO_INITDATA =
   "-L          : Specify lines path\n"
   "-C          : Specify roottask configuration file path\n"
   "-T          : Test mode -- do not load any modules\n"
-  "-s          : Emulate cli/sti instructions\n";
+  "-s          : Emulate cli/sti instructions\n"
+  "-P          : Enter the kernel through shared pages instead of ptrace;\n"
+  "              faster, but lets tasks make host system calls\n";
 
 
 char const *Boot_info::_modules[64] FIASCO_INITDATA =
@@ -219,7 +224,7 @@ Boot_info::init()
   // Parse command line. Use getopt_long_only() to achieve more compatibility
   // with command line switches in the IA32 architecture.
   while ((arg = getopt_long_only (__libc_argc, __libc_argv,
-                                  "C:f:hj:k:l:m:qst:wE:F:G:I:L:NR:S:TY:0",
+                                  "C:f:hj:k:l:m:qst:wE:F:G:I:L:NPR:S:TY:0",
                                   _long_options, NULL)) != -1) {
     switch (arg) {
 
@@ -326,6 +331,10 @@ Boot_info::init()
 	_emulate_clisti = 1;
 	break;
 
+      case 'P':
+        _entry_pages = true;
+        break;
+
       default:
         printf ("Usage: %s\n\n%s", *__libc_argv, _help);
         exit (arg == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
@@ -693,6 +702,11 @@ bool
 Boot_info::emulate_clisti()
 { return _emulate_clisti; }
 
+PUBLIC static inline
+bool
+Boot_info::entry_pages()
+{ return _entry_pages; }
+
 PUBLIC static inline
 unsigned long
 Boot_info::sigma0_start()
@@ -54,7 +54,7 @@ Context::load_gdt_user_entries(Context *old = 0)
       {
         memcpy(trampoline_page + 1, &_gdt_user_entries[i],
                sizeof(_gdt_user_entries[0]));
-        Trampoline::syscall(tos->pid(), 243,
+        Trampoline::syscall(tos, 243,
                             Mem_layout::Trampoline_page + sizeof(Mword));
       }
 
@@ -0,0 +1,493 @@
+/*
+ * Fiasco-UX
+ * Kernel entry of tasks through a page shared with their host process
+ */
+
+INTERFACE:
+
+#include <sys/types.h>			// for pid_t
+#include "config.h"
+#include "trampoline.h"
+#include "types.h"
+
+class Fpu_state;
+struct ucontext;
+
+/**
+ * Kernel entry page of a task.
+ *
+ * With ptrace, each kernel entry of a task costs the kernel a waitpid()
+ * plus several PTRACE_GETREGS, PTRACE_PEEKTEXT, PTRACE_SETREGS and
+ * PTRACE_SYSCALL round trips. Tasks with an entry page are not traced
+ * at all. Their signal handler (_task_entry_start in sighandler.S) runs on
+ * a signal stack within this page, publishes the signal context here and
+ * parks on its state word until the kernel lets it return by rt_sigreturn.
+ * The kernel reads and modifies the task's registers directly in the
+ * signal context. Host system calls on behalf of the kernel (mmap, munmap, ...)
+ * are executed by the parked handler.
+ *
+ * The page lives in kernel memory and is mapped shared into the host
+ * process at Mem_layout::Entry_page_user. Everything in it is writable by
+ * the task, the kernel keeps what it must rely on (the location of the
+ * signal context) in the Entry_page object itself.
+ *
+ * The entry code, and hence the task, can make host system calls, among
+ * them mmap of the physical memory file. Entry pages are thus only used if
+ * Fiasco-UX is started with -P, for trusted tasks.
+ */
+class Entry_page
+{
+public:
+  enum State
+  {
+    Starting  = 0, ///< Host process not yet parked
+    User      = 1, ///< Task returns to user mode
+    Kernel    = 2, ///< Task parked, the context belongs to the kernel
+    Host_call = 3, ///< Task executes a host system call for the kernel
+    Failed    = 4, ///< Host kernel refused the setup, use ptrace
+    Host_batch = 5, ///< Task executes the host system calls in batch
+  };
+
+  enum
+  {
+    Order = Config::PAGE_SHIFT + 1,
+    Size  = 1UL << Order,
+  };
+
+private:
+  /// The part of the page shared with the host process
+  struct Shared
+  {
+    // The layout of these is known to sighandler.S
+    Unsigned32 state;    ///< futex word, see State
+    Unsigned32 signal;   ///< signal that caused the kernel entry
+    Unsigned32 context;  ///< offset of the signal context in this page
+    Unsigned32 call[7];  ///< host system call: eax, ebx ... ebp; result
+    Unsigned32 batch_count;                       ///< number of calls in batch
+    Trampoline::Call batch[Trampoline::Batch_max]; ///< host system calls
+
+    // The rest of the page is the signal stack of the task
+  };
+
+  Shared *_page;
+  Unsigned32 _context;  ///< offset of the signal context, set by attach()
+};
+
+IMPLEMENTATION:
+
+#include <cassert>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <ucontext.h>
+#include <unistd.h>
+#include <asm/unistd.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/futex.h>
+#include <linux/seccomp.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include "undef_page.h"
+
+#include "boot_info.h"
+#include "cpu.h"
+#include "fpu_state.h"
+#include "globals.h"
+#include "kmem.h"
+#include "kmem_alloc.h"
+#include "mem.h"
+#include "mem_layout.h"
+#include "panic.h"
+#include "regdefs.h"
+
+enum
+{
+  // struct _fpstate of the i386 signal frame: the FXSR image follows
+  // the 112 bytes of i387 state, the XSAVE header follows the FXSR image
+  Fpstate_fxsr       = 112,
+  Fpstate_fxsr_size  = 512,
+  Fpstate_i387_size  = 108,
+  Fpstate_xmagic     = 464,
+  Fpstate_xmagic1    = 0x46505853,
+};
+
+PRIVATE inline
+Entry_page::Entry_page(Shared *page) : _page(page), _context(0) {}
+
+/**
+ * Allocate the entry page of a new task.
+ * @return the page, or 0 if the task shall run under ptrace.
+ */
+PUBLIC static
+Entry_page *
+Entry_page::create()
+{
+  static bool code_copied;
+
+  if (!Boot_info::entry_pages())
+    return 0;
+
+  static_assert(offsetof(Shared, state) == 0
+                && offsetof(Shared, signal) == 4
+                && offsetof(Shared, context) == 8
+                && offsetof(Shared, call) == 12
+                && offsetof(Shared, batch_count) == 40
+                && offsetof(Shared, batch) == 44
+                && sizeof(Trampoline::Call) == 28,
+                "Entry_page layout does not match sighandler.S");
+
+  if (!code_copied)
+    {
+      memcpy((void *)Mem_layout::phys_to_pmem(Mem_layout::Entry_code_frame),
+             &Mem_layout::task_entry_start,
+             &Mem_layout::task_entry_end - &Mem_layout::task_entry_start);
+      code_copied = true;
+    }
+
+  void *e = Kmem_alloc::allocator()->unaligned_alloc(sizeof(Entry_page));
+  if (!e)
+    return 0;
+
+  void *p = Kmem_alloc::allocator()->alloc(Order);
+  if (!p)
+    {
+      Kmem_alloc::allocator()->unaligned_free(sizeof(Entry_page), e);
+      return 0;
+    }
+
+  // the task can read the whole page, do not leak old kernel data
+  memset(p, 0, Size);
+  return new (e) Entry_page(reinterpret_cast<Shared *>(p));
+}
+
+PUBLIC
+void
+Entry_page::free()
+{
+  Kmem_alloc::allocator()->free(Order, _page);
+  Kmem_alloc::allocator()->unaligned_free(sizeof(Entry_page), this);
+}
+
+/**
+ * Is the host process parked in the entry code?
+ * False if the host process never got there, i.e. uses ptrace.
+ */
+PUBLIC inline
+bool
+Entry_page::parked() const
+{ return access_once(&_page->state) == Kernel; }
+
+PUBLIC inline
+int
+Entry_page::signal() const
+{ return access_once(&_page->signal); }
+
+PRIVATE inline NEEDS["mem.h"]
+void
+Entry_page::set_state(Unsigned32 state)
+{
+  // the host process may see the new state before the futex wake
+  Mem::barrier();
+  write_now(&_page->state, state);
+  syscall(__NR_futex, &_page->state, FUTEX_WAKE, 1, 0, 0, 0);
+}
+
+/**
+ * Wait until the host process parked in the entry code.
+ * @param pid process id of the host process.
+ */
+PRIVATE
+void
+Entry_page::wait_parked(pid_t pid)
+{
+  struct timespec timeout = { 0, 100 * 1000 * 1000 };
+  Unsigned32 state;
+
+  while ((state = access_once(&_page->state)) != Kernel)
+    if (syscall(__NR_futex, &_page->state, FUTEX_WAIT, state, &timeout, 0, 0) == -1
+        && errno == ETIMEDOUT)
+      {
+        // Unlike waitpid() on a traced process a futex does not tell us
+        // if the host process died
+        int status;
+        if (waitpid(pid, &status, WNOHANG) == pid)
+          panic("host process %d of task died (status %x)", pid, status);
+      }
+}
+
+/**
+ * Let the parked task return to user mode and wait for its next kernel
+ * entry.
+ * @param pid process id of the host process.
+ */
+PUBLIC
+void
+Entry_page::resume(pid_t pid)
+{
+  set_state(User);
+  wait_parked(pid);
+}
+
+/**
+ * Execute a host system call in the host process of the task.
+ * @param pid process id of the host process.
+ * @return the result of the system call.
+ */
+PUBLIC
+Mword
+Entry_page::host_call(pid_t pid, Mword eax, Mword ebx = 0, Mword ecx = 0,
+                      Mword edx = 0, Mword esi = 0, Mword edi = 0,
+                      Mword ebp = 0)
+{
+  _page->call[0] = eax;
+  _page->call[1] = ebx;
+  _page->call[2] = ecx;
+  _page->call[3] = edx;
+  _page->call[4] = esi;
+  _page->call[5] = edi;
+  _page->call[6] = ebp;
+
+  set_state(Host_call);
+  wait_parked(pid);
+
+  return access_once(&_page->call[0]);
+}
+
+/**
+ * Execute a sequence of host system calls in the host process of the task,
+ * with a single round trip.
+ * @param pid process id of the host process.
+ * @param calls the calls; the results replace Trampoline::Call::nr.
+ * @param n number of calls, at most Trampoline::Batch_max.
+ */
+PUBLIC
+void
+Entry_page::host_batch(pid_t pid, Trampoline::Call *calls, unsigned n)
+{
+  assert (n <= Trampoline::Batch_max);
+
+  memcpy(_page->batch, calls, n * sizeof(calls[0]));
+  _page->batch_count = n;
+
+  set_state(Host_batch);
+  wait_parked(pid);
+
+  memcpy(calls, _page->batch, n * sizeof(calls[0]));
+}
+
+/**
+ * Signal context of the parked task, in kernel address space.
+ */
+PUBLIC inline
+struct ucontext *
+Entry_page::context()
+{
+  return reinterpret_cast<struct ucontext *>
+    (reinterpret_cast<char *>(_page) + _context);
+}
+
+/**
+ * FPU state in the signal frame of the parked task, in kernel address
+ * space and in the format of Fpu_state.
+ */
+PRIVATE
+char *
+Entry_page::fpu_frame(struct ucontext *context, bool *fxsr)
+{
+  Address fpstate = reinterpret_cast<Address>(context->uc_mcontext.fpregs);
+  if (!fpstate)
+    return 0;
+
+  *fxsr = Cpu::boot_cpu()->features() & FEAT_FXSR;
+
+  Address offset = fpstate - Mem_layout::Entry_page_user;
+  Address size   = *fxsr ? Fpstate_fxsr + Fpstate_fxsr_size : Fpstate_i387_size;
+
+  if (offset < sizeof(Shared) || offset > Size - size)
+    return 0;
+
+  return reinterpret_cast<char *>(_page) + offset + (*fxsr ? Fpstate_fxsr : 0);
+}
+
+/**
+ * Load the FPU state s into the parked task, see Fpu::restore_state.
+ */
+PUBLIC
+void
+Entry_page::load_fpu(struct ucontext *context, Fpu_state *s)
+{
+  bool fxsr;
+  char *f = fpu_frame(context, &fxsr);
+  if (!f || !s->state_buffer())
+    return;
+
+  memcpy(f, s->state_buffer(), fxsr ? Fpstate_fxsr_size : Fpstate_i387_size);
+
+  // With an XSAVE frame the host only restores the components marked in
+  // the header, make sure it takes x87 and SSE state from the image
+  if (fxsr && Address(f + Fpstate_fxsr_size + 8 - (char *)_page) <= Size
+      && *reinterpret_cast<Unsigned32 *>(f + Fpstate_xmagic) == Fpstate_xmagic1)
+    *reinterpret_cast<Unsigned64 *>(f + Fpstate_fxsr_size) |= 3;
+}
+
+/**
+ * Store the FPU state of the parked task in s, see Fpu::save_state.
+ */
+PUBLIC
+void
+Entry_page::store_fpu(struct ucontext *context, Fpu_state *s)
+{
+  bool fxsr;
+  char *f = fpu_frame(context, &fxsr);
+  if (!f || !s->state_buffer())
+    return;
+
+  memcpy(s->state_buffer(), f, fxsr ? Fpstate_fxsr_size : Fpstate_i387_size);
+}
+
+/**
+ * Take over a host process which stopped in the entry code.
+ * Called by the kernel when the (still traced) host process stopped with
+ * SIGSEGV on _task_entry_park.
+ * @param pid process id of the host process.
+ */
+PUBLIC
+void
+Entry_page::attach(pid_t pid)
+{
+  // Detach and let the signal through to the entry code
+  ptrace(PTRACE_DETACH, pid, NULL, SIGSEGV);
+  wait_parked(pid);
+
+  // The host delivers every signal to the top of the empty signal stack,
+  // so the context stays where it is now. The task has not run any code
+  // of its own yet, later it could move the published offset anywhere.
+  _context = access_once(&_page->context);
+  if (_context < sizeof(Shared) || _context > Size - sizeof(struct ucontext))
+    panic("invalid signal context in entry page (%x)", _context);
+
+  host_call(pid, __NR_munmap, 0, Mem_layout::Trampoline_page);
+}
+
+//---------------------------------------------------------------------------
+// Host process side
+
+PRIVATE static
+bool
+Entry_page::install_filter()
+{
+  // Only the entry code may call into the host kernel, and only with the
+  // system calls it needs itself or the kernel issues through it. All
+  // other system calls raise SIGSYS and enter the Fiasco kernel like
+  // int $0x80 does under ptrace.
+  struct sock_filter filter[] =
+  {
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch)),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_I386, 1, 0),
+    BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL),
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+             offsetof(struct seccomp_data, instruction_pointer)),
+    BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, Mem_layout::Entry_code_user, 0, 9),
+    BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K,
+             Mem_layout::Entry_code_user + Config::PAGE_SIZE, 8, 0),
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_futex,           7, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_rt_sigreturn,    6, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_mmap2,           5, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_munmap,          4, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_mprotect,        3, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_modify_ldt,      2, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_set_thread_area, 1, 0),
+    BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+    BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+  };
+
+  struct sock_fprog prog;
+  prog.len    = sizeof(filter) / sizeof(filter[0]);
+  prog.filter = filter;
+
+  return prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0
+         && prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) == 0;
+}
+
+/**
+ * Switch a freshly forked host process to the entry page.
+ * Runs in the host process, after PTRACE_TRACEME. Does not return but
+ * stops the host process in the entry code, unless the host kernel lacks
+ * support. In that case the page is marked Failed and the host process
+ * stays with ptrace.
+ */
+PUBLIC
+void
+Entry_page::enter_host_process()
+{
+  static int const entry_signals[] =
+    { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGTRAP, SIGIO, SIGSYS };
+  static int const ignored_signals[] =
+    { SIGINT, SIGTERM, SIGHUP, SIGWINCH };
+  enum
+  {
+    Nentry   = sizeof(entry_signals) / sizeof(entry_signals[0]),
+    Nignored = sizeof(ignored_signals) / sizeof(ignored_signals[0]),
+  };
+
+  struct sigaction old[Nentry + Nignored];
+  stack_t stack, old_stack;
+
+  if (mmap((void *)Mem_layout::Entry_page_user, Size,
+           PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+           Boot_info::fd(), Kmem::virt_to_phys(_page)) == MAP_FAILED
+      || mmap((void *)Mem_layout::Entry_code_user, Config::PAGE_SIZE,
+              PROT_READ | PROT_EXEC, MAP_SHARED | MAP_FIXED,
+              Boot_info::fd(), Mem_layout::Entry_code_frame) == MAP_FAILED)
+    {
+      write_now(&_page->state, (Unsigned32)Failed);
+      return;
+    }
+
+  stack.ss_sp    = (void *)(Mem_layout::Entry_page_user + sizeof(Shared));
+  stack.ss_size  = Size - sizeof(Shared);
+  stack.ss_flags = 0;
+  check (!sigaltstack(&stack, &old_stack));
+
+  struct sigaction action;
+  sigfillset(&action.sa_mask);
+  action.sa_flags     = SA_ONSTACK | SA_SIGINFO;
+  action.sa_restorer  = (void (*)()) 0xDEADC0DE;
+  action.sa_sigaction = (void (*)(int,siginfo_t*,void*))
+                          Mem_layout::Entry_code_user;
+  for (unsigned i = 0; i < Nentry; ++i)
+    check (!sigaction(entry_signals[i], &action, &old[i]));
+
+  // Nobody intercepts these for us anymore
+  action.sa_flags   = 0;
+  action.sa_handler = SIG_IGN;
+  for (unsigned i = 0; i < Nignored; ++i)
+    check (!sigaction(ignored_signals[i], &action, &old[Nentry + i]));
+
+  if (install_filter())
+    {
+      // Stop with SIGSEGV in the entry code, see attach()
+      asm volatile ("jmp *%0" : : "r" (Mem_layout::Entry_code_user
+                                       + (&Mem_layout::task_entry_park
+                                          - &Mem_layout::task_entry_start)));
+      __builtin_unreachable();
+    }
+
+  // No seccomp support, undo everything
+  for (unsigned i = 0; i < Nentry; ++i)
+    sigaction(entry_signals[i], &old[i], 0);
+  for (unsigned i = 0; i < Nignored; ++i)
+    sigaction(ignored_signals[i], &old[Nentry + i], 0);
+  sigaltstack(&old_stack, 0);
+  munmap((void *)Mem_layout::Entry_page_user, Size);
+  munmap((void *)Mem_layout::Entry_code_user, Config::PAGE_SIZE);
+
+  write_now(&_page->state, (Unsigned32)Failed);
+}
@@ -6,8 +6,13 @@
 
 INTERFACE:
 
+class Entry_page;
+
 class Hostproc
-{};
+{
+private:
+  static Entry_page *_entry_page;	// entry page of the forked process
+};
 
 IMPLEMENTATION:
 
@@ -24,12 +29,15 @@ IMPLEMENTATION:
 #include "boot_info.h"
 #include "config.h"
 #include "cpu_lock.h"
+#include "entry_page.h"
 #include "globals.h"
 #include "lock_guard.h"
 #include "mem_layout.h"
 #include "panic.h"
 #include "trampoline.h"
 
+Entry_page *Hostproc::_entry_page;
+
 PRIVATE static
 void
 Hostproc::setup()
@@ -76,12 +84,21 @@ Hostproc::setup()
 
   ptrace (PTRACE_TRACEME, 0, NULL, NULL);
 
+  if (_entry_page)
+    _entry_page->enter_host_process();	// returns only on failure
+
   raise (SIGUSR1);
 }
 
+/**
+ * Create the host process of a task.
+ * @param e entry page of the task, or 0 to run the task under ptrace.
+ *          If the host process cannot use it, e is left unparked.
+ * @return process id of the host process, 0 on failure.
+ */
 PUBLIC static
 unsigned
-Hostproc::create()
+Hostproc::create(Entry_page *e = 0)
 {
   auto guard = lock_guard(cpu_lock);
 
@@ -89,6 +106,8 @@ Hostproc::create()
   static Mword _stack[256];
   register pid_t pid;
 
+  _entry_page = e;
+
   /*
    * Careful with local variables here because we are changing the
    * stack pointer for the fork system call. This ensures that the
@@ -110,7 +129,16 @@ Hostproc::create()
       default:                            // Parent
         int status;
         check (waitpid (pid, &status, 0) == pid);
-        assert (WIFSTOPPED (status) && WSTOPSIG (status) == SIGUSR1);
+        assert (WIFSTOPPED (status));
+
+        if (e && WSTOPSIG (status) == SIGSEGV)
+          {
+            // Stopped in the entry code, see Entry_page::enter_host_process
+            e->attach (pid);
+            return pid;
+          }
+
+        assert (WSTOPSIG (status) == SIGUSR1);
 
         Trampoline::syscall (pid, __NR_munmap, 0, Mem_layout::Trampoline_page);
         return pid;
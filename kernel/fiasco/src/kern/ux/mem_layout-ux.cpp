@@ -92,6 +92,8 @@ public:
     Trampoline_page    = 0xbfff1000 - Host_as_offset,  ///< % 4KB
     Kip_auto_map       = 0xbfff2000 - Host_as_offset,  ///< % 4KB
     Tbuf_ustatus_page  = 0xbfff3000 - Host_as_offset,  ///< % 4KB
+    Entry_page_user    = 0xbfff4000 - Host_as_offset,  ///< % 4KB   size 8KB
+    Entry_code_user    = 0xbfff6000 - Host_as_offset,  ///< % 4KB
     Space_index        = 0xc0000000,  ///< % 4MB   v2
     Kip_index          = 0xc0800000,  ///< % 4MB
     Syscalls           = 0xeacff000,  ///< % 4KB   syscall page
@@ -109,7 +111,8 @@ public:
     Sigstack_size             = 1 << Sigstack_log2_size,
     Sigstack_cpu0_end_frame   = Sigstack_cpu0_start_frame // Kernel Signal Altstack End
                                 + Sigstack_size,
-    Kernel_end_frame          = Sigstack_cpu0_end_frame,
+    Entry_code_frame          = Sigstack_cpu0_end_frame, // Task entry code
+    Kernel_end_frame          = Entry_code_frame + 0x1000,
   };
 
   enum
@@ -121,6 +124,9 @@ public:
   /// reflect symbols in linker script
   static const char task_sighandler_start  asm ("_task_sighandler_start");
   static const char task_sighandler_end    asm ("_task_sighandler_end");
+  static const char task_entry_start       asm ("_task_entry_start");
+  static const char task_entry_park        asm ("_task_entry_park");
+  static const char task_entry_end         asm ("_task_entry_end");
 
   static Address const kernel_trampoline_page;
 };
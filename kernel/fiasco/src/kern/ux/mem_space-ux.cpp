@@ -16,12 +16,45 @@ int
 thread_page_fault(Address, Mword, Address, Mword, Return_frame *);
 
 
+class Entry_page;
+
 EXTENSION class Mem_space
 {
+public:
+  /// Counters of the host update queue, see sync_host()
+  struct Host_stats
+  {
+    Unsigned64 ops;        ///< page_map, page_unmap and page_protect calls
+    Unsigned64 coalesced;  ///< ops merged into a queued range operation
+    Unsigned64 syncs;      ///< non-empty queue flushes
+    Unsigned64 calls;      ///< host system calls issued by the flushes
+  };
+
+  static Host_stats host_stats;
+
 protected:
   int sync_kernel() const { return 0; }
 
   pid_t _pid;
+  Entry_page *_entry_page;
+
+private:
+  enum Host_op_type { Host_map, Host_unmap, Host_protect };
+
+  /// Pending host mmap, munmap or mprotect of a virtual address range
+  struct Host_op
+  {
+    Host_op_type type;
+    unsigned prot;
+    Address virt;
+    Address size;
+    Address offs;          ///< offset in the physical memory file (Host_map)
+  };
+
+  enum { Host_queue_size = 16 };
+
+  Host_op _host_queue[Host_queue_size];
+  unsigned _host_queued;
 };
 
 IMPLEMENTATION[ux]:
@@ -56,17 +89,41 @@ Mem_space::make_current()
   _current.cpu(current_cpu()) = this;
 }
 
+// no host process yet, see set_pid()
+PRIVATE inline
+void
+Mem_space::init_host()
+{
+  _pid = 0;
+  _entry_page = 0;
+  _host_queued = 0;
+}
+
 // returns host pid number
 PUBLIC inline
 pid_t
 Mem_space::pid() const
 { return _pid; }
 
-// sets host pid number
+// sets host pid number, the new host process has no pending updates
 PUBLIC inline
 void
 Mem_space::set_pid(pid_t pid)
-{ _pid = pid; }
+{
+  _pid = pid;
+  _host_queued = 0;
+}
+
+// returns the entry page of the host process, 0 if it runs under ptrace
+PUBLIC inline
+Entry_page *
+Mem_space::entry_page() const
+{ return _entry_page; }
+
+PUBLIC inline
+void
+Mem_space::set_entry_page(Entry_page *e)
+{ _entry_page = e; }
 
 IMPLEMENT inline NEEDS["logdefs.h"]
 void
@@ -79,52 +136,142 @@ Mem_space::switchin_context(Mem_space *from)
   make_current();
 }
 
-IMPLEMENT inline NEEDS [<asm/unistd.h>, <sys/mman.h>, "boot_info.h",
-                        "cpu_lock.h", "lock_guard.h", "mem_layout.h",
-                        "trampoline.h"]
+Mem_space::Host_stats Mem_space::host_stats;
+
+/**
+ * Queue a host address space update, merging it into the last queued one
+ * if both form a contiguous range operation.
+ */
+PRIVATE
 void
-Mem_space::page_map(Address phys, Address virt, Address size, Attr attr)
+Mem_space::host_queue(Host_op_type type, Address virt, Address size,
+                      unsigned prot, Address offs = 0)
+{
+  // no host process -- should only happen in tests and for the kernel
+  if (!_pid)
+    return;
+
+  auto guard = lock_guard(cpu_lock);
+
+  ++host_stats.ops;
+
+  if (_host_queued)
+    {
+      Host_op *l = &_host_queue[_host_queued - 1];
+      if (l->type == type && l->prot == prot && l->virt + l->size == virt
+          && (type != Host_map || l->offs + l->size == offs))
+        {
+          l->size += size;
+          ++host_stats.coalesced;
+          return;
+        }
+
+      if (_host_queued == Host_queue_size)
+        sync_host();
+    }
+
+  Host_op *o = &_host_queue[_host_queued++];
+  o->type = type;
+  o->prot = prot;
+  o->virt = virt;
+  o->size = size;
+  o->offs = offs;
+}
+
+/**
+ * Apply the queued updates to the host process.
+ * Page table updates reach the host process lazily: page_map, page_unmap
+ * and page_protect only queue them. They must be applied before the task
+ * runs again, which Usermode::iret_to_user_mode ensures, and on
+ * tlb_flush().
+ */
+PUBLIC
+void
+Mem_space::sync_host()
 {
+  if (!_pid)
+    return;
+
   auto guard = lock_guard(cpu_lock);
 
-  Mword *trampoline = (Mword *)Mem_layout::kernel_trampoline_page;
+  if (!_host_queued)
+    return;
+
+  Trampoline::Call calls[Host_queue_size];
+  static_assert(int(Host_queue_size) <= int(Trampoline::Batch_max),
+                "host update queue exceeds a host system call batch");
 
-  *(trampoline + 1) = virt;
-  *(trampoline + 2) = size;
-  *(trampoline + 3) = PROT_READ | (attr.rights & Page::Rights::W() ? PROT_WRITE : 0);
-  *(trampoline + 4) = MAP_SHARED | MAP_FIXED;
-  *(trampoline + 5) = Boot_info::fd();
+  for (unsigned i = 0; i < _host_queued; ++i)
+    {
+      Host_op const *o = &_host_queue[i];
+      Trampoline::Call *c = &calls[i];
+
+      memset(c, 0, sizeof(*c));
+      c->ebx = o->virt;
+      c->ecx = o->size;
+      switch (o->type)
+        {
+        case Host_map:
+          c->nr  = __NR_mmap2;
+          c->edx = o->prot;
+          c->esi = MAP_SHARED | MAP_FIXED;
+          c->edi = Boot_info::fd();
+          c->ebp = o->offs >> Config::PAGE_SHIFT;
+          break;
+        case Host_unmap:
+          c->nr  = __NR_munmap;
+          break;
+        case Host_protect:
+          c->nr  = __NR_mprotect;
+          c->edx = o->prot;
+          break;
+        }
+    }
+
+  Trampoline::syscall_batch(this, calls, _host_queued);
+
+  ++host_stats.syncs;
+  host_stats.calls += _host_queued;
+  _host_queued = 0;
+}
+
+PUBLIC inline
+void
+Mem_space::tlb_flush(bool = false)
+{ sync_host(); }
+
+IMPLEMENT inline NEEDS [<sys/mman.h>, "boot_info.h"]
+void
+Mem_space::page_map(Address phys, Address virt, Address size, Attr attr)
+{
+  Address offs;
 
   if (phys >= Boot_info::fb_virt() &&
       phys + size <= Boot_info::fb_virt() +
                      Boot_info::fb_size() +
                      Boot_info::input_size())
-    *(trampoline + 6) = Boot_info::fb_phys() + (phys - Boot_info::fb_virt());
+    offs = Boot_info::fb_phys() + (phys - Boot_info::fb_virt());
   else
-    *(trampoline + 6) = phys;
+    offs = phys;
 
-  Trampoline::syscall(pid(), __NR_mmap, Mem_layout::Trampoline_page + 4);
+  host_queue(Host_map, virt, size,
+             PROT_READ | (attr.rights & Page::Rights::W() ? PROT_WRITE : 0),
+             offs);
 }
 
-IMPLEMENT inline NEEDS [<asm/unistd.h>, "cpu_lock.h", "lock_guard.h",
-                        "trampoline.h"]
+IMPLEMENT inline
 void
 Mem_space::page_unmap(Address virt, Address size)
 {
-  auto guard = lock_guard(cpu_lock);
-
-  Trampoline::syscall(pid(), __NR_munmap, virt, size);
+  host_queue(Host_unmap, virt, size, 0);
 }
 
-IMPLEMENT inline NEEDS [<asm/unistd.h>, "cpu_lock.h", "lock_guard.h",
-                        "trampoline.h"]
+IMPLEMENT inline NEEDS [<sys/mman.h>]
 void
 Mem_space::page_protect(Address virt, Address size, unsigned attr)
 {
-  auto guard = lock_guard(cpu_lock);
-
-  Trampoline::syscall(pid(), __NR_mprotect, virt, size,
-                      PROT_READ | (attr & Page_writable ? PROT_WRITE : 0));
+  host_queue(Host_protect, virt, size,
+             PROT_READ | (attr & Page_writable ? PROT_WRITE : 0));
 }
 
 
@@ -181,6 +328,35 @@ Mem_space::user_to_kernel(T const *addr, bool write)
     }
 }
 
+/**
+ * Read user memory that is currently mapped, without raising page faults.
+ * @param addr Virtual address in user address space.
+ * @param buf Buffer in kernel space.
+ * @param n Number of bytes to read.
+ * @return false if a part of the range is not mapped.
+ */
+PUBLIC
+bool
+Mem_space::read_mapped(Address addr, void *buf, unsigned n)
+{
+  char *dst = static_cast<char *>(buf);
+
+  for (; n; --n, ++addr)
+    {
+      Phys_addr phys;
+      Virt_addr virt = Virt_addr(addr);
+      Page_order size;
+
+      if (!v_lookup(virt, &phys, &size))
+        return false;
+
+      phys = phys | cxx::get_lsb(virt, size);
+      *dst++ = *(char *)Mem_layout::phys_to_pmem(Phys_addr::val(phys));
+    }
+
+  return true;
+}
+
 IMPLEMENT inline NEEDS ["config.h", "cpu_lock.h", "lock_guard.h"]
 template< typename T >
 T
@@ -4,6 +4,7 @@ IMPLEMENTATION [ux]:
 #include <sys/wait.h>
 
 #include "cpu_lock.h"
+#include "entry_page.h"
 #include "hostproc.h"
 #include "lock_guard.h"
 #include "map_util.h"
@@ -12,7 +13,20 @@ IMPLEMENTATION [ux]:
 IMPLEMENT
 void
 Task::ux_init()
-{ set_pid(Hostproc::create()); }
+{
+  Entry_page *e = Entry_page::create();
+
+  set_pid(Hostproc::create(e));
+
+  if (e && !e->parked())
+    {
+      // Host process runs under ptrace
+      e->free();
+      e = 0;
+    }
+
+  set_entry_page(e);
+}
 
 PRIVATE inline
 bool
@@ -64,7 +78,7 @@ Task::invoke_arch(L4_msg_tag &tag, Utcb *utcb)
                 *(trampoline_page + i + 1) = *(((Mword *)&info) + i);
 
               // Call modify_ldt for given user process
-              Trampoline::syscall(pid(), __NR_modify_ldt,
+              Trampoline::syscall(this, __NR_modify_ldt,
                                   1, // write LDT
                                   Mem_layout::Trampoline_page + sizeof(Mword),
                                   sizeof(info));
@@ -93,14 +107,21 @@ Task::~Task()
   auto guard = lock_guard(cpu_lock);
 
   pid_t hostpid = pid();
-  ptrace (PTRACE_KILL, hostpid, NULL, NULL);
 
   // If we crash very early in the boot process we might get a pid of 0
   if (EXPECT_FALSE(hostpid == 0))
     return;
 
+  if (entry_page())
+    kill (hostpid, SIGKILL);		// not traced
+  else
+    ptrace (PTRACE_KILL, hostpid, NULL, NULL);
+
   while (waitpid (hostpid, NULL, 0) != hostpid)
     ;
+
+  if (entry_page())
+    entry_page()->free();
 }
 
 
@@ -252,7 +252,7 @@ Thread::invoke_arch(L4_msg_tag tag, Utcb *utcb)
 	      memcpy(trampoline_page + 1, &info, sizeof(info));
 
 	      // Call set_thread_area for given user process
-	      Trampoline::syscall(space()->pid(), 243 /* __NR_set_thread_area */,
+	      Trampoline::syscall(space(), 243 /* __NR_set_thread_area */,
                                   Mem_layout::Trampoline_page + sizeof(Mword));
 
 	      // Also set this for the fiasco kernel so that
@@ -4,8 +4,19 @@ INTERFACE:
 #include <sys/types.h>			// for pid_t
 #include "types.h"			// for Mword
 
+class Mem_space;
+
 class Trampoline
-{};
+{
+public:
+  /// A host system call for syscall_batch(), the result replaces nr
+  struct Call
+  {
+    Mword nr, ebx, ecx, edx, esi, edi, ebp;
+  };
+
+  enum { Batch_max = 32 };
+};
 
 IMPLEMENTATION:
 
@@ -15,7 +26,9 @@ IMPLEMENTATION:
 #include <sys/user.h>
 #include <sys/wait.h>
 #include "undef_page.h"			// this undef's crap in <sys/user.h>
+#include "entry_page.h"
 #include "mem_layout.h"
+#include "mem_space.h"
 
 PRIVATE static inline NOEXPORT
 void
@@ -40,15 +53,16 @@ Trampoline::wait_for_stop (pid_t pid)
  * top of the magic page, which the code uses as stack.
  */
 PUBLIC static
-void
+Mword
 Trampoline::syscall (pid_t pid, Mword eax = 0, Mword ebx = 0,
-                                Mword ecx = 0, Mword edx = 0)
+                                Mword ecx = 0, Mword edx = 0,
+                                Mword esi = 0, Mword edi = 0, Mword ebp = 0)
 {
   struct user_regs_struct regs, tramp_regs;
 
   // don't perform syscalls without PID -- should only happen in tests
   if (!pid)
-    return;
+    return 0;
 
   ptrace (PTRACE_GETREGS, pid, NULL, &regs);		// Save registers
 
@@ -57,6 +71,9 @@ Trampoline::syscall (pid_t pid, Mword eax = 0, Mword ebx = 0,
   tramp_regs.ebx = ebx;
   tramp_regs.ecx = ecx;
   tramp_regs.edx = edx;
+  tramp_regs.esi = esi;
+  tramp_regs.edi = edi;
+  tramp_regs.ebp = ebp;
   tramp_regs.eip = Mem_layout::Trampoline_page;
 
   *(Mword *) Mem_layout::kernel_trampoline_page = 0x80cd;
@@ -66,5 +83,51 @@ Trampoline::syscall (pid_t pid, Mword eax = 0, Mword ebx = 0,
   wait_for_stop (pid);					// Kernel entry
   wait_for_stop (pid);					// Kernel exit
 
+  ptrace (PTRACE_GETREGS, pid, NULL, &tramp_regs);	// Fetch result
   ptrace (PTRACE_SETREGS, pid, NULL, &regs);		// Restore registers
+
+  return tramp_regs.eax;
+}
+
+/**
+ * Perform a host system call in the host process of a space: through the
+ * entry page if the host process has one, by ptrace otherwise.
+ * @return the result of the system call.
+ */
+PUBLIC static
+Mword
+Trampoline::syscall (Mem_space const *space, Mword eax = 0, Mword ebx = 0,
+                                             Mword ecx = 0, Mword edx = 0)
+{
+  // don't perform syscalls without PID -- should only happen in tests
+  if (!space->pid())
+    return 0;
+
+  if (Entry_page *e = space->entry_page())
+    return e->host_call (space->pid(), eax, ebx, ecx, edx);
+
+  return syscall (space->pid(), eax, ebx, ecx, edx);
+}
+
+/**
+ * Perform a sequence of host system calls in the host process of a space.
+ * With an entry page the whole sequence costs a single round trip to the
+ * host process, under ptrace each call still needs its own.
+ * @param calls  the calls, in order; results replace Call::nr.
+ * @param n      number of calls, at most Batch_max.
+ */
+PUBLIC static
+void
+Trampoline::syscall_batch (Mem_space const *space, Call *calls, unsigned n)
+{
+  if (!space->pid() || !n)
+    return;
+
+  if (Entry_page *e = space->entry_page())
+    e->host_batch (space->pid(), calls, n);
+  else
+    for (unsigned i = 0; i < n; ++i)
+      calls[i].nr = syscall (space->pid(), calls[i].nr, calls[i].ebx,
+                             calls[i].ecx, calls[i].edx, calls[i].esi,
+                             calls[i].edi, calls[i].ebp);
 }
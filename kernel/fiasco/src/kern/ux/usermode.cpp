@@ -5,6 +5,9 @@ INTERFACE:
 #include "initcalls.h"
 #include "types.h"
 
+class Context;
+class Entry_page;
+
 class Usermode
 {};
 
@@ -34,6 +37,7 @@ IMPLEMENTATION:
 #include "config_tcbsize.h"
 #include "context.h"
 #include "emulation.h"
+#include "entry_page.h"
 #include "fpu.h"
 #include "globals.h"
 #include "mem_layout.h"
@@ -443,6 +447,267 @@ Usermode::user_emulation(Cpu_number _cpu, int stop, pid_t pid,
   return true;
 }
 
+/**
+ * Run a traced task until its next kernel entry.
+ * @param regs user registers, updated on return
+ */
+PRIVATE static inline NOEXPORT
+void
+Usermode::run_user_ptrace(Cpu_number _cpu, Context *t, pid_t pid,
+                          struct ucontext *context,
+                          struct user_regs_struct *regs)
+{
+  // ptrace will return with an error if we try to load invalid values to
+  // segment registers
+  int r = ptrace (PTRACE_SETREGS, pid, NULL, regs);
+  if (EXPECT_FALSE(r == -EPERM))
+    {
+      WARN("Failure setting registers, probably invalid segment values.\n"
+           "        Fixing up!\n");
+      regs->xds = Cpu::kern_ds();
+      regs->xes = Cpu::kern_es();
+      regs->xgs = 0;
+      check(ptrace (PTRACE_SETREGS, pid, NULL, regs));
+    }
+  else
+    assert(r == 0);
+
+  Fpu::restore_state (t->fpu_state());
+
+  for (;;)
+    {
+      ptrace (t->is_native() ? PTRACE_CONT :  PTRACE_SYSCALL, pid, NULL, NULL);
+
+      int stop = wait_for_stop (pid);
+
+      if (EXPECT_FALSE (stop == SIGWINCH || stop == SIGTERM || stop == SIGINT))
+        continue;
+
+      check(ptrace (PTRACE_GETREGS, pid, NULL, regs) == 0);
+
+      if (EXPECT_TRUE (user_emulation (_cpu, stop, pid, context, regs)))
+        break;
+    }
+
+  Fpu::save_state (t->fpu_state());
+}
+
+PRIVATE static inline NOEXPORT
+void
+Usermode::regs_from_frame(struct user_regs_struct *regs, mcontext_t const *m)
+{
+  regs->eip    = m->gregs[REG_EIP];
+  regs->xcs    = m->gregs[REG_CS];
+  regs->eflags = m->gregs[REG_EFL];
+  regs->esp    = m->gregs[REG_ESP];
+  regs->xss    = m->gregs[REG_SS];
+  regs->eax    = m->gregs[REG_EAX];
+  regs->ebx    = m->gregs[REG_EBX];
+  regs->ecx    = m->gregs[REG_ECX];
+  regs->edx    = m->gregs[REG_EDX];
+  regs->esi    = m->gregs[REG_ESI];
+  regs->edi    = m->gregs[REG_EDI];
+  regs->ebp    = m->gregs[REG_EBP];
+  regs->xds    = m->gregs[REG_DS];
+  regs->xes    = m->gregs[REG_ES];
+  regs->xfs    = m->gregs[REG_FS];
+  regs->xgs    = m->gregs[REG_GS];
+}
+
+PRIVATE static inline NOEXPORT
+void
+Usermode::regs_to_frame(mcontext_t *m, struct user_regs_struct const *regs)
+{
+  m->gregs[REG_EIP] = regs->eip;
+  m->gregs[REG_CS]  = regs->xcs;
+  m->gregs[REG_EFL] = regs->eflags;
+  m->gregs[REG_ESP] = regs->esp;
+  m->gregs[REG_SS]  = regs->xss;
+  m->gregs[REG_EAX] = regs->eax;
+  m->gregs[REG_EBX] = regs->ebx;
+  m->gregs[REG_ECX] = regs->ecx;
+  m->gregs[REG_EDX] = regs->edx;
+  m->gregs[REG_ESI] = regs->esi;
+  m->gregs[REG_EDI] = regs->edi;
+  m->gregs[REG_EBP] = regs->ebp;
+  m->gregs[REG_DS]  = regs->xds;
+  m->gregs[REG_ES]  = regs->xes;
+  m->gregs[REG_FS]  = regs->xfs;
+  m->gregs[REG_GS]  = regs->xgs;
+}
+
+/**
+ * Read user memory of a task that does not run under ptrace.
+ * The memory was just used by the task, so it is mapped.
+ */
+PRIVATE static inline NOEXPORT
+Mword
+Usermode::peek_at_space (Context *t, Address addr, unsigned n)
+{
+  Mword val = 0;
+
+  t->vcpu_aware_space()->read_mapped (addr, &val, n);
+
+  return val;
+}
+
+/**
+ * Decode the kernel entry of a task with an entry page.
+ * Same as user_emulation() and user_exception() for traced tasks, but
+ * trap number, error code and fault address come from the signal context
+ * the task's entry code left in the entry page.
+ * @return false if the task shall continue without entering the kernel.
+ */
+PRIVATE static inline NOEXPORT NEEDS["thread_state.h"]
+bool
+Usermode::user_emulation_shm(Cpu_number _cpu, Context *t, Entry_page *e,
+                             pid_t pid, struct ucontext *context,
+                             struct user_regs_struct *regs)
+{
+  mcontext_t const *m = &e->context()->uc_mcontext;
+  Mword trap, error = 0, addr = 0;
+
+  switch (e->signal())
+    {
+      case SIGSEGV:
+        if ((trap = kip_syscall (regs->eip)))
+          {
+            // See user_exception()
+            if (EXPECT_FALSE((t->state() & (Thread_alien | Thread_dis_alien))
+                             == Thread_alien || t->space_ref()->user_mode()))
+              regs->eip += 2;
+            else
+              {
+                regs->eip  = peek_at_space (t, regs->esp, 4);
+                regs->esp += 4;
+              }
+            break;
+          }
+
+        trap  = m->gregs[REG_TRAPNO];
+        error = m->gregs[REG_ERR];
+        addr  = m->cr2;
+
+        // 'int X' on a gate with DPL 0 faults with error code X << 3 | 2
+        if (trap == 0xd && (error & 7) == 2
+            && Emulation::idt_vector (error >> 3, true))
+          {
+            trap       = error >> 3;
+            error      = 0;
+            regs->eip += 2;
+            break;
+          }
+
+        switch (trap)
+          {
+            case 0xd:
+              if (Boot_info::emulate_clisti())
+                switch (peek_at_space (t, regs->eip, 1))
+                  {
+                    case 0xfa:	// cli
+                      Pic::set_owner (Boot_info::pid());
+                      regs->eip++;
+                      regs->eflags &= ~EFLAGS_IF;
+                      sync_interrupt_state (0, regs->eflags);
+                      return false;
+
+                    case 0xfb:	// sti
+                      Pic::set_owner (pid);
+                      regs->eip++;
+                      regs->eflags |= EFLAGS_IF;
+                      sync_interrupt_state (0, regs->eflags);
+                      return false;
+                  }
+              break;
+
+            case 0xe:
+              error |= PF_ERR_USERADDR;
+              break;
+          }
+        break;
+
+      case SIGSYS:
+        // Host system call outside the entry code, caught by seccomp
+        if (t->is_native())
+          {
+            regs->eax = e->host_call (pid, regs->eax, regs->ebx, regs->ecx,
+                                      regs->edx, regs->esi, regs->edi,
+                                      regs->ebp);
+            return false;
+          }
+
+        trap       = 0xd;
+        error      = 0x80 << 3 | 2;
+        regs->eip -= 2;
+        break;
+
+      case SIGIO:
+        int irq_pend;
+        if ((irq_pend = Pic::irq_pending()) == -1)
+          return false;
+        Pic::eat (irq_pend);
+        trap = Pic::map_irq_to_gate (irq_pend);
+        break;
+
+      case SIGTRAP:
+        trap = m->gregs[REG_TRAPNO] == 0x3 ? 0x3 : 0x1;
+        break;
+
+      case SIGILL:
+        trap = 0x6;
+        break;
+
+      case SIGFPE:
+        trap = 0x10;
+        break;
+
+      default:
+        trap = 0x1;
+        break;
+    }
+
+  kernel_entry (_cpu, context, trap,
+                regs->xss,      /* XSS */
+                regs->esp,	/* ESP */
+                regs->eflags,   /* EFL */
+                regs->xcs,      /* XCS */
+                regs->eip,      /* EIP */
+                error,          /* ERR */
+                addr);          /* CR2 */
+
+  return true;
+}
+
+/**
+ * Run a task with an entry page until its next kernel entry.
+ * The task is parked in its entry code, registers and FPU state are
+ * exchanged through its signal context.
+ * @param regs user registers, updated on return
+ */
+PRIVATE static inline NOEXPORT
+void
+Usermode::run_user_shm(Cpu_number _cpu, Context *t, Entry_page *e, pid_t pid,
+                       struct ucontext *context,
+                       struct user_regs_struct *regs)
+{
+  regs_to_frame (&e->context()->uc_mcontext, regs);
+  e->load_fpu (e->context(), t->fpu_state());
+
+  for (;;)
+    {
+      e->resume (pid);
+
+      regs_from_frame (regs, &e->context()->uc_mcontext);
+
+      if (EXPECT_TRUE (user_emulation_shm (_cpu, t, e, pid, context, regs)))
+        break;
+
+      regs_to_frame (&e->context()->uc_mcontext, regs);
+    }
+
+  e->store_fpu (e->context(), t->fpu_state());
+}
+
 /**
  * IRET to a user context.
  * We restore the saved context on the stack, namely EIP, CS, EFLAGS, ESP, SS.
@@ -459,6 +724,9 @@ Usermode::iret_to_user_mode(Cpu_number _cpu,
   Context *t = context_of (kesp);
   pid_t pid = t->vcpu_aware_space()->pid();
 
+  // The task must see its current address space
+  t->vcpu_aware_space()->sync_host();
+
   Pic::set_owner (pid);
 
   /*
@@ -504,37 +772,10 @@ Usermode::iret_to_user_mode(Cpu_number _cpu,
   regs.xfs    = Cpu::get_fs();
   regs.xgs    = Cpu::get_gs();
 
-  // ptrace will return with an error if we try to load invalid values to
-  // segment registers
-  int r = ptrace (PTRACE_SETREGS, pid, NULL, &regs);
-  if (EXPECT_FALSE(r == -EPERM))
-    {
-      WARN("Failure setting registers, probably invalid segment values.\n"
-           "        Fixing up!\n");
-      regs.xds = Cpu::kern_ds();
-      regs.xes = Cpu::kern_es();
-      regs.xgs = 0;
-      check(ptrace (PTRACE_SETREGS, pid, NULL, &regs));
-    }
+  if (Entry_page *e = t->vcpu_aware_space()->entry_page())
+    run_user_shm (_cpu, t, e, pid, context, &regs);
   else
-    assert(r == 0);
-
-  Fpu::restore_state (t->fpu_state());
-
-  for (;;)
-    {
-      ptrace (t->is_native() ? PTRACE_CONT :  PTRACE_SYSCALL, pid, NULL, NULL);
-
-      int stop = wait_for_stop (pid);
-
-      if (EXPECT_FALSE (stop == SIGWINCH || stop == SIGTERM || stop == SIGINT))
-        continue;
-
-      check(ptrace (PTRACE_GETREGS, pid, NULL, &regs) == 0);
-
-      if (EXPECT_TRUE (user_emulation (_cpu, stop, pid, context, &regs)))
-        break;
-    }
+    run_user_ptrace (_cpu, t, pid, context, &regs);
 
   Pic::set_owner (Boot_info::pid());
 
@@ -552,8 +793,6 @@ Usermode::iret_to_user_mode(Cpu_number _cpu,
   context->uc_mcontext.gregs[REG_ES]  = regs.xes;
   Cpu::set_fs(regs.xfs);
   Cpu::set_gs(regs.xgs);
-
-  Fpu::save_state (t->fpu_state());
 }
 
 /**
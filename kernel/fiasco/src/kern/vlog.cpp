@@ -1,6 +1,7 @@
 INTERFACE:
 
 #include "icu_helper.h"
+#include "per_cpu_data.h"
 
 class Irq;
 
@@ -28,10 +29,40 @@ public:
   };
 
 private:
+  /**
+   * Per-CPU buffer for log output.
+   *
+   * log_string() only appends to the ring of the current CPU, the idle
+   * thread of that CPU writes the ring to the console.  So that a CPU
+   * that rarely gets idle does not keep its output forever, its timer
+   * tick also writes a small chunk when the ring is half full or has
+   * waited for Stale_ticks ticks.  A writer that finds the ring full
+   * drops the rest of its string and counts it.
+   */
+  struct Log_ring
+  {
+    enum
+    {
+      Size        = 4096, ///< power of two
+      Tick_chunk  = 16,   ///< most characters written per timer tick
+      Stale_ticks = 10,
+    };
+
+    Mword head;    ///< next character to output
+    Mword tail;    ///< next free slot
+    Mword dropped; ///< characters dropped since the last drain
+    Mword lost;    ///< characters dropped in total
+    Mword stale;   ///< timer ticks since the last drain
+    bool draining; ///< the idle thread is writing the ring
+    char buf[Size];
+  };
+
   Irq_base *_irq;
   Mword _i_flags;
   Mword _o_flags;
   Mword _l_flags;
+
+  static Per_cpu<Log_ring> _ring;
 };
 
 IMPLEMENTATION:
@@ -44,10 +75,14 @@ IMPLEMENTATION:
 #include "vkey.h"
 #include "irq.h"
 #include "irq_controller.h"
+#include "lock_guard.h"
+#include "simpleio.h"
 
 
 FIASCO_DEFINE_KOBJ(Vlog);
 
+DEFINE_PER_CPU Per_cpu<Vlog::Log_ring> Vlog::_ring;
+
 PUBLIC
 Vlog::Vlog()
 : _irq(0),
@@ -77,6 +112,9 @@ Vlog::log_string(Syscall_frame *f, Utcb const *u)
   if (len > sizeof(u->values) - sizeof(u->values[0]) * 2)
     return;
 
+  auto guard = lock_guard(cpu_lock);
+  Log_ring *r = &_ring.current();
+
   while (len--)
     {
       int c = *str++;
@@ -93,10 +131,118 @@ Vlog::log_string(Syscall_frame *f, Utcb const *u)
       if (_o_flags & F_ONLRET && c == '\r')
 	continue;
 
-      putchar(c);
+      if (EXPECT_FALSE(r->tail - r->head >= Log_ring::Size))
+        {
+          r->dropped += len + 1;
+          r->lost += len + 1;
+          break;
+        }
+
+      r->buf[r->tail++ & (Log_ring::Size - 1)] = c;
+    }
+}
+
+/**
+ * Write the log buffer of the current CPU to the console.
+ *
+ * Called by the idle thread with interrupts enabled, the console is only
+ * written to with the CPU lock released.  Meanwhile the timer tick keeps
+ * off the ring, so the output stays in order.
+ */
+PUBLIC static
+void
+Vlog::drain()
+{
+  Log_ring *r = &_ring.current();
+  if (access_once(&r->head) == access_once(&r->tail)
+      && !access_once(&r->dropped))
+    return;
+
+  for (;;)
+    {
+      char b[64];
+      unsigned n = 0;
+      Mword dropped = 0;
+
+        {
+          auto guard = lock_guard(cpu_lock);
+          r->draining = true;
+          while (n < sizeof(b) && r->head != r->tail)
+            b[n++] = r->buf[r->head++ & (Log_ring::Size - 1)];
+
+          if (!n)
+            {
+              dropped = r->dropped;
+              r->dropped = 0;
+              r->stale = 0;
+              r->draining = false;
+            }
+        }
+
+      if (n)
+        {
+          putnstr(b, n);
+          continue;
+        }
+
+      if (dropped)
+        printf("\n[vlog: %lu characters dropped]\n", dropped);
+      return;
+    }
+}
+
+/**
+ * Write a chunk of the log buffer of the current CPU from its timer tick,
+ * if the idle thread did not get to it for a while.
+ * \pre cpu_lock held.
+ */
+PUBLIC static
+void
+Vlog::timer_tick()
+{
+  Log_ring *r = &_ring.current();
+  if (EXPECT_TRUE(r->head == r->tail && !r->dropped) || r->draining)
+    return;
+
+  if (r->tail - r->head < Log_ring::Size / 2
+      && ++r->stale < Log_ring::Stale_ticks)
+    return;
+
+  r->stale = 0;
+
+  char b[Log_ring::Tick_chunk];
+  unsigned n = 0;
+  while (n < sizeof(b) && r->head != r->tail)
+    b[n++] = r->buf[r->head++ & (Log_ring::Size - 1)];
+
+  if (n)
+    putnstr(b, n);
+  else
+    {
+      printf("\n[vlog: %lu characters dropped]\n", r->dropped);
+      r->dropped = 0;
     }
 }
 
+/**
+ * Print the unwritten part of the log buffer of the online CPU \a cpu,
+ * without consuming it.  For the kernel debugger.
+ */
+PUBLIC static
+void
+Vlog::dump_ring(Cpu_number cpu)
+{
+  Log_ring const *r = &_ring.cpu(cpu);
+  printf("CPU%u: %lu characters pending, %lu dropped\n",
+         cxx::int_value<Cpu_number>(cpu), r->tail - r->head, r->lost);
+
+  for (Mword i = r->head; i != r->tail; ++i)
+    putchar(r->buf[i & (Log_ring::Size - 1)]);
+
+  if (r->head != r->tail)
+    putchar('\n');
+}
+
 PRIVATE inline NOEXPORT
 L4_msg_tag
 Vlog::get_input(L4_fpage::Rights rights, Syscall_frame *f, Utcb *u)
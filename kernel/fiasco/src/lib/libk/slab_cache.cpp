@@ -1,6 +1,6 @@
 INTERFACE:
 
-#include <spin_lock.h>
+#include <queued_spin_lock.h>
 #include <cxx/hlist>
 #include <cxx/slist>
 #include <auto_quota.h>
@@ -50,7 +50,7 @@ private:
   unsigned long _slab_size;
   unsigned _entry_size, _elem_num;
   unsigned _num_empty;
-  typedef Spin_lock<> Lock;
+  typedef Mcs_spin_lock Lock;
   Lock lock;
   char const *_name;
 };
@@ -147,6 +147,11 @@ unsigned
 Slab_cache::entry_size(unsigned elem_size, unsigned alignment)
 { return (elem_size + alignment - 1) & ~(alignment - 1); }
 
+PUBLIC inline
+unsigned
+Slab_cache::entry_size() const
+{ return _entry_size; }
+
 // 
 // Slab_cache
 // 
@@ -193,6 +198,15 @@ Slab_cache::~Slab_cache()
   // assert(_first_slab == 0);
 }
 
+/**
+ * Name the slab lock in the lock statistics.  Only for caches that are
+ * never destroyed.
+ */
+PROTECTED inline
+void
+Slab_cache::register_lock_stats()
+{ lock.register_stats(_name, "slab"); }
+
 PROTECTED inline
 void
 Slab_cache::destroy()	// descendant should call this in destructor
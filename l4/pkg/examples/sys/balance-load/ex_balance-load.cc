@@ -0,0 +1,122 @@
+/*
+ * This file is licensed under the terms of the GNU General Public License 2.
+ * See file COPYING-GPL-2 for details.
+ */
+
+/*
+ * Load generator for the scheduler balancing in moe.
+ *
+ * Starts two worker threads per CPU, all of them allowed to run on any
+ * CPU: half of them compute all the time, the other half compute for a
+ * millisecond and then sleep for three.  As threads start out on the CPU
+ * of their creator, the load is uneven unless something moves them.  The
+ * work done per second is printed for a couple of seconds, so the effect
+ * of moe balancing the load (moe --balance=<ms>) is directly visible.
+ */
+#include <l4/re/env>
+#include <l4/re/error_helper>
+#include <l4/sys/scheduler>
+#include <l4/sys/kip.h>
+
+#include <thread>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+enum
+{
+  Default_run_s = 10,
+  Busy_us = 1000,
+  Sleep_us = 3000,
+  Chunk = 1000,
+  Max_workers = 2 * sizeof(l4_umword_t) * 8,
+};
+
+struct alignas(64) Counter
+{
+  unsigned long volatile n;
+};
+
+static Counter counters[Max_workers];
+static volatile bool done;
+
+static l4_cpu_time_t now()
+{ return l4_kip_clock(l4re_kip()); }
+
+static void spin(Counter *c)
+{
+  for (unsigned i = 0; i < Chunk; ++i)
+    asm volatile ("" : : : "memory");
+  c->n = c->n + 1;
+}
+
+static void heavy(Counter *c)
+{
+  while (!done)
+    spin(c);
+}
+
+static void light(Counter *c)
+{
+  while (!done)
+    {
+      l4_cpu_time_t end = now() + Busy_us;
+      while (now() < end)
+        spin(c);
+      usleep(Sleep_us);
+    }
+}
+
+static unsigned num_cpus()
+{
+  l4_umword_t max;
+  l4_sched_cpu_set_t cpus = l4_sched_cpu_set(0, 0);
+  L4Re::chksys(L4Re::Env::env()->scheduler()->info(&max, &cpus),
+               "Could not query CPUs.");
+  return __builtin_popcountl(cpus.map);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned run_s = argc > 1 ? strtoul(argv[1], 0, 0) : Default_run_s;
+
+  try
+    {
+      unsigned n = 2 * num_cpus();
+      std::vector<std::thread> workers;
+
+      for (unsigned i = 0; i < n; ++i)
+        workers.emplace_back(i & 1 ? light : heavy, &counters[i]);
+
+      printf("%u workers on %u CPUs\n", n, n / 2);
+      printf("%6s %16s\n", "second", "work/s");
+
+      unsigned long last = 0, total = 0;
+      for (unsigned s = 1; s <= run_s; ++s)
+        {
+          sleep(1);
+          unsigned long sum = 0;
+          for (unsigned i = 0; i < n; ++i)
+            sum += counters[i].n;
+          printf("%6u %16lu\n", s, sum - last);
+          last = sum;
+          total = sum;
+        }
+
+      done = true;
+      for (auto &t: workers)
+        t.join();
+
+      printf("average %lu work/s\n", run_s ? total / run_s : 0);
+      printf("balance-load finished.\n");
+      return 0;
+    }
+  catch (L4::Runtime_error &e)
+    {
+      fprintf(stderr, "Runtime error: %s.\n", e.str());
+    }
+
+  return 1;
+}
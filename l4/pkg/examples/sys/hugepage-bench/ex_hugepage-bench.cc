@@ -0,0 +1,138 @@
+/*
+ * This file is licensed under the terms of the GNU General Public License 2.
+ * See file COPYING-GPL-2 for details.
+ */
+
+/*
+ * Random-access benchmark for dataspaces backed by super pages.
+ *
+ * Allocates a working set from moe once with small pages and once with
+ * the Super_pages flag, attaches it super-page aligned and reads random
+ * words of it.  With small pages nearly every access misses the TLB once
+ * the working set exceeds a few MB; with super pages moe answers the page
+ * faults with super-page mappings and the whole working set fits into the
+ * TLB.  The third round attaches the super-page dataspace at an address
+ * that is not super-page aligned, so moe has to fall back to small
+ * mappings of the super pages.
+ */
+#include <l4/re/env>
+#include <l4/re/error_helper>
+#include <l4/re/util/cap_alloc>
+#include <l4/sys/task>
+#include <l4/util/rdtsc.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+enum
+{
+  Default_mb = 64,
+  Accesses = 1 << 24,
+};
+
+struct Mapping
+{
+  L4::Cap<L4Re::Dataspace> ds;
+  l4_addr_t base;
+};
+
+static Mapping attach(unsigned long size, bool huge, bool aligned)
+{
+  Mapping m;
+  m.ds = L4Re::chkcap(L4Re::Util::cap_alloc.alloc<L4Re::Dataspace>());
+  L4Re::chksys(L4Re::Env::env()->mem_alloc()->alloc(size, m.ds,
+                 huge ? L4Re::Mem_alloc::Super_pages : 0),
+               "Could not allocate memory.");
+
+  // reserve one more super page, so that we can also attach off by a page
+  l4_addr_t area = 0;
+  L4Re::chksys(L4Re::Env::env()->rm()->reserve_area(&area,
+                 size + L4_SUPERPAGESIZE, L4Re::Rm::Search_addr,
+                 L4_SUPERPAGESHIFT),
+               "Could not reserve an area.");
+
+  m.base = area + (aligned ? 0 : L4_PAGESIZE);
+  L4Re::chksys(L4Re::Env::env()->rm()->attach(&m.base, size,
+                 L4Re::Rm::In_area, m.ds),
+               "Could not attach memory.");
+
+  // fault in the whole working set before measuring
+  for (unsigned long o = 0; o < size; o += L4_PAGESIZE)
+    *(char volatile *)(m.base + o) = 1;
+
+  return m;
+}
+
+static void detach(Mapping const &m)
+{
+  L4Re::Env::env()->rm()->detach(m.base, 0);
+  L4Re::Env::env()->rm()->free_area(l4_trunc_size(m.base, L4_SUPERPAGESHIFT));
+  L4Re::Env::env()->task()->unmap(m.ds.fpage(), L4_FP_ALL_SPACES);
+  L4Re::Util::cap_alloc.free(m.ds);
+}
+
+/* Read Accesses random words of the mapping, return the TSC ticks. */
+static l4_cpu_time_t walk(Mapping const &m, unsigned long size)
+{
+  unsigned long mask = size / sizeof(unsigned long) - 1;
+  unsigned long const volatile *w = (unsigned long const volatile *)m.base;
+  l4_uint32_t x = 2463534242U;
+  unsigned long sum = 0;
+
+  l4_cpu_time_t start = l4_rdtsc();
+  for (unsigned i = 0; i < Accesses; ++i)
+    {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      sum += w[x & mask];
+    }
+  l4_cpu_time_t end = l4_rdtsc();
+
+  asm volatile ("" : : "r" (sum));
+  return end - start;
+}
+
+static void measure(char const *name, unsigned long size, bool huge,
+                    bool aligned)
+{
+  Mapping m = attach(size, huge, aligned);
+  walk(m, size);
+  l4_cpu_time_t t = walk(m, size);
+  detach(m);
+
+  unsigned long long ns = l4_tsc_to_ns(t);
+  printf("%-22s %12llu %12llu\n", name, ns * 1000 / Accesses,
+         ns ? Accesses * 1000ULL / ns : 0);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long mb = argc > 1 ? strtoul(argv[1], 0, 0) : Default_mb;
+  if (!mb || (mb & (mb - 1)))
+    {
+      fprintf(stderr, "usage: %s [working set in MB, power of 2]\n", argv[0]);
+      return 1;
+    }
+
+  try
+    {
+      l4_calibrate_tsc(l4re_kip());
+      unsigned long size = mb << 20;
+
+      printf("%lu MB working set, %u random reads\n", mb, (unsigned)Accesses);
+      printf("%-22s %12s %12s\n", "pages", "ps/access", "Maccess/s");
+      measure("small", size, false, true);
+      measure("super", size, true, true);
+      measure("super, misaligned", size, true, false);
+
+      printf("hugepage benchmark finished.\n");
+      return 0;
+    }
+  catch (L4::Runtime_error &e)
+    {
+      fprintf(stderr, "Runtime error: %s.\n", e.str());
+    }
+
+  return 1;
+}
@@ -0,0 +1,152 @@
+/**
+ * \file
+ * \brief Cross-CPU IPC ping-pong benchmark.
+ *
+ * A client thread calls a server thread with short messages, once with both
+ * threads on the same CPU and then with the server on each of the other
+ * available CPUs. For each placement the round-trip latency and the
+ * resulting number of round trips per second are printed. Cross-CPU IPC
+ * goes through the DRQ mechanism of the kernel and is much cheaper when
+ * the idle thread of the server's CPU polls for requests instead of
+ * waiting for an IPI.
+ */
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#include <l4/sys/ipc.h>
+#include <l4/sys/scheduler.h>
+#include <l4/util/rdtsc.h>
+#include <l4/re/env.h>
+
+#include <pthread-l4.h>
+#include <stdio.h>
+
+enum
+{
+  Warmup = 1000,
+  Rounds = 100000,
+  Runs   = 3,
+  Prio   = 20,
+};
+
+static pthread_t server;
+
+static void *server_fn(void *arg)
+{
+  l4_msgtag_t tag;
+  l4_umword_t label;
+  (void)arg;
+
+  tag = l4_ipc_wait(l4_utcb(), &label, L4_IPC_NEVER);
+  while (1)
+    {
+      if (l4_ipc_error(tag, l4_utcb()))
+        {
+          tag = l4_ipc_wait(l4_utcb(), &label, L4_IPC_NEVER);
+          continue;
+        }
+
+      tag = l4_ipc_reply_and_wait(l4_utcb(), l4_msgtag(0, 1, 0, 0),
+                                  &label, L4_IPC_NEVER);
+    }
+  return NULL;
+}
+
+static int move_thread(l4_cap_idx_t thread, unsigned cpu)
+{
+  l4_sched_param_t sp = l4_sched_param(Prio, 0);
+  sp.affinity = l4_sched_cpu_set(cpu, 0, 1);
+  return l4_error(l4_scheduler_run_thread(l4re_env()->scheduler, thread, &sp));
+}
+
+static int pingpong(unsigned rounds)
+{
+  l4_cap_idx_t srv = pthread_getl4cap(server);
+  unsigned i;
+
+  for (i = 0; i < rounds; i++)
+    {
+      l4_utcb_mr()->mr[0] = i;
+      if (l4_ipc_error(l4_ipc_call(srv, l4_utcb(), l4_msgtag(0, 1, 0, 0),
+                                   L4_IPC_NEVER), l4_utcb()))
+        return 1;
+    }
+  return 0;
+}
+
+static int bench(unsigned cpu)
+{
+  l4_cpu_time_t start, end, best = ~0ULL;
+  unsigned run;
+
+  if (move_thread(pthread_getl4cap(server), cpu))
+    {
+      fprintf(stderr, "Cannot move server to CPU %u\n", cpu);
+      return 1;
+    }
+
+  if (pingpong(Warmup))
+    return 1;
+
+  for (run = 0; run < Runs; run++)
+    {
+      start = l4_rdtsc();
+      if (pingpong(Rounds))
+        return 1;
+      end = l4_rdtsc();
+
+      if (end - start < best)
+        best = end - start;
+    }
+
+  printf("server on CPU %2u: %8llu ns per round trip, %9llu round trips/s\n",
+         cpu, l4_tsc_to_ns(best) / Rounds,
+         Rounds * 1000000000ULL / l4_tsc_to_ns(best));
+  return 0;
+}
+
+int main(void)
+{
+  l4_sched_cpu_set_t cs = l4_sched_cpu_set(0, 0, 1);
+  l4_umword_t cpu_max;
+  unsigned cpu;
+
+  l4_calibrate_tsc(l4re_kip());
+
+  if (l4_error(l4_scheduler_info(l4re_env()->scheduler, &cpu_max, &cs)) < 0)
+    {
+      fprintf(stderr, "Cannot query CPUs\n");
+      return 1;
+    }
+
+  if (pthread_create(&server, NULL, server_fn, NULL))
+    {
+      fprintf(stderr, "Thread creation failed\n");
+      return 1;
+    }
+
+  if (move_thread(pthread_getl4cap(pthread_self()), 0))
+    {
+      fprintf(stderr, "Cannot move client to CPU 0\n");
+      return 1;
+    }
+
+  printf("client on CPU 0, best of %u runs with %u round trips each\n",
+         Runs, Rounds);
+
+  for (cpu = 0; cpu < cpu_max && cpu < L4_MWORD_BITS; cpu++)
+    {
+      if (!(cs.map & (1UL << cpu)))
+        continue;
+
+      if (bench(cpu))
+        {
+          fprintf(stderr, "IPC error\n");
+          return 1;
+        }
+    }
+
+  return 0;
+}
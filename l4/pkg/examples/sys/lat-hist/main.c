@@ -0,0 +1,210 @@
+/**
+ * \file
+ * \brief Print the kernel latency histograms.
+ *
+ * A kernel built with CONFIG_LATENCY_HIST (which needs CONFIG_JDB) keeps
+ * per-CPU histograms of the latencies of IPC calls, replies, page faults,
+ * map and unmap operations, thread switches and IRQ deliveries, which
+ * every task can read. This program sums them up over all CPUs and
+ * prints, for every interval, the number of operations of each kind and
+ * upper bounds of their median, 99th percentile and maximum latency. With
+ * -d it dumps the raw counters of every CPU instead and exits.
+ *
+ * Usage: ex_lat-hist [-d] [interval_s]
+ */
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#include <l4/re/env.h>
+#include <l4/sys/ktrace.h>
+#include <l4/util/rdtsc.h>
+#include <l4/util/util.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+  Max_kinds   = 16,
+  Max_buckets = 64,
+};
+
+static char const *const kind_names[] =
+{
+  [L4_LAT_HIST_IPC_CALL]       = "ipc call",
+  [L4_LAT_HIST_IPC_REPLY_WAIT] = "reply+wait",
+  [L4_LAT_HIST_PAGE_FAULT]     = "page fault",
+  [L4_LAT_HIST_MAP]            = "map",
+  [L4_LAT_HIST_UNMAP]          = "unmap",
+  [L4_LAT_HIST_THREAD_SWITCH]  = "switch",
+  [L4_LAT_HIST_IRQ]            = "irq",
+};
+
+static l4_umword_t last[Max_kinds][Max_buckets];
+static l4_umword_t cur[Max_kinds][Max_buckets];
+
+static char const *kind_name(unsigned k)
+{
+  static char buf[16];
+  if (k < sizeof(kind_names) / sizeof(kind_names[0]) && kind_names[k])
+    return kind_names[k];
+  snprintf(buf, sizeof(buf), "kind %u", k);
+  return buf;
+}
+
+static volatile l4_umword_t const *
+row(l4_tracebuffer_lat_hist_t const *lh, unsigned cpu, unsigned k)
+{
+  return (volatile l4_umword_t const *)((char const *)lh->hist
+                                        + cpu * lh->cpu_stride)
+         + k * lh->num_buckets;
+}
+
+/* Upper bound of bucket b in ns. */
+static unsigned long long bound_ns(unsigned b)
+{ return l4_tsc_to_ns(2ULL << b); }
+
+static void sum(l4_tracebuffer_lat_hist_t const *lh,
+                l4_umword_t h[Max_kinds][Max_buckets])
+{
+  unsigned c, k, b;
+
+  memset(h, 0, sizeof(l4_umword_t) * Max_kinds * Max_buckets);
+  for (c = 0; c < lh->num_cpus; ++c)
+    for (k = 0; k < lh->num_kinds; ++k)
+      {
+        volatile l4_umword_t const *r = row(lh, c, k);
+        for (b = 0; b < lh->num_buckets; ++b)
+          h[k][b] += r[b];
+      }
+}
+
+/* Bucket holding the event at the given per mille of n events. */
+static unsigned percentile(l4_umword_t const *h, unsigned buckets,
+                           l4_umword_t n, unsigned permille)
+{
+  unsigned long long want = ((unsigned long long)n * permille + 999) / 1000;
+  l4_umword_t seen = 0;
+  unsigned b;
+
+  for (b = 0; b < buckets; ++b)
+    {
+      seen += h[b];
+      if (seen >= want)
+        return b;
+    }
+  return buckets - 1;
+}
+
+static void print_interval(l4_tracebuffer_lat_hist_t const *lh)
+{
+  l4_umword_t d[Max_buckets];
+  unsigned k, b;
+
+  printf("%-10s %10s %12s %12s %12s\n", "", "events",
+         "p50 ns <=", "p99 ns <=", "max ns <=");
+  for (k = 0; k < lh->num_kinds; ++k)
+    {
+      l4_umword_t n = 0;
+      unsigned max = 0;
+
+      for (b = 0; b < lh->num_buckets; ++b)
+        {
+          d[b] = cur[k][b] - last[k][b];
+          n += d[b];
+          if (d[b])
+            max = b;
+        }
+
+      if (!n)
+        continue;
+
+      printf("%-10s %10lu %12llu %12llu %12llu\n", kind_name(k), n,
+             bound_ns(percentile(d, lh->num_buckets, n, 500)),
+             bound_ns(percentile(d, lh->num_buckets, n, 990)),
+             bound_ns(max));
+    }
+}
+
+static void dump(l4_tracebuffer_lat_hist_t const *lh)
+{
+  unsigned c, k, b;
+
+  for (c = 0; c < lh->num_cpus; ++c)
+    for (k = 0; k < lh->num_kinds; ++k)
+      {
+        volatile l4_umword_t const *r = row(lh, c, k);
+        int any = 0;
+
+        for (b = 0; b < lh->num_buckets; ++b)
+          {
+            if (!r[b])
+              continue;
+            if (!any)
+              printf("cpu %u %s:", c, kind_name(k));
+            printf(" <=%lluns:%lu", bound_ns(b), r[b]);
+            any = 1;
+          }
+
+        if (any)
+          printf("\n");
+      }
+}
+
+int main(int argc, char **argv)
+{
+  l4_tracebuffer_lat_hist_t const *lh = fiasco_tbuf_get_lat_hist();
+  unsigned long interval = 1;
+  int dump_only = 0;
+  int a = 1;
+
+  if (a < argc && !strcmp(argv[a], "-d"))
+    {
+      dump_only = 1;
+      ++a;
+    }
+  if (a < argc)
+    interval = strtoul(argv[a], NULL, 0);
+  if (!interval)
+    {
+      fprintf(stderr, "Usage: %s [-d] [interval_s]\n", argv[0]);
+      return 1;
+    }
+
+  if (!lh->hist)
+    {
+      fprintf(stderr, "Kernel keeps no latency histograms "
+                      "(CONFIG_LATENCY_HIST)\n");
+      return 1;
+    }
+
+  if (lh->num_kinds > Max_kinds || lh->num_buckets > Max_buckets)
+    {
+      fprintf(stderr, "Unexpected histogram layout (%lu kinds, %lu buckets)\n",
+              lh->num_kinds, lh->num_buckets);
+      return 1;
+    }
+
+  l4_calibrate_tsc(l4re_kip());
+
+  if (dump_only)
+    {
+      dump(lh);
+      return 0;
+    }
+
+  sum(lh, last);
+  for (;;)
+    {
+      l4_sleep(interval * 1000);
+      sum(lh, cur);
+      printf("--- last %lu s\n", interval);
+      print_interval(lh);
+      memcpy(last, cur, sizeof(last));
+    }
+
+  return 0;
+}
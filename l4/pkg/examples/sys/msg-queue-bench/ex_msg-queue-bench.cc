@@ -0,0 +1,196 @@
+/*
+ * This file is licensed under the terms of the GNU General Public License 2.
+ * See file COPYING-GPL-2 for details.
+ */
+
+/*
+ * Message-queue throughput benchmark.
+ *
+ * A producer pushes a fixed number of messages through an
+ * L4::Msg_queue_ring while a consumer thread pops them, blocking on the
+ * message queue only when the ring runs empty or full.  For comparison
+ * the same number of messages is sent with synchronous IPC calls to a
+ * server thread.  Both are run for a couple of message sizes.
+ */
+#include <l4/re/env>
+#include <l4/re/error_helper>
+#include <l4/re/util/cap_alloc>
+#include <l4/sys/msg_queue>
+#include <l4/sys/factory>
+#include <l4/sys/ipc.h>
+#include <l4/sys/kip.h>
+
+#include <pthread-l4.h>
+#include <thread>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+enum
+{
+  Num_msgs = 1000000,
+  Num_slots = 1024,
+  Max_msg_size = 256,
+};
+
+static l4_cpu_time_t now()
+{ return l4_kip_clock(l4re_kip()); }
+
+static L4::Cap<L4::Thread> self()
+{ return L4::Cap<L4::Thread>(pthread_getl4cap(pthread_self())); }
+
+static unsigned long rate(unsigned long n, l4_cpu_time_t us)
+{ return us ? (unsigned long long)n * 1000000 / us : 0; }
+
+static void consumer(L4::Cap<L4::Msg_queue> q, L4::Msg_queue_ring *ring,
+                     volatile bool *ready, unsigned long *sum)
+{
+  L4Re::chksys(q->attach(L4::Msg_queue::Consumer, 0, self()),
+               "Could not attach consumer.");
+  *ready = true;
+
+  char msg[Max_msg_size];
+  unsigned long s = 0;
+  for (unsigned long i = 0; i < Num_msgs; ++i)
+    {
+      L4Re::chksys(ring->pop(q, msg), "Could not dequeue.");
+      s += *reinterpret_cast<unsigned long *>(msg);
+    }
+
+  *sum = s;
+  L4Re::chksys(q->detach(L4::Msg_queue::Consumer), "Could not detach.");
+}
+
+static unsigned long run_queue(L4::Cap<L4::Msg_queue> q, void *mem,
+                               unsigned long size)
+{
+  L4::Msg_queue_ring *ring = static_cast<L4::Msg_queue_ring *>(mem);
+  ring->init(Num_slots, size);
+
+  L4Re::chksys(q->attach(L4::Msg_queue::Producer, 0, self()),
+               "Could not attach producer.");
+
+  volatile bool ready = false;
+  unsigned long sum = 0;
+  std::thread c([q, ring, &ready, &sum](){ consumer(q, ring, &ready, &sum); });
+  while (!ready)
+    std::this_thread::yield();
+
+  char msg[Max_msg_size];
+  memset(msg, 0, sizeof(msg));
+
+  l4_cpu_time_t start = now();
+  for (unsigned long i = 0; i < Num_msgs; ++i)
+    {
+      *reinterpret_cast<unsigned long *>(msg) = i;
+      L4Re::chksys(ring->push(q, msg), "Could not enqueue.");
+    }
+  c.join();
+  l4_cpu_time_t d = now() - start;
+
+  L4Re::chksys(q->detach(L4::Msg_queue::Producer), "Could not detach.");
+
+  if (sum != (unsigned long long)Num_msgs * (Num_msgs - 1) / 2)
+    printf("message queue lost messages\n");
+
+  return rate(Num_msgs, d);
+}
+
+static void server(volatile bool *ready)
+{
+  l4_umword_t label;
+  *ready = true;
+  l4_msgtag_t tag = l4_ipc_wait(l4_utcb(), &label, L4_IPC_NEVER);
+  for (;;)
+    {
+      if (l4_ipc_error(tag, l4_utcb()))
+        break;
+      if (l4_msgtag_label(tag) == 1)
+        {
+          l4_ipc_send(L4_INVALID_CAP | L4_SYSF_REPLY, l4_utcb(),
+                      l4_msgtag(0, 0, 0, 0), L4_IPC_NEVER);
+          break;
+        }
+      tag = l4_ipc_reply_and_wait(l4_utcb(), l4_msgtag(0, 0, 0, 0), &label,
+                                  L4_IPC_NEVER);
+    }
+}
+
+static unsigned long run_ipc(unsigned long size)
+{
+  volatile bool ready = false;
+  std::thread s([&ready](){ server(&ready); });
+  while (!ready)
+    std::this_thread::yield();
+
+  L4::Cap<L4::Thread> srv(pthread_getl4cap(s.native_handle()));
+  unsigned words = (size + sizeof(l4_umword_t) - 1) / sizeof(l4_umword_t);
+  if (words > L4_UTCB_GENERIC_DATA_SIZE)
+    words = L4_UTCB_GENERIC_DATA_SIZE;
+
+  l4_cpu_time_t start = now();
+  for (unsigned long i = 0; i < Num_msgs; ++i)
+    {
+      l4_utcb_mr()->mr[0] = i;
+      l4_msgtag_t tag = l4_ipc_call(srv.cap(), l4_utcb(),
+                                    l4_msgtag(0, words, 0, 0), L4_IPC_NEVER);
+      if (l4_ipc_error(tag, l4_utcb()))
+        {
+          printf("IPC error %ld\n", l4_ipc_error(tag, l4_utcb()));
+          break;
+        }
+    }
+  l4_cpu_time_t d = now() - start;
+
+  l4_ipc_call(srv.cap(), l4_utcb(), l4_msgtag(1, 0, 0, 0), L4_IPC_NEVER);
+  s.join();
+
+  return rate(Num_msgs, d);
+}
+
+int main()
+{
+  try
+    {
+      static unsigned long const sizes[] = { 8, 64, 256 };
+
+      L4::Cap<L4::Msg_queue> q;
+      q = L4Re::chkcap(L4Re::Util::cap_alloc.alloc<L4::Msg_queue>());
+
+      void *mem;
+      if (posix_memalign(&mem, L4::Msg_queue_ring::Cache_line,
+                         L4::Msg_queue_ring::mem_size(Num_slots,
+                                                      Max_msg_size)))
+        {
+          fprintf(stderr, "Out of memory.\n");
+          return 1;
+        }
+
+      printf("%10s %16s %16s\n", "msg size", "queue msgs/s", "ipc msgs/s");
+
+      for (unsigned long size: sizes)
+        {
+          L4Re::chksys(L4Re::Env::env()->factory()->create_msg_queue(q,
+                                                     Num_slots, size),
+                       "Failed to create message queue.");
+
+          unsigned long qr = run_queue(q, mem, size);
+          unsigned long ir = run_ipc(size);
+          printf("%10lu %16lu %16lu\n", size, qr, ir);
+
+          L4Re::Env::env()->task()->unmap(q.fpage(),
+                                          L4_FP_ALL_SPACES);
+        }
+
+      free(mem);
+      printf("msg-queue benchmark finished.\n");
+      return 0;
+    }
+  catch (L4::Runtime_error &e)
+    {
+      fprintf(stderr, "Runtime error: %s.\n", e.str());
+    }
+
+  return 1;
+}
@@ -0,0 +1,439 @@
+/**
+ * \file
+ * \brief Statistical system-wide profiler.
+ *
+ * Starts the kernel profiler, collects the samples it logs into the
+ * per-CPU segments of the trace buffer for a while, and prints the threads
+ * and code locations that got most of the samples. The profiler samples
+ * every n unhalted CPU cycles if the CPU has a performance counter with
+ * an overflow interrupt, otherwise every n-th timer tick; in the latter
+ * case only the user instruction pointer of the last kernel entry of a
+ * thread is known.
+ *
+ * User addresses are symbolized with the symbol table of rom/<task name>,
+ * so the profiled programs should be linked statically and not stripped.
+ *
+ * Usage: ex_profile [-t] [-p period] [-d seconds] [-n entries]
+ */
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#include <l4/re/env.h>
+#include <l4/re/c/util/cap_alloc.h>
+#include <l4/sys/debugger.h>
+#include <l4/sys/err.h>
+#include <l4/sys/factory.h>
+#include <l4/sys/irq.h>
+#include <l4/sys/kip.h>
+#include <l4/sys/ktrace.h>
+#include <l4/util/util.h>
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __x86_64__
+typedef Elf64_Ehdr Ehdr;
+typedef Elf64_Shdr Shdr;
+typedef Elf64_Sym  Sym;
+#define SYM_TYPE(i) ELF64_ST_TYPE(i)
+#else
+typedef Elf32_Ehdr Ehdr;
+typedef Elf32_Shdr Shdr;
+typedef Elf32_Sym  Sym;
+#define SYM_TYPE(i) ELF32_ST_TYPE(i)
+#endif
+
+enum
+{
+  Chunk       = 64,       /* records copied at once */
+  Slack       = 8,        /* records the kernel may write beyond head */
+  Poll_us     = 100000,   /* check the time at least this often */
+  Hash_size   = 1 << 14,  /* distinct (space, ip) pairs kept */
+  Max_threads = 1024,     /* distinct threads kept */
+  Max_images  = 64,       /* symbol tables kept */
+  Name_len    = 20,
+};
+
+typedef struct
+{
+  l4_umword_t space;
+  l4_umword_t ip;
+  l4_umword_t flags;
+  unsigned long count;
+} Location;
+
+typedef struct
+{
+  l4_umword_t ctx;
+  unsigned long count;
+} Thread;
+
+typedef struct
+{
+  l4_umword_t space;
+  char name[Name_len];
+  char *file;         /* ELF image, 0 if not available */
+  Sym const *syms;
+  unsigned long nsyms;
+  char const *strtab;
+} Image;
+
+static l4_umword_t tail[L4_TBUF_MAX_SEGMENTS];
+static char chunk[Chunk * 256];
+
+static Location locations[Hash_size];
+static Thread threads[Max_threads];
+static Image images[Max_images];
+static unsigned nthreads, nimages;
+static unsigned long samples, dropped, lost;
+
+static l4_cap_idx_t dbg;
+static int prof_type;
+
+static void
+count(l4_tracebuffer_profile_sample_t const *s)
+{
+  unsigned long h;
+  unsigned i;
+
+  ++samples;
+
+  for (i = 0; i < nthreads; ++i)
+    if (threads[i].ctx == s->head.ctx)
+      break;
+  if (i == nthreads && nthreads < Max_threads)
+    threads[nthreads++].ctx = s->head.ctx;
+  if (i < nthreads)
+    ++threads[i].count;
+
+  h = ((s->space >> 4) ^ s->ip * 0x9e3779b1UL) & (Hash_size - 1);
+  for (i = 0; i < Hash_size; ++i, h = (h + 1) & (Hash_size - 1))
+    {
+      Location *l = &locations[h];
+      if (!l->count)
+        {
+          l->space = s->space;
+          l->ip = s->ip;
+          l->flags = s->flags;
+        }
+      else if (l->space != s->space || l->ip != s->ip)
+        continue;
+
+      ++l->count;
+      return;
+    }
+
+  ++dropped;
+}
+
+/*
+ * Account the samples of segment s from tail[s] up to its head.
+ */
+static void
+drain(l4_tracebuffer_stream_t const *st, unsigned s)
+{
+  l4_tracebuffer_segment_t const *seg = &st->segment[s];
+  char const *base = (char const *)seg->tracebuffer;
+  l4_umword_t size = st->entry_size;
+  l4_umword_t head = seg->head;
+
+  if (head - tail[s] > seg->entries)
+    {
+      lost += head - tail[s] - seg->entries;
+      tail[s] = head - seg->entries;
+    }
+
+  while (tail[s] != head)
+    {
+      l4_umword_t idx = tail[s] & (seg->entries - 1);
+      l4_umword_t n = head - tail[s];
+      l4_umword_t skip = 0, i;
+      long overrun;
+
+      if (n > seg->entries - idx)
+        n = seg->entries - idx;
+      if (n > Chunk)
+        n = Chunk;
+
+      memcpy(chunk, base + idx * size, n * size);
+      __sync_synchronize();
+
+      /* see ex_tbuf-stream */
+      overrun = (long)(seg->head + Slack - seg->entries - tail[s]);
+      if (overrun > 0)
+        skip = (l4_umword_t)overrun < n ? (l4_umword_t)overrun : n;
+
+      for (i = skip; i < n; ++i)
+        {
+          l4_tracebuffer_profile_sample_t const *r
+            = (l4_tracebuffer_profile_sample_t const *)(chunk + i * size);
+          if (r->head.type == prof_type)
+            count(r);
+        }
+
+      lost += skip;
+      tail[s] += n;
+    }
+}
+
+static void
+object_name(l4_umword_t kobj, char *name)
+{
+  unsigned long id = l4_debugger_kobj_to_id(dbg, kobj);
+
+  name[0] = 0;
+  if (id != ~0UL)
+    l4_debugger_get_object_name(dbg, id, name, Name_len);
+  if (!name[0])
+    snprintf(name, Name_len, "%lx", kobj);
+}
+
+static void
+load_symbols(Image *img)
+{
+  char path[Name_len + 8];
+  Ehdr const *eh;
+  Shdr const *sh;
+  FILE *f;
+  long size;
+  unsigned i;
+
+  snprintf(path, sizeof(path), "rom/%s", img->name);
+  if (!(f = fopen(path, "r")))
+    return;
+
+  if (fseek(f, 0, SEEK_END) || (size = ftell(f)) < (long)sizeof(Ehdr)
+      || fseek(f, 0, SEEK_SET) || !(img->file = malloc(size))
+      || fread(img->file, size, 1, f) != 1)
+    {
+      fclose(f);
+      free(img->file);
+      img->file = 0;
+      return;
+    }
+  fclose(f);
+
+  eh = (Ehdr const *)img->file;
+  if (memcmp(eh->e_ident, ELFMAG, SELFMAG)
+      || eh->e_shoff + eh->e_shnum * sizeof(Shdr) > (unsigned long)size)
+    return;
+
+  sh = (Shdr const *)(img->file + eh->e_shoff);
+  for (i = 0; i < eh->e_shnum; ++i)
+    if (sh[i].sh_type == SHT_SYMTAB && sh[i].sh_link < eh->e_shnum)
+      {
+        img->syms = (Sym const *)(img->file + sh[i].sh_offset);
+        img->nsyms = sh[i].sh_size / sizeof(Sym);
+        img->strtab = img->file + sh[sh[i].sh_link].sh_offset;
+        return;
+      }
+}
+
+static Image *
+image(l4_umword_t space)
+{
+  unsigned i;
+  for (i = 0; i < nimages; ++i)
+    if (images[i].space == space)
+      return &images[i];
+
+  if (nimages == Max_images)
+    return 0;
+
+  images[nimages].space = space;
+  object_name(space, images[nimages].name);
+  load_symbols(&images[nimages]);
+  return &images[nimages++];
+}
+
+static void
+symbolize(Location const *l, char *buf, unsigned len)
+{
+  Image *img;
+  Sym const *best = 0;
+  unsigned long i;
+
+  if (l->flags & L4_TBUF_PROFILE_KERNEL_IP)
+    {
+      if (l->ip)
+        snprintf(buf, len, "[kernel] %lx", l->ip);
+      else
+        snprintf(buf, len, "[kernel]");
+      return;
+    }
+
+  if (!(img = image(l->space)))
+    {
+      snprintf(buf, len, "%lx:%lx", l->space, l->ip);
+      return;
+    }
+
+  for (i = 0; i < img->nsyms; ++i)
+    {
+      Sym const *s = &img->syms[i];
+      if (SYM_TYPE(s->st_info) != STT_FUNC || s->st_value > l->ip)
+        continue;
+      if (l->ip < s->st_value + s->st_size)
+        {
+          best = s;
+          break;
+        }
+      if (!best || s->st_value > best->st_value)
+        best = s;
+    }
+
+  if (best)
+    snprintf(buf, len, "%s:%s+%lx", img->name, img->strtab + best->st_name,
+             l->ip - best->st_value);
+  else
+    snprintf(buf, len, "%s:%lx", img->name, l->ip);
+}
+
+static int
+cmp_threads(void const *a, void const *b)
+{
+  unsigned long x = ((Thread const *)a)->count;
+  unsigned long y = ((Thread const *)b)->count;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static int
+cmp_locations(void const *a, void const *b)
+{
+  unsigned long x = ((Location const *)a)->count;
+  unsigned long y = ((Location const *)b)->count;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void
+report(unsigned top)
+{
+  char name[96];
+  unsigned i;
+
+  printf("%lu samples, %lu lost in the trace buffer, %lu not accounted\n",
+         samples, lost, dropped);
+  if (!samples)
+    return;
+
+  qsort(threads, nthreads, sizeof(threads[0]), cmp_threads);
+  printf("\n%8s %6s  %s\n", "samples", "%", "thread");
+  for (i = 0; i < nthreads && i < top; ++i)
+    {
+      object_name(threads[i].ctx, name);
+      printf("%8lu %6.2f  %s\n", threads[i].count,
+             100.0 * threads[i].count / samples, name);
+    }
+
+  qsort(locations, Hash_size, sizeof(locations[0]), cmp_locations);
+  printf("\n%8s %6s  %s\n", "samples", "%", "location");
+  for (i = 0; i < Hash_size && i < top && locations[i].count; ++i)
+    {
+      symbolize(&locations[i], name, sizeof(name));
+      printf("%8lu %6.2f  %s\n", locations[i].count,
+             100.0 * locations[i].count / samples, name);
+    }
+}
+
+int main(int argc, char **argv)
+{
+  l4_tracebuffer_stream_t const *st = fiasco_tbuf_get_stream();
+  unsigned source = L4_DEBUGGER_PROFILE_CYCLES;
+  unsigned long period = 0, seconds = 10;
+  unsigned top = 20;
+  l4_cpu_time_t end;
+  unsigned s;
+  long e;
+  int c;
+
+  while ((c = getopt(argc, argv, "tp:d:n:")) != -1)
+    switch (c)
+      {
+      case 't': source = L4_DEBUGGER_PROFILE_TIMER; break;
+      case 'p': period = strtoul(optarg, NULL, 0); break;
+      case 'd': seconds = strtoul(optarg, NULL, 0); break;
+      case 'n': top = strtoul(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "Usage: %s [-t] [-p period] [-d seconds] "
+                        "[-n entries]\n", argv[0]);
+        return 1;
+      }
+
+  if (st->entry_size > sizeof(chunk) / Chunk
+      || st->entry_size < sizeof(l4_tracebuffer_profile_sample_t))
+    {
+      fprintf(stderr, "Unexpected trace-buffer record size (%lu bytes)\n",
+              st->entry_size);
+      return 1;
+    }
+
+  if (l4_is_invalid_cap(dbg = l4re_util_cap_alloc()))
+    return 1;
+
+  if (l4_error(l4_factory_create_irq(l4re_env()->factory, dbg)))
+    {
+      fprintf(stderr, "Could not create IRQ object\n");
+      return 1;
+    }
+
+  if (l4_error(l4_irq_attach(dbg, 0, l4re_env()->main_thread)))
+    {
+      fprintf(stderr, "Could not attach to IRQ\n");
+      return 1;
+    }
+
+  if (l4_error(l4_debugger_tbuf_observer(dbg, 0)))
+    {
+      fprintf(stderr, "Kernel does not support trace-buffer streaming\n");
+      return 1;
+    }
+
+  if ((prof_type = l4_debugger_query_log_typeid(dbg, "prof", 0)) < 0)
+    {
+      fprintf(stderr, "Kernel has no profiler\n");
+      return 1;
+    }
+
+  l4_debugger_switch_log(dbg, "prof", L4_DEBUGGER_SWITCH_LOG_ON);
+
+  for (s = 0; s < st->num_segments; ++s)
+    tail[s] = st->segment[s].head;
+
+  e = l4_error(l4_debugger_profile(dbg, source, period ? period : 1000000));
+  if (e == -L4_ENOSYS && source == L4_DEBUGGER_PROFILE_CYCLES)
+    {
+      printf("No cycle counter for sampling, using the timer\n");
+      source = L4_DEBUGGER_PROFILE_TIMER;
+      e = l4_error(l4_debugger_profile(dbg, source, period ? period : 1));
+    }
+  if (e < 0)
+    {
+      fprintf(stderr, "Could not start profiler: %ld\n", e);
+      l4_debugger_switch_log(dbg, "prof", L4_DEBUGGER_SWITCH_LOG_OFF);
+      return 1;
+    }
+
+  printf("Profiling %lu CPUs for %lus...\n", st->num_segments, seconds);
+
+  end = l4_kip_clock(l4re_kip()) + seconds * 1000000ULL;
+  while (l4_kip_clock(l4re_kip()) < end)
+    {
+      l4_irq_receive(dbg, l4_timeout(L4_IPC_TIMEOUT_NEVER,
+                                     l4util_micros2l4to(Poll_us)));
+      for (s = 0; s < st->num_segments; ++s)
+        drain(st, s);
+    }
+
+  l4_debugger_profile(dbg, L4_DEBUGGER_PROFILE_OFF, 0);
+  l4_debugger_switch_log(dbg, "prof", L4_DEBUGGER_SWITCH_LOG_OFF);
+  for (s = 0; s < st->num_segments; ++s)
+    drain(st, s);
+
+  report(top);
+  return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * This file is licensed under the terms of the GNU General Public License 2.
+ * See file COPYING-GPL-2 for details.
+ */
+
+/*
+ * Scheduler wakeup-burst benchmark.
+ *
+ * A number of worker threads block on IRQs of their own.  The main thread
+ * triggers all of the IRQs back to back and measures the time until the
+ * last worker ran, i.e. the time the kernel needs to put the whole burst
+ * on the ready queue and to dispatch it.  The workers run on the second
+ * CPU if there is one, so that the wakeups take the cross-CPU path.
+ *
+ * Each burst size is measured with the workers in the fixed-priority
+ * class (Ready_queue_fp) and with the workers in the WFQ class
+ * (Ready_queue_wfq).  The latter needs a kernel with both scheduling
+ * classes and a scheduler capability that accepts WFQ parameters,
+ * otherwise it is reported as n/a.
+ */
+#include <l4/re/env>
+#include <l4/re/error_helper>
+#include <l4/re/util/cap_alloc>
+#include <l4/sys/irq>
+#include <l4/sys/factory>
+#include <l4/sys/scheduler>
+#include <l4/util/rdtsc.h>
+
+#include <pthread-l4.h>
+#include <pthread.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+enum
+{
+  Max_workers = 4096,
+  Rounds = 10,
+  Worker_prio = 2,
+  Main_prio = 4,
+  Stack_size = 16 << 10,
+  Wfq_quantum = 10000,
+  Wfq_weight = 1,
+};
+
+struct Worker
+{
+  pthread_t thread;
+  L4::Cap<L4::Irq> irq;
+};
+
+static Worker workers[Max_workers];
+static L4::Cap<L4::Irq> done_irq;
+static unsigned long num_workers;
+static unsigned long pending;
+static volatile bool stop;
+
+static L4::Cap<L4::Scheduler> sched()
+{ return L4Re::Env::env()->scheduler(); }
+
+static L4::Cap<L4::Thread> self()
+{ return L4::Cap<L4::Thread>(pthread_getl4cap(pthread_self())); }
+
+/*
+ * The scheduler interface of l4sys only knows the legacy fixed-priority
+ * parameters, so the WFQ parameters are marshalled here.
+ */
+static long run_wfq(L4::Cap<L4::Thread> t, l4_sched_cpu_set_t const &cpus)
+{
+  l4_msg_regs_t *m = l4_utcb_mr();
+  m->mr[0] = L4_SCHEDULER_RUN_THREAD_OP;
+  m->mr[1] = (cpus.granularity << 24) | cpus.offset;
+  m->mr[2] = cpus.map;
+  m->mr[3] = -2;                      // WFQ class
+  m->mr[4] = 6 * sizeof(l4_umword_t); // size of the parameters
+  m->mr[5] = Wfq_quantum;
+  m->mr[6] = Wfq_weight;
+  m->mr[7] = l4_map_obj_control(0, 0);
+  m->mr[8] = l4_obj_fpage(t.cap(), 0, L4_FPAGE_RWX).raw;
+
+  return l4_error(l4_ipc_call(sched().cap(), l4_utcb(),
+                              l4_msgtag(L4_PROTO_SCHEDULER, 7, 1, 0),
+                              L4_IPC_NEVER));
+}
+
+static long run_fp(L4::Cap<L4::Thread> t, l4_sched_cpu_set_t const &cpus,
+                   unsigned prio)
+{
+  l4_sched_param_t sp = l4_sched_param(prio);
+  sp.affinity = cpus;
+  return l4_error(sched()->run_thread(t, sp));
+}
+
+static void *worker(void *arg)
+{
+  Worker *w = static_cast<Worker *>(arg);
+  for (;;)
+    {
+      if (l4_ipc_error(w->irq->receive(), l4_utcb()) || stop)
+        break;
+
+      if (__atomic_sub_fetch(&pending, 1, __ATOMIC_RELAXED) == 0)
+        done_irq->trigger();
+    }
+  return 0;
+}
+
+static void start_workers(unsigned long n)
+{
+  pthread_attr_t a;
+  pthread_attr_init(&a);
+  pthread_attr_setstacksize(&a, Stack_size);
+
+  for (unsigned long i = 0; i < n; ++i)
+    {
+      Worker *w = &workers[i];
+      w->irq = L4Re::chkcap(L4Re::Util::cap_alloc.alloc<L4::Irq>());
+      L4Re::chksys(L4Re::Env::env()->factory()->create_irq(w->irq),
+                   "Failed to create IRQ.");
+      if (pthread_create(&w->thread, &a, worker, w))
+        {
+          fprintf(stderr, "Failed to create worker %lu.\n", i);
+          exit(1);
+        }
+      L4::Cap<L4::Thread> t(pthread_getl4cap(w->thread));
+      L4Re::chksys(w->irq->attach(i, t), "Could not attach to IRQ.");
+    }
+
+  pthread_attr_destroy(&a);
+  num_workers = n;
+}
+
+static void stop_workers()
+{
+  stop = true;
+  for (unsigned long i = 0; i < num_workers; ++i)
+    {
+      workers[i].irq->trigger();
+      pthread_join(workers[i].thread, 0);
+      L4Re::Env::env()->task()->unmap(workers[i].irq.fpage(),
+                                      L4_FP_ALL_SPACES);
+      L4Re::Util::cap_alloc.free(workers[i].irq);
+    }
+  stop = false;
+  num_workers = 0;
+}
+
+static bool set_class(bool wfq, l4_sched_cpu_set_t const &cpus)
+{
+  for (unsigned long i = 0; i < num_workers; ++i)
+    {
+      L4::Cap<L4::Thread> t(pthread_getl4cap(workers[i].thread));
+      long r = wfq ? run_wfq(t, cpus) : run_fp(t, cpus, Worker_prio);
+      if (r < 0)
+        return false;
+    }
+  return true;
+}
+
+/* Average burst latency in ns. */
+static unsigned long long burst()
+{
+  unsigned long long sum = 0;
+  for (unsigned r = 0; r < Rounds; ++r)
+    {
+      pending = num_workers;
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+      l4_cpu_time_t start = l4_rdtsc();
+      for (unsigned long i = 0; i < num_workers; ++i)
+        workers[i].irq->trigger();
+      done_irq->receive();
+      sum += l4_tsc_to_ns(l4_rdtsc() - start);
+    }
+  return sum / Rounds;
+}
+
+int main(int argc, char **argv)
+{
+  static unsigned long const default_sizes[] = { 256, 1024, 4096 };
+  unsigned long size = 0;
+  if (argc > 1)
+    {
+      size = strtoul(argv[1], 0, 0);
+      if (!size || size > Max_workers)
+        {
+          fprintf(stderr, "usage: %s [workers <= %d]\n", argv[0],
+                  (int)Max_workers);
+          return 1;
+        }
+    }
+
+  try
+    {
+      l4_calibrate_tsc(l4re_kip());
+
+      l4_umword_t cpu_max;
+      l4_sched_cpu_set_t cpus = l4_sched_cpu_set(0, 0);
+      L4Re::chksys(sched()->info(&cpu_max, &cpus),
+                   "Could not query CPUs.");
+      l4_sched_cpu_set_t wcpus = l4_sched_cpu_set(0, 0, 1);
+      if (cpus.map & 2)
+        wcpus = l4_sched_cpu_set(1, 0, 1);
+
+      L4Re::chksys(run_fp(self(), l4_sched_cpu_set(0, 0, 1), Main_prio),
+                   "Could not set up the main thread.");
+
+      done_irq = L4Re::chkcap(L4Re::Util::cap_alloc.alloc<L4::Irq>());
+      L4Re::chksys(L4Re::Env::env()->factory()->create_irq(done_irq),
+                   "Failed to create IRQ.");
+      L4Re::chksys(done_irq->attach(0, self()), "Could not attach to IRQ.");
+
+      printf("workers on CPU %lu\n", wcpus.offset);
+      printf("%10s %16s %16s\n", "workers", "fixed prio ns", "wfq ns");
+
+      unsigned long const *sizes = size ? &size : default_sizes;
+      unsigned long num_sizes = size ? 1 : sizeof(default_sizes)
+                                           / sizeof(default_sizes[0]);
+
+      for (unsigned long s = 0; s < num_sizes; ++s)
+        {
+          start_workers(sizes[s]);
+
+          set_class(false, wcpus);
+          unsigned long long fp = burst();
+
+          printf("%10lu %16llu", sizes[s], fp);
+          if (set_class(true, wcpus))
+            printf(" %16llu\n", burst());
+          else
+            printf(" %16s\n", "n/a");
+
+          set_class(false, wcpus);
+          stop_workers();
+        }
+
+      printf("sched-burst benchmark finished.\n");
+      return 0;
+    }
+  catch (L4::Runtime_error &e)
+    {
+      fprintf(stderr, "Runtime error: %s.\n", e.str());
+    }
+
+  return 1;
+}
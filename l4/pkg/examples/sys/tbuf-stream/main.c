@@ -0,0 +1,173 @@
+/**
+ * \file
+ * \brief Stream the kernel trace buffer to a file.
+ *
+ * The kernel logs the events of each CPU into a separate segment of the
+ * trace buffer, which every task can read. This program binds an IRQ that
+ * the kernel triggers whenever a segment passes its watermark, and appends
+ * the records written since the last round to the output file. Records of
+ * one segment are written in order; merge the segments by event number to
+ * get a global order. Records the kernel overwrote before they could be
+ * copied are counted as lost.
+ *
+ * Usage: ex_tbuf-stream <file> [watermark]
+ */
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#include <l4/re/env.h>
+#include <l4/re/c/util/cap_alloc.h>
+#include <l4/sys/debugger.h>
+#include <l4/sys/factory.h>
+#include <l4/sys/irq.h>
+#include <l4/sys/ktrace.h>
+#include <l4/util/util.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+  Chunk    = 64,        /* records copied at once */
+  Slack    = 8,         /* records the kernel may write beyond head */
+  Flush_us = 1000000,   /* drain slow segments at least this often */
+};
+
+static l4_umword_t tail[L4_TBUF_MAX_SEGMENTS];
+static char chunk[Chunk * 256];
+
+/*
+ * Append the records of segment s from tail[s] up to its head to out.
+ * Returns the number of records lost.
+ */
+static unsigned long
+drain(l4_tracebuffer_stream_t const *st, unsigned s, FILE *out,
+      unsigned long *written)
+{
+  l4_tracebuffer_segment_t const *seg = &st->segment[s];
+  char const *base = (char const *)seg->tracebuffer;
+  l4_umword_t size = st->entry_size;
+  l4_umword_t head = seg->head;
+  unsigned long lost = 0;
+
+  if (head - tail[s] > seg->entries)
+    {
+      lost += head - tail[s] - seg->entries;
+      tail[s] = head - seg->entries;
+    }
+
+  while (tail[s] != head)
+    {
+      l4_umword_t idx = tail[s] & (seg->entries - 1);
+      l4_umword_t n = head - tail[s];
+      l4_umword_t skip = 0;
+      long overrun;
+
+      if (n > seg->entries - idx)
+        n = seg->entries - idx;
+      if (n > Chunk)
+        n = Chunk;
+
+      memcpy(chunk, base + idx * size, n * size);
+      __sync_synchronize();
+
+      /*
+       * The kernel may have reused slots while we were copying. It
+       * publishes head only after the records below it are complete,
+       * but may already be writing a few records beyond.
+       */
+      overrun = (long)(seg->head + Slack - seg->entries - tail[s]);
+      if (overrun > 0)
+        skip = (l4_umword_t)overrun < n ? (l4_umword_t)overrun : n;
+
+      fwrite(chunk + skip * size, size, n - skip, out);
+      *written += n - skip;
+      lost += skip;
+      tail[s] += n;
+    }
+
+  return lost;
+}
+
+int main(int argc, char **argv)
+{
+  l4_tracebuffer_stream_t const *st = fiasco_tbuf_get_stream();
+  unsigned long watermark = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+  unsigned long written = 0, lost = 0, reported = 0;
+  l4_cap_idx_t irq;
+  FILE *out;
+  unsigned s;
+
+  if (argc < 2)
+    {
+      fprintf(stderr, "Usage: %s <file> [watermark]\n", argv[0]);
+      return 1;
+    }
+
+  if (st->entry_size > sizeof(chunk) / Chunk)
+    {
+      fprintf(stderr, "Trace-buffer records too large (%lu bytes)\n",
+              st->entry_size);
+      return 1;
+    }
+
+  if (!(out = fopen(argv[1], "w")))
+    {
+      fprintf(stderr, "Cannot open %s\n", argv[1]);
+      return 1;
+    }
+
+  if (l4_is_invalid_cap(irq = l4re_util_cap_alloc()))
+    return 1;
+
+  if (l4_error(l4_factory_create_irq(l4re_env()->factory, irq)))
+    {
+      fprintf(stderr, "Could not create IRQ object\n");
+      return 1;
+    }
+
+  if (l4_error(l4_irq_attach(irq, 0, l4re_env()->main_thread)))
+    {
+      fprintf(stderr, "Could not attach to IRQ\n");
+      return 1;
+    }
+
+  if (l4_error(l4_debugger_tbuf_observer(irq, watermark)))
+    {
+      fprintf(stderr, "Kernel does not support trace-buffer streaming\n");
+      return 1;
+    }
+
+  /* Start with what is still in the buffer. */
+  for (s = 0; s < st->num_segments; ++s)
+    {
+      l4_umword_t head = st->segment[s].head;
+      tail[s] = head > st->segment[s].entries
+                ? head - st->segment[s].entries : 0;
+    }
+
+  printf("Streaming %lu segments of %lu records to %s, watermark %lu\n",
+         st->num_segments, st->segment[0].entries, argv[1], st->watermark);
+
+  for (;;)
+    {
+      l4_irq_receive(irq, l4_timeout(L4_IPC_TIMEOUT_NEVER,
+                                     l4util_micros2l4to(Flush_us)));
+
+      for (s = 0; s < st->num_segments; ++s)
+        lost += drain(st, s, out, &written);
+
+      fflush(out);
+
+      if (lost != reported)
+        {
+          printf("%lu records written, %lu lost\n", written, lost);
+          reported = lost;
+        }
+    }
+
+  return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * This file is licensed under the terms of the GNU General Public License 2.
+ * See file COPYING-GPL-2 for details.
+ */
+
+/*
+ * TLB benchmark for map/unmap and address-space switches.
+ *
+ * The map/unmap rounds map a number of pages into a reserved area of the
+ * own task, unmap them again and then walk a working set of pages.  The
+ * kernel flushes few unmapped pages one by one and larger regions with the
+ * whole address space; the time for walking the working set afterwards
+ * shows how much of the TLB survived the unmap.
+ *
+ * The IPC rounds call a server in a different task, each side walking its
+ * own working set per round trip.  With PCIDs the TLB entries of both
+ * tasks survive the address-space switches.  The walk alone and the IPC
+ * alone are measured for comparison.
+ */
+#include <l4/re/env>
+#include <l4/re/error_helper>
+#include <l4/re/util/cap_alloc>
+#include <l4/sys/ipc_gate>
+#include <l4/sys/task>
+#include <l4/util/rdtsc.h>
+
+#include <cstdio>
+#include <cstring>
+
+enum
+{
+  Rounds = 10000,
+  Ws_pages = 256,
+  Max_map_order = 6,  // 64 pages
+  Label_walk = 1,
+};
+
+static char working_set[Ws_pages * L4_PAGESIZE]
+  __attribute__((aligned(L4_PAGESIZE)));
+
+static void walk()
+{
+  for (unsigned i = 0; i < Ws_pages; ++i)
+    (void)*(char volatile *)&working_set[i * L4_PAGESIZE];
+}
+
+static unsigned long long per_round(l4_cpu_time_t tsc)
+{ return l4_tsc_to_ns(tsc) / Rounds; }
+
+static int server()
+{
+  L4::Cap<L4::Ipc_gate> gate = L4Re::Env::env()->get_cap<L4::Ipc_gate>("srv");
+  if (!gate)
+    {
+      fprintf(stderr, "No 'srv' capability.\n");
+      return 1;
+    }
+
+  L4Re::chksys(gate->bind_thread(L4Re::Env::env()->main_thread(), 0),
+               "Could not bind to the IPC gate.");
+
+  l4_umword_t label;
+  l4_msgtag_t tag = l4_ipc_wait(l4_utcb(), &label, L4_IPC_NEVER);
+  for (;;)
+    {
+      if (l4_ipc_error(tag, l4_utcb()))
+        {
+          tag = l4_ipc_wait(l4_utcb(), &label, L4_IPC_NEVER);
+          continue;
+        }
+
+      if (l4_msgtag_label(tag) == Label_walk)
+        walk();
+
+      tag = l4_ipc_reply_and_wait(l4_utcb(), l4_msgtag(0, 0, 0, 0), &label,
+                                  L4_IPC_NEVER);
+    }
+}
+
+/* Map and unmap 2^order pages, then walk the working set. */
+static void map_unmap(l4_addr_t src, l4_addr_t dst, unsigned order,
+                      l4_cpu_time_t *map_tsc, l4_cpu_time_t *walk_tsc)
+{
+  L4::Cap<L4::Task> task = L4Re::Env::env()->task();
+  unsigned shift = order + L4_PAGESHIFT;
+  l4_cpu_time_t m = 0, w = 0;
+
+  for (unsigned r = 0; r < Rounds; ++r)
+    {
+      l4_cpu_time_t start = l4_rdtsc();
+      task->map(task, l4_fpage(src, shift, L4_FPAGE_RW),
+                l4_map_control(dst, 0, L4_MAP_ITEM_MAP));
+      for (unsigned long o = 0; o < 1UL << shift; o += L4_PAGESIZE)
+        (void)*(char volatile *)(dst + o);
+      task->unmap(l4_fpage(dst, shift, L4_FPAGE_RWX), L4_FP_ALL_SPACES);
+      l4_cpu_time_t mid = l4_rdtsc();
+      walk();
+      l4_cpu_time_t end = l4_rdtsc();
+
+      m += mid - start;
+      w += end - mid;
+    }
+
+  *map_tsc = m;
+  *walk_tsc = w;
+}
+
+static l4_cpu_time_t ipc(L4::Cap<L4::Ipc_gate> gate, bool with_walk)
+{
+  l4_msgtag_t tag = l4_msgtag(with_walk ? Label_walk : 0, 0, 0, 0);
+  l4_cpu_time_t start = l4_rdtsc();
+  for (unsigned r = 0; r < Rounds; ++r)
+    {
+      if (with_walk)
+        walk();
+      if (l4_ipc_error(l4_ipc_call(gate.cap(), l4_utcb(), tag, L4_IPC_NEVER),
+                       l4_utcb()))
+        {
+          fprintf(stderr, "IPC error.\n");
+          break;
+        }
+    }
+  return l4_rdtsc() - start;
+}
+
+int main(int argc, char **argv)
+{
+  try
+    {
+      if (argc > 1 && !strcmp(argv[1], "server"))
+        return server();
+
+      l4_calibrate_tsc(l4re_kip());
+      memset(working_set, 1, sizeof(working_set));
+
+      unsigned long size = L4_PAGESIZE << Max_map_order;
+      unsigned char align = L4_PAGESHIFT + Max_map_order;
+
+      L4::Cap<L4Re::Dataspace> ds
+        = L4Re::chkcap(L4Re::Util::cap_alloc.alloc<L4Re::Dataspace>());
+      L4Re::chksys(L4Re::Env::env()->mem_alloc()->alloc(size, ds),
+                   "Could not allocate memory.");
+
+      l4_addr_t src = 0, dst = 0;
+      L4Re::chksys(L4Re::Env::env()->rm()->attach(&src, size,
+                     L4Re::Rm::Search_addr | L4Re::Rm::Eager_map,
+                     ds, 0, align),
+                   "Could not attach memory.");
+      L4Re::chksys(L4Re::Env::env()->rm()->reserve_area(&dst, size,
+                     L4Re::Rm::Search_addr, align),
+                   "Could not reserve the map area.");
+
+      printf("%8s %16s %16s\n", "pages", "map+unmap ns", "walk ns");
+      l4_cpu_time_t m, w;
+      for (unsigned order = 0; order <= Max_map_order; order += 2)
+        {
+          map_unmap(src, dst, order, &m, &w);
+          printf("%8u %16llu %16llu\n", 1U << order, per_round(m),
+                 per_round(w));
+        }
+
+      L4::Cap<L4::Ipc_gate> gate
+        = L4Re::Env::env()->get_cap<L4::Ipc_gate>("srv");
+      if (!gate)
+        printf("No 'srv' capability, skipping the IPC rounds.\n");
+      else
+        {
+          l4_cpu_time_t start = l4_rdtsc();
+          for (unsigned r = 0; r < Rounds; ++r)
+            walk();
+          l4_cpu_time_t walk_only = l4_rdtsc() - start;
+
+          l4_cpu_time_t call = ipc(gate, false);
+          l4_cpu_time_t call_walk = ipc(gate, true);
+
+          printf("%16s %16s %16s\n", "walk ns", "ipc ns", "ipc+walks ns");
+          printf("%16llu %16llu %16llu\n", per_round(walk_only),
+                 per_round(call), per_round(call_walk));
+        }
+
+      printf("tlb benchmark finished.\n");
+      return 0;
+    }
+  catch (L4::Runtime_error &e)
+    {
+      fprintf(stderr, "Runtime error: %s.\n", e.str());
+    }
+
+  return 1;
+}
@@ -0,0 +1,130 @@
+/*
+ * This file is licensed under the terms of the GNU General Public License 2.
+ * See file COPYING-GPL-2 for details.
+ */
+
+/*
+ * Software-IRQ throughput benchmark for interrupt moderation.
+ *
+ * A trigger thread fires a user IRQ as fast as it can for a fixed time
+ * while a receiver thread attached to the IRQ counts the events and the
+ * notifications it gets.  This is repeated for a couple of moderation
+ * settings (see L4::Irq::moderate()), a moderated notification carries
+ * its number of events in the label of the message tag.
+ */
+#include <l4/re/env>
+#include <l4/re/error_helper>
+#include <l4/re/util/cap_alloc>
+#include <l4/sys/irq>
+#include <l4/sys/factory>
+#include <l4/sys/kip.h>
+
+#include <pthread-l4.h>
+#include <thread>
+
+#include <cstdio>
+
+enum { Run_us = 1000000 };
+
+struct Result
+{
+  unsigned long triggered;
+  unsigned long events;
+  unsigned long notifications;
+};
+
+static volatile bool done;
+
+static l4_cpu_time_t now()
+{ return l4_kip_clock(l4re_kip()); }
+
+static void receiver(L4::Cap<L4::Irq> irq, Result *r, volatile bool *ready)
+{
+  L4::Cap<L4::Thread> t(pthread_getl4cap(pthread_self()));
+  L4Re::chksys(irq->attach(0, t), "Could not attach to IRQ.");
+  *ready = true;
+
+  for (;;)
+    {
+      l4_msgtag_t tag = irq->receive(l4_timeout(L4_IPC_TIMEOUT_NEVER,
+                                                l4_timeout_from_us(100000)));
+      if (l4_ipc_error(tag, l4_utcb()))
+        {
+          if (done)
+            break;
+          continue;
+        }
+
+      long n = l4_msgtag_label(tag);
+      r->events += n > 0 ? n : 1;
+      ++r->notifications;
+    }
+
+  L4Re::chksys(irq->detach(), "Could not detach from IRQ.");
+}
+
+static Result run(L4::Cap<L4::Irq> irq, unsigned long max_events,
+                  unsigned long max_delay)
+{
+  Result r = { 0, 0, 0 };
+  volatile bool ready = false;
+
+  L4Re::chksys(irq->moderate(max_events, max_delay),
+               "Could not set IRQ moderation.");
+
+  done = false;
+  std::thread rcv([irq, &r, &ready](){ receiver(irq, &r, &ready); });
+  while (!ready)
+    std::this_thread::yield();
+
+  l4_cpu_time_t end = now() + Run_us;
+  while (now() < end)
+    {
+      irq->trigger();
+      ++r.triggered;
+    }
+
+  done = true;
+  rcv.join();
+  return r;
+}
+
+int main()
+{
+  try
+    {
+      static struct { unsigned long events, delay; } const cfg[] =
+        {
+          {   0,    0 },
+          {  16,    0 },
+          {  16, 1000 },
+          {  64, 1000 },
+          { 256, 1000 },
+        };
+
+      L4::Cap<L4::Irq> irq;
+      irq = L4Re::chkcap(L4Re::Util::cap_alloc.alloc<L4::Irq>());
+      L4Re::chksys(L4Re::Env::env()->factory()->create_irq(irq),
+                   "Failed to create IRQ.");
+
+      printf("%10s %10s %14s %14s %14s\n", "max events", "max delay",
+             "triggers/s", "events/s", "notifies/s");
+
+      for (auto const &c: cfg)
+        {
+          Result r = run(irq, c.events, c.delay);
+          printf("%10lu %8luus %14lu %14lu %14lu%s\n", c.events, c.delay,
+                 r.triggered, r.events, r.notifications,
+                 r.events != r.triggered ? "  (events lost)" : "");
+        }
+
+      printf("uirq benchmark finished.\n");
+      return 0;
+    }
+  catch (L4::Runtime_error &e)
+    {
+      fprintf(stderr, "Runtime error: %s.\n", e.str());
+    }
+
+  return 1;
+}
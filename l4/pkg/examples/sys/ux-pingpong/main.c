@@ -0,0 +1,107 @@
+/**
+ * \file
+ * \brief IPC round-trip benchmark for Fiasco-UX.
+ *
+ * Two threads of one task exchange short messages with l4_ipc_call and
+ * l4_ipc_reply_and_wait. Each round trip enters the kernel twice, which
+ * Fiasco-UX implements either by tracing the task's host process with
+ * ptrace (default) or through the shared entry page of the task (Fiasco-UX
+ * started with -P). Run the benchmark once per mode to compare.
+ */
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ */
+#include <l4/sys/ipc.h>
+#include <l4/util/rdtsc.h>
+#include <l4/re/env.h>
+
+#include <pthread-l4.h>
+#include <stdio.h>
+
+enum
+{
+  Warmup = 100,
+  Rounds = 10000,
+  Runs   = 5,
+};
+
+static pthread_t server;
+
+static void *server_fn(void *arg)
+{
+  l4_msgtag_t tag;
+  l4_umword_t label;
+  (void)arg;
+
+  tag = l4_ipc_wait(l4_utcb(), &label, L4_IPC_NEVER);
+  while (1)
+    {
+      if (l4_ipc_error(tag, l4_utcb()))
+        {
+          tag = l4_ipc_wait(l4_utcb(), &label, L4_IPC_NEVER);
+          continue;
+        }
+
+      tag = l4_ipc_reply_and_wait(l4_utcb(), l4_msgtag(0, 1, 0, 0),
+                                  &label, L4_IPC_NEVER);
+    }
+  return NULL;
+}
+
+static int pingpong(unsigned rounds)
+{
+  l4_cap_idx_t srv = pthread_getl4cap(server);
+  unsigned i;
+
+  for (i = 0; i < rounds; i++)
+    {
+      l4_utcb_mr()->mr[0] = i;
+      if (l4_ipc_error(l4_ipc_call(srv, l4_utcb(), l4_msgtag(0, 1, 0, 0),
+                                   L4_IPC_NEVER), l4_utcb()))
+        return 1;
+    }
+  return 0;
+}
+
+int main(void)
+{
+  l4_cpu_time_t start, end, best = ~0ULL;
+  unsigned run;
+
+  l4_calibrate_tsc(l4re_kip());
+
+  if (pthread_create(&server, NULL, server_fn, NULL))
+    {
+      fprintf(stderr, "Thread creation failed\n");
+      return 1;
+    }
+
+  if (pingpong(Warmup))
+    {
+      fprintf(stderr, "IPC error\n");
+      return 1;
+    }
+
+  for (run = 0; run < Runs; run++)
+    {
+      start = l4_rdtsc();
+      if (pingpong(Rounds))
+        {
+          fprintf(stderr, "IPC error\n");
+          return 1;
+        }
+      end = l4_rdtsc();
+
+      printf("run %u: %llu cycles, %llu ns per round trip\n", run,
+             (end - start) / Rounds, l4_tsc_to_ns(end - start) / Rounds);
+
+      if (end - start < best)
+        best = end - start;
+    }
+
+  printf("best: %llu cycles, %llu ns per round trip (%u round trips)\n",
+         best / Rounds, l4_tsc_to_ns(best) / Rounds, Rounds);
+  return 0;
+}
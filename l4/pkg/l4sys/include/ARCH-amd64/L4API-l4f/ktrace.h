@@ -98,6 +98,129 @@ typedef struct
 
 } l4_tracebuffer_status_t;
 
+/**
+ * Trace-buffer segment descriptor.
+ * \ingroup api_calls_fiasco
+ *
+ * The kernel logs the events of each CPU into a separate segment. Record
+ * `n` of a segment is at index `n & (entries - 1)`; records below `head`
+ * are complete. The kernel keeps writing while a consumer reads, so a
+ * consumer must check `head` again after copying records to detect
+ * records that got overwritten in the meantime.
+ */
+// keep in sync with fiasco/src/jabi/jdb_ktrace.cpp
+typedef struct
+{
+  /// Address of the first record of the segment
+  l4_addr_t tracebuffer;
+  /// Number of records in the segment, a power of 2
+  l4_umword_t entries;
+  /// Number of records written to the segment since boot (free running)
+  volatile l4_umword_t head;
+} __attribute__((aligned(64))) l4_tracebuffer_segment_t;
+
+enum
+{
+  L4_TBUF_MAX_SEGMENTS    = 32,
+  L4_TBUF_STREAM_OFFSET   = 1024,
+  L4_TBUF_LAT_HIST_OFFSET = 3584,
+};
+
+/**
+ * Streaming view of the trace-buffer.
+ * \ingroup api_calls_fiasco
+ */
+// keep in sync with fiasco/src/jabi/jdb_ktrace.cpp
+typedef struct
+{
+  /// Number of valid entries in segment[]
+  l4_umword_t num_segments;
+  /// Size of a record in bytes
+  l4_umword_t entry_size;
+  /// Records per segment between two observer notifications, see
+  /// l4_debugger_tbuf_observer()
+  volatile l4_umword_t watermark;
+  l4_tracebuffer_segment_t segment[L4_TBUF_MAX_SEGMENTS];
+} l4_tracebuffer_stream_t;
+
+/**
+ * Kinds of operations with a latency histogram.
+ * \ingroup api_calls_fiasco
+ */
+// keep in sync with fiasco/src/jabi/jdb_ktrace.cpp
+enum
+{
+  L4_LAT_HIST_IPC_CALL       = 0, ///< IPC call, from entry to the reply
+  L4_LAT_HIST_IPC_REPLY_WAIT = 1, ///< Reply and wait, up to the reply
+  L4_LAT_HIST_PAGE_FAULT     = 2, ///< User page fault
+  L4_LAT_HIST_MAP            = 3, ///< Task map
+  L4_LAT_HIST_UNMAP          = 4, ///< Task unmap
+  L4_LAT_HIST_THREAD_SWITCH  = 5, ///< Switch between two threads
+  L4_LAT_HIST_IRQ            = 6, ///< IRQ hit to delivery of its message
+};
+
+/**
+ * Per-CPU latency histograms, see fiasco_tbuf_get_lat_hist().
+ * \ingroup api_calls_fiasco
+ *
+ * The histograms of CPU `c` start at `hist + c * cpu_stride`: one row of
+ * `num_buckets` counters per kind (L4_LAT_HIST_*).  Bucket 0 counts
+ * latencies below 2 TSC ticks, bucket `i` latencies of [2^i, 2^(i+1))
+ * ticks and the last bucket everything longer.  The kernel updates the
+ * counters while they are read.
+ */
+// keep in sync with fiasco/src/jabi/jdb_ktrace.cpp
+typedef struct
+{
+  /// Address of the histograms of CPU 0, 0 if the kernel keeps none
+  volatile l4_umword_t const *hist;
+  /// Distance between the histograms of two CPUs in bytes
+  l4_umword_t cpu_stride;
+  /// Number of CPUs with histograms
+  l4_umword_t num_cpus;
+  /// Number of histograms per CPU
+  l4_umword_t num_kinds;
+  /// Number of buckets per histogram
+  l4_umword_t num_buckets;
+} l4_tracebuffer_lat_hist_t;
+
+/**
+ * Common header of trace-buffer records.
+ * \ingroup api_calls_fiasco
+ */
+// keep in sync with fiasco/src/kern/tb_entry.cpp
+typedef struct
+{
+  l4_umword_t number;   ///< Event number
+  l4_umword_t ip;       ///< Kernel instruction pointer of the event
+  l4_uint64_t tsc;      ///< Time stamp counter
+  l4_umword_t ctx;      ///< Kernel address of the current thread
+  l4_uint32_t pmc1;     ///< Performance counter value 1
+  l4_uint32_t pmc2;     ///< Performance counter value 2
+  l4_uint32_t kclock;   ///< Lower 32 bits of the kernel clock
+  l4_uint8_t  type;     ///< Event type
+  l4_uint8_t  cpu;      ///< CPU
+} __attribute__((packed, aligned(8))) l4_tracebuffer_entry_head_t;
+
+enum
+{
+  L4_TBUF_PROFILE_KERNEL_IP = 1, ///< ip is a kernel address, 0 if unknown
+  L4_TBUF_PROFILE_ENTRY_IP  = 2, ///< ip is the user ip of the last kernel entry
+};
+
+/**
+ * Record of the "Profile samples" event, see l4_debugger_profile().
+ * \ingroup api_calls_fiasco
+ */
+// keep in sync with fiasco/src/kern/perf_sampler.cpp
+typedef struct
+{
+  l4_tracebuffer_entry_head_t head;
+  l4_addr_t   ip;       ///< Sampled instruction pointer
+  l4_umword_t space;    ///< Kernel address of the sampled address space
+  l4_umword_t flags;    ///< L4_TBUF_PROFILE_* flags
+} l4_tracebuffer_profile_sample_t;
+
 /**
  * Return tracebuffer status.
  * \ingroup api_calls_fiasco
@@ -107,6 +230,24 @@ typedef struct
 L4_INLINE l4_tracebuffer_status_t *
 fiasco_tbuf_get_status(void);
 
+/**
+ * Return the streaming view of the trace-buffer.
+ * \ingroup api_calls_fiasco
+ *
+ * \return Pointer to the stream descriptor in the trace-buffer status page.
+ */
+L4_INLINE l4_tracebuffer_stream_t *
+fiasco_tbuf_get_stream(void);
+
+/**
+ * Return the descriptor of the per-CPU latency histograms.
+ * \ingroup api_calls_fiasco
+ *
+ * \return Pointer to the descriptor in the trace-buffer status page.
+ */
+L4_INLINE l4_tracebuffer_lat_hist_t *
+fiasco_tbuf_get_lat_hist(void);
+
 /**
  * Return the physical address of the tracebuffer status struct.
  * \ingroup api_calls_fiasco
@@ -189,6 +330,20 @@ fiasco_tbuf_get_status(void)
   return tbuf;
 }
 
+L4_INLINE l4_tracebuffer_stream_t *
+fiasco_tbuf_get_stream(void)
+{
+  return (l4_tracebuffer_stream_t *)((char *)fiasco_tbuf_get_status()
+                                     + L4_TBUF_STREAM_OFFSET);
+}
+
+L4_INLINE l4_tracebuffer_lat_hist_t *
+fiasco_tbuf_get_lat_hist(void)
+{
+  return (l4_tracebuffer_lat_hist_t *)((char *)fiasco_tbuf_get_status()
+                                       + L4_TBUF_LAT_HIST_OFFSET);
+}
+
 L4_INLINE l4_addr_t
 fiasco_tbuf_get_status_phys(void)
 {
@@ -160,6 +160,55 @@ L4_INLINE l4_msgtag_t
 l4_debugger_switch_log_u(l4_cap_idx_t cap, const char *name, int on_off,
                          l4_utcb_t *utcb) L4_NOTHROW;
 
+/**
+ * \brief Bind an IRQ to the trace buffer.
+ * \ingroup l4_debugger_api
+ *
+ * \param irq        Capability of the IRQ object. The kernel triggers it
+ *                   whenever a segment of the trace buffer passes a
+ *                   multiple of \a watermark records.
+ * \param watermark  Records between two notifications, rounded down to a
+ *                   power of 2; 0 selects half a segment.
+ *
+ * Deleting the IRQ object or binding another IRQ removes the binding.
+ */
+L4_INLINE l4_msgtag_t
+l4_debugger_tbuf_observer(l4_cap_idx_t irq, unsigned long watermark) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_debugger_tbuf_observer_u(l4_cap_idx_t irq, unsigned long watermark,
+                            l4_utcb_t *utcb) L4_NOTHROW;
+
+/**
+ * \brief Start or stop the statistical profiler of the kernel.
+ * \ingroup l4_debugger_api
+ *
+ * \param cap     Capability of any kernel object.
+ * \param source  Sample source, see #L4_debugger_profile_source.
+ * \param period  Timer ticks (#L4_DEBUGGER_PROFILE_TIMER) or unhalted CPU
+ *                cycles (#L4_DEBUGGER_PROFILE_CYCLES) between two samples.
+ *
+ * \return Syscall return tag. The error is -L4_ENOSYS if the source is not
+ *         available, -L4_EINVAL for a bad period.
+ *
+ * The kernel records each sample as a "Profile samples" event in the
+ * trace buffer, see #l4_tracebuffer_profile_sample_t; that event must be
+ * switched on with l4_debugger_switch_log() for samples to be recorded.
+ */
+L4_INLINE l4_msgtag_t
+l4_debugger_profile(l4_cap_idx_t cap, unsigned source,
+                    unsigned long period) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_debugger_profile_u(l4_cap_idx_t cap, unsigned source,
+                      unsigned long period, l4_utcb_t *utcb) L4_NOTHROW;
+
 enum
 {
   L4_DEBUGGER_NAME_SET_OP         = 0UL,
@@ -169,6 +218,8 @@ enum
   L4_DEBUGGER_SWITCH_LOG_OP       = 4UL,
   L4_DEBUGGER_NAME_GET_OP         = 5UL,
   L4_DEBUGGER_QUERY_LOG_NAME_OP   = 6UL,
+  L4_DEBUGGER_TBUF_OBSERVER_OP    = 7UL,
+  L4_DEBUGGER_PROFILE_OP          = 8UL,
 };
 
 enum
@@ -177,6 +228,17 @@ enum
   L4_DEBUGGER_SWITCH_LOG_OFF = 0,
 };
 
+/**
+ * \brief Sample sources of the kernel profiler.
+ * \ingroup l4_debugger_api
+ */
+enum L4_debugger_profile_source
+{
+  L4_DEBUGGER_PROFILE_OFF    = 0, ///< Stop sampling
+  L4_DEBUGGER_PROFILE_TIMER  = 1, ///< Sample every n-th timer tick
+  L4_DEBUGGER_PROFILE_CYCLES = 2, ///< Sample every n unhalted CPU cycles
+};
+
 /* IMPLEMENTATION -----------------------------------------------------------*/
 
 #include <l4/sys/kernel_object.h>
@@ -285,6 +347,25 @@ l4_debugger_get_object_name_u(l4_cap_idx_t cap, unsigned id,
   return t;
 }
 
+L4_INLINE l4_msgtag_t
+l4_debugger_tbuf_observer_u(l4_cap_idx_t irq, unsigned long watermark,
+                            l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_utcb_mr_u(utcb)->mr[0] = L4_DEBUGGER_TBUF_OBSERVER_OP;
+  l4_utcb_mr_u(utcb)->mr[1] = watermark;
+  return l4_invoke_debugger(irq, l4_msgtag(0, 2, 0, 0), utcb);
+}
+
+L4_INLINE l4_msgtag_t
+l4_debugger_profile_u(l4_cap_idx_t cap, unsigned source,
+                      unsigned long period, l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_utcb_mr_u(utcb)->mr[0] = L4_DEBUGGER_PROFILE_OP;
+  l4_utcb_mr_u(utcb)->mr[1] = source;
+  l4_utcb_mr_u(utcb)->mr[2] = period;
+  return l4_invoke_debugger(cap, l4_msgtag(0, 3, 0, 0), utcb);
+}
+
 
 L4_INLINE l4_msgtag_t
 l4_debugger_set_object_name(unsigned long cap,
@@ -334,3 +415,16 @@ l4_debugger_get_object_name(l4_cap_idx_t cap, unsigned id,
 {
   return l4_debugger_get_object_name_u(cap, id, name, size, l4_utcb());
 }
+
+L4_INLINE l4_msgtag_t
+l4_debugger_tbuf_observer(l4_cap_idx_t irq, unsigned long watermark) L4_NOTHROW
+{
+  return l4_debugger_tbuf_observer_u(irq, watermark, l4_utcb());
+}
+
+L4_INLINE l4_msgtag_t
+l4_debugger_profile(l4_cap_idx_t cap, unsigned source,
+                    unsigned long period) L4_NOTHROW
+{
+  return l4_debugger_profile_u(cap, source, period, l4_utcb());
+}
@@ -172,6 +172,31 @@ L4_INLINE l4_msgtag_t
 l4_factory_create_irq_u(l4_cap_idx_t factory,
                         l4_cap_idx_t target_cap, l4_utcb_t *utcb) L4_NOTHROW;
 
+/**
+ * \brief Create a new message queue.
+ * \ingroup l4_factory_api
+ *
+ * \param factory       Capability selector for factory to use for creation.
+ * \param target_cap    Capability selector for the root capability of the
+ *                      new message queue.
+ * \param slots         Number of message slots of the ring, a power of two.
+ * \param slot_size     Size of a message slot in bytes.
+ *
+ * \return Syscall return tag
+ * \see \ref l4_msg_queue_api
+ */
+L4_INLINE l4_msgtag_t
+l4_factory_create_msg_queue(l4_cap_idx_t factory, l4_cap_idx_t target_cap,
+                            l4_umword_t slots, l4_umword_t slot_size) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_factory_create_msg_queue_u(l4_cap_idx_t factory, l4_cap_idx_t target_cap,
+                              l4_umword_t slots, l4_umword_t slot_size,
+                              l4_utcb_t *utcb) L4_NOTHROW;
+
 /**
  * \brief Create a new virtual machine.
  * \ingroup l4_factory_api
@@ -298,6 +323,18 @@ l4_factory_create_vm_u(l4_cap_idx_t factory,
   return l4_factory_create_commit_u(factory, t, u);
 }
 
+L4_INLINE l4_msgtag_t
+l4_factory_create_msg_queue_u(l4_cap_idx_t factory, l4_cap_idx_t target_cap,
+                              l4_umword_t slots, l4_umword_t slot_size,
+                              l4_utcb_t *u) L4_NOTHROW
+{
+  l4_msgtag_t t;
+  t = l4_factory_create_start_u(L4_PROTO_MSG_QUEUE, target_cap, u);
+  l4_factory_create_add_uint_u(slots, &t, u);
+  l4_factory_create_add_uint_u(slot_size, &t, u);
+  return l4_factory_create_commit_u(factory, t, u);
+}
+
 
 
 
@@ -346,6 +383,14 @@ l4_factory_create_vm(l4_cap_idx_t factory,
   return l4_factory_create_vm_u(factory, target_cap, l4_utcb());
 }
 
+L4_INLINE l4_msgtag_t
+l4_factory_create_msg_queue(l4_cap_idx_t factory, l4_cap_idx_t target_cap,
+                            l4_umword_t slots, l4_umword_t slot_size) L4_NOTHROW
+{
+  return l4_factory_create_msg_queue_u(factory, target_cap, slots, slot_size,
+                                       l4_utcb());
+}
+
 L4_INLINE l4_msgtag_t
 l4_factory_create_start_u(long obj, l4_cap_idx_t target_cap,
                           l4_utcb_t *u) L4_NOTHROW
@@ -199,6 +199,38 @@ l4_irq_unmask(l4_cap_idx_t irq) L4_NOTHROW;
 L4_INLINE l4_msgtag_t
 l4_irq_unmask_u(l4_cap_idx_t irq, l4_utcb_t *utcb) L4_NOTHROW;
 
+/**
+ * \brief Set up interrupt moderation for an IRQ.
+ * \ingroup l4_irq_api
+ *
+ * \param irq         IRQ to configure.
+ * \param max_events  Notify once this many events are pending, 0 turns
+ *                    moderation off.
+ * \param max_delay   Notify at the latest this many microseconds after
+ *                    the first pending event, 0 for no time bound. The
+ *                    kernel caps the delay at 100ms.
+ *
+ * \return Syscall return tag
+ *
+ * With moderation on, the attached thread receives one notification for
+ * a batch of events. The label of the notification's message tag holds
+ * the number of events in the batch (see l4_msgtag_label()). Moderation
+ * can be switched on or off only while no thread is attached, the limits
+ * of a moderated IRQ may be changed at any time. A level-triggered IRQ
+ * has at most one event pending, so it needs a max_delay for max_events
+ * above 1, otherwise the call fails with -L4_EINVAL.
+ */
+L4_INLINE l4_msgtag_t
+l4_irq_moderate(l4_cap_idx_t irq, unsigned long max_events,
+                unsigned long max_delay) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_irq_moderate_u(l4_cap_idx_t irq, unsigned long max_events,
+                  unsigned long max_delay, l4_utcb_t *utcb) L4_NOTHROW;
+
 /**
  * \internal
  */
@@ -208,6 +240,7 @@ enum L4_irq_op
   L4_IRQ_OP_TRIGGER   = 2,
   L4_IRQ_OP_CHAIN     = 3,
   L4_IRQ_OP_EOI       = 4,
+  L4_IRQ_OP_MODERATE  = 5,
 };
 
 /**************************************************************************
@@ -276,6 +309,17 @@ l4_irq_unmask_u(l4_cap_idx_t irq, l4_utcb_t *utcb) L4_NOTHROW
   return l4_ipc_send(irq, utcb, l4_msgtag(L4_PROTO_IRQ, 1, 0, 0), L4_IPC_NEVER);
 }
 
+L4_INLINE l4_msgtag_t
+l4_irq_moderate_u(l4_cap_idx_t irq, unsigned long max_events,
+                  unsigned long max_delay, l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  m->mr[0] = L4_IRQ_OP_MODERATE;
+  m->mr[1] = max_events;
+  m->mr[2] = max_delay;
+  return l4_ipc_call(irq, utcb, l4_msgtag(L4_PROTO_IRQ, 3, 0, 0), L4_IPC_NEVER);
+}
+
 
 L4_INLINE l4_msgtag_t
 l4_irq_attach(l4_cap_idx_t irq, l4_umword_t label,
@@ -322,3 +366,10 @@ l4_irq_unmask(l4_cap_idx_t irq) L4_NOTHROW
   return l4_irq_unmask_u(irq, l4_utcb());
 }
 
+
+L4_INLINE l4_msgtag_t
+l4_irq_moderate(l4_cap_idx_t irq, unsigned long max_events,
+                unsigned long max_delay) L4_NOTHROW
+{
+  return l4_irq_moderate_u(irq, max_events, max_delay, l4_utcb());
+}
@@ -0,0 +1,314 @@
+/**
+ * \file
+ * \brief Message-queue interface.
+ */
+/*
+ * This file is part of TUD:OS and distributed under the terms of the
+ * GNU General Public License 2.
+ * Please see the COPYING-GPL-2 file for details.
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ */
+#pragma once
+
+#include <l4/sys/ipc.h>
+
+/**
+ * \defgroup l4_msg_queue_api Message queue
+ * \ingroup  l4_kernel_object_api
+ * \brief Kernel-mediated wakeups for a message ring in shared memory.
+ *
+ * <c>\#include <l4/sys/msg_queue.h></c>
+ *
+ * A message queue pairs a ring of fixed-size message slots, which lives in
+ * memory shared by the producers and the consumer, with two wakeup
+ * channels in the kernel.  Messages are enqueued and dequeued without
+ * kernel entry (see L4::Msg_queue_ring in <l4/sys/msg_queue>).  Only a
+ * side that has to block, or that has to wake a blocked peer, invokes the
+ * kernel object.
+ *
+ * Each end of the queue (#L4_MSG_QUEUE_CONSUMER, #L4_MSG_QUEUE_PRODUCER)
+ * has at most one attached thread.  Signalling an end sends a wakeup IPC
+ * to that thread; signals arriving while a wakeup is pending are merged.
+ * The attached thread waits for its wakeup with l4_msg_queue_wait(), or
+ * receives it in an open wait with the label given at attach time.
+ *
+ * A message queue is created with l4_factory_create_msg_queue().
+ */
+
+/**
+ * \brief Ends of a message queue.
+ * \ingroup l4_msg_queue_api
+ */
+enum L4_msg_queue_end
+{
+  L4_MSG_QUEUE_CONSUMER = 0, ///< Signalled when the ring becomes non-empty
+  L4_MSG_QUEUE_PRODUCER = 1, ///< Signalled when the ring becomes non-full
+};
+
+/**
+ * \brief Operations on message queues.
+ * \ingroup l4_msg_queue_api
+ * \internal
+ */
+enum L4_msg_queue_op
+{
+  L4_MSG_QUEUE_OP_ATTACH = 0,
+  L4_MSG_QUEUE_OP_DETACH = 1,
+  L4_MSG_QUEUE_OP_SIGNAL = 2,
+  L4_MSG_QUEUE_OP_WAIT   = 3,
+  L4_MSG_QUEUE_OP_INFO   = 4,
+};
+
+/**
+ * \brief Attach a thread to an end of a message queue.
+ * \ingroup l4_msg_queue_api
+ *
+ * \param q       Message queue.
+ * \param end     End to attach to, see #L4_msg_queue_end.
+ * \param label   Label of the wakeup messages.
+ * \param thread  Thread to attach.
+ *
+ * \return Syscall return tag, -L4_EBUSY if another thread is attached.
+ *
+ * A wakeup that was signalled while no thread was attached is delivered
+ * right away.
+ */
+L4_INLINE l4_msgtag_t
+l4_msg_queue_attach(l4_cap_idx_t q, unsigned end, l4_umword_t label,
+                    l4_cap_idx_t thread) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_msg_queue_attach_u(l4_cap_idx_t q, unsigned end, l4_umword_t label,
+                      l4_cap_idx_t thread, l4_utcb_t *utcb) L4_NOTHROW;
+
+/**
+ * \brief Detach the thread from an end of a message queue.
+ * \ingroup l4_msg_queue_api
+ *
+ * \param q    Message queue.
+ * \param end  End to detach from, see #L4_msg_queue_end.
+ *
+ * \return Syscall return tag
+ */
+L4_INLINE l4_msgtag_t
+l4_msg_queue_detach(l4_cap_idx_t q, unsigned end) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_msg_queue_detach_u(l4_cap_idx_t q, unsigned end,
+                      l4_utcb_t *utcb) L4_NOTHROW;
+
+/**
+ * \brief Wake the thread attached to an end of a message queue.
+ * \ingroup l4_msg_queue_api
+ *
+ * \param q    Message queue.
+ * \param end  End to signal, see #L4_msg_queue_end.
+ *
+ * \return Syscall return tag
+ */
+L4_INLINE l4_msgtag_t
+l4_msg_queue_signal(l4_cap_idx_t q, unsigned end) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_msg_queue_signal_u(l4_cap_idx_t q, unsigned end,
+                      l4_utcb_t *utcb) L4_NOTHROW;
+
+/**
+ * \brief Wait for a wakeup on an end of a message queue.
+ * \ingroup l4_msg_queue_api
+ *
+ * \param q    Message queue.
+ * \param end  End to wait on, the caller must be attached to it.
+ * \param to   Timeout.
+ *
+ * \return Syscall return tag, -L4_EPERM if the caller is not attached.
+ *
+ * Returns at once if a wakeup is pending.  Wakeups are hints: the caller
+ * has to re-check the ring afterwards.
+ */
+L4_INLINE l4_msgtag_t
+l4_msg_queue_wait(l4_cap_idx_t q, unsigned end, l4_timeout_t to) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_msg_queue_wait_u(l4_cap_idx_t q, unsigned end, l4_timeout_t to,
+                    l4_utcb_t *utcb) L4_NOTHROW;
+
+/**
+ * \brief Signal one end and wait on another end in one system call.
+ * \ingroup l4_msg_queue_api
+ *
+ * \param q       Message queue.
+ * \param signal  End to signal, see #L4_msg_queue_end.
+ * \param end     End to wait on, the caller must be attached to it.
+ * \param to      Timeout.
+ *
+ * \return Syscall return tag
+ */
+L4_INLINE l4_msgtag_t
+l4_msg_queue_signal_and_wait(l4_cap_idx_t q, unsigned signal, unsigned end,
+                             l4_timeout_t to) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_msg_queue_signal_and_wait_u(l4_cap_idx_t q, unsigned signal, unsigned end,
+                               l4_timeout_t to, l4_utcb_t *utcb) L4_NOTHROW;
+
+/**
+ * \brief Get the ring geometry a message queue was created with.
+ * \ingroup l4_msg_queue_api
+ *
+ * \param q          Message queue.
+ * \retval slots     Number of message slots.
+ * \retval slot_size Size of a message slot in bytes.
+ *
+ * \return Syscall return tag
+ */
+L4_INLINE l4_msgtag_t
+l4_msg_queue_info(l4_cap_idx_t q, l4_umword_t *slots,
+                  l4_umword_t *slot_size) L4_NOTHROW;
+
+/**
+ * \internal
+ */
+L4_INLINE l4_msgtag_t
+l4_msg_queue_info_u(l4_cap_idx_t q, l4_umword_t *slots,
+                    l4_umword_t *slot_size, l4_utcb_t *utcb) L4_NOTHROW;
+
+
+/* IMPLEMENTATION -----------------------------------------------------------*/
+
+L4_INLINE l4_msgtag_t
+l4_msg_queue_attach_u(l4_cap_idx_t q, unsigned end, l4_umword_t label,
+                      l4_cap_idx_t thread, l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  m->mr[0] = L4_MSG_QUEUE_OP_ATTACH;
+  m->mr[1] = end;
+  m->mr[2] = label;
+  m->mr[3] = l4_map_obj_control(0, 0);
+  m->mr[4] = l4_obj_fpage(thread, 0, L4_FPAGE_RWX).raw;
+  return l4_ipc_call(q, utcb, l4_msgtag(L4_PROTO_MSG_QUEUE, 3, 1, 0),
+                     L4_IPC_NEVER);
+}
+
+L4_INLINE l4_msgtag_t
+l4_msg_queue_detach_u(l4_cap_idx_t q, unsigned end,
+                      l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  m->mr[0] = L4_MSG_QUEUE_OP_DETACH;
+  m->mr[1] = end;
+  return l4_ipc_call(q, utcb, l4_msgtag(L4_PROTO_MSG_QUEUE, 2, 0, 0),
+                     L4_IPC_NEVER);
+}
+
+L4_INLINE l4_msgtag_t
+l4_msg_queue_signal_u(l4_cap_idx_t q, unsigned end,
+                      l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  m->mr[0] = L4_MSG_QUEUE_OP_SIGNAL;
+  m->mr[1] = end;
+  return l4_ipc_send(q, utcb, l4_msgtag(L4_PROTO_MSG_QUEUE, 2, 0, 0),
+                     L4_IPC_NEVER);
+}
+
+L4_INLINE l4_msgtag_t
+l4_msg_queue_wait_u(l4_cap_idx_t q, unsigned end, l4_timeout_t to,
+                    l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  m->mr[0] = L4_MSG_QUEUE_OP_WAIT;
+  m->mr[1] = end;
+  return l4_ipc_call(q, utcb, l4_msgtag(L4_PROTO_MSG_QUEUE, 2, 0, 0), to);
+}
+
+L4_INLINE l4_msgtag_t
+l4_msg_queue_signal_and_wait_u(l4_cap_idx_t q, unsigned signal, unsigned end,
+                               l4_timeout_t to, l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  m->mr[0] = L4_MSG_QUEUE_OP_WAIT;
+  m->mr[1] = end;
+  m->mr[2] = signal;
+  return l4_ipc_call(q, utcb, l4_msgtag(L4_PROTO_MSG_QUEUE, 3, 0, 0), to);
+}
+
+L4_INLINE l4_msgtag_t
+l4_msg_queue_info_u(l4_cap_idx_t q, l4_umword_t *slots,
+                    l4_umword_t *slot_size, l4_utcb_t *utcb) L4_NOTHROW
+{
+  l4_msgtag_t t;
+  l4_msg_regs_t *m = l4_utcb_mr_u(utcb);
+  m->mr[0] = L4_MSG_QUEUE_OP_INFO;
+  t = l4_ipc_call(q, utcb, l4_msgtag(L4_PROTO_MSG_QUEUE, 1, 0, 0),
+                  L4_IPC_NEVER);
+  if (l4_error_u(t, utcb) >= 0)
+    {
+      *slots = m->mr[0];
+      *slot_size = m->mr[1];
+    }
+  return t;
+}
+
+
+L4_INLINE l4_msgtag_t
+l4_msg_queue_attach(l4_cap_idx_t q, unsigned end, l4_umword_t label,
+                    l4_cap_idx_t thread) L4_NOTHROW
+{
+  return l4_msg_queue_attach_u(q, end, label, thread, l4_utcb());
+}
+
+L4_INLINE l4_msgtag_t
+l4_msg_queue_detach(l4_cap_idx_t q, unsigned end) L4_NOTHROW
+{
+  return l4_msg_queue_detach_u(q, end, l4_utcb());
+}
+
+L4_INLINE l4_msgtag_t
+l4_msg_queue_signal(l4_cap_idx_t q, unsigned end) L4_NOTHROW
+{
+  return l4_msg_queue_signal_u(q, end, l4_utcb());
+}
+
+L4_INLINE l4_msgtag_t
+l4_msg_queue_wait(l4_cap_idx_t q, unsigned end, l4_timeout_t to) L4_NOTHROW
+{
+  return l4_msg_queue_wait_u(q, end, to, l4_utcb());
+}
+
+L4_INLINE l4_msgtag_t
+l4_msg_queue_signal_and_wait(l4_cap_idx_t q, unsigned signal, unsigned end,
+                             l4_timeout_t to) L4_NOTHROW
+{
+  return l4_msg_queue_signal_and_wait_u(q, signal, end, to, l4_utcb());
+}
+
+L4_INLINE l4_msgtag_t
+l4_msg_queue_info(l4_cap_idx_t q, l4_umword_t *slots,
+                  l4_umword_t *slot_size) L4_NOTHROW
+{
+  return l4_msg_queue_info_u(q, slots, slot_size, l4_utcb());
+}
@@ -68,6 +68,7 @@ enum l4_msgtag_protocol
   L4_PROTO_VM            = -16L, ///< Protocol for messages to a virtual machine object
   L4_PROTO_DEBUGGER      = -17L,
   L4_PROTO_META          = -21L, ///< Meta information protocol
+  L4_PROTO_MSG_QUEUE     = -22L, ///< Protocol for messages to a message-queue object
 };
 
 enum L4_varg_type
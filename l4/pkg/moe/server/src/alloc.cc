@@ -107,6 +107,10 @@ Allocator::alloc(unsigned long size, unsigned long flags, unsigned long align)
 
       mo = new (&_quota) Moe::Dataspace_annon(size, true, align);
     }
+  else if (flags & L4Re::Mem_alloc::Super_pages)
+    mo = Moe::Dataspace_noncont::create(&_quota, size,
+                                        Moe::Dataspace::Writable,
+                                        L4_SUPERPAGESHIFT);
   else
     mo = Moe::Dataspace_noncont::create(&_quota, size);
 
@@ -45,14 +45,19 @@ Moe::Dataspace_noncont::free_page(Page &p) const throw()
   p.set(0,0);
 }
 
+/*
+ * A page larger than L4_PAGESIZE is sent as a whole only if the receive
+ * window can take it: the hot spot has to sit at the same offset within
+ * the page as the dataspace offset, and the page has to fit into
+ * [min, max].  Otherwise, e.g., after the client unmapped part of a region
+ * and the page no longer fits, the fault is answered with the single
+ * L4_PAGESIZE part of the page containing the offset.
+ */
 Moe::Dataspace::Address
 Moe::Dataspace_noncont::address(l4_addr_t offset,
-                                Ds_rw rw, l4_addr_t,
-                                l4_addr_t, l4_addr_t) const
+                                Ds_rw rw, l4_addr_t hot_spot,
+                                l4_addr_t min, l4_addr_t max) const
 {
-  // XXX: There may be a problem with data spaces with
-  //      page_size() > L4_PAGE_SIZE
-  //      MUST review that!!
   if (!check_limit(offset))
     return Address(-L4_ERANGE);
 
@@ -85,7 +90,18 @@ Moe::Dataspace_noncont::address(l4_addr_t offset,
       memset(*p, 0, page_size());
     }
 
-  return Address(l4_addr_t(*p), page_shift(), rw, offset & (page_size()-1));
+  l4_addr_t offs = offset & (page_size() - 1);
+  unsigned char order = page_shift();
+  if (order > L4_PAGESHIFT)
+    {
+      l4_addr_t map_base = l4_trunc_size(hot_spot, order);
+      if (((hot_spot ^ offset) & (page_size() - 1))
+          || map_base < min || map_base + (page_size() - 1) > max)
+        order = L4_PAGESHIFT;
+    }
+
+  return Address(l4_addr_t(*p) + l4_trunc_size(offs, order), order, rw,
+                 offs & ((1UL << order) - 1));
 }
 
 int
@@ -166,8 +182,9 @@ namespace {
   class Mem_one_page : public Moe::Dataspace_noncont
   {
   public:
-    Mem_one_page(unsigned long size, unsigned long flags) throw()
-    : Moe::Dataspace_noncont(size, flags)
+    Mem_one_page(unsigned long size, unsigned long flags,
+                 unsigned char page_shift) throw()
+    : Moe::Dataspace_noncont(size, flags, page_shift)
     {}
 
     ~Mem_one_page() throw()
@@ -193,8 +210,9 @@ namespace {
   public:
     unsigned long meta_size() const throw()
     { return (l4_round_size(num_pages()*sizeof(unsigned long), Meta_align_bits)); }
-    Mem_small(unsigned long size, unsigned long flags)
-    : Moe::Dataspace_noncont(size, flags)
+    Mem_small(unsigned long size, unsigned long flags,
+              unsigned char page_shift)
+    : Moe::Dataspace_noncont(size, flags, page_shift)
     {
       pages = (unsigned long*)Page_alloc::_alloc(quota(), meta_size(), Meta_align);
       memset(pages, 0, meta_size());
@@ -210,10 +228,10 @@ namespace {
     }
 
     Page &page(unsigned long offs) const throw()
-    { return (Page &)(pages[offs >> 12]); }
+    { return (Page &)(pages[offs >> page_shift()]); }
 
     Page &alloc_page(unsigned long offs) const throw()
-    { return (Page &)(pages[offs >> 12]); }
+    { return (Page &)(pages[offs >> page_shift()]); }
 
   };
 
@@ -235,8 +253,8 @@ namespace {
 
     public:
       Page *l2() const throw() { return (Page*)(p & ~0xfffUL); }
-      Page &operator [] (unsigned long offs) throw()
-      { return l2()[(offs >> 12) & (entries2()-1)]; }
+      Page &operator [] (unsigned long idx) throw()
+      { return l2()[idx & (entries2()-1)]; }
       Page *operator * () const throw() { return l2(); }
       unsigned long cnt() const throw() { return p & 0xfffUL; }
       void inc() throw() { p = (p & ~0xfffUL) | (((p & 0xfffUL)+1) & 0xfffUL); }
@@ -245,7 +263,7 @@ namespace {
     };
 
     L1 &__p(unsigned long offs) const throw()
-    { return ((L1*)pages)[(offs >> 12) / entries2()]; }
+    { return ((L1*)pages)[(offs >> page_shift()) / entries2()]; }
 
   public:
     unsigned long entries1() const throw()
@@ -254,8 +272,9 @@ namespace {
     long meta1_size() const throw()
     { return (entries1() * sizeof(unsigned long) + 1023) & ~1023; }
 
-    Mem_big(unsigned long size, unsigned long flags)
-    : Moe::Dataspace_noncont(size, flags)
+    Mem_big(unsigned long size, unsigned long flags,
+            unsigned char page_shift)
+    : Moe::Dataspace_noncont(size, flags, page_shift)
     {
       pages = (unsigned long*)Page_alloc::_alloc(quota(), meta1_size(), 1024);
       memset(pages, 0, meta1_size());
@@ -268,7 +287,7 @@ namespace {
           free_page(page(i));
         }
 
-      for (unsigned long i = 0; i < size(); i+=page_size()*1024)
+      for (unsigned long i = 0; i < size(); i+=page_size()*entries2())
         {
           L1 &p = __p(i); 
 
@@ -286,7 +305,7 @@ namespace {
       if (!__p(offs).cnt())
         return invalid_page;
 
-      return __p(offs)[offs];
+      return __p(offs)[offs >> page_shift()];
     }
 
     Page &alloc_page(unsigned long offs) const
@@ -300,7 +319,7 @@ namespace {
           memset(a, 0, meta2_size());
         }
 
-      Page &_pa = _p[offs];
+      Page &_pa = _p[offs >> page_shift()];
 
       if (!_pa.valid())
         _p.inc();
@@ -315,13 +334,14 @@ namespace {
 
 Moe::Dataspace_noncont *
 Moe::Dataspace_noncont::create(Quota *q, unsigned long size,
-                               unsigned long flags)
+                               unsigned long flags, unsigned char page_shift)
 {
-  if (size <= L4_PAGESIZE)
-    return new (q) Mem_one_page(size, flags);
-  else if (size <= L4_PAGESIZE * (L4_PAGESIZE/sizeof(unsigned long)))
-    return new (q) Mem_small(size, flags);
+  unsigned long ps = 1UL << page_shift;
+  if (size <= ps)
+    return new (q) Mem_one_page(size, flags, page_shift);
+  else if (size <= ps * (L4_PAGESIZE/sizeof(unsigned long)))
+    return new (q) Mem_small(size, flags, page_shift);
   else
-    return new (q) Mem_big(size, flags);
+    return new (q) Mem_big(size, flags, page_shift);
 }
 
@@ -48,8 +48,9 @@ public:
 
   bool is_static() const throw() { return false; }
 
-  Dataspace_noncont(unsigned long size, unsigned long flags = Writable) throw()
-  : Dataspace(size, flags | Cow_enabled), pages(0)
+  Dataspace_noncont(unsigned long size, unsigned long flags = Writable,
+                    unsigned char page_shift = L4_PAGESHIFT) throw()
+  : Dataspace(size, flags | Cow_enabled), pages(0), _page_shift(page_shift)
   {}
 
   virtual ~Dataspace_noncont() {}
@@ -59,7 +60,7 @@ public:
                   l4_addr_t min = 0, l4_addr_t max = ~0) const;
   void unmap(bool ro = false) const throw();
 
-  unsigned long page_shift() const throw() { return L4_LOG2_PAGESIZE; }
+  unsigned long page_shift() const throw() { return _page_shift; }
 
   int pre_allocate(l4_addr_t offset, l4_size_t size, unsigned rights);
 
@@ -93,10 +94,13 @@ public:
   long clear(unsigned long offs, unsigned long size) const throw();
 
   static Dataspace_noncont *create(Quota *q, unsigned long size,
-      unsigned long flags = Writable);
+      unsigned long flags = Writable,
+      unsigned char page_shift = L4_PAGESHIFT);
 
 protected:
   unsigned long *pages;
 
+private:
+  unsigned char const _page_shift;
 };
 };
@@ -33,6 +33,7 @@ public:
     Parser     = 0x100,
     Boot_fs    = 0x200,
     Name_space = 0x400,
+    Sched      = 0x800,
   };
 
   struct Dbg_bits { char const *n; unsigned long bits; };
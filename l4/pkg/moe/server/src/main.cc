@@ -39,6 +39,7 @@
 #include "name_space.h"
 #include "page_alloc.h"
 #include "pages.h"
+#include "sched_proxy.h"
 #include "vesa_fb.h"
 #include "dataspace_static.h"
 #include "debug.h"
@@ -260,13 +261,34 @@ static void GC_CALLBACK finalization_notifier()
 }
 
 class Loop_hooks :
-  public L4::Ipc_svr::Ignore_errors,
-  public L4::Ipc_svr::Default_timeout,
-  public L4::Ipc_svr::Compound_reply
+  public L4::Ipc_svr::Ignore_errors
 {
 public:
-  static void setup_wait(L4::Ipc::Istream &istr, L4::Ipc_svr::Reply_mode)
+  enum { Timeout_br = 8 };
+
+  static l4_timeout_t timeout()
+  {
+    if (!Sched_proxy::balancing())
+      return L4_IPC_SEND_TIMEOUT_0;
+
+    return l4_timeout(L4_IPC_TIMEOUT_0,
+                      l4_timeout_abs(Sched_proxy::next_balance(), Timeout_br));
+  }
+
+  // balancing uses the UTCB, so the reply must not be combined with the
+  // following wait when it is due
+  static L4::Ipc_svr::Reply_mode before_reply(long, L4::Ipc::Ostream const &)
+  {
+    return Sched_proxy::balance_due()
+           ? L4::Ipc_svr::Reply_separate
+           : L4::Ipc_svr::Reply_compound;
+  }
+
+  static void setup_wait(L4::Ipc::Istream &istr, L4::Ipc_svr::Reply_mode mode)
   {
+    if (mode == L4::Ipc_svr::Reply_separate && Sched_proxy::balance_due())
+      Sched_proxy::balance();
+
     GC_collect_a_little();
     istr.reset();
     istr << L4::Ipc::Small_buf(Rcv_cap << L4_CAP_SHIFT,  L4_RCV_ITEM_LOCAL_ID);
@@ -365,6 +387,7 @@ static Dbg_bits const dbb[] =
    {"loader",     Dbg::Loader},
    {"ldr",        Dbg::Loader},
    {"ns",         Dbg::Name_space},
+   {"sched",      Dbg::Sched},
    {"all",        ~0UL},
    {0,0}};
 
@@ -435,7 +458,20 @@ static void hdl_ldr_flags(cxx::String const &args)
 
 
 
+static void hdl_balance(cxx::String const &args)
+{
+  unsigned period;
+  if (args.from_dec(&period) != args.len() || !period)
+    {
+      warn.printf("invalid balancing period '%.*s'\n", args.len(), args.start());
+      return;
+    }
+
+  Sched_proxy::set_balance_period(period);
+}
+
 static Get_opt const _options[] = {
+      {"--balance=",   hdl_balance },
       {"--debug=",     hdl_debug },
       {"--init=",      hdl_init },
       {"--l4re-dbg=",  hdl_l4re_dbg },
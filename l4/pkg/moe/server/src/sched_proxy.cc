@@ -12,7 +12,10 @@
 
 #include <algorithm>
 #include <l4/re/env>
+#include <l4/sys/kip.h>
 #include <l4/sys/scheduler>
+#include <l4/sys/task.h>
+#include <l4/sys/thread>
 
 //#include <cstdio>
 
@@ -77,7 +80,31 @@ l4_sched_cpu_set_t operator & (l4_sched_cpu_set_t const &a, l4_sched_cpu_set_t c
     }
 }
 
+static bool
+in_set(l4_sched_cpu_set_t const &s, unsigned cpu)
+{
+  unsigned char g = s.granularity & (sizeof(l4_umword_t) * 8 - 1);
+  l4_umword_t offs = s.offset & (~0UL << g);
+  if (cpu < offs)
+    return false;
+
+  l4_umword_t b = (cpu - offs) >> g;
+  return b < sizeof(l4_umword_t) * 8 && (s.map & (1UL << b));
+}
+
+static l4_cpu_time_t
+now()
+{ return l4_kip_clock(_current_kip); }
+
+static l4_kernel_clock_t
+clock_mr0()
+{ return *reinterpret_cast<l4_kernel_clock_t const *>(l4_utcb_mr()->mr); }
+
 Sched_proxy::List Sched_proxy::_list;
+unsigned Sched_proxy::_balance_period;
+l4_cpu_time_t Sched_proxy::_last_balance;
+l4_umword_t Sched_proxy::_online;
+Sched_proxy::Cpu_load Sched_proxy::_load[Max_cpus];
 
 Sched_proxy::Sched_proxy() :
   Icu(1, &_scheduler_irq),
@@ -111,6 +138,9 @@ Sched_proxy::rescan_cpus()
 
 Sched_proxy::~Sched_proxy()
 {
+  while (!_threads.empty())
+    drop_thread(_threads.front());
+
   _list.remove(this);
 }
 
@@ -146,6 +176,8 @@ Sched_proxy::run_thread(L4::Cap<L4::Thread> thread, l4_sched_param_t const &sp)
   l4_sched_param_t s = sp;
   s.prio = std::min(sp.prio + _prio_offset, _prio_limit);
   s.affinity = sp.affinity & _cpus;
+  if (_balance_period)
+    return place_thread(thread, s);
 #if 0
   printf("loader[%p] run_thread: o=%u scheduler affinity = %lx sp.m=%lx sp.o=%u sp.g=%u\n",
       this, _cpus.offset, _cpus.map, sp.affinity.map, (unsigned)sp.affinity.offset, (unsigned)sp.affinity.granularity);
@@ -160,6 +192,268 @@ Sched_proxy::idle_time(l4_sched_cpu_set_t const &)
 { return -L4_ENOSYS; }
 
 
+/*
+ * Load balancing
+ *
+ * Threads that may run on more than one CPU are pinned to a single CPU of
+ * their set by the proxy, which keeps a capability to each of them.  Every
+ * balancing period the busy time of each CPU is derived from the idle
+ * time the kernel reports for it, and the CPU time of each balanced thread
+ * from its thread statistics.  Threads are then moved from the busiest to
+ * the least busy CPU, as long as that shrinks the difference between the
+ * two.  A thread the client bound to a single CPU is never moved.
+ */
+
+void
+Sched_proxy::set_balance_period(unsigned period)
+{
+  l4_umword_t max = 0;
+  l4_sched_cpu_set_t c = l4_sched_cpu_set(0, 0, 0);
+  if (l4_error(L4Re::Env::env()->scheduler()->info(&max, &c)) < 0)
+    return;
+
+  _online = c.map;
+  _balance_period = period * 1000;
+  _last_balance = now();
+  sample_cpus(0);
+}
+
+bool
+Sched_proxy::balance_due()
+{ return _balance_period && next_balance() <= now(); }
+
+Sched_proxy::Thread_info *
+Sched_proxy::find_thread(L4::Cap<L4::Thread> thread)
+{
+  for (Thread_list::Iterator i = _threads.begin(); i != _threads.end(); ++i)
+    if (l4_msgtag_label(L4Re::Env::env()->task()->cap_equal(thread, i->cap)))
+      return *i;
+
+  return 0;
+}
+
+void
+Sched_proxy::drop_thread(Thread_info *t)
+{
+  --_load[t->cpu].threads;
+  _threads.remove(t);
+  object_pool.cap_alloc()->free(t->cap);
+  delete t;
+}
+
+unsigned
+Sched_proxy::idlest_cpu(l4_sched_cpu_set_t const &cpus)
+{
+  unsigned best = Max_cpus;
+  for (unsigned i = 0; i < Max_cpus; ++i)
+    {
+      if (!(_online & (1UL << i)) || !in_set(cpus, i))
+        continue;
+
+      if (best == Max_cpus
+          || _load[i].busy < _load[best].busy
+          || (_load[i].busy == _load[best].busy
+              && _load[i].threads < _load[best].threads))
+        best = i;
+    }
+  return best;
+}
+
+int
+Sched_proxy::place_thread(L4::Cap<L4::Thread> thread,
+                          l4_sched_param_t const &sp)
+{
+  L4::Cap<L4::Scheduler> sched = L4Re::Env::env()->scheduler();
+  Thread_info *t = find_thread(thread);
+
+  unsigned cpu = idlest_cpu(sp.affinity);
+  unsigned n = 0;
+  for (unsigned i = 0; i < Max_cpus; ++i)
+    if ((_online & (1UL << i)) && in_set(sp.affinity, i))
+      ++n;
+
+  if (n < 2)
+    {
+      // the client chose the CPU, leave the thread alone
+      if (t)
+        drop_thread(t);
+      return l4_error(sched->run_thread(thread, sp));
+    }
+
+  l4_sched_param_t s = sp;
+  s.affinity = l4_sched_cpu_set(cpu, 0);
+  int r = l4_error(sched->run_thread(thread, s));
+  if (r < 0)
+    return r;
+
+  if (!t)
+    {
+      L4::Cap<L4::Thread> c = object_pool.cap_alloc()->alloc<L4::Thread>();
+      if (!c.is_valid())
+        return 0; // runs unbalanced
+
+      // take the received capability over, it is not needed any more
+      L4Re::Env::env()->task()->map(L4Re::This_task,
+                                    thread.fpage(L4_CAP_FPAGE_RWSD),
+                                    c.snd_base(L4_MAP_ITEM_GRANT));
+      t = new Thread_info;
+      t->cap = c;
+      _threads.push_front(t);
+    }
+  else
+    --_load[t->cpu].threads;
+
+  t->sp = sp;
+  t->cpu = cpu;
+  t->load = 0;
+  t->time = 0;
+  if (!l4_error(t->cap->stats_time()))
+    t->time = clock_mr0();
+
+  ++_load[cpu].threads;
+  return 0;
+}
+
+int
+Sched_proxy::migrate(Thread_info *t, unsigned cpu)
+{
+  l4_sched_param_t s = t->sp;
+  s.affinity = l4_sched_cpu_set(cpu, 0);
+  int r = l4_error(L4Re::Env::env()->scheduler()->run_thread(t->cap, s));
+  if (r < 0)
+    return r;
+
+  --_load[t->cpu].threads;
+  ++_load[cpu].threads;
+  t->cpu = cpu;
+  return 0;
+}
+
+bool
+Sched_proxy::sample_cpus(l4_cpu_time_t period)
+{
+  L4::Cap<L4::Scheduler> sched = L4Re::Env::env()->scheduler();
+  bool imbalance = false;
+  for (unsigned i = 0; i < Max_cpus; ++i)
+    {
+      if (!(_online & (1UL << i)))
+        continue;
+
+      if (l4_error(sched->idle_time(l4_sched_cpu_set(i, 0))) < 0)
+        continue;
+
+      l4_kernel_clock_t idle = clock_mr0();
+      l4_kernel_clock_t d = idle - _load[i].idle;
+      _load[i].idle = idle;
+      _load[i].busy = d < period ? period - d : 0;
+      if (_load[i].threads)
+        imbalance = true;
+    }
+  return imbalance;
+}
+
+void
+Sched_proxy::sample_threads()
+{
+  for (List::Iterator p = _list.begin(); p != _list.end(); ++p)
+    for (Thread_list::Iterator i = p->_threads.begin();
+         i != p->_threads.end();)
+      {
+        Thread_info *t = *i;
+        if (l4_error(t->cap->stats_time()) < 0)
+          {
+            // the thread is gone, the iterator moves on by itself
+            p->drop_thread(t);
+            continue;
+          }
+
+        l4_kernel_clock_t time = clock_mr0();
+        t->load = time - t->time;
+        t->time = time;
+        ++i;
+      }
+}
+
+/**
+ * Find the thread on \a src that, moved to \a dst, evens out the two
+ * CPUs best, given their difference in busy time \a diff.
+ */
+Sched_proxy::Thread_info *
+Sched_proxy::pick_thread(unsigned src, unsigned dst, l4_kernel_clock_t diff)
+{
+  Thread_info *best = 0;
+  l4_kernel_clock_t best_rest = diff;
+  for (List::Iterator p = _list.begin(); p != _list.end(); ++p)
+    for (Thread_list::Iterator i = p->_threads.begin();
+         i != p->_threads.end(); ++i)
+      {
+        Thread_info *t = *i;
+        if (t->cpu != src || !t->load || t->load >= diff
+            || !in_set(t->sp.affinity, dst))
+          continue;
+
+        // the difference remaining after the move
+        l4_kernel_clock_t rest = diff > 2 * t->load
+                               ? diff - 2 * t->load : 2 * t->load - diff;
+        if (rest < best_rest)
+          {
+            best = t;
+            best_rest = rest;
+          }
+      }
+  return best;
+}
+
+void
+Sched_proxy::balance()
+{
+  enum { Max_moves = 4 };
+
+  l4_cpu_time_t t = now();
+  l4_cpu_time_t period = t - _last_balance;
+  _last_balance = t;
+
+  if (!sample_cpus(period))
+    return;
+
+  sample_threads();
+
+  for (unsigned m = 0; m < Max_moves; ++m)
+    {
+      unsigned src = Max_cpus, dst = Max_cpus;
+      for (unsigned i = 0; i < Max_cpus; ++i)
+        {
+          if (!(_online & (1UL << i)))
+            continue;
+          if (_load[i].threads
+              && (src == Max_cpus || _load[i].busy > _load[src].busy))
+            src = i;
+          if (dst == Max_cpus || _load[i].busy < _load[dst].busy)
+            dst = i;
+        }
+
+      if (src == Max_cpus || dst == Max_cpus
+          || _load[src].busy <= _load[dst].busy)
+        return;
+
+      // ignore small differences, moving a thread has its cost too
+      l4_kernel_clock_t diff = _load[src].busy - _load[dst].busy;
+      if (diff < period / 8)
+        return;
+
+      Thread_info *t = pick_thread(src, dst, diff);
+      if (!t || migrate(t, dst) < 0)
+        return;
+
+      Dbg(Dbg::Sched).printf("balance: %lx from CPU%u to CPU%u, load %llu\n",
+                             t->cap.cap(), src, dst,
+                             (unsigned long long)t->load);
+      _load[src].busy -= t->load;
+      _load[dst].busy += t->load;
+    }
+}
+
+
 L4::Cap<L4::Thread>
 Sched_proxy::received_thread(L4::Ipc::Snd_fpage const &fp)
 {
@@ -12,6 +12,8 @@
 #include <l4/cxx/ipc_server>
 #include <l4/libkproxy/scheduler_svr>
 
+#include <gc.h>
+
 #include "globals.h"
 #include "server_obj.h"
 
@@ -66,9 +68,59 @@ public:
   Icu::Irq *scheduler_irq() { return &_scheduler_irq; }
   Icu::Irq const *scheduler_irq() const { return &_scheduler_irq; }
 
+  /**
+   * \brief Enable load balancing.
+   * \param period  Balancing period in ms, 0 disables balancing.
+   */
+  static void set_balance_period(unsigned period);
+  static bool balancing() { return _balance_period; }
+  static l4_cpu_time_t next_balance() { return _last_balance + _balance_period; }
+  static bool balance_due();
+  static void balance();
+
 private:
   friend class Cpu_hotplug_server;
 
+  enum { Max_cpus = sizeof(l4_umword_t) * 8 };
+
+  /**
+   * A thread that may run on more than one CPU and is placed by the
+   * balancer.
+   */
+  struct Thread_info : public cxx::H_list_item
+  {
+    L4::Cap<L4::Thread> cap;
+    l4_sched_param_t sp;    ///< parameters as requested by the client
+    unsigned cpu;           ///< CPU the thread is placed on
+    l4_kernel_clock_t time; ///< consumed time at the last sample
+    l4_kernel_clock_t load; ///< time consumed during the last period
+
+    void *operator new (size_t s) { return GC_MALLOC(s); }
+    void operator delete (void *) {}
+  };
+
+  typedef cxx::H_list<Thread_info> Thread_list;
+
+  struct Cpu_load
+  {
+    l4_kernel_clock_t idle; ///< idle time at the last sample
+    l4_kernel_clock_t busy; ///< busy time during the last period
+    unsigned threads;       ///< number of balanced threads on the CPU
+  };
+
+  int place_thread(L4::Cap<L4::Thread> thread, l4_sched_param_t const &sp);
+  Thread_info *find_thread(L4::Cap<L4::Thread> thread);
+  void drop_thread(Thread_info *t);
+
+  static int migrate(Thread_info *t, unsigned cpu);
+  static unsigned idlest_cpu(l4_sched_cpu_set_t const &cpus);
+  static bool sample_cpus(l4_cpu_time_t period);
+  static void sample_threads();
+  static Thread_info *pick_thread(unsigned src, unsigned dst,
+                                  l4_kernel_clock_t diff);
+
+  Thread_list _threads;
+
   l4_sched_cpu_set_t _cpus, _real_cpus, _cpu_mask;
   unsigned _max_cpus;
   unsigned _prio_offset, _prio_limit;
@@ -76,5 +128,10 @@ private:
 
   typedef cxx::H_list_bss<Sched_proxy> List;
   static List _list;
+
+  static unsigned _balance_period;
+  static l4_cpu_time_t _last_balance;
+  static l4_umword_t _online;
+  static Cpu_load _load[Max_cpus];
 };
 